@@ -30,18 +30,34 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*
- * map_bench.c -- benchmarks for: ctree, btree, rbtree, hashmap_atomic
- * and hashmap_tx from examples.
+ * map_bench.c -- benchmarks for: ctree, btree, rbtree, hashmap_atomic,
+ * hashmap_tx and hashmap_mt from examples.
+ *
+ * The map_ycsb benchmark runs the YCSB core workloads against any of the
+ * maps or against a running kv_server.
  */
 #include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "benchmark.h"
 #include "map.h"
 #include "map_ctree.h"
 #include "map_btree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_cpp.h"
+#include "map_hashmap_mt.h"
+#include "hashmap.h"
+#include "kv_protocol.h"
 
 #define	FACTOR	2
 #define	ALLOC_OVERHEAD	64
@@ -62,15 +78,23 @@ struct root {
 
 #define	SIZE_PER_KEY	1024
 
-static const struct {
+struct map_type {
 	const char *str;
 	const struct map_ops *ops;
-} map_types[] = {
-	{"ctree",		MAP_CTREE},
-	{"btree",		MAP_BTREE},
-	{"rbtree",		MAP_RBTREE},
-	{"hashmap_tx",		MAP_HASHMAP_TX},
-	{"hashmap_atomic",	MAP_HASHMAP_ATOMIC},
+	/* the map synchronizes concurrent operations itself */
+	bool concurrent;
+};
+
+static const struct map_type map_types[] = {
+	{"ctree",		MAP_CTREE,		true},
+	{"btree",		MAP_BTREE,		false},
+	{"rbtree",		MAP_RBTREE,		true},
+	{"bptree",		MAP_BPTREE,		false},
+	{"art",			MAP_ART,		true},
+	{"hashmap_tx",		MAP_HASHMAP_TX,		false},
+	{"hashmap_atomic",	MAP_HASHMAP_ATOMIC,	false},
+	{"hashmap_cpp",		MAP_HASHMAP_CPP,	false},
+	{"hashmap_mt",		MAP_HASHMAP_MT,		true},
 };
 
 #define	MAP_TYPES_NUM	(sizeof (map_types) / sizeof (map_types[0]))
@@ -81,16 +105,35 @@ struct map_bench_args {
 	char *type;
 	bool ext_tx;
 	bool alloc;
+	unsigned scan_len;
+	unsigned batch;
+
+	/* map_ycsb only */
+	char *workload;
+	char *dist;
+	unsigned theta;
+	unsigned hot_keys;
+	unsigned hot_ops;
+	unsigned read;
+	unsigned update;
+	unsigned insert;
+	unsigned scan;
+	unsigned rmw;
+	uint64_t records;
+	uint64_t warmup;
+	char *server;
 };
 
 struct map_bench_worker {
 	uint64_t *keys;
 	size_t nkeys;
+	PMEMoid *values;
 };
 
 struct map_bench {
 	struct map_ctx *mapc;
 	pthread_mutex_t lock;
+	bool concurrent;
 	PMEMobjpool *pop;
 	off_t pool_size;
 
@@ -107,6 +150,8 @@ struct map_bench {
 	int (*insert)(struct map_bench *, uint64_t);
 	int (*remove)(struct map_bench *, uint64_t);
 	int (*get)(struct map_bench *, uint64_t);
+
+	struct ycsb *ycsb;
 };
 
 static struct benchmark_clo map_bench_clos[] = {
@@ -114,7 +159,8 @@ static struct benchmark_clo map_bench_clos[] = {
 		.opt_short	= 'T',
 		.opt_long	= "type",
 		.descr		= "Type of container "
-			"[ctree|btree|rbtree|hashmap_tx|hashmap_atomic]",
+			"[ctree|btree|rbtree|bptree|art|hashmap_tx|"
+			"hashmap_atomic|hashmap_cpp|hashmap_mt]",
 		.off		= clo_field_offset(struct map_bench_args, type),
 		.type		= CLO_TYPE_STR,
 		.def		= "ctree",
@@ -166,8 +212,229 @@ static struct benchmark_clo map_bench_clos[] = {
 						alloc),
 		.type		= CLO_TYPE_FLAG,
 	},
+	{
+		.opt_short	= 'l',
+		.opt_long	= "scan-len",
+		.descr		= "Number of pairs visited by a range scan",
+		.off		= clo_field_offset(struct map_bench_args,
+						scan_len),
+		.type		= CLO_TYPE_UINT,
+		.def		= "100",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						scan_len),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'b',
+		.opt_long	= "batch",
+		.descr		= "Number of keys per batched operation",
+		.off		= clo_field_offset(struct map_bench_args,
+						batch),
+		.type		= CLO_TYPE_UINT,
+		.def		= "1",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						batch),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX,
+		},
+	},
+	/* the options below are used only by map_ycsb */
+	{
+		.opt_short	= 'w',
+		.opt_long	= "workload",
+		.descr		= "YCSB workload [a|b|c|d|e|f|custom]",
+		.off		= clo_field_offset(struct map_bench_args,
+						workload),
+		.type		= CLO_TYPE_STR,
+		.def		= "a",
+	},
+	{
+		.opt_short	= 'D',
+		.opt_long	= "distribution",
+		.descr		= "Key distribution "
+			"[default|zipfian|uniform|latest|hotspot]",
+		.off		= clo_field_offset(struct map_bench_args, dist),
+		.type		= CLO_TYPE_STR,
+		.def		= "default",
+	},
+	{
+		.opt_long	= "zipf-theta",
+		.descr		= "Skew of the zipfian and latest "
+				"distributions in hundredths",
+		.off		= clo_field_offset(struct map_bench_args,
+						theta),
+		.type		= CLO_TYPE_UINT,
+		.def		= "99",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, theta),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= 99,
+		},
+	},
+	{
+		.opt_long	= "hot-keys",
+		.descr		= "Percentage of keys in the hot set of the "
+				"hotspot distribution",
+		.off		= clo_field_offset(struct map_bench_args,
+						hot_keys),
+		.type		= CLO_TYPE_UINT,
+		.def		= "1",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						hot_keys),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "hot-ops",
+		.descr		= "Percentage of operations hitting the "
+				"hot set of the hotspot distribution",
+		.off		= clo_field_offset(struct map_bench_args,
+						hot_ops),
+		.type		= CLO_TYPE_UINT,
+		.def		= "90",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						hot_ops),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "read",
+		.descr		= "Percentage of reads in the custom "
+				"workload",
+		.off		= clo_field_offset(struct map_bench_args,
+						read),
+		.type		= CLO_TYPE_UINT,
+		.def		= "50",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, read),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "update",
+		.descr		= "Percentage of updates in the custom "
+				"workload",
+		.off		= clo_field_offset(struct map_bench_args,
+						update),
+		.type		= CLO_TYPE_UINT,
+		.def		= "50",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, update),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "insert",
+		.descr		= "Percentage of inserts in the custom "
+				"workload",
+		.off		= clo_field_offset(struct map_bench_args,
+						insert),
+		.type		= CLO_TYPE_UINT,
+		.def		= "0",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, insert),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "scan",
+		.descr		= "Percentage of scans in the custom "
+				"workload",
+		.off		= clo_field_offset(struct map_bench_args,
+						scan),
+		.type		= CLO_TYPE_UINT,
+		.def		= "0",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, scan),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_long	= "rmw",
+		.descr		= "Percentage of read-modify-writes in the "
+				"custom workload",
+		.off		= clo_field_offset(struct map_bench_args,
+						rmw),
+		.type		= CLO_TYPE_UINT,
+		.def		= "0",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args, rmw),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100,
+		},
+	},
+	{
+		.opt_short	= 'R',
+		.opt_long	= "records",
+		.descr		= "Number of records inserted in the "
+				"load phase",
+		.off		= clo_field_offset(struct map_bench_args,
+						records),
+		.type		= CLO_TYPE_UINT,
+		.def		= "100000",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						records),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT64_MAX,
+		},
+	},
+	{
+		.opt_long	= "warmup",
+		.descr		= "Number of not measured operations run "
+				"by each thread before the benchmark",
+		.off		= clo_field_offset(struct map_bench_args,
+						warmup),
+		.type		= CLO_TYPE_UINT,
+		.def		= "0",
+		.type_uint = {
+			.size	= clo_field_size(struct map_bench_args,
+						warmup),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT64_MAX,
+		},
+	},
+	{
+		.opt_long	= "server",
+		.descr		= "Address (host:port) of kv_server to run "
+				"the workload against, none for a local map",
+		.off		= clo_field_offset(struct map_bench_args,
+						server),
+		.type		= CLO_TYPE_STR,
+		.def		= "none",
+	},
 };
 
+/* number of the map_ycsb only options at the end of map_bench_clos */
+#define	MAP_YCSB_NCLOS	13
+
+/* number of the options common for all map benchmarks */
+#define	MAP_BENCH_NCLOS	(ARRAY_SIZE(map_bench_clos) - MAP_YCSB_NCLOS)
+
 /*
  * mutex_lock_nofail -- locks mutex and aborts if locking failed
  */
@@ -194,6 +461,26 @@ mutex_unlock_nofail(pthread_mutex_t *lock)
 	}
 }
 
+/*
+ * map_lock -- serializes the operations on maps which aren't thread-safe
+ */
+static void
+map_lock(struct map_bench *map_bench)
+{
+	if (!map_bench->concurrent)
+		mutex_lock_nofail(&map_bench->lock);
+}
+
+/*
+ * map_unlock -- counterpart of map_lock
+ */
+static void
+map_unlock(struct map_bench *map_bench)
+{
+	if (!map_bench->concurrent)
+		mutex_unlock_nofail(&map_bench->lock);
+}
+
 /*
  * get_key -- return 64-bit random key
  */
@@ -213,12 +500,12 @@ get_key(unsigned int *seed, uint64_t max_key)
 /*
  * parse_map_type -- parse type of map
  */
-static const struct map_ops *
+static const struct map_type *
 parse_map_type(const char *str)
 {
 	for (int i = 0; i < MAP_TYPES_NUM; i++) {
 		if (strcmp(str, map_types[i].str) == 0)
-			return map_types[i].ops;
+			return &map_types[i];
 	}
 
 	return NULL;
@@ -265,11 +552,11 @@ map_remove_op(struct benchmark *bench, struct operation_info *info)
 	struct map_bench_worker *tworker = info->worker->priv;
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_lock(map_bench);
 
 	int ret = map_bench->remove(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_unlock(map_bench);
 
 	return ret;
 }
@@ -313,11 +600,11 @@ map_insert_op(struct benchmark *bench, struct operation_info *info)
 	struct map_bench_worker *tworker = info->worker->priv;
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_lock(map_bench);
 
 	int ret = map_bench->insert(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_unlock(map_bench);
 
 	return ret;
 }
@@ -354,11 +641,101 @@ map_get_op(struct benchmark *bench, struct operation_info *info)
 	struct map_bench_worker *tworker = info->worker->priv;
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_lock(map_bench);
 
 	int ret = map_bench->get(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_unlock(map_bench);
+
+	return ret;
+}
+
+/*
+ * map_scan_cb -- counts down the pairs left to visit by a range scan
+ */
+static int
+map_scan_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	size_t *left = arg;
+
+	return --(*left) == 0;
+}
+
+/*
+ * map_scan_op -- main operation for map_scan benchmark
+ */
+static int
+map_scan_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct map_bench_worker *tworker = info->worker->priv;
+	uint64_t key = tworker->keys[info->index];
+	size_t left = map_bench->margs->scan_len;
+
+	map_lock(map_bench);
+
+	map_range(map_bench->mapc, map_bench->map, key, UINT64_MAX,
+			map_scan_cb, &left);
+
+	map_unlock(map_bench);
+
+	/* the scan starts at an existing key */
+	return left == map_bench->margs->scan_len;
+}
+
+/*
+ * map_insert_batch_op -- main operation for map_insert_batch benchmark
+ */
+static int
+map_insert_batch_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct map_bench_worker *tworker = info->worker->priv;
+	size_t batch = map_bench->margs->batch;
+	uint64_t *keys = &tworker->keys[info->index * batch];
+	int ret = 0;
+
+	map_lock(map_bench);
+
+	TX_BEGIN(map_bench->pop) {
+		for (size_t i = 0; i < batch; i++) {
+			tworker->values[i] = map_bench->margs->alloc ?
+				pmemobj_tx_alloc(map_bench->args->dsize,
+					OBJ_TYPE_NUM) :
+				map_bench->root_oid;
+		}
+
+		ret = map_insert_batch(map_bench->mapc, map_bench->map,
+				keys, tworker->values, batch);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	map_unlock(map_bench);
+
+	return ret;
+}
+
+/*
+ * map_get_batch_op -- main operation for map_get_batch benchmark
+ */
+static int
+map_get_batch_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct map_bench_worker *tworker = info->worker->priv;
+	size_t batch = map_bench->margs->batch;
+	uint64_t *keys = &tworker->keys[info->index * batch];
+
+	map_lock(map_bench);
+
+	int ret = map_get_batch(map_bench->mapc, map_bench->map,
+			keys, tworker->values, batch);
+
+	map_unlock(map_bench);
+
+	for (size_t i = 0; ret == 0 && i < batch; i++)
+		ret = OID_IS_NULL(tworker->values[i]);
 
 	return ret;
 }
@@ -417,6 +794,7 @@ map_common_free_worker(struct benchmark *bench, struct benchmark_args *args,
 		pmemobj_tx_commit();
 		pmemobj_tx_end();
 	}
+	free(tworker->values);
 	free(tworker->keys);
 	free(tworker);
 }
@@ -513,60 +891,167 @@ err_common_free_worker:
 }
 
 /*
- * map_common_init -- common init function for map_* benchmarks
+ * map_batch_init_worker -- (internal) prepares the worker for operations
+ *	on batch keys at a time, drawing the keys with the given function
  */
 static int
-map_common_init(struct benchmark *bench, struct benchmark_args *args)
+map_batch_init_worker(struct benchmark *bench, struct benchmark_args *args,
+		struct worker_info *worker,
+		int (*keys_init)(struct benchmark *bench,
+			struct benchmark_args *args,
+			struct worker_info *worker))
 {
-	assert(bench);
-	assert(args);
-	assert(args->opts);
-
-	struct map_bench *map_bench = calloc(1, sizeof (*map_bench));
-	if (!map_bench) {
-		perror("calloc");
-		return -1;
-	}
+	int ret = map_common_init_worker(bench, args, worker);
+	if (ret)
+		return ret;
 
-	map_bench->args = args;
-	map_bench->margs = args->opts;
+	struct map_bench_args *targs = args->opts;
+	struct map_bench_worker *tworker = worker->priv;
+	size_t nkeys = tworker->nkeys * targs->batch;
 
-	const struct map_ops *ops = parse_map_type(map_bench->margs->type);
-	if (!ops) {
-		fprintf(stderr, "invalid map type value specified -- '%s'\n",
-				map_bench->margs->type);
-		goto err_free_bench;
+	uint64_t *keys = realloc(tworker->keys, nkeys * sizeof (*keys));
+	if (!keys) {
+		perror("realloc");
+		goto err_common_free_worker;
 	}
+	tworker->keys = keys;
+	tworker->nkeys = nkeys;
 
-	if (map_bench->margs->ext_tx && args->n_threads > 1) {
-		fprintf(stderr, "external transaction "
-			"requires single thread\n");
-		goto err_free_bench;
+	tworker->values = malloc(targs->batch * sizeof (*tworker->values));
+	if (!tworker->values) {
+		perror("malloc");
+		goto err_common_free_worker;
 	}
 
-	if (map_bench->margs->alloc) {
-		map_bench->insert = map_insert_alloc_op;
-		map_bench->remove = map_remove_free_op;
-		map_bench->get = map_get_obj_op;
-	} else {
-		map_bench->insert = map_insert_root_op;
-		map_bench->remove = map_remove_root_op;
-		map_bench->get = map_get_root_op;
-	}
+	if (keys_init(bench, args, worker))
+		goto err_common_free_worker;
 
-	map_bench->nkeys = args->n_threads * args->n_ops_per_thread;
-	map_bench->init_nkeys = map_bench->nkeys;
-	size_t size_per_key = map_bench->margs->alloc ?
-		SIZE_PER_KEY :
-		SIZE_PER_KEY + map_bench->args->dsize + ALLOC_OVERHEAD;
+	return 0;
+err_common_free_worker:
+	map_common_free_worker(bench, args, worker);
+	return -1;
+}
 
-	map_bench->pool_size = map_bench->nkeys * size_per_key * FACTOR;
+/*
+ * map_rand_keys_init -- (internal) assigns random keys to the worker
+ */
+static int
+map_rand_keys_init(struct benchmark *bench, struct benchmark_args *args,
+		struct worker_info *worker)
+{
+	struct map_bench_args *targs = args->opts;
+	struct map_bench_worker *tworker = worker->priv;
 
-	if (args->is_poolset) {
-		if (args->fsize < map_bench->pool_size) {
-			fprintf(stderr, "insufficient poolset size\n");
-			goto err_free_bench;
-		}
+	for (size_t i = 0; i < tworker->nkeys; i++)
+		tworker->keys[i] = get_key(&targs->seed, targs->max_key);
+
+	return 0;
+}
+
+/*
+ * map_stored_keys_init -- (internal) assigns random keys, with repetitions,
+ *	from the global keys array to the worker
+ */
+static int
+map_stored_keys_init(struct benchmark *bench, struct benchmark_args *args,
+		struct worker_info *worker)
+{
+	struct map_bench *tree = pmembench_get_priv(bench);
+	struct map_bench_args *targs = args->opts;
+	struct map_bench_worker *tworker = worker->priv;
+
+	for (size_t i = 0; i < tworker->nkeys; i++) {
+		uint64_t index = get_key(&targs->seed, tree->nkeys);
+		tworker->keys[i] = tree->keys[index];
+	}
+
+	return 0;
+}
+
+/*
+ * map_insert_batch_init_worker -- init worker function for map_insert_batch
+ * benchmark
+ */
+static int
+map_insert_batch_init_worker(struct benchmark *bench,
+		struct benchmark_args *args, struct worker_info *worker)
+{
+	return map_batch_init_worker(bench, args, worker, map_rand_keys_init);
+}
+
+/*
+ * map_get_batch_init_worker -- init worker function for map_get_batch
+ * benchmark
+ */
+static int
+map_get_batch_init_worker(struct benchmark *bench,
+		struct benchmark_args *args, struct worker_info *worker)
+{
+	return map_batch_init_worker(bench, args, worker,
+			map_stored_keys_init);
+}
+
+/*
+ * map_common_init -- common init function for map_* benchmarks
+ */
+static int
+map_common_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench);
+	assert(args);
+	assert(args->opts);
+
+	struct map_bench *map_bench = calloc(1, sizeof (*map_bench));
+	if (!map_bench) {
+		perror("calloc");
+		return -1;
+	}
+
+	map_bench->args = args;
+	map_bench->margs = args->opts;
+
+	const struct map_type *type = parse_map_type(map_bench->margs->type);
+	if (!type) {
+		fprintf(stderr, "invalid map type value specified -- '%s'\n",
+				map_bench->margs->type);
+		goto err_free_bench;
+	}
+
+	map_bench->concurrent = type->concurrent;
+
+	if (map_bench->margs->ext_tx && args->n_threads > 1) {
+		fprintf(stderr, "external transaction "
+			"requires single thread\n");
+		goto err_free_bench;
+	}
+
+	if (map_bench->margs->alloc) {
+		map_bench->insert = map_insert_alloc_op;
+		map_bench->remove = map_remove_free_op;
+		map_bench->get = map_get_obj_op;
+	} else {
+		map_bench->insert = map_insert_root_op;
+		map_bench->remove = map_remove_root_op;
+		map_bench->get = map_get_root_op;
+	}
+
+	/* map_ycsb loads its records upfront and runs warm-up operations */
+	map_bench->nkeys = args->n_threads *
+		(args->n_ops_per_thread + map_bench->margs->warmup) +
+		map_bench->margs->records;
+	map_bench->init_nkeys = map_bench->nkeys;
+	size_t size_per_key = map_bench->margs->alloc ?
+		SIZE_PER_KEY :
+		SIZE_PER_KEY + map_bench->args->dsize + ALLOC_OVERHEAD;
+
+	map_bench->pool_size = map_bench->nkeys * map_bench->margs->batch *
+		size_per_key * FACTOR;
+
+	if (args->is_poolset) {
+		if (args->fsize < map_bench->pool_size) {
+			fprintf(stderr, "insufficient poolset size\n");
+			goto err_free_bench;
+		}
 
 		map_bench->pool_size = 0;
 	} else {
@@ -587,7 +1072,7 @@ map_common_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_close;
 	}
 
-	map_bench->mapc = map_ctx_init(ops, map_bench->pop);
+	map_bench->mapc = map_ctx_init(type->ops, map_bench->pop);
 	if (!map_bench->mapc) {
 		perror("map_ctx_init");
 		goto err_destroy_lock;
@@ -684,6 +1169,14 @@ map_keys_init(struct benchmark *bench, struct benchmark_args *args)
 		ret = -1;
 	} TX_END
 
+	/*
+	 * hashmap_mt doesn't split buckets within a transaction, let it
+	 * catch up with the keys inserted above
+	 */
+	if (!ret && map_bench->mapc->ops == MAP_HASHMAP_MT)
+		ret = map_cmd(map_bench->mapc, map_bench->map,
+				HASHMAP_CMD_REBUILD, 0);
+
 	mutex_unlock_nofail(&map_bench->lock);
 
 	if (!ret)
@@ -762,59 +1255,1355 @@ map_get_exit(struct benchmark *bench, struct benchmark_args *args)
 	return map_common_exit(bench, args);
 }
 
-static struct benchmark_info map_insert_info = {
-	.name		= "map_insert",
-	.brief		= "Inserting to tree map",
-	.init		= map_common_init,
-	.exit		= map_common_exit,
-	.multithread	= true,
-	.multiops	= true,
-	.init_worker	= map_insert_init_worker,
-	.free_worker	= map_common_free_worker,
-	.operation	= map_insert_op,
-	.measure_time	= true,
-	.clos		= map_bench_clos,
-	.nclos		= ARRAY_SIZE(map_bench_clos),
-	.opts_size	= sizeof (struct map_bench_args),
-	.rm_file	= true,
-	.allow_poolset	= true,
+/*
+ * YCSB core workloads
+ *
+ * The records are numbered in the insertion order and stored under a hash
+ * of the record number, so the popular records are scattered over the key
+ * space like in YCSB with the hashed insert order. The operations and their
+ * records are drawn by init_worker, then the record is resolved against the
+ * number of records visible at the time of the operation, so the reads don't
+ * target the records which are still being inserted.
+ */
+
+enum ycsb_op_type {
+	YCSB_READ,
+	YCSB_UPDATE,
+	YCSB_INSERT,
+	YCSB_SCAN,
+	YCSB_RMW,
+
+	MAX_YCSB_OP
 };
-REGISTER_BENCHMARK(map_insert_info);
 
-static struct benchmark_info map_remove_info = {
-	.name		= "map_remove",
-	.brief		= "Inserting to tree map",
-	.init		= map_remove_init,
-	.exit		= map_remove_exit,
-	.multithread	= true,
-	.multiops	= true,
-	.init_worker	= map_remove_init_worker,
-	.free_worker	= map_common_free_worker,
-	.operation	= map_remove_op,
-	.measure_time	= true,
-	.clos		= map_bench_clos,
-	.nclos		= ARRAY_SIZE(map_bench_clos),
-	.opts_size	= sizeof (struct map_bench_args),
-	.rm_file	= true,
-	.allow_poolset	= true,
+static const char *ycsb_op_str[MAX_YCSB_OP] = {
+	[YCSB_READ] = "read",
+	[YCSB_UPDATE] = "update",
+	[YCSB_INSERT] = "insert",
+	[YCSB_SCAN] = "scan",
+	[YCSB_RMW] = "rmw",
 };
-REGISTER_BENCHMARK(map_remove_info);
 
-static struct benchmark_info map_get_info = {
-	.name		= "map_get",
-	.brief		= "Tree lookup",
-	.init		= map_bench_get_init,
-	.exit		= map_get_exit,
-	.multithread	= true,
-	.multiops	= true,
-	.init_worker	= map_bench_get_init_worker,
-	.free_worker	= map_common_free_worker,
-	.operation	= map_get_op,
-	.measure_time	= true,
-	.clos		= map_bench_clos,
-	.nclos		= ARRAY_SIZE(map_bench_clos),
-	.opts_size	= sizeof (struct map_bench_args),
-	.rm_file	= true,
-	.allow_poolset	= true,
+enum ycsb_dist {
+	YCSB_ZIPFIAN,
+	YCSB_UNIFORM,
+	YCSB_LATEST,
+	YCSB_HOTSPOT,
+
+	MAX_YCSB_DIST
 };
-REGISTER_BENCHMARK(map_get_info);
+
+static const char *ycsb_dist_str[MAX_YCSB_DIST] = {
+	[YCSB_ZIPFIAN] = "zipfian",
+	[YCSB_UNIFORM] = "uniform",
+	[YCSB_LATEST] = "latest",
+	[YCSB_HOTSPOT] = "hotspot",
+};
+
+struct ycsb_workload {
+	const char *str;
+	unsigned mix[MAX_YCSB_OP];	/* percentage of each operation type */
+	enum ycsb_dist dist;
+};
+
+static const struct ycsb_workload ycsb_workloads[] = {
+	/*	read	update	insert	scan	rmw */
+	{"a", {50,	50,	0,	0,	0}, YCSB_ZIPFIAN},
+	{"b", {95,	5,	0,	0,	0}, YCSB_ZIPFIAN},
+	{"c", {100,	0,	0,	0,	0}, YCSB_ZIPFIAN},
+	{"d", {95,	0,	5,	0,	0}, YCSB_LATEST},
+	{"e", {0,	0,	5,	95,	0}, YCSB_ZIPFIAN},
+	{"f", {50,	0,	0,	0,	50}, YCSB_ZIPFIAN},
+};
+
+#define	YCSB_RECORD_LOCKS	256
+#define	YCSB_LOAD_TX_RECORDS	1024
+#define	YCSB_REQ_OVERHEAD	64
+#define	YCSB_RESP_BUF_SIZE	4096
+
+struct ycsb_zipf {
+	uint64_t n;
+	double alpha;
+	double zetan;
+	double eta;
+	double half_pow_theta;
+};
+
+struct ycsb_conn {
+	int fd;
+	char *buf;
+	size_t size;
+	size_t len;	/* number of received bytes */
+	size_t off;	/* offset of the first not consumed byte */
+};
+
+struct ycsb_op {
+	enum ycsb_op_type type;
+	bool hot;
+	unsigned scan_len;
+	uint64_t rand;
+};
+
+struct ycsb_stats {
+	uint64_t failed;
+	size_t nlat;
+	uint64_t *lat;
+};
+
+struct ycsb {
+	unsigned mix[MAX_YCSB_OP];
+	enum ycsb_dist dist;
+	struct ycsb_zipf zipf;
+	unsigned hot_keys;
+	unsigned hot_ops;
+	size_t dsize;
+
+	uint64_t max_records;
+	uint64_t next_record;	/* number of the next inserted record */
+	uint64_t visible;	/* all records below are inserted */
+	uint8_t *done;		/* finished inserts */
+	pthread_mutex_t visible_lock;
+
+	/* protect the values stored in the thread-safe maps */
+	pthread_rwlock_t record_locks[YCSB_RECORD_LOCKS];
+
+	struct addrinfo *server;
+
+	struct ycsb_stats stats[MAX_YCSB_OP];
+	double run_time;	/* time of the slowest worker */
+};
+
+struct ycsb_worker {
+	struct ycsb_op *ops;
+	size_t nwarmup;
+	uint64_t rand_state;
+	char *value;
+	char *req;
+	struct ycsb_conn conn;
+	uint64_t failed[MAX_YCSB_OP];
+};
+
+/*
+ * ycsb_key -- (internal) returns the key of the record, the murmur3
+ *	finalizer is a bijection so the keys of all records differ and only
+ *	zero, which ctree doesn't accept, maps to zero
+ */
+static uint64_t
+ycsb_key(uint64_t recno)
+{
+	uint64_t k = recno + 1;
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+
+	return k;
+}
+
+/*
+ * ycsb_rand -- (internal) xorshift64* generator, rand_r() doesn't give
+ *	enough bits for the zipfian generator
+ */
+static uint64_t
+ycsb_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 2685821657736338717ULL;
+}
+
+/*
+ * ycsb_rand_double -- (internal) returns a random number from [0, 1)
+ */
+static double
+ycsb_rand_double(uint64_t *state)
+{
+	return (ycsb_rand(state) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/*
+ * ycsb_zipf_init -- (internal) precomputes the constants of the zipfian
+ *	generator of n items, as in J. Gray et al., "Quickly Generating
+ *	Billion-Record Synthetic Databases"
+ */
+static void
+ycsb_zipf_init(struct ycsb_zipf *z, uint64_t n, double theta)
+{
+	z->n = n;
+	z->alpha = 1.0 / (1.0 - theta);
+	z->zetan = 0;
+	for (uint64_t i = 1; i <= n; i++)
+		z->zetan += 1.0 / pow((double)i, theta);
+
+	z->half_pow_theta = pow(0.5, theta);
+	double zeta2 = 1.0 + z->half_pow_theta;
+	z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+/*
+ * ycsb_zipf_next -- (internal) returns the rank of a zipfian distributed
+ *	item, 0 is the most popular one
+ */
+static uint64_t
+ycsb_zipf_next(struct ycsb_zipf *z, uint64_t *state)
+{
+	double u = ycsb_rand_double(state);
+	double uz = u * z->zetan;
+
+	if (uz < 1.0)
+		return 0;
+	if (uz < 1.0 + z->half_pow_theta)
+		return 1;
+
+	uint64_t rank = (uint64_t)(z->n *
+			pow(z->eta * u - z->eta + 1.0, z->alpha));
+
+	return rank < z->n ? rank : z->n - 1;
+}
+
+/*
+ * ycsb_op_init -- (internal) draws the operation type and its record
+ */
+static void
+ycsb_op_init(struct ycsb *ycsb, struct ycsb_op *op, uint64_t *state,
+		unsigned scan_len)
+{
+	unsigned p = ycsb_rand(state) % 100;
+	int type = 0;
+	while (p >= ycsb->mix[type])
+		p -= ycsb->mix[type++];
+
+	op->type = type;
+	op->hot = false;
+	op->scan_len = 1 + ycsb_rand(state) % scan_len;
+
+	switch (ycsb->dist) {
+	case YCSB_ZIPFIAN:
+	case YCSB_LATEST:
+		op->rand = ycsb_zipf_next(&ycsb->zipf, state);
+		break;
+	case YCSB_HOTSPOT:
+		op->hot = ycsb_rand(state) % 100 < ycsb->hot_ops;
+		op->rand = ycsb_rand(state);
+		break;
+	default:
+		op->rand = ycsb_rand(state);
+	}
+}
+
+/*
+ * ycsb_record -- (internal) returns the number of the record accessed by
+ *	the operation
+ *
+ * The zipfian ranks are drawn from all the records which may exist by the
+ * end of the run, so the ones above the currently visible records wrap
+ * around.
+ */
+static uint64_t
+ycsb_record(struct ycsb *ycsb, const struct ycsb_op *op)
+{
+	uint64_t n = __atomic_load_n(&ycsb->visible, __ATOMIC_ACQUIRE);
+	uint64_t hot;
+
+	switch (ycsb->dist) {
+	case YCSB_LATEST:
+		return n - 1 - op->rand % n;
+	case YCSB_HOTSPOT:
+		hot = n * ycsb->hot_keys / 100;
+		if (hot == 0)
+			hot = 1;
+		if (op->hot || hot == n)
+			return op->rand % hot;
+		return hot + op->rand % (n - hot);
+	default:
+		return op->rand % n;
+	}
+}
+
+/*
+ * ycsb_record_done -- (internal) marks the insert of the record as finished
+ *	and makes visible all records inserted in sequence
+ */
+static void
+ycsb_record_done(struct ycsb *ycsb, uint64_t recno)
+{
+	mutex_lock_nofail(&ycsb->visible_lock);
+
+	ycsb->done[recno] = 1;
+
+	uint64_t n = ycsb->visible;
+	while (n < ycsb->max_records && ycsb->done[n])
+		n++;
+
+	__atomic_store_n(&ycsb->visible, n, __ATOMIC_RELEASE);
+
+	mutex_unlock_nofail(&ycsb->visible_lock);
+}
+
+/*
+ * ycsb_value_change -- (internal) modifies a single character of the value
+ */
+static void
+ycsb_value_change(struct ycsb *ycsb, struct ycsb_worker *w,
+		const struct ycsb_op *op)
+{
+	w->value[op->rand % ycsb->dsize] = 'a' + ycsb_rand(&w->rand_state) % 26;
+}
+
+/*
+ * ycsb_lock -- (internal) locks the map and the value of the record
+ *
+ * The maps which aren't thread-safe are serialized as a whole, the values
+ * stored in the thread-safe ones are protected by striped locks.
+ */
+static void
+ycsb_lock(struct map_bench *map_bench, uint64_t key, bool write)
+{
+	map_lock(map_bench);
+	if (!map_bench->concurrent)
+		return;
+
+	pthread_rwlock_t *lock =
+		&map_bench->ycsb->record_locks[key % YCSB_RECORD_LOCKS];
+	errno = write ? pthread_rwlock_wrlock(lock) :
+		pthread_rwlock_rdlock(lock);
+	if (errno) {
+		perror("pthread_rwlock_lock");
+		abort();
+	}
+}
+
+/*
+ * ycsb_unlock -- (internal) counterpart of ycsb_lock
+ */
+static void
+ycsb_unlock(struct map_bench *map_bench, uint64_t key)
+{
+	if (map_bench->concurrent) {
+		struct ycsb *ycsb = map_bench->ycsb;
+		errno = pthread_rwlock_unlock(
+			&ycsb->record_locks[key % YCSB_RECORD_LOCKS]);
+		if (errno) {
+			perror("pthread_rwlock_unlock");
+			abort();
+		}
+	}
+	map_unlock(map_bench);
+}
+
+/*
+ * ycsb_read_op -- (internal) copies the value of the record
+ */
+static int
+ycsb_read_op(struct map_bench *map_bench, struct ycsb_worker *w, uint64_t key)
+{
+	ycsb_lock(map_bench, key, false);
+
+	PMEMoid val = map_get(map_bench->mapc, map_bench->map, key);
+	if (!OID_IS_NULL(val))
+		memcpy(w->value, pmemobj_direct(val), map_bench->ycsb->dsize);
+
+	ycsb_unlock(map_bench, key);
+
+	return OID_IS_NULL(val);
+}
+
+/*
+ * ycsb_write_op -- (internal) overwrites the value of the record in place,
+ *	for read-modify-write the current value is modified
+ */
+static int
+ycsb_write_op(struct map_bench *map_bench, struct ycsb_worker *w,
+		uint64_t key, const struct ycsb_op *op)
+{
+	struct ycsb *ycsb = map_bench->ycsb;
+	volatile int ret = 0;
+
+	ycsb_lock(map_bench, key, true);
+
+	PMEMoid val = map_get(map_bench->mapc, map_bench->map, key);
+	if (OID_IS_NULL(val)) {
+		ret = 1;
+		goto out;
+	}
+
+	char *buf = pmemobj_direct(val);
+	if (op->type == YCSB_RMW)
+		memcpy(w->value, buf, ycsb->dsize);
+	ycsb_value_change(ycsb, w, op);
+
+	TX_BEGIN(map_bench->pop) {
+		pmemobj_tx_add_range(val, 0, ycsb->dsize);
+		memcpy(buf, w->value, ycsb->dsize);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+out:
+	ycsb_unlock(map_bench, key);
+
+	return ret;
+}
+
+/*
+ * ycsb_insert_op -- (internal) allocates and inserts a new record
+ */
+static int
+ycsb_insert_op(struct map_bench *map_bench, struct ycsb_worker *w,
+		uint64_t key)
+{
+	size_t dsize = map_bench->ycsb->dsize;
+	volatile int ret = 0;
+
+	map_lock(map_bench);
+
+	TX_BEGIN(map_bench->pop) {
+		PMEMoid val = pmemobj_tx_alloc(dsize, OBJ_TYPE_NUM);
+		memcpy(pmemobj_direct(val), w->value, dsize);
+		ret = map_insert(map_bench->mapc, map_bench->map, key, val);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	map_unlock(map_bench);
+
+	return ret;
+}
+
+/*
+ * ycsb_scan_op -- (internal) visits len records starting at the key
+ */
+static int
+ycsb_scan_op(struct map_bench *map_bench, uint64_t key, unsigned len)
+{
+	size_t left = len;
+
+	map_lock(map_bench);
+
+	map_range(map_bench->mapc, map_bench->map, key, UINT64_MAX,
+			map_scan_cb, &left);
+
+	map_unlock(map_bench);
+
+	return left == len;
+}
+
+/*
+ * ycsb_conn_open -- (internal) connects to kv_server
+ */
+static int
+ycsb_conn_open(struct ycsb_conn *conn, struct addrinfo *ai)
+{
+	conn->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (conn->fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (connect(conn->fd, ai->ai_addr, ai->ai_addrlen)) {
+		perror("connect");
+		goto err_close;
+	}
+
+	/* there is a single request in flight, don't wait for more data */
+	int one = 1;
+	if (setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY,
+			&one, sizeof (one))) {
+		perror("setsockopt");
+		goto err_close;
+	}
+
+	conn->size = YCSB_RESP_BUF_SIZE;
+	conn->len = 0;
+	conn->off = 0;
+	conn->buf = malloc(conn->size);
+	if (!conn->buf) {
+		perror("malloc");
+		goto err_close;
+	}
+
+	return 0;
+err_close:
+	close(conn->fd);
+	return -1;
+}
+
+/*
+ * ycsb_conn_send -- (internal) sends the whole request
+ */
+static int
+ycsb_conn_send(struct ycsb_conn *conn, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("send");
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * ycsb_conn_recv -- (internal) receives a single response line, returns
+ *	its length including the newline
+ *
+ * kv_server pads the values with zeros, which are skipped here.
+ */
+static char *
+ycsb_conn_recv(struct ycsb_conn *conn, size_t *len)
+{
+	for (;;) {
+		while (conn->off < conn->len && conn->buf[conn->off] == '\0')
+			conn->off++;
+
+		char *line = conn->buf + conn->off;
+		char *end = memchr(line, '\n', conn->len - conn->off);
+		if (end) {
+			*len = end - line + 1;
+			conn->off += *len;
+			return line;
+		}
+
+		/* make room for the rest of the line */
+		memmove(conn->buf, line, conn->len - conn->off);
+		conn->len -= conn->off;
+		conn->off = 0;
+
+		if (conn->len == conn->size) {
+			char *buf = realloc(conn->buf, conn->size * 2);
+			if (!buf) {
+				perror("realloc");
+				return NULL;
+			}
+			conn->buf = buf;
+			conn->size *= 2;
+		}
+
+		ssize_t n = recv(conn->fd, conn->buf + conn->len,
+				conn->size - conn->len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (n == 0)
+				fprintf(stderr, "kv_server closed "
+					"the connection\n");
+			else
+				perror("recv");
+			return NULL;
+		}
+		conn->len += n;
+	}
+}
+
+/*
+ * ycsb_conn_close -- (internal) says goodbye to kv_server
+ */
+static void
+ycsb_conn_close(struct ycsb_conn *conn)
+{
+	char bye[YCSB_REQ_OVERHEAD];
+	int len = sprintf(bye, "%s\n", kv_cmsg_token[CMSG_BYE]);
+	ycsb_conn_send(conn, bye, len);
+
+	close(conn->fd);
+	free(conn->buf);
+}
+
+/*
+ * ycsb_resp_is -- (internal) checks if the response is the given message
+ */
+static bool
+ycsb_resp_is(const char *resp, size_t len, enum resp_messages msg)
+{
+	return len == strlen(resp_msg[msg]) &&
+		memcmp(resp, resp_msg[msg], len) == 0;
+}
+
+/*
+ * ycsb_server_get -- (internal) copies the value of the record from
+ *	kv_server
+ */
+static int
+ycsb_server_get(struct ycsb *ycsb, struct ycsb_worker *w, uint64_t key)
+{
+	int len = sprintf(w->req, "%s %" PRIu64 "\n",
+			kv_cmsg_token[CMSG_GET], key);
+	if (ycsb_conn_send(&w->conn, w->req, len))
+		return -1;
+
+	size_t rlen;
+	char *resp = ycsb_conn_recv(&w->conn, &rlen);
+	if (!resp)
+		return -1;
+
+	if (ycsb_resp_is(resp, rlen, RESP_MSG_NULL))
+		return 1;
+
+	memcpy(w->value, resp, rlen - 1 < ycsb->dsize ? rlen - 1 : ycsb->dsize);
+
+	return 0;
+}
+
+/*
+ * ycsb_server_put -- (internal) stores the value of the record in kv_server
+ */
+static int
+ycsb_server_put(struct ycsb *ycsb, struct ycsb_worker *w, uint64_t key)
+{
+	int len = sprintf(w->req, "%s %" PRIu64 " ",
+			kv_cmsg_token[CMSG_INSERT], key);
+	memcpy(w->req + len, w->value, ycsb->dsize);
+	len += ycsb->dsize;
+	w->req[len++] = '\n';
+
+	if (ycsb_conn_send(&w->conn, w->req, len))
+		return -1;
+
+	size_t rlen;
+	char *resp = ycsb_conn_recv(&w->conn, &rlen);
+	if (!resp)
+		return -1;
+
+	return !ycsb_resp_is(resp, rlen, RESP_MSG_SUCCESS);
+}
+
+/*
+ * ycsb_run_op -- (internal) performs the operation on the map or kv_server,
+ *	returns 1 if the record doesn't exist or couldn't be stored
+ */
+static int
+ycsb_run_op(struct map_bench *map_bench, struct ycsb_worker *w,
+		const struct ycsb_op *op)
+{
+	struct ycsb *ycsb = map_bench->ycsb;
+	bool server = ycsb->server != NULL;
+	int ret;
+
+	if (op->type == YCSB_INSERT) {
+		uint64_t recno = __sync_fetch_and_add(&ycsb->next_record, 1);
+		uint64_t key = ycsb_key(recno);
+
+		ycsb_value_change(ycsb, w, op);
+		ret = server ? ycsb_server_put(ycsb, w, key) :
+			ycsb_insert_op(map_bench, w, key);
+
+		ycsb_record_done(ycsb, recno);
+		return ret;
+	}
+
+	uint64_t key = ycsb_key(ycsb_record(ycsb, op));
+
+	switch (op->type) {
+	case YCSB_READ:
+		return server ? ycsb_server_get(ycsb, w, key) :
+			ycsb_read_op(map_bench, w, key);
+	case YCSB_UPDATE:
+		if (!server)
+			return ycsb_write_op(map_bench, w, key, op);
+		ycsb_value_change(ycsb, w, op);
+		return ycsb_server_put(ycsb, w, key);
+	case YCSB_SCAN:
+		return ycsb_scan_op(map_bench, key, op->scan_len);
+	case YCSB_RMW:
+		if (!server)
+			return ycsb_write_op(map_bench, w, key, op);
+		ret = ycsb_server_get(ycsb, w, key);
+		if (ret)
+			return ret;
+		ycsb_value_change(ycsb, w, op);
+		return ycsb_server_put(ycsb, w, key);
+	default:
+		assert(0);
+		return -1;
+	}
+}
+
+/*
+ * ycsb_load -- (internal) inserts the initial records into the map
+ */
+static int
+ycsb_load(struct map_bench *map_bench, uint64_t records, const char *value)
+{
+	size_t dsize = map_bench->ycsb->dsize;
+	volatile int ret = 0;
+
+	for (uint64_t i = 0; i < records && !ret;
+			i += YCSB_LOAD_TX_RECORDS) {
+		uint64_t end = i + YCSB_LOAD_TX_RECORDS < records ?
+			i + YCSB_LOAD_TX_RECORDS : records;
+
+		TX_BEGIN(map_bench->pop) {
+			for (uint64_t r = i; r < end; r++) {
+				PMEMoid val = pmemobj_tx_alloc(dsize,
+						OBJ_TYPE_NUM);
+				memcpy(pmemobj_direct(val), value, dsize);
+				if (map_insert(map_bench->mapc, map_bench->map,
+						ycsb_key(r), val))
+					pmemobj_tx_abort(EINVAL);
+			}
+		} TX_ONABORT {
+			ret = -1;
+		} TX_END
+	}
+
+	/*
+	 * hashmap_mt doesn't split buckets within a transaction, let it
+	 * catch up with the loaded records
+	 */
+	if (!ret && map_bench->mapc->ops == MAP_HASHMAP_MT)
+		ret = map_cmd(map_bench->mapc, map_bench->map,
+				HASHMAP_CMD_REBUILD, 0);
+
+	return ret;
+}
+
+/*
+ * ycsb_load_server -- (internal) inserts the initial records into kv_server
+ */
+static int
+ycsb_load_server(struct ycsb *ycsb, uint64_t records, char *value)
+{
+	struct ycsb_worker w = {.value = value};
+	int ret = -1;
+
+	w.req = malloc(ycsb->dsize + YCSB_REQ_OVERHEAD);
+	if (!w.req) {
+		perror("malloc");
+		return -1;
+	}
+
+	if (ycsb_conn_open(&w.conn, ycsb->server))
+		goto out;
+
+	for (uint64_t r = 0; r < records; r++) {
+		ret = ycsb_server_put(ycsb, &w, ycsb_key(r));
+		if (ret) {
+			if (ret > 0)
+				fprintf(stderr, "kv_server failed to insert "
+					"record %" PRIu64 "\n", r);
+			ret = -1;
+			break;
+		}
+	}
+
+	ycsb_conn_close(&w.conn);
+out:
+	free(w.req);
+	return ret;
+}
+
+/*
+ * ycsb_delete -- (internal) frees the workload state
+ */
+static void
+ycsb_delete(struct ycsb *ycsb)
+{
+	for (int t = 0; t < MAX_YCSB_OP; t++)
+		free(ycsb->stats[t].lat);
+	for (int i = 0; i < YCSB_RECORD_LOCKS; i++)
+		pthread_rwlock_destroy(&ycsb->record_locks[i]);
+	pthread_mutex_destroy(&ycsb->visible_lock);
+	if (ycsb->server)
+		freeaddrinfo(ycsb->server);
+	free(ycsb->done);
+	free(ycsb);
+}
+
+/*
+ * ycsb_resolve_server -- (internal) resolves the host:port address
+ */
+static int
+ycsb_resolve_server(struct ycsb *ycsb, const char *addr)
+{
+	char *host = strdup(addr);
+	if (!host) {
+		perror("strdup");
+		return -1;
+	}
+
+	int ret = -1;
+	char *port = strrchr(host, ':');
+	if (!port || port == host || port[1] == '\0') {
+		fprintf(stderr, "invalid server address -- '%s'\n", addr);
+		goto out;
+	}
+	*port++ = '\0';
+
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	ret = getaddrinfo(host, port, &hints, &ycsb->server);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", addr, gai_strerror(ret));
+		ycsb->server = NULL;
+		ret = -1;
+	}
+out:
+	free(host);
+	return ret;
+}
+
+/*
+ * ycsb_new -- (internal) parses the workload options and allocates the
+ *	workload state
+ */
+static struct ycsb *
+ycsb_new(struct benchmark_args *args)
+{
+	struct map_bench_args *margs = args->opts;
+
+	if (margs->ext_tx) {
+		fprintf(stderr, "external transaction is not supported\n");
+		return NULL;
+	}
+
+	if (args->dsize == 0) {
+		fprintf(stderr, "records require non-zero data size\n");
+		return NULL;
+	}
+
+	struct ycsb *ycsb = calloc(1, sizeof (*ycsb));
+	if (!ycsb) {
+		perror("calloc");
+		return NULL;
+	}
+
+	if (strcmp(margs->workload, "custom") == 0) {
+		unsigned custom[MAX_YCSB_OP] = {
+			[YCSB_READ] = margs->read,
+			[YCSB_UPDATE] = margs->update,
+			[YCSB_INSERT] = margs->insert,
+			[YCSB_SCAN] = margs->scan,
+			[YCSB_RMW] = margs->rmw,
+		};
+		memcpy(ycsb->mix, custom, sizeof (ycsb->mix));
+		ycsb->dist = YCSB_ZIPFIAN;
+	} else {
+		size_t i;
+		for (i = 0; i < ARRAY_SIZE(ycsb_workloads); i++) {
+			if (strcmp(margs->workload, ycsb_workloads[i].str) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(ycsb_workloads)) {
+			fprintf(stderr, "invalid workload -- '%s'\n",
+					margs->workload);
+			goto err_free;
+		}
+		memcpy(ycsb->mix, ycsb_workloads[i].mix, sizeof (ycsb->mix));
+		ycsb->dist = ycsb_workloads[i].dist;
+	}
+
+	unsigned total = 0;
+	for (int t = 0; t < MAX_YCSB_OP; t++)
+		total += ycsb->mix[t];
+	if (total != 100) {
+		fprintf(stderr, "percentages of operations sum up to %u "
+				"instead of 100\n", total);
+		goto err_free;
+	}
+
+	if (strcmp(margs->dist, "default") != 0) {
+		int d;
+		for (d = 0; d < MAX_YCSB_DIST; d++) {
+			if (strcmp(margs->dist, ycsb_dist_str[d]) == 0)
+				break;
+		}
+		if (d == MAX_YCSB_DIST) {
+			fprintf(stderr, "invalid distribution -- '%s'\n",
+					margs->dist);
+			goto err_free;
+		}
+		ycsb->dist = d;
+	}
+
+	if (strcmp(margs->server, "none") != 0) {
+		if (ycsb->mix[YCSB_SCAN]) {
+			fprintf(stderr, "kv_server doesn't support scans\n");
+			goto err_free;
+		}
+		if (ycsb_resolve_server(ycsb, margs->server))
+			goto err_free;
+	}
+
+	ycsb->hot_keys = margs->hot_keys;
+	ycsb->hot_ops = margs->hot_ops;
+	ycsb->dsize = args->dsize;
+
+	size_t nops = args->n_threads * args->n_ops_per_thread;
+	ycsb->max_records = margs->records;
+	if (ycsb->mix[YCSB_INSERT])
+		ycsb->max_records += args->n_threads *
+			(margs->warmup + args->n_ops_per_thread);
+
+	if (ycsb->dist == YCSB_ZIPFIAN || ycsb->dist == YCSB_LATEST)
+		ycsb_zipf_init(&ycsb->zipf, ycsb->max_records,
+				margs->theta / 100.0);
+
+	ycsb->done = calloc(ycsb->max_records, sizeof (*ycsb->done));
+	if (!ycsb->done) {
+		perror("calloc");
+		goto err_free_server;
+	}
+	memset(ycsb->done, 1, margs->records);
+	ycsb->visible = margs->records;
+	ycsb->next_record = margs->records;
+
+	for (int t = 0; t < MAX_YCSB_OP; t++) {
+		if (!ycsb->mix[t])
+			continue;
+		ycsb->stats[t].lat = malloc(nops * sizeof (uint64_t));
+		if (!ycsb->stats[t].lat) {
+			perror("malloc");
+			goto err_free_stats;
+		}
+	}
+
+	errno = pthread_mutex_init(&ycsb->visible_lock, NULL);
+	if (errno) {
+		perror("pthread_mutex_init");
+		goto err_free_stats;
+	}
+
+	for (int i = 0; i < YCSB_RECORD_LOCKS; i++) {
+		errno = pthread_rwlock_init(&ycsb->record_locks[i], NULL);
+		if (errno) {
+			perror("pthread_rwlock_init");
+			while (i--)
+				pthread_rwlock_destroy(
+					&ycsb->record_locks[i]);
+			goto err_destroy_lock;
+		}
+	}
+
+	return ycsb;
+err_destroy_lock:
+	pthread_mutex_destroy(&ycsb->visible_lock);
+err_free_stats:
+	for (int t = 0; t < MAX_YCSB_OP; t++)
+		free(ycsb->stats[t].lat);
+	free(ycsb->done);
+err_free_server:
+	if (ycsb->server)
+		freeaddrinfo(ycsb->server);
+err_free:
+	free(ycsb);
+	return NULL;
+}
+
+/*
+ * ycsb_value_init -- (internal) fills the value with random letters, so it
+ *	can be sent to kv_server as it is
+ */
+static void
+ycsb_value_init(char *value, size_t dsize, uint64_t *state)
+{
+	for (size_t i = 0; i < dsize; i++)
+		value[i] = 'a' + ycsb_rand(state) % 26;
+}
+
+/*
+ * ycsb_seed -- (internal) returns the non-zero initial state of the
+ *	generator of the given thread
+ */
+static uint64_t
+ycsb_seed(unsigned seed, size_t thread)
+{
+	return ycsb_key(((uint64_t)seed << 32) | (thread + 1));
+}
+
+/*
+ * map_ycsb_init -- init function for map_ycsb benchmark
+ */
+static int
+map_ycsb_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct map_bench_args *margs = args->opts;
+
+	struct ycsb *ycsb = ycsb_new(args);
+	if (!ycsb)
+		return -1;
+
+	char *value = malloc(ycsb->dsize);
+	if (!value) {
+		perror("malloc");
+		goto err_free_ycsb;
+	}
+
+	uint64_t state = ycsb_seed(margs->seed, args->n_threads);
+	ycsb_value_init(value, ycsb->dsize, &state);
+
+	struct map_bench *map_bench;
+	if (ycsb->server) {
+		map_bench = calloc(1, sizeof (*map_bench));
+		if (!map_bench) {
+			perror("calloc");
+			goto err_free_value;
+		}
+		map_bench->args = args;
+		map_bench->margs = margs;
+		map_bench->ycsb = ycsb;
+		pmembench_set_priv(bench, map_bench);
+
+		if (ycsb_load_server(ycsb, margs->records, value)) {
+			free(map_bench);
+			goto err_free_value;
+		}
+	} else {
+		if (map_common_init(bench, args))
+			goto err_free_value;
+
+		map_bench = pmembench_get_priv(bench);
+		map_bench->ycsb = ycsb;
+
+		if (ycsb_load(map_bench, margs->records, value)) {
+			fprintf(stderr, "loading records failed\n");
+			map_common_exit(bench, args);
+			goto err_free_value;
+		}
+	}
+
+	free(value);
+	return 0;
+err_free_value:
+	free(value);
+err_free_ycsb:
+	ycsb_delete(ycsb);
+	return -1;
+}
+
+/*
+ * ycsb_cmp_lat -- (internal) compares latencies for qsort
+ */
+static int
+ycsb_cmp_lat(const void *a, const void *b)
+{
+	uint64_t la = *(const uint64_t *)a;
+	uint64_t lb = *(const uint64_t *)b;
+
+	return (la > lb) - (la < lb);
+}
+
+/*
+ * ycsb_print_stats -- (internal) prints results of the run per operation
+ *	type, to stderr so the pmembench results on stdout stay intact
+ */
+static void
+ycsb_print_stats(struct ycsb *ycsb, struct map_bench_args *margs)
+{
+	fprintf(stderr, "map_ycsb: workload %s, %s distribution\n",
+			margs->workload, ycsb_dist_str[ycsb->dist]);
+	fprintf(stderr, "operation;ops;ops-per-second[1/sec];failed;"
+			"lat-avg[nsec];lat-p50[nsec];lat-p99[nsec];"
+			"lat-max[nsec]\n");
+
+	for (int t = 0; t < MAX_YCSB_OP; t++) {
+		struct ycsb_stats *s = &ycsb->stats[t];
+		if (!s->nlat)
+			continue;
+
+		qsort(s->lat, s->nlat, sizeof (*s->lat), ycsb_cmp_lat);
+
+		uint64_t sum = 0;
+		for (size_t i = 0; i < s->nlat; i++)
+			sum += s->lat[i];
+
+		fprintf(stderr, "%s;%zu;%f;%" PRIu64 ";%" PRIu64 ";%" PRIu64
+			";%" PRIu64 ";%" PRIu64 "\n",
+			ycsb_op_str[t], s->nlat,
+			ycsb->run_time > 0 ? s->nlat / ycsb->run_time : 0,
+			s->failed, sum / s->nlat, s->lat[s->nlat / 2],
+			s->lat[s->nlat * 99 / 100], s->lat[s->nlat - 1]);
+	}
+}
+
+/*
+ * map_ycsb_exit -- exit function for map_ycsb benchmark
+ */
+static int
+map_ycsb_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct ycsb *ycsb = map_bench->ycsb;
+	bool server = ycsb->server != NULL;
+
+	ycsb_print_stats(ycsb, args->opts);
+	ycsb_delete(ycsb);
+
+	if (!server)
+		return map_common_exit(bench, args);
+
+	free(map_bench);
+	return 0;
+}
+
+/*
+ * map_ycsb_init_worker -- init worker function for map_ycsb benchmark,
+ *	draws the operations and runs the warm-up ones
+ */
+static int
+map_ycsb_init_worker(struct benchmark *bench, struct benchmark_args *args,
+		struct worker_info *worker)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct ycsb *ycsb = map_bench->ycsb;
+	struct map_bench_args *margs = args->opts;
+
+	struct ycsb_worker *w = calloc(1, sizeof (*w));
+	if (!w) {
+		perror("calloc");
+		return -1;
+	}
+
+	w->nwarmup = margs->warmup;
+	w->rand_state = ycsb_seed(margs->seed, worker->index);
+
+	size_t nops = w->nwarmup + worker->nops;
+	w->ops = malloc(nops * sizeof (*w->ops));
+	if (!w->ops) {
+		perror("malloc");
+		goto err_free_worker;
+	}
+
+	for (size_t i = 0; i < nops; i++)
+		ycsb_op_init(ycsb, &w->ops[i], &w->rand_state,
+				margs->scan_len);
+
+	w->value = malloc(ycsb->dsize);
+	if (!w->value) {
+		perror("malloc");
+		goto err_free_ops;
+	}
+	ycsb_value_init(w->value, ycsb->dsize, &w->rand_state);
+
+	if (ycsb->server) {
+		w->req = malloc(ycsb->dsize + YCSB_REQ_OVERHEAD);
+		if (!w->req) {
+			perror("malloc");
+			goto err_free_value;
+		}
+		if (ycsb_conn_open(&w->conn, ycsb->server))
+			goto err_free_req;
+	}
+
+	for (size_t i = 0; i < w->nwarmup; i++) {
+		if (ycsb_run_op(map_bench, w, &w->ops[i]) < 0)
+			goto err_close;
+	}
+
+	worker->priv = w;
+	return 0;
+err_close:
+	if (ycsb->server)
+		ycsb_conn_close(&w->conn);
+err_free_req:
+	free(w->req);
+err_free_value:
+	free(w->value);
+err_free_ops:
+	free(w->ops);
+err_free_worker:
+	free(w);
+	return -1;
+}
+
+/*
+ * map_ycsb_free_worker -- cleanup worker function for map_ycsb benchmark,
+ *	collects the latencies of operations measured by the framework
+ */
+static void
+map_ycsb_free_worker(struct benchmark *bench, struct benchmark_args *args,
+		struct worker_info *worker)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct ycsb *ycsb = map_bench->ycsb;
+	struct ycsb_worker *w = worker->priv;
+	double time = 0;
+
+	for (size_t i = 0; i < worker->nops; i++) {
+		benchmark_time_t *t = &worker->opinfo[i].t_diff;
+		struct ycsb_stats *s =
+			&ycsb->stats[w->ops[w->nwarmup + i].type];
+
+		s->lat[s->nlat++] = benchmark_time_get_nsecs(t);
+		time += benchmark_time_get_secs(t);
+	}
+
+	for (int t = 0; t < MAX_YCSB_OP; t++)
+		ycsb->stats[t].failed += w->failed[t];
+
+	if (time > ycsb->run_time)
+		ycsb->run_time = time;
+
+	if (ycsb->server)
+		ycsb_conn_close(&w->conn);
+
+	free(w->req);
+	free(w->value);
+	free(w->ops);
+	free(w);
+}
+
+/*
+ * map_ycsb_op -- main operation for map_ycsb benchmark
+ */
+static int
+map_ycsb_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct map_bench *map_bench = pmembench_get_priv(bench);
+	struct ycsb_worker *w = info->worker->priv;
+	const struct ycsb_op *op = &w->ops[w->nwarmup + info->index];
+
+	int ret = ycsb_run_op(map_bench, w, op);
+	if (ret > 0) {
+		/* missing records are reported, not fatal */
+		w->failed[op->type]++;
+		ret = 0;
+	}
+
+	return ret;
+}
+
+static struct benchmark_info map_insert_info = {
+	.name		= "map_insert",
+	.brief		= "Inserting to tree map",
+	.init		= map_common_init,
+	.exit		= map_common_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_insert_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_insert_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_insert_info);
+
+static struct benchmark_info map_remove_info = {
+	.name		= "map_remove",
+	.brief		= "Inserting to tree map",
+	.init		= map_remove_init,
+	.exit		= map_remove_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_remove_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_remove_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_remove_info);
+
+static struct benchmark_info map_get_info = {
+	.name		= "map_get",
+	.brief		= "Tree lookup",
+	.init		= map_bench_get_init,
+	.exit		= map_get_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_bench_get_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_get_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_get_info);
+
+static struct benchmark_info map_scan_info = {
+	.name		= "map_scan",
+	.brief		= "Range scan of tree map",
+	.init		= map_bench_get_init,
+	.exit		= map_get_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_bench_get_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_scan_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_scan_info);
+
+static struct benchmark_info map_insert_batch_info = {
+	.name		= "map_insert_batch",
+	.brief		= "Batched inserting to tree map",
+	.init		= map_common_init,
+	.exit		= map_common_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_insert_batch_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_insert_batch_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_insert_batch_info);
+
+static struct benchmark_info map_get_batch_info = {
+	.name		= "map_get_batch",
+	.brief		= "Batched tree lookup",
+	.init		= map_bench_get_init,
+	.exit		= map_get_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_get_batch_init_worker,
+	.free_worker	= map_common_free_worker,
+	.operation	= map_get_batch_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= MAP_BENCH_NCLOS,
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_get_batch_info);
+
+static struct benchmark_info map_ycsb_info = {
+	.name		= "map_ycsb",
+	.brief		= "YCSB workloads on map or kv_server",
+	.init		= map_ycsb_init,
+	.exit		= map_ycsb_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= map_ycsb_init_worker,
+	.free_worker	= map_ycsb_free_worker,
+	.operation	= map_ycsb_op,
+	.measure_time	= true,
+	.clos		= map_bench_clos,
+	.nclos		= ARRAY_SIZE(map_bench_clos),
+	.opts_size	= sizeof (struct map_bench_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(map_ycsb_info);
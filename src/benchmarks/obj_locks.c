@@ -87,6 +87,7 @@ struct prog_args {
 	char *lock_mode;	/* "1by1" or "all-lock" */
 	char *lock_type;	/* "mutex", "rwlock" or "ram-mutex" */
 	bool use_rdlock;	/* use read lock, instead of write lock */
+	unsigned read_pct;	/* percentage of read locks in "rwlock-mix" */
 };
 
 /*
@@ -136,6 +137,7 @@ enum benchmark_mode {
 	BENCH_MODE_MUTEX,	/* PMEMmutex vs. pthread_mutex_t */
 	BENCH_MODE_RWLOCK,	/* PMEMrwlock vs. pthread_rwlock_t */
 	BENCH_MODE_VOLATILE_MUTEX, /* PMEMmutex with pthread mutex in RAM */
+	BENCH_MODE_RWLOCK_MIX,	/* mix of read and write locks */
 	BENCH_MODE_MAX
 };
 
@@ -144,7 +146,7 @@ struct mutex_bench;
 struct bench_ops {
 	int (*bench_init)(struct mutex_bench *);
 	int (*bench_exit)(struct mutex_bench *);
-	int (*bench_op)(struct mutex_bench *);
+	int (*bench_op)(struct mutex_bench *, struct operation_info *);
 };
 
 /*
@@ -319,7 +321,7 @@ exit_bench_mutex(struct mutex_bench *mb)
  * this will force the rwlock object(s) reinitialization at the lock operation.
  */
 static int
-op_bench_mutex(struct mutex_bench *mb)
+op_bench_mutex(struct mutex_bench *mb, struct operation_info *info)
 {
 	if (!mb->pa->use_pthread) {
 		if (mb->lock_mode == OP_MODE_1BY1)
@@ -402,7 +404,7 @@ exit_bench_rwlock(struct mutex_bench *mb)
  * this will force the rwlock object(s) reinitialization at the lock operation.
  */
 static int
-op_bench_rwlock(struct mutex_bench *mb)
+op_bench_rwlock(struct mutex_bench *mb, struct operation_info *info)
 {
 	if (!mb->pa->use_pthread) {
 		if (mb->lock_mode == OP_MODE_1BY1)
@@ -475,7 +477,7 @@ exit_bench_vmutex(struct mutex_bench *mb)
  * op_bench_volatile_mutex -- lock and unlock the mutex object
  */
 static int
-op_bench_vmutex(struct mutex_bench *mb)
+op_bench_vmutex(struct mutex_bench *mb, struct operation_info *info)
 {
 	if (mb->lock_mode == OP_MODE_1BY1)
 		BENCH_OPERATION_1BY1(volatile_mutex_lock,
@@ -492,10 +494,45 @@ op_bench_vmutex(struct mutex_bench *mb)
 	return 0;
 }
 
+/*
+ * op_bench_rwlock_mix -- read lock or write lock the rwlock objects
+ *
+ * The lock kind is chosen by the index of the operation, so that every
+ * hundred operations of each thread contain exactly read_pct read locks.
+ */
+static int
+op_bench_rwlock_mix(struct mutex_bench *mb, struct operation_info *info)
+{
+	bool rdlock = info->index % 100 < mb->pa->read_pct;
+
+	if (!mb->pa->use_pthread) {
+		if (mb->lock_mode == OP_MODE_1BY1)
+			BENCH_OPERATION_1BY1(rdlock ?
+				pmemobj_rwlock_rdlock : pmemobj_rwlock_wrlock,
+				pmemobj_rwlock_unlock, mb, PMEMrwlock, mb->pop);
+		else
+			BENCH_OPERATION_ALL_LOCK(rdlock ?
+				pmemobj_rwlock_rdlock : pmemobj_rwlock_wrlock,
+				pmemobj_rwlock_unlock, mb, PMEMrwlock, mb->pop);
+	} else {
+		if (mb->lock_mode == OP_MODE_1BY1)
+			BENCH_OPERATION_1BY1(rdlock ?
+				pthread_rwlock_rdlock : pthread_rwlock_wrlock,
+				pthread_rwlock_unlock, mb, pthread_rwlock_t);
+		else
+			BENCH_OPERATION_ALL_LOCK(rdlock ?
+				pthread_rwlock_rdlock : pthread_rwlock_wrlock,
+				pthread_rwlock_unlock, mb, pthread_rwlock_t);
+	}
+
+	return 0;
+}
+
 struct bench_ops benchmark_ops[BENCH_MODE_MAX] = {
 	{ init_bench_mutex, exit_bench_mutex, op_bench_mutex },
 	{ init_bench_rwlock, exit_bench_rwlock, op_bench_rwlock },
-	{ init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex }
+	{ init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex },
+	{ init_bench_rwlock, exit_bench_rwlock, op_bench_rwlock_mix }
 };
 
 /*
@@ -526,6 +563,8 @@ parse_benchmark_mode(const char *arg)
 		return &benchmark_ops[BENCH_MODE_RWLOCK];
 	else if (strcmp(arg, "volatile-mutex") == 0)
 		return &benchmark_ops[BENCH_MODE_VOLATILE_MUTEX];
+	else if (strcmp(arg, "rwlock-mix") == 0)
+		return &benchmark_ops[BENCH_MODE_RWLOCK_MIX];
 	else
 		return NULL;
 }
@@ -557,6 +596,13 @@ locks_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_free_mb;
 	}
 
+	if (mb->pa->run_id_increment && args->n_threads > 1) {
+		fprintf(stderr, "run_id can be incremented only by a single "
+			"thread\n");
+		errno = EINVAL;
+		goto err_free_mb;
+	}
+
 	mb->ops = parse_benchmark_mode(mb->pa->lock_type);
 	if (mb->ops == NULL) {
 		fprintf(stderr, "Invalid benchmark type: %s\n",
@@ -641,7 +687,7 @@ locks_op(struct benchmark *bench, struct operation_info *info)
 	assert(mb->locks != NULL);
 	assert(mb->lock_mode < OP_MODE_MAX);
 
-	mb->ops->bench_op(mb);
+	mb->ops->bench_op(mb, info);
 
 	return 0;
 }
@@ -711,8 +757,8 @@ static struct benchmark_clo locks_clo[] = {
 	{
 		.opt_short	= 'b',
 		.opt_long	= "bench_type",
-		.descr		= "The Benchmark type: mutex, rwlock or "
-					"volatile-mutex",
+		.descr		= "The Benchmark type: mutex, rwlock, "
+					"rwlock-mix or volatile-mutex",
 		.type		= CLO_TYPE_STR,
 		.off		= clo_field_offset(struct prog_args, lock_type),
 		.def		= "mutex",
@@ -726,6 +772,21 @@ static struct benchmark_clo locks_clo[] = {
 		.off		= clo_field_offset(struct prog_args,
 							use_rdlock),
 	},
+	{
+		.opt_short	= 0,
+		.opt_long	= "read_pct",
+		.descr		= "Percentage of read locks, only valid "
+					"when lock_type is \"rwlock-mix\"",
+		.def		= "90",
+		.off		= clo_field_offset(struct prog_args, read_pct),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, read_pct),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 100
+		}
+	},
 };
 
 /* Stores information about benchmark. */
@@ -734,7 +795,7 @@ static struct benchmark_info locks_info = {
 	.brief		= "Benchmark for pmem locks operations",
 	.init		= locks_init,
 	.exit		= locks_exit,
-	.multithread	= false,
+	.multithread	= true,
 	.multiops	= true,
 	.operation	= locks_op,
 	.measure_time	= true,
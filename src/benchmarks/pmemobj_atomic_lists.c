@@ -1141,3 +1141,224 @@ static struct benchmark_info obj_move = {
 	.allow_poolset	= true,
 };
 REGISTER_BENCHMARK(obj_move);
+
+/*
+ * obj_queue benchmark -- all the threads push to and pop from one shared
+ * persistent queue. With the list flag set a shared atomic list is used
+ * instead, in which case removing the first element requires an
+ * additional lock.
+ */
+
+/*
+ * obj_queue_args -- stores command line parsed arguments.
+ */
+struct obj_queue_args {
+	bool list;		/* use a shared atomic list instead */
+	unsigned queue_len;	/* initial queue length */
+};
+
+TOID_DECLARE(struct queue_item, 2);
+TOID_DECLARE(struct queue_root, 3);
+
+/*
+ * queue_item -- element of both the shared queue and the shared list
+ */
+struct queue_item {
+	POBJ_QUEUE_ENTRY(struct queue_item) next;
+	POBJ_LIST_ENTRY(struct queue_item) field;
+};
+
+POBJ_QUEUE_HEAD(item_queue, struct queue_item);
+POBJ_LIST_HEAD(item_list, struct queue_item);
+
+/*
+ * queue_root -- root object holding the shared queue and list
+ */
+struct queue_root {
+	struct item_queue queue;
+	struct item_list list;
+	PMEMmutex pop_lock;	/* serializes removing of the list head */
+};
+
+/*
+ * obj_queue_bench -- stores variables used in obj_queue benchmark
+ */
+static struct {
+	PMEMobjpool *pop;		/* handle to persistent pool */
+	struct obj_queue_args *args;	/* benchmark specific arguments */
+	size_t dsize;			/* size of each element */
+	TOID(struct queue_root) root;	/* shared queue and list */
+} obj_queue_bench;
+
+static struct benchmark_clo obj_queue_clo[] = {
+	{
+		.opt_short	= 'L',
+		.opt_long	= "list",
+		.descr		= "Use shared atomic list instead of queue",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct obj_queue_args, list),
+	},
+	{
+		.opt_short	= 'l',
+		.opt_long	= "queue-len",
+		.type		= CLO_TYPE_UINT,
+		.descr		= "Initial queue len",
+		.off		= clo_field_offset(struct obj_queue_args,
+						queue_len),
+		.def		= "64",
+		.type_uint	= {
+			.size	= clo_field_size(struct obj_queue_args,
+						queue_len),
+			.base	= CLO_INT_BASE_DEC|CLO_INT_BASE_HEX,
+			.min	= 0,
+			.max	= UINT_MAX,
+		},
+	},
+};
+
+/*
+ * obj_queue_push -- appends new element to the shared queue or list
+ */
+static int
+obj_queue_push(void)
+{
+	struct queue_root *root = D_RW(obj_queue_bench.root);
+	PMEMoid oid;
+
+	if (obj_queue_bench.args->list)
+		oid = POBJ_LIST_INSERT_NEW_TAIL(obj_queue_bench.pop,
+			&root->list, field, obj_queue_bench.dsize, NULL, NULL);
+	else
+		oid = POBJ_QUEUE_PUSH_NEW(obj_queue_bench.pop, &root->queue,
+			next, obj_queue_bench.dsize, NULL, NULL);
+
+	if (OID_IS_NULL(oid)) {
+		perror("push");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_queue_pop -- removes and frees the first element of the shared queue
+ * or list
+ */
+static int
+obj_queue_pop(void)
+{
+	struct queue_root *root = D_RW(obj_queue_bench.root);
+	PMEMobjpool *pop = obj_queue_bench.pop;
+
+	if (!obj_queue_bench.args->list)
+		return POBJ_QUEUE_POP_FREE(pop, &root->queue, next);
+
+	pmemobj_mutex_lock(pop, &root->pop_lock);
+
+	int ret = ENOENT;
+	TOID(struct queue_item) first = POBJ_LIST_FIRST(&root->list);
+	if (!TOID_IS_NULL(first))
+		ret = POBJ_LIST_REMOVE_FREE(pop, &root->list, first, field);
+
+	pmemobj_mutex_unlock(pop, &root->pop_lock);
+
+	return ret;
+}
+
+/*
+ * obj_queue_op -- main operation of the obj_queue benchmark, each operation
+ * pushes one element and pops one element
+ */
+static int
+obj_queue_op(struct benchmark *bench, struct operation_info *info)
+{
+	if (obj_queue_push() != 0)
+		return -1;
+
+	if (obj_queue_pop() != 0) {
+		fprintf(stderr, "pop failed\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_queue_init -- initialization of the obj_queue benchmark, creates the
+ * pool and fills the shared queue or list
+ */
+static int
+obj_queue_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	obj_queue_bench.args = args->opts;
+	obj_queue_bench.dsize = args->dsize < sizeof (struct queue_item) ?
+				sizeof (struct queue_item) : args->dsize;
+
+	/*
+	 * Multiplication by FACTOR prevents from out of memory error
+	 * as the actual size of the allocated persistent objects
+	 * is always larger than requested.
+	 */
+	size_t psize = (obj_queue_bench.args->queue_len + args->n_threads) *
+				obj_queue_bench.dsize * FACTOR;
+	if (args->is_poolset) {
+		if (args->fsize < psize) {
+			fprintf(stderr, "insufficient size of poolset\n");
+			return -1;
+		}
+
+		psize = 0;
+	} else if (psize < PMEMOBJ_MIN_POOL) {
+		psize = PMEMOBJ_MIN_POOL;
+	}
+
+	obj_queue_bench.pop = pmemobj_create(args->fname, LAYOUT_NAME, psize,
+							args->fmode);
+	if (obj_queue_bench.pop == NULL) {
+		perror(pmemobj_errormsg());
+		return -1;
+	}
+
+	obj_queue_bench.root = POBJ_ROOT(obj_queue_bench.pop,
+							struct queue_root);
+
+	for (unsigned i = 0; i < obj_queue_bench.args->queue_len; i++) {
+		if (obj_queue_push() != 0) {
+			pmemobj_close(obj_queue_bench.pop);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * obj_queue_exit -- cleanup of the obj_queue benchmark
+ */
+static int
+obj_queue_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	pmemobj_close(obj_queue_bench.pop);
+	return 0;
+}
+
+static struct benchmark_info obj_queue = {
+	.name		= "obj_queue",
+	.brief		= "shared persistent queue benchmark",
+	.init		= obj_queue_init,
+	.exit		= obj_queue_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.operation	= obj_queue_op,
+	.measure_time	= true,
+	.clos		= obj_queue_clo,
+	.nclos		= ARRAY_SIZE(obj_queue_clo),
+	.opts_size	= sizeof (struct obj_queue_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+REGISTER_BENCHMARK(obj_queue);
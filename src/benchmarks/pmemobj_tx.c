@@ -88,6 +88,10 @@ struct obj_tx_args {
 	 *		- abort-nested - all nested transactions will be
 	 *		  aborted.
 	 *
+	 *	modes for obj_tx_nested benchmark are the same, but
+	 *	transactions are empty so only the cost of beginning and
+	 *	ending (nested) transactions is measured.
+	 *
 	 *	modes for  obj_tx_add_range benchmark:
 	 *		- basic - one object is added to undo log many times in
 	 *		  one transaction.
@@ -466,6 +470,17 @@ no_free(struct obj_tx_bench *obj_bench, struct worker_info *worker,
 	return 0;
 }
 
+/*
+ * nested_empty -- main operation for obj_tx_nested benchmark, the innermost
+ * transaction does nothing
+ */
+static int
+nested_empty(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+							unsigned int idx)
+{
+	return 0;
+}
+
 /*
  * realloc_dram -- main operations for obj_tx_realloc benchmark in dram mode
  */
@@ -702,6 +717,8 @@ static fn_op free_op[] = {free_dram, free_tx, free_pmem, no_free};
 
 static fn_op realloc_op[] = {realloc_dram, realloc_tx, realloc_pmem};
 
+static fn_op nested_op[] = {nested_empty, nested_empty, nested_empty};
+
 static fn_op add_range_op[] = {add_range_tx, add_range_nested_tx};
 
 static fn_parse parse_op[] = {parse_op_mode, parse_op_mode_add_range};
@@ -1011,6 +1028,23 @@ obj_tx_alloc_init(struct benchmark *bench, struct benchmark_args *args)
 	return 0;
 }
 
+/*
+ * obj_tx_nested_init -- specific part of the obj_tx_nested initialization.
+ */
+static int
+obj_tx_nested_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	if (obj_tx_init(bench, args) != 0)
+		return -1;
+
+	struct obj_tx_bench *obj_bench = pmembench_get_priv(bench);
+	obj_bench->fn_op = nested_op;
+
+	/* no objects are allocated */
+	obj_bench->lib_op_free = LIB_MODE_NONE;
+	return 0;
+}
+
 /*
  * obj_tx_realloc_init -- specific part of the obj_tx_realloc initialization.
  */
@@ -1248,3 +1282,23 @@ static struct benchmark_info obj_tx_add_range = {
 };
 
 REGISTER_BENCHMARK(obj_tx_add_range);
+
+static struct benchmark_info obj_tx_nested = {
+	.name		= "obj_tx_nested",
+	.brief		= "nested transactions benchmark",
+	.init		= obj_tx_nested_init,
+	.exit		= obj_tx_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.init_worker	= obj_tx_init_worker,
+	.free_worker	= obj_tx_exit_worker,
+	.operation	= obj_tx_op,
+	.measure_time	= true,
+	.clos		= obj_tx_clo,
+	.nclos		= ARRAY_SIZE(obj_tx_clo) - 3,
+	.opts_size	= sizeof (struct obj_tx_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+
+REGISTER_BENCHMARK(obj_tx_nested);
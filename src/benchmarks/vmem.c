@@ -40,11 +40,14 @@
 #include "benchmark.h"
 #include <libvmem.h>
 #include <assert.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #define	DIR_MODE 0700
 #define	MAX_POOLS 8
 #define	FACTOR 2
+#define	ARENA_CHUNK_SIZE ((size_t)(4 << 20))
+#define	MAX_NUMA_DIRS 64
 #define	RRAND(max, min) (rand() % ((max) - (min)) + (min))
 
 struct vmem_bench;
@@ -62,6 +65,12 @@ struct vmem_args
 	int min_size;		/* size of min allocation in range mode */
 	size_t rsize;		/* size of reallocation */
 	int min_rsize;		/* size of min reallocation in range mode */
+	unsigned narenas;	/* number of arenas in each pool */
+	size_t tcache_max;	/* largest size cached per thread */
+	bool no_tcache;		/* disable thread caches */
+	int lg_dirty_mult;	/* active to dirty pages ratio (log2) */
+	char *numa_dirs;	/* pool directories, one per NUMA node */
+	bool interleave;	/* spread allocations over all nodes */
 
 	/* perform operation on object allocated by other thread */
 	bool mix;
@@ -144,6 +153,79 @@ static struct benchmark_clo vmem_clo[] = {
 			.max	= INT_MAX,
 		},
 	},
+	{
+		.opt_short	= 'A',
+		.opt_long	= "arenas",
+		.type		= CLO_TYPE_UINT,
+		.descr		= "Number of arenas in each pool"
+					" (0 - default)",
+		.off		= clo_field_offset(struct vmem_args, narenas),
+		.def		= "0",
+		.type_uint	= {
+			.size	= clo_field_size(struct vmem_args, narenas),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'C',
+		.opt_long	= "tcache-max",
+		.type		= CLO_TYPE_UINT,
+		.descr		= "Largest size cached per thread"
+					" (0 - default)",
+		.off		= clo_field_offset(struct vmem_args,
+							tcache_max),
+		.def		= "0",
+		.type_uint	= {
+			.size	= clo_field_size(struct vmem_args,
+							tcache_max),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= ~0,
+		},
+	},
+	{
+		.opt_short	= 'N',
+		.opt_long	= "no-tcache",
+		.descr		= "Disable thread caches",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct vmem_args, no_tcache),
+	},
+	{
+		.opt_short	= 'D',
+		.opt_long	= "lg-dirty-mult",
+		.type		= CLO_TYPE_INT,
+		.descr		= "Active to dirty pages ratio (log2,"
+					" 0 - default, -1 - never purge)",
+		.off		= clo_field_offset(struct vmem_args,
+							lg_dirty_mult),
+		.def		= "0",
+		.type_int	= {
+			.size	= clo_field_size(struct vmem_args,
+							lg_dirty_mult),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= -1,
+			.max	= 31,
+		},
+	},
+	{
+		.opt_long	= "numa-dirs",
+		.descr		= "Create every pool as a set of NUMA node"
+					" pools in the given directories"
+					" (separated by ':', none - disabled)",
+		.type		= CLO_TYPE_STR,
+		.off		= clo_field_offset(struct vmem_args, numa_dirs),
+		.def		= "none",
+	},
+	{
+		.opt_long	= "interleave",
+		.descr		= "Interleave allocations over the NUMA"
+					" node pools",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct vmem_args,
+							interleave),
+	},
 	/*
 	 * number of command line arguments is decremented to make below
 	 * options available only for vmem_free and vmem_realloc benchmark
@@ -300,7 +382,7 @@ static operation free_op[2] = {vmem_free_op, stdlib_free_op};
 static operation realloc_op[2] = {vmem_realloc_op, stdlib_realloc_op};
 
 /*
- * vmem_create_pools -- use vmem_create to create pools
+ * vmem_create_pools -- use vmem_create_ext or vmem_create_numa to create pools
  */
 static int
 vmem_create_pools(struct vmem_bench *vb, struct benchmark_args *args)
@@ -320,18 +402,61 @@ vmem_create_pools(struct vmem_bench *vb, struct benchmark_args *args)
 
 	/* multiply pool size to prevent out of memory error  */
 	vb->pool_size *= FACTOR;
+
+	/* every arena in use takes at least one chunk of the pool */
+	vb->pool_size += (size_t)va->narenas * ARENA_CHUNK_SIZE;
+
+	struct vmem_opts opts = {
+		.narenas = va->narenas,
+		.flags = va->no_tcache ? VMEM_OPT_NO_TCACHE : 0,
+		.tcache_max = va->tcache_max,
+		.lg_dirty_mult = va->lg_dirty_mult,
+	};
+	if (va->lg_dirty_mult < 0) {
+		opts.flags |= VMEM_OPT_NO_PURGE;
+		opts.lg_dirty_mult = 0;
+	}
+	if (va->interleave)
+		opts.flags |= VMEM_OPT_INTERLEAVE;
+
+	const char *dirs[MAX_NUMA_DIRS];
+	unsigned ndirs = 0;
+	char *dirlist = NULL;
+	if (strcmp(va->numa_dirs, "none") != 0) {
+		dirlist = strdup(va->numa_dirs);
+		if (dirlist == NULL) {
+			perror("strdup");
+			free(vb->pools);
+			return -1;
+		}
+
+		char *saveptr;
+		for (char *dir = strtok_r(dirlist, ":", &saveptr);
+				dir != NULL && ndirs < MAX_NUMA_DIRS;
+				dir = strtok_r(NULL, ":", &saveptr))
+			dirs[ndirs++] = dir;
+	}
+
 	for (i = 0; i < vb->npools; i++) {
-		vb->pools[i] = vmem_create(args->fname, vb->pool_size);
+		if (ndirs != 0) {
+			vb->pools[i] = vmem_create_numa(dirs, ndirs,
+						vb->pool_size, &opts);
+		} else {
+			vb->pools[i] = vmem_create_ext(args->fname,
+						vb->pool_size, &opts);
+		}
 		if (vb->pools[i] == NULL) {
-			perror("vmem_create");
+			perror(ndirs ? "vmem_create_numa" : "vmem_create_ext");
 			goto err;
 		}
 	}
+	free(dirlist);
 	return 0;
 err:
 	for (int j = i - 1; j >= 0; j--)
 		vmem_delete(vb->pools[j]);
 	free(vb->pools);
+	free(dirlist);
 	return -1;
 }
 
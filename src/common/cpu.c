@@ -90,6 +90,10 @@ cpuid(unsigned func, unsigned subfunc, unsigned cpuinfo[4])
 #define	bit_SSE2	(1 << 26)
 #endif
 
+#ifndef bit_SSE4_2
+#define	bit_SSE4_2	(1 << 20)
+#endif
+
 #ifndef bit_CLFLUSH
 #define	bit_CLFLUSH	(1 << 23)
 #endif
@@ -148,6 +152,22 @@ is_cpu_sse2_present(void)
 	return ret;
 }
 
+/*
+ * is_cpu_sse42_present -- checks if SSE4.2 extensions are supported
+ */
+int
+is_cpu_sse42_present(void)
+{
+	unsigned cpuinfo[4] = { 0 };
+
+	cpuid(0x1, 0x0, cpuinfo);
+
+	int ret = (cpuinfo[ECX_IDX] & bit_SSE4_2) != 0;
+	LOG(4, "SSE4.2 %ssupported", ret == 0 ? "not " : "");
+
+	return ret;
+}
+
 /*
  * is_cpu_clflush_present -- checks if CLFLUSH instruction is supported
  */
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * numa.c -- CPU to NUMA node mapping
+ *
+ * The map is read from sysfs once, without allocating any memory, so it can
+ * be set up by libvmmalloc before its pools exist.  If sysfs is not there,
+ * all CPUs are considered to be on node 0.
+ */
+
+#define	_GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "out.h"
+#include "numa.h"
+
+#define	NUMA_CPULIST_PATH "/sys/devices/system/node/node%u/cpulist"
+
+static uint8_t Cpu_node[NUMA_CPUS_MAX];
+static unsigned Nnodes = 1;
+
+/*
+ * numa_parse_cpulist -- (internal) assign the CPUs from a list to a node
+ *
+ * The list has the form of "0-3,8,10-11".
+ */
+static void
+numa_parse_cpulist(char *list, unsigned node)
+{
+	char *p = list;
+
+	while (*p >= '0' && *p <= '9') {
+		unsigned long first = strtoul(p, &p, 10);
+		unsigned long last = first;
+		if (*p == '-')
+			last = strtoul(p + 1, &p, 10);
+
+		for (unsigned long cpu = first;
+				cpu <= last && cpu < NUMA_CPUS_MAX; cpu++)
+			Cpu_node[cpu] = (uint8_t)node;
+
+		if (*p == ',')
+			p++;
+	}
+}
+
+/*
+ * util_numa_init -- read the CPU to node map of the system
+ */
+void
+util_numa_init(void)
+{
+	char path[64];
+	char list[4096];
+
+	for (unsigned node = 1; node < NUMA_NODES_MAX; node++) {
+		snprintf(path, sizeof (path), NUMA_CPULIST_PATH, node);
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			continue;
+
+		ssize_t len = read(fd, list, sizeof (list) - 1);
+		(void) close(fd);
+		if (len <= 0)
+			continue;
+
+		list[len] = '\0';
+		numa_parse_cpulist(list, node);
+		Nnodes = node + 1;
+	}
+
+	LOG(3, "%u NUMA node(s)", Nnodes);
+}
+
+/*
+ * util_numa_nnodes -- return the number of NUMA nodes
+ */
+unsigned
+util_numa_nnodes(void)
+{
+	return Nnodes;
+}
+
+/*
+ * util_numa_node -- return the NUMA node of the CPU the caller runs on
+ */
+unsigned
+util_numa_node(void)
+{
+	int cpu = sched_getcpu();
+	if (cpu < 0 || cpu >= NUMA_CPUS_MAX)
+		return 0;
+
+	return Cpu_node[cpu];
+}
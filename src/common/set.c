@@ -52,6 +52,7 @@
 #include <time.h>
 #include <ctype.h>
 #include <linux/limits.h>
+#include <pthread.h>
 
 #include "libpmem.h"
 #include "util.h"
@@ -63,6 +64,9 @@ extern unsigned long Pagesize;
 /* reserve space for size, path and some whitespace and/or comment */
 #define	PARSER_MAX_LINE (PATH_MAX + 1024)
 
+/* upper limit of the threads creating part files concurrently */
+#define	POOLSET_CREATE_THREADS_MAX 64
+
 enum parser_codes {
 	PARSER_CONTINUE = 0,
 	PARSER_PMEMPOOLSET,
@@ -178,6 +182,8 @@ util_map_part(struct pool_set_part *part, void *addr, size_t size,
 		return -1;
 	}
 
+	util_map_advise(part->addr, part->size);
+
 	VALGRIND_REGISTER_PMEM_MAPPING(part->addr, part->size);
 	VALGRIND_REGISTER_PMEM_FILE(part->fd, part->addr, part->size, offset);
 
@@ -697,24 +703,130 @@ util_poolset_file(struct pool_set_part *part, size_t minsize, int create)
 	return 0;
 }
 
+struct poolset_create_arg {
+	struct pool_set_part **parts;
+	unsigned nparts;
+	size_t minsize;
+	unsigned next;		/* index of the next part to be created */
+	int error;		/* errno of the first failure */
+};
+
+/*
+ * util_poolset_create_worker -- (internal) create part files until
+ *	there are none left or one of the workers has failed
+ */
+static void *
+util_poolset_create_worker(void *arg)
+{
+	struct poolset_create_arg *a = arg;
+
+	while (__sync_fetch_and_add(&a->error, 0) == 0) {
+		unsigned i = __sync_fetch_and_add(&a->next, 1);
+		if (i >= a->nparts)
+			break;
+
+		if (util_poolset_file(a->parts[i], a->minsize, 1) != 0) {
+			int err = errno ? errno : EINVAL;
+			(void) __sync_bool_compare_and_swap(&a->error, 0, err);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * util_poolset_create_parts -- (internal) create the given part files
+ *
+ * Allocating the space of a large part file (posix_fallocate) takes
+ * time proportional to its size, so the files are created concurrently,
+ * one thread per part, the calling thread included.
+ */
+static int
+util_poolset_create_parts(struct pool_set_part **parts, unsigned nparts,
+	size_t minsize)
+{
+	LOG(3, "parts %p nparts %u minsize %zu", parts, nparts, minsize);
+
+	struct poolset_create_arg arg = {parts, nparts, minsize, 0, 0};
+
+	unsigned nthreads = nparts - 1;
+	if (nthreads > POOLSET_CREATE_THREADS_MAX)
+		nthreads = POOLSET_CREATE_THREADS_MAX;
+
+	pthread_t threads[POOLSET_CREATE_THREADS_MAX];
+	unsigned started = 0;
+	for (; started < nthreads; ++started) {
+		if (pthread_create(&threads[started], NULL,
+				util_poolset_create_worker, &arg) != 0)
+			break;
+	}
+
+	util_poolset_create_worker(&arg);
+
+	for (unsigned i = 0; i < started; ++i) {
+		if ((errno = pthread_join(threads[i], NULL)))
+			FATAL("!pthread_join");
+	}
+
+	if (arg.error) {
+		errno = arg.error;
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * util_poolset_files -- (internal) open or create all the part files
  *                       of a pool set and replica sets
+ *
+ * Existing part files are opened first, in order.  The missing ones
+ * are then created concurrently.
  */
 static int
 util_poolset_files(struct pool_set *set, size_t minsize, int create)
 {
 	LOG(3, "set %p minsize %zu create %d", set, minsize, create);
 
+	unsigned nparts = 0;
+	for (unsigned r = 0; r < set->nreplicas; r++)
+		nparts += set->replica[r]->nparts;
+
+	struct pool_set_part **parts = NULL;
+	if (create && (parts = Malloc(nparts * sizeof (*parts))) == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	int ret = 0;
+	unsigned ncreate = 0;
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
 		for (unsigned p = 0; p < rep->nparts; p++) {
-			if (util_poolset_file(&rep->part[p], minsize, create))
-				return -1;
+			struct pool_set_part *part = &rep->part[p];
+			if (create && access(part->path, F_OK) != 0) {
+				parts[ncreate++] = part;
+				continue;
+			}
+
+			if (util_poolset_file(part, minsize, 0)) {
+				ret = -1;
+				goto out;
+			}
 		}
 	}
 
-	return 0;
+	if (ncreate > 0)
+		ret = util_poolset_create_parts(parts, ncreate, minsize);
+
+out:
+	if (parts) {
+		int oerrno = errno;
+		Free(parts);
+		errno = oerrno;
+	}
+
+	return ret;
 }
 
 /*
@@ -1349,6 +1461,40 @@ err:
 	return -1;
 }
 
+/*
+ * util_poolset_incompat_set -- add incompat features to the headers of all
+ *	the parts of a newly created pool set
+ *
+ * Used for features which depend on the way the pool set was created, and
+ * so are not known until util_pool_create() returns.
+ */
+int
+util_poolset_incompat_set(struct pool_set *set, uint32_t incompat)
+{
+	LOG(3, "set %p incompat %#x", set, incompat);
+
+	for (unsigned r = 0; r < set->nreplicas; r++) {
+		struct pool_replica *rep = set->replica[r];
+
+		for (unsigned p = 0; p < rep->nparts; p++) {
+			if (util_map_hdr(&rep->part[p], MAP_SHARED) != 0) {
+				LOG(2, "header mapping failed - part #%d", p);
+				return -1;
+			}
+
+			struct pool_hdr *hdrp = rep->part[p].hdr;
+			hdrp->incompat_features = htole32(
+				le32toh(hdrp->incompat_features) | incompat);
+			util_checksum(hdrp, sizeof (*hdrp), &hdrp->checksum, 1);
+			pmem_msync(hdrp, sizeof (*hdrp));
+
+			util_unmap_hdr(&rep->part[p]);
+		}
+	}
+
+	return 0;
+}
+
 /*
  * util_replica_open -- (internal) open a memory pool replica
  */
@@ -1410,6 +1556,13 @@ util_replica_open(struct pool_set *set, unsigned repidx, int flags)
 
 	ASSERTeq(mapsize, rep->repsize);
 
+	/*
+	 * Write faults of a private mapping would copy the pages and those of
+	 * a file in the page cache would make the whole pool dirty.
+	 */
+	util_map_prefault(rep->part[0].addr, rep->repsize,
+		rep->is_pmem && !(flags & MAP_PRIVATE));
+
 	/* calculate pool size - choose the smallest replica size */
 	if (rep->repsize < set->poolsize)
 		set->poolsize = rep->repsize;
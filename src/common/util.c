@@ -50,6 +50,7 @@
 #include <stddef.h>
 #include <elf.h>
 #include <link.h>
+#include <pthread.h>
 
 #include "util.h"
 #include "out.h"
@@ -111,6 +112,15 @@ unsigned _On_valgrind;
 static int Mmap_no_random;
 static void *Mmap_hint;
 
+static unsigned Mmap_opts; /* UTIL_MMAP_* flags */
+static unsigned Mmap_prefault_threads; /* 0 means one per online CPU */
+
+/* granularity of the parallel prefault */
+#define	PREFAULT_ALIGN (2 * MEGABYTE)
+
+/* upper limit of the prefault threads */
+#define	PREFAULT_THREADS_MAX 256
+
 /*
  * util_init -- initialize the utils
  *
@@ -142,12 +152,146 @@ util_init(void)
 		}
 	}
 
+	/*
+	 * Huge page and read-ahead advice and prefaulting of the mappings
+	 * of the pool files can be requested by the user.
+	 */
+	e = getenv("PMEM_MMAP_HUGEPAGE");
+	if (e && atoi(e))
+		Mmap_opts |= UTIL_MMAP_HUGEPAGE;
+
+	e = getenv("PMEM_MMAP_WILLNEED");
+	if (e && atoi(e))
+		Mmap_opts |= UTIL_MMAP_WILLNEED;
+
+	e = getenv("PMEM_MMAP_PREFAULT");
+	if (e) {
+		int nthreads = atoi(e);
+		if (nthreads > 0) {
+			Mmap_opts |= UTIL_MMAP_PREFAULT;
+			Mmap_prefault_threads = (unsigned)nthreads;
+		}
+	}
+
 #if defined(USE_VG_PMEMCHECK) || defined(USE_VG_HELGRIND) ||\
 	defined(USE_VG_MEMCHECK)
 	_On_valgrind = RUNNING_ON_VALGRIND;
 #endif
 }
 
+/*
+ * util_set_mmap_opts -- set the options of the pool file mappings
+ *
+ * If prefault_threads is 0, the prefault uses one thread per online CPU.
+ */
+void
+util_set_mmap_opts(unsigned opts, unsigned prefault_threads)
+{
+	LOG(3, "opts %#x prefault_threads %u", opts, prefault_threads);
+
+	Mmap_opts = opts;
+	Mmap_prefault_threads = prefault_threads;
+}
+
+/*
+ * util_map_advise -- apply the requested advice to a new mapping
+ *
+ * The advice is only a hint, so failures (e.g. no transparent huge pages
+ * on a DAX file system) are not treated as errors.
+ */
+void
+util_map_advise(void *addr, size_t len)
+{
+	LOG(3, "addr %p len %zu", addr, len);
+
+#ifdef MADV_HUGEPAGE
+	if ((Mmap_opts & UTIL_MMAP_HUGEPAGE) &&
+			madvise(addr, len, MADV_HUGEPAGE) != 0)
+		LOG(2, "!madvise MADV_HUGEPAGE %p %zu", addr, len);
+#endif
+
+	if ((Mmap_opts & UTIL_MMAP_WILLNEED) &&
+			madvise(addr, len, MADV_WILLNEED) != 0)
+		LOG(2, "!madvise MADV_WILLNEED %p %zu", addr, len);
+}
+
+struct prefault_arg {
+	char *addr;
+	size_t len;
+	int write;
+};
+
+/*
+ * util_prefault_range -- (internal) fault in a range of a mapping
+ *
+ * Write faults are taken without modifying the data when the kernel can
+ * populate the page tables on request, otherwise every page is read.
+ */
+static void *
+util_prefault_range(void *arg)
+{
+	struct prefault_arg *pa = arg;
+
+#ifdef MADV_POPULATE_WRITE
+	if (madvise(pa->addr, pa->len, pa->write ?
+			MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0)
+		return NULL;
+#endif
+
+	for (size_t off = 0; off < pa->len; off += Pagesize)
+		(void) *(volatile char *)(pa->addr + off);
+
+	return NULL;
+}
+
+/*
+ * util_map_prefault -- fault in a whole mapping in parallel, if requested
+ *
+ * Taking the page faults up front moves them off the hot path after the
+ * pool is opened. If write is not set, only read faults are taken, which
+ * avoids dirtying the page cache of a file which is not on pmem.
+ */
+void
+util_map_prefault(void *addr, size_t len, int write)
+{
+	LOG(3, "addr %p len %zu write %d", addr, len, write);
+
+	if (!(Mmap_opts & UTIL_MMAP_PREFAULT))
+		return;
+
+	unsigned nthreads = Mmap_prefault_threads;
+	if (nthreads == 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? (unsigned)ncpus : 1;
+	}
+	if (nthreads > PREFAULT_THREADS_MAX)
+		nthreads = PREFAULT_THREADS_MAX;
+
+	size_t chunk = roundup(len / nthreads + 1, PREFAULT_ALIGN);
+
+	pthread_t threads[PREFAULT_THREADS_MAX];
+	struct prefault_arg args[PREFAULT_THREADS_MAX];
+	int started[PREFAULT_THREADS_MAX];
+
+	unsigned n = 0;
+	for (size_t off = 0; off < len && n < nthreads; off += chunk, ++n) {
+		args[n].addr = (char *)addr + off;
+		args[n].len = len - off < chunk ? len - off : chunk;
+		args[n].write = write;
+
+		/* the last range is done by the calling thread */
+		started[n] = off + chunk < len && pthread_create(&threads[n],
+			NULL, util_prefault_range, &args[n]) == 0;
+		if (!started[n])
+			util_prefault_range(&args[n]);
+	}
+
+	for (unsigned i = 0; i < n; ++i) {
+		if (started[i] && (errno = pthread_join(threads[i], NULL)))
+			FATAL("!pthread_join");
+	}
+}
+
 /*
  * util_set_alloc_funcs -- allow one to override malloc, etc.
  */
@@ -332,6 +476,8 @@ util_map(int fd, size_t len, int cow, size_t req_align)
 		return NULL;
 	}
 
+	util_map_advise(base, len);
+
 	LOG(3, "mapped at %p", base);
 
 	return base;
@@ -59,6 +59,17 @@ void util_set_alloc_funcs(
 void *util_map(int fd, size_t len, int cow, size_t req_align);
 int util_unmap(void *addr, size_t len);
 
+/*
+ * mapping options, see util_set_mmap_opts
+ */
+#define	UTIL_MMAP_HUGEPAGE	(1U << 0) /* advise transparent huge pages */
+#define	UTIL_MMAP_WILLNEED	(1U << 1) /* advise reading ahead */
+#define	UTIL_MMAP_PREFAULT	(1U << 2) /* fault in the whole mapping */
+
+void util_set_mmap_opts(unsigned opts, unsigned prefault_threads);
+void util_map_advise(void *addr, size_t len);
+void util_map_prefault(void *addr, size_t len, int write);
+
 int util_tmpfile(const char *dir, const char *templ);
 void *util_map_tmpfile(const char *dir, size_t size, size_t req_align);
 
@@ -254,6 +265,7 @@ int util_uuid_generate(uuid_t uuid);
 int util_pool_create(struct pool_set **setp, const char *path, size_t poolsize,
 	size_t minsize, const char *sig,
 	uint32_t major, uint32_t compat, uint32_t incompat, uint32_t ro_compat);
+int util_poolset_incompat_set(struct pool_set *set, uint32_t incompat);
 int util_pool_open_nocheck(struct pool_set **setp, const char *path,
 		int rdonly);
 int util_pool_open(struct pool_set **setp, const char *path, int rdonly,
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * hashmap_cpp.cpp -- integer hash map built on the C++ unordered_map
+ * container, exported through a C interface
+ */
+
+#include <cerrno>
+
+#include <libpmemobj/make_persistent.hpp>
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/unordered_map.hpp>
+
+#include "hashmap_cpp.h"
+
+using namespace nvml::obj;
+
+typedef unordered_map<uint64_t, PMEMoid> map_type;
+
+/*
+ * hm_cpp_map -- (internal) returns a direct pointer to the map
+ */
+static map_type *
+hm_cpp_map(TOID(struct hashmap_cpp) hashmap)
+{
+	return persistent_ptr<map_type>(hashmap.oid).get();
+}
+
+/*
+ * hm_cpp_new -- allocates new hashmap
+ */
+int
+hm_cpp_new(PMEMobjpool *pop, TOID(struct hashmap_cpp) *map, void *arg)
+{
+	int ret = 0;
+	bool failed = false;
+
+	TX_BEGIN(pop) {
+		try {
+			pmemobj_tx_add_range_direct(map, sizeof (*map));
+			map->oid = make_persistent<map_type>().raw();
+		} catch (...) {
+			failed = true;
+		}
+
+		if (failed && pmemobj_tx_stage() == TX_STAGE_WORK)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_cpp_delete -- frees hashmap and all its entries
+ */
+int
+hm_cpp_delete(PMEMobjpool *pop, TOID(struct hashmap_cpp) *map)
+{
+	int ret = 0;
+	bool failed = false;
+
+	TX_BEGIN(pop) {
+		try {
+			persistent_ptr<map_type> m(map->oid);
+			delete_persistent<map_type>(m);
+			pmemobj_tx_add_range_direct(map, sizeof (*map));
+			map->oid = OID_NULL;
+		} catch (...) {
+			failed = true;
+		}
+
+		if (failed && pmemobj_tx_stage() == TX_STAGE_WORK)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_cpp_init -- recovers hashmap state, called after pmemobj_open
+ */
+int
+hm_cpp_init(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap)
+{
+	return 0;
+}
+
+/*
+ * hm_cpp_insert -- inserts specified value into the hashmap,
+ * returns:
+ * - 0 if successful,
+ * - 1 if value already existed,
+ * - -1 if something bad happened
+ */
+int
+hm_cpp_insert(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key, PMEMoid value)
+{
+	map_type *m = hm_cpp_map(hashmap);
+
+	try {
+		if (!m->insert(key, value))
+			return 1;
+	} catch (...) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * hm_cpp_remove -- removes specified value from the hashmap,
+ * returns:
+ * - key's value if successful,
+ * - OID_NULL if value didn't exist or if something bad happened
+ */
+PMEMoid
+hm_cpp_remove(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap, uint64_t key)
+{
+	map_type *m = hm_cpp_map(hashmap);
+	PMEMoid value = OID_NULL;
+
+	try {
+		if (!m->find(key, value) || m->erase(key) == 0)
+			return OID_NULL;
+	} catch (...) {
+		return OID_NULL;
+	}
+
+	return value;
+}
+
+/*
+ * hm_cpp_get -- checks whether specified key is in the hashmap,
+ * returns its value or OID_NULL
+ */
+PMEMoid
+hm_cpp_get(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap, uint64_t key)
+{
+	PMEMoid value = OID_NULL;
+
+	try {
+		if (hm_cpp_map(hashmap)->find(key, value))
+			return value;
+	} catch (...) {
+	}
+
+	return OID_NULL;
+}
+
+/*
+ * hm_cpp_lookup -- checks whether specified key exists
+ */
+int
+hm_cpp_lookup(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key)
+{
+	try {
+		return hm_cpp_map(hashmap)->count(key) != 0;
+	} catch (...) {
+		return 0;
+	}
+}
+
+/*
+ * hm_cpp_foreach -- prints all values from the hashmap
+ */
+int
+hm_cpp_foreach(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	int ret = 0;
+
+	try {
+		hm_cpp_map(hashmap)->for_each(
+			[&](const uint64_t &key, const PMEMoid &value) {
+				if (ret == 0)
+					ret = cb(key, value, arg);
+			});
+	} catch (...) {
+		return -1;
+	}
+
+	return ret;
+}
+
+/*
+ * hm_cpp_count -- returns number of elements
+ */
+size_t
+hm_cpp_count(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap)
+{
+	return hm_cpp_map(hashmap)->size();
+}
+
+/*
+ * hm_cpp_check -- checks if specified persistent object is an
+ * instance of hashmap
+ */
+int
+hm_cpp_check(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap)
+{
+	return TOID_IS_NULL(hashmap) || pmemobj_type_num(hashmap.oid) !=
+		(uint64_t)nvml::detail::type_num<map_type>();
+}
+
+/*
+ * hm_cpp_cmd -- execute cmd for hashmap
+ */
+int
+hm_cpp_cmd(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		unsigned cmd, uint64_t arg)
+{
+	switch (cmd) {
+		case HASHMAP_CMD_REBUILD:
+			try {
+				hm_cpp_map(hashmap)->rehash(arg);
+			} catch (...) {
+				return -1;
+			}
+			return 0;
+		default:
+			return -EINVAL;
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef	HASHMAP_CPP_H
+#define	HASHMAP_CPP_H
+
+/*
+ * C interface to the nvml::obj::unordered_map C++ container, so it can be
+ * plugged into the common map interface
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hashmap.h>
+#include <libpmemobj.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef	HASHMAP_CPP_TYPE_OFFSET
+#define	HASHMAP_CPP_TYPE_OFFSET 1008
+#endif
+
+struct hashmap_cpp;
+TOID_DECLARE(struct hashmap_cpp, HASHMAP_CPP_TYPE_OFFSET + 0);
+
+int hm_cpp_check(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap);
+int hm_cpp_new(PMEMobjpool *pop, TOID(struct hashmap_cpp) *map, void *arg);
+int hm_cpp_delete(PMEMobjpool *pop, TOID(struct hashmap_cpp) *map);
+int hm_cpp_init(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap);
+int hm_cpp_insert(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key, PMEMoid value);
+PMEMoid hm_cpp_remove(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key);
+PMEMoid hm_cpp_get(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key);
+int hm_cpp_lookup(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		uint64_t key);
+int hm_cpp_foreach(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+size_t hm_cpp_count(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap);
+int hm_cpp_cmd(PMEMobjpool *pop, TOID(struct hashmap_cpp) hashmap,
+		unsigned cmd, uint64_t arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HASHMAP_CPP_H */
@@ -0,0 +1,1058 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * integer hash map for concurrent use, with striped locks and incremental
+ * (linear hashing) resize
+ *
+ * Each bucket is an open-addressed array of HM_MT_SLOTS pairs spanning two
+ * cache lines: the first one holds the keys, so a lookup reads a single
+ * line before it finds the matching slot, the second one holds the values.
+ * A full bucket is extended by a chain of overflow buckets.
+ *
+ * The buckets are protected by HM_MT_STRIPES rwlocks. The stripe of a key
+ * is selected by the low bits of its hash, which are also the low bits of
+ * the bucket index, so a bucket and both halves it's split into always
+ * belong to the same stripe and no operation ever needs a second lock.
+ * The locks are taken through the transaction, so a pair modified within
+ * an outer transaction stays locked until the outer transaction ends.
+ * Concurrent transactions which modify several pairs should do it with
+ * a single insert_batch, which takes the locks in order, or they may
+ * deadlock.
+ *
+ * The table grows one bucket at a time: nbuckets is the whole linear
+ * hashing state and every insert splits at most HM_MT_SPLIT_STEP buckets
+ * when its stripe gets overloaded. The splits are serialized by the resize
+ * lock. An insert within a transaction splits the buckets as a part of it,
+ * holding the resize lock and the locks of the split stripes until the
+ * outermost transaction ends, but it only tries to take them, as waiting
+ * for them with a stripe lock held could deadlock. The stripes it couldn't
+ * relieve are marked pending in the hashmap and their buckets are split by
+ * the next operation of any thread. An insert within a transaction may
+ * abort it if the allocation of a new bucket segment fails. The table never
+ * shrinks.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <libpmemobj.h>
+#include "hashmap_mt.h"
+
+/* number of pairs in a bucket */
+#define	HM_MT_SLOTS 4
+
+/* number of lock stripes, one bit per stripe in a uint64_t mask */
+#define	HM_MT_STRIPES 64
+
+/* initial number of buckets, a power of two not smaller than HM_MT_STRIPES */
+#define	HM_MT_INIT_BUCKETS 64
+
+/* segment k > 0 holds HM_MT_INIT_BUCKETS << (k - 1) buckets */
+#define	HM_MT_MAX_SEGMENTS 48
+
+/* average number of pairs in a bucket which triggers a split */
+#define	HM_MT_MAX_LOAD 2
+
+/* maximum number of buckets split by a single insert */
+#define	HM_MT_SPLIT_STEP 2
+
+/* layout definition */
+TOID_DECLARE(struct hm_mt_bucket, HASHMAP_MT_TYPE_OFFSET + 1);
+
+struct hm_mt_bucket {
+	/* first cache line -- compared keys */
+	uint64_t keys[HM_MT_SLOTS];
+	/* number of used slots */
+	uint64_t n;
+	/* overflow bucket */
+	TOID(struct hm_mt_bucket) next;
+	uint64_t unused;
+
+	/* second cache line -- values of the keys */
+	PMEMoid values[HM_MT_SLOTS];
+};
+
+struct hm_mt_stripe {
+	PMEMrwlock lock;
+
+	/* number of pairs in the buckets of the stripe */
+	uint64_t count;
+	uint64_t unused[7];
+};
+
+struct hashmap_mt {
+	struct hm_mt_stripe stripes[HM_MT_STRIPES];
+
+	/* hash function seed */
+	uint64_t seed;
+
+	/* number of buckets, the linear hashing state */
+	uint64_t nbuckets;
+
+	/* serializes splits */
+	PMEMmutex resize_lock;
+
+	/* bucket arrays */
+	TOID(struct hm_mt_bucket) segments[HM_MT_MAX_SEGMENTS];
+
+	/* runtime state, reset by hm_mt_init */
+
+	/* overloaded stripes whose buckets are to be split */
+	uint64_t pending;
+
+	/* thread which holds the resize lock until its transaction ends */
+	const void *tx_owner;
+
+	/* stripes locked by the splits of the owner's transaction */
+	uint64_t tx_locked;
+};
+
+struct hm_mt_pair {
+	uint64_t key;
+	PMEMoid value;
+};
+
+static __thread char hm_mt_me; /* its address identifies the thread */
+
+/*
+ * hm_mt_hash -- (internal) 64-bit finalizer of MurmurHash3, every bit
+ * of the key affects the low bits used for bucket selection
+ */
+static inline uint64_t
+hm_mt_hash(uint64_t seed, uint64_t key)
+{
+	key ^= seed;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+
+	return key;
+}
+
+/*
+ * hm_mt_nbuckets -- (internal) reads the number of buckets
+ *
+ * It's changed by splits under the lock of the split stripe only, so the
+ * operations on other stripes read it atomically. Their buckets are not
+ * affected by the change.
+ */
+static inline uint64_t
+hm_mt_nbuckets(struct hashmap_mt *hm)
+{
+	return __atomic_load_n(&hm->nbuckets, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * hm_mt_index -- (internal) linear hashing bucket index of a hash
+ */
+static inline uint64_t
+hm_mt_index(uint64_t nbuckets, uint64_t h)
+{
+	uint64_t m = 1ULL << (63 - __builtin_clzll(nbuckets));
+	uint64_t idx = h & (2 * m - 1);
+
+	return idx < nbuckets ? idx : h & (m - 1);
+}
+
+/*
+ * hm_mt_segment -- (internal) returns segment of the bucket, and the bucket
+ * index within the segment through *off
+ */
+static inline unsigned
+hm_mt_segment(uint64_t idx, uint64_t *off)
+{
+	if (idx < HM_MT_INIT_BUCKETS) {
+		*off = idx;
+		return 0;
+	}
+
+	unsigned seg = 64 - __builtin_clzll(idx / HM_MT_INIT_BUCKETS);
+	*off = idx - ((uint64_t)HM_MT_INIT_BUCKETS << (seg - 1));
+
+	return seg;
+}
+
+/*
+ * hm_mt_bucket -- (internal) returns bucket with the given index
+ */
+static inline struct hm_mt_bucket *
+hm_mt_bucket(struct hashmap_mt *hm, uint64_t idx)
+{
+	uint64_t off;
+	unsigned seg = hm_mt_segment(idx, &off);
+
+	return D_RW(hm->segments[seg]) + off;
+}
+
+/*
+ * hm_mt_stripe -- (internal) returns stripe of the hash
+ */
+static inline struct hm_mt_stripe *
+hm_mt_stripe(struct hashmap_mt *hm, uint64_t h)
+{
+	return &hm->stripes[h & (HM_MT_STRIPES - 1)];
+}
+
+/*
+ * hm_mt_head -- (internal) returns first bucket of the hash's chain
+ */
+static inline struct hm_mt_bucket *
+hm_mt_head(struct hashmap_mt *hm, uint64_t h)
+{
+	return hm_mt_bucket(hm, hm_mt_index(hm_mt_nbuckets(hm), h));
+}
+
+/*
+ * hm_mt_tx_owner -- (internal) checks if the resize lock is held until
+ * the transaction of the calling thread ends
+ */
+static inline int
+hm_mt_tx_owner(struct hashmap_mt *hm)
+{
+	return __atomic_load_n(&hm->tx_owner, __ATOMIC_RELAXED) == &hm_mt_me;
+}
+
+/*
+ * hm_mt_tx_lock -- (internal) adds the lock of the stripe to the current
+ * transaction, unless a split within the transaction holds it already
+ */
+static void
+hm_mt_tx_lock(struct hashmap_mt *hm, struct hm_mt_stripe *st)
+{
+	if (hm_mt_tx_owner(hm) &&
+			(hm->tx_locked & (1ULL << (st - hm->stripes))))
+		return;
+
+	if (pmemobj_tx_lock(TX_LOCK_RWLOCK, &st->lock))
+		pmemobj_tx_abort(EINVAL);
+}
+
+/*
+ * hm_mt_rdlock -- (internal) locks the stripe for reading
+ *
+ * Within a transaction the lock is added to it, so it's held until the
+ * outermost transaction ends. Returns 1 if the caller has to unlock it.
+ */
+static int
+hm_mt_rdlock(PMEMobjpool *pop, struct hashmap_mt *hm, struct hm_mt_stripe *st)
+{
+	if (pmemobj_tx_stage() == TX_STAGE_WORK) {
+		hm_mt_tx_lock(hm, st);
+		return 0;
+	}
+
+	pmemobj_rwlock_rdlock(pop, &st->lock);
+	return 1;
+}
+
+/*
+ * hm_mt_find -- (internal) looks for the key in the chain, returns the
+ * bucket and the slot of the key, and the preceding bucket if prev is
+ * not NULL
+ */
+static struct hm_mt_bucket *
+hm_mt_find(struct hm_mt_bucket *b, uint64_t key, unsigned *slot,
+	struct hm_mt_bucket **prev)
+{
+	struct hm_mt_bucket *p = NULL;
+	for (; b != NULL; p = b, b = D_RW(b->next)) {
+		for (unsigned i = 0; i < b->n; i++) {
+			if (b->keys[i] == key) {
+				*slot = i;
+				if (prev)
+					*prev = p;
+				return b;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * hm_mt_append -- (internal) appends pair to the last bucket of a chain,
+ * returns the new last bucket
+ *
+ * The slots above n are not used, so only n is snapshotted and the pair
+ * is persisted before n is changed.
+ */
+static struct hm_mt_bucket *
+hm_mt_append(PMEMobjpool *pop, struct hm_mt_bucket *b,
+	uint64_t key, PMEMoid value)
+{
+	if (b->n == HM_MT_SLOTS) {
+		TX_ADD_FIELD_DIRECT(b, next);
+		b->next = TX_ZNEW(struct hm_mt_bucket);
+		b = D_RW(b->next);
+	}
+
+	b->keys[b->n] = key;
+	b->values[b->n] = value;
+	pmemobj_persist(pop, &b->keys[b->n], sizeof (b->keys[b->n]));
+	pmemobj_persist(pop, &b->values[b->n], sizeof (b->values[b->n]));
+
+	TX_ADD_FIELD_DIRECT(b, n);
+	b->n++;
+
+	return b;
+}
+
+/*
+ * hm_mt_insert_locked -- (internal) inserts pair into the locked stripe,
+ * must be called within a transaction
+ */
+static int
+hm_mt_insert_locked(PMEMobjpool *pop, struct hashmap_mt *hm, uint64_t h,
+	uint64_t key, PMEMoid value)
+{
+	struct hm_mt_bucket *b = hm_mt_head(hm, h);
+	unsigned slot;
+
+	if (hm_mt_find(b, key, &slot, NULL))
+		return 1;
+
+	/* first bucket of the chain with a free slot */
+	while (b->n == HM_MT_SLOTS && !TOID_IS_NULL(b->next))
+		b = D_RW(b->next);
+
+	hm_mt_append(pop, b, key, value);
+
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+	TX_ADD_FIELD_DIRECT(st, count);
+	st->count++;
+
+	return 0;
+}
+
+/*
+ * hm_mt_split_stripe -- (internal) returns stripe of the bucket split next
+ */
+static inline unsigned
+hm_mt_split_stripe(struct hashmap_mt *hm)
+{
+	uint64_t nbuckets = hm->nbuckets;
+	uint64_t m = 1ULL << (63 - __builtin_clzll(nbuckets));
+
+	return (unsigned)((nbuckets - m) & (HM_MT_STRIPES - 1));
+}
+
+/*
+ * hm_mt_split_locked -- (internal) splits the next bucket in the linear
+ * hashing order, must be called with the resize lock and the lock of the
+ * split stripe held
+ *
+ * Within a transaction the split becomes a part of it. Returns 0 if
+ * a bucket was split, 1 otherwise.
+ */
+static int
+hm_mt_split_locked(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+
+	uint64_t nbuckets = hm->nbuckets;
+	uint64_t m = 1ULL << (63 - __builtin_clzll(nbuckets));
+	uint64_t off;
+	unsigned seg = hm_mt_segment(nbuckets, &off);
+	if (seg == HM_MT_MAX_SEGMENTS)
+		return 1;
+
+	/* the pairs with bit m of the hash set move to the new bucket */
+	uint64_t idx = nbuckets - m;
+
+	int ret = 0;
+	TX_BEGIN(pop) {
+		if (off == 0) {
+			size_t len = (size_t)HM_MT_INIT_BUCKETS << (seg - 1);
+			TX_ADD_FIELD(hashmap, segments[seg]);
+			hm->segments[seg] = TX_ZALLOC(struct hm_mt_bucket,
+					len * sizeof (struct hm_mt_bucket));
+		}
+
+		struct hm_mt_bucket *src = hm_mt_bucket(hm, idx);
+		struct hm_mt_bucket *dst = hm_mt_bucket(hm, nbuckets);
+
+		/* the new bucket is unused, its slots need no snapshot */
+		TX_ADD_FIELD_DIRECT(dst, n);
+		TX_ADD_FIELD_DIRECT(dst, next);
+		struct hm_mt_bucket *last = dst;
+
+		/* the staying pairs are compacted within the old chain */
+		struct hm_mt_bucket *w = src;
+		unsigned wn = 0;
+		for (struct hm_mt_bucket *r = src; r != NULL;
+				r = D_RW(r->next)) {
+			TX_ADD_DIRECT(r);
+			for (unsigned i = 0; i < r->n; i++) {
+				uint64_t key = r->keys[i];
+				PMEMoid value = r->values[i];
+				if (hm_mt_hash(hm->seed, key) & m) {
+					last = hm_mt_append(pop, last,
+							key, value);
+					continue;
+				}
+
+				if (wn == HM_MT_SLOTS) {
+					w->n = HM_MT_SLOTS;
+					w = D_RW(w->next);
+					wn = 0;
+				}
+				w->keys[wn] = key;
+				w->values[wn] = value;
+				wn++;
+			}
+		}
+		w->n = wn;
+
+		/* free the emptied overflow buckets */
+		TOID(struct hm_mt_bucket) next = w->next;
+		TOID_ASSIGN(w->next, OID_NULL);
+		while (!TOID_IS_NULL(next)) {
+			TOID(struct hm_mt_bucket) b = next;
+			next = D_RO(b)->next;
+			TX_FREE(b);
+		}
+
+		TX_ADD_FIELD(hashmap, nbuckets);
+		__atomic_store_n(&hm->nbuckets, nbuckets + 1, __ATOMIC_RELEASE);
+	} TX_ONABORT {
+		fprintf(stderr, "%s: transaction aborted: %s\n", __func__,
+			pmemobj_errormsg());
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_mt_split -- (internal) splits the next bucket in the linear hashing
+ * order, must be called outside of a transaction with the resize lock held
+ *
+ * Returns 0 if a bucket was split, 1 otherwise.
+ */
+static int
+hm_mt_split(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	struct hm_mt_stripe *st = &hm->stripes[hm_mt_split_stripe(hm)];
+
+	pmemobj_rwlock_wrlock(pop, &st->lock);
+	int ret = hm_mt_split_locked(pop, hashmap);
+	pmemobj_rwlock_unlock(pop, &st->lock);
+
+	return ret;
+}
+
+/*
+ * hm_mt_overloaded -- (internal) checks if the stripe holds more pairs than
+ * its share of buckets should
+ */
+static int
+hm_mt_overloaded(struct hashmap_mt *hm, struct hm_mt_stripe *st)
+{
+	return st->count * HM_MT_STRIPES >
+		hm_mt_nbuckets(hm) * HM_MT_MAX_LOAD;
+}
+
+/*
+ * hm_mt_grow -- (internal) splits up to max buckets while the stripe is
+ * overloaded
+ *
+ * The overload is checked again under the resize lock, as the threads
+ * waiting for it may have been relieved by the current holder.
+ */
+static void
+hm_mt_grow(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	struct hm_mt_stripe *st, size_t max)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	if (!hm_mt_overloaded(hm, st))
+		return;
+
+	pmemobj_mutex_lock(pop, &hm->resize_lock);
+	for (size_t i = 0; i < max && hm_mt_overloaded(hm, st); i++) {
+		if (hm_mt_split(pop, hashmap))
+			break;
+	}
+	pmemobj_mutex_unlock(pop, &hm->resize_lock);
+}
+
+/*
+ * hm_mt_overloaded_mask -- (internal) returns the overloaded stripes out of
+ * the given ones
+ */
+static uint64_t
+hm_mt_overloaded_mask(struct hashmap_mt *hm, uint64_t stripes)
+{
+	uint64_t ret = 0;
+	while (stripes) {
+		unsigned s = (unsigned)__builtin_ctzll(stripes);
+		stripes &= stripes - 1;
+		if (hm_mt_overloaded(hm, &hm->stripes[s]))
+			ret |= 1ULL << s;
+	}
+
+	return ret;
+}
+
+/*
+ * hm_mt_defer -- (internal) marks the stripes pending, so their buckets are
+ * split by the next operation
+ */
+static void
+hm_mt_defer(struct hashmap_mt *hm, uint64_t stripes)
+{
+	if (stripes)
+		__atomic_fetch_or(&hm->pending, stripes, __ATOMIC_RELEASE);
+}
+
+/*
+ * hm_mt_grow_pending -- (internal) splits buckets while any of the pending
+ * stripes is overloaded, must be called outside of a transaction
+ *
+ * The resize lock is only tried, so the operation doesn't wait for the
+ * transaction which holds it.
+ */
+static void
+hm_mt_grow_pending(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	if (__atomic_load_n(&hm->pending, __ATOMIC_ACQUIRE) == 0)
+		return;
+
+	if (pmemobj_mutex_trylock(pop, &hm->resize_lock))
+		return;
+
+	uint64_t stripes = __atomic_exchange_n(&hm->pending, 0,
+			__ATOMIC_ACQ_REL);
+	while ((stripes = hm_mt_overloaded_mask(hm, stripes)) != 0) {
+		if (hm_mt_split(pop, hashmap))
+			break;
+	}
+	hm_mt_defer(hm, stripes);
+
+	pmemobj_mutex_unlock(pop, &hm->resize_lock);
+}
+
+/*
+ * hm_mt_tx_unlock -- (internal) releases the locks taken by the splits
+ * of the transaction, once it has been committed or rolled back
+ */
+static void
+hm_mt_tx_unlock(PMEMobjpool *pop, enum pobj_tx_stage stage, void *arg)
+{
+	struct hashmap_mt *hm = arg;
+
+	__atomic_store_n(&hm->tx_owner, NULL, __ATOMIC_RELAXED);
+	uint64_t locked = hm->tx_locked;
+	hm->tx_locked = 0;
+	while (locked) {
+		unsigned s = (unsigned)__builtin_ctzll(locked);
+		locked &= locked - 1;
+		pmemobj_rwlock_unlock(pop, &hm->stripes[s].lock);
+	}
+
+	pmemobj_mutex_unlock(pop, &hm->resize_lock);
+}
+
+/*
+ * hm_mt_tx_grow -- (internal) splits up to max buckets within the current
+ * transaction while any of the given or pending stripes is overloaded
+ *
+ * The locks of the held stripes are already held through the transaction.
+ * The resize lock and the locks of the other split stripes are taken until
+ * the outermost transaction ends, once per transaction. The stripes which
+ * are still overloaded are left pending.
+ */
+static void
+hm_mt_tx_grow(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	uint64_t stripes, uint64_t held, size_t max)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+
+	stripes |= __atomic_exchange_n(&hm->pending, 0, __ATOMIC_ACQ_REL);
+	stripes = hm_mt_overloaded_mask(hm, stripes);
+	if (stripes == 0)
+		return;
+
+	if (!hm_mt_tx_owner(hm)) {
+		if (pmemobj_mutex_trylock(pop, &hm->resize_lock)) {
+			hm_mt_defer(hm, stripes);
+			return;
+		}
+
+		if (pmemobj_tx_on_end(hm_mt_tx_unlock, hm)) {
+			pmemobj_mutex_unlock(pop, &hm->resize_lock);
+			hm_mt_defer(hm, stripes);
+			return;
+		}
+
+		hm->tx_locked = 0;
+		__atomic_store_n(&hm->tx_owner, &hm_mt_me, __ATOMIC_RELAXED);
+	}
+
+	for (size_t i = 0; i < max && stripes; i++) {
+		unsigned s = hm_mt_split_stripe(hm);
+		uint64_t bit = 1ULL << s;
+		if (!((held | hm->tx_locked) & bit)) {
+			if (pmemobj_rwlock_trywrlock(pop,
+					&hm->stripes[s].lock))
+				break;
+			hm->tx_locked |= bit;
+		}
+
+		if (hm_mt_split_locked(pop, hashmap))
+			break;
+
+		stripes = hm_mt_overloaded_mask(hm, stripes);
+	}
+
+	hm_mt_defer(hm, stripes);
+}
+
+/*
+ * hm_mt_insert -- inserts specified value into the hashmap,
+ * returns:
+ * - 0 if successful,
+ * - 1 if value already existed,
+ * - -1 if something bad happened
+ */
+int
+hm_mt_insert(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	uint64_t key, PMEMoid value)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	uint64_t h = hm_mt_hash(hm->seed, key);
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+	int outer = pmemobj_tx_stage() == TX_STAGE_NONE;
+
+	if (outer)
+		hm_mt_grow_pending(pop, hashmap);
+
+	int ret = 0;
+	TX_BEGIN(pop) {
+		hm_mt_tx_lock(hm, st);
+		ret = hm_mt_insert_locked(pop, hm, h, key, value);
+	} TX_ONABORT {
+		fprintf(stderr, "transaction aborted: %s\n",
+			pmemobj_errormsg());
+		ret = -1;
+	} TX_END
+
+	uint64_t bit = 1ULL << (h & (HM_MT_STRIPES - 1));
+	if (ret == 0 && outer)
+		hm_mt_grow(pop, hashmap, st, HM_MT_SPLIT_STEP);
+	else if (ret == 0)
+		hm_mt_tx_grow(pop, hashmap, bit, bit, HM_MT_SPLIT_STEP);
+
+	return ret;
+}
+
+/*
+ * hm_mt_insert_batch -- inserts n pairs in a single transaction,
+ * returns 0 if successful, 1 if any of the keys already existed or
+ * something bad happened
+ *
+ * The stripes are locked in ascending order before any pair is inserted,
+ * so concurrent batches don't deadlock.
+ */
+int
+hm_mt_insert_batch(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	const uint64_t *keys, const PMEMoid *values, size_t n)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	int outer = pmemobj_tx_stage() == TX_STAGE_NONE;
+
+	if (outer)
+		hm_mt_grow_pending(pop, hashmap);
+
+	uint64_t mask = 0;
+	for (size_t i = 0; i < n; i++)
+		mask |= 1ULL << (hm_mt_hash(hm->seed, keys[i]) &
+				(HM_MT_STRIPES - 1));
+
+	int ret = 0;
+	TX_BEGIN(pop) {
+		for (unsigned s = 0; s < HM_MT_STRIPES; s++) {
+			if (mask & (1ULL << s))
+				hm_mt_tx_lock(hm, &hm->stripes[s]);
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			uint64_t h = hm_mt_hash(hm->seed, keys[i]);
+			if (hm_mt_insert_locked(pop, hm, h, keys[i], values[i]))
+				pmemobj_tx_abort(EINVAL);
+		}
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	if (ret == 0 && outer && n > 0) {
+		uint64_t h = hm_mt_hash(hm->seed, keys[n - 1]);
+		hm_mt_grow(pop, hashmap, hm_mt_stripe(hm, h),
+				n * HM_MT_SPLIT_STEP);
+	} else if (ret == 0) {
+		hm_mt_tx_grow(pop, hashmap, mask, mask, n * HM_MT_SPLIT_STEP);
+	}
+
+	return ret;
+}
+
+/*
+ * hm_mt_remove_locked -- (internal) removes key from the locked stripe,
+ * must be called within a transaction
+ */
+static PMEMoid
+hm_mt_remove_locked(PMEMobjpool *pop, struct hashmap_mt *hm, uint64_t h,
+	uint64_t key)
+{
+	struct hm_mt_bucket *prev;
+	unsigned slot;
+	struct hm_mt_bucket *b = hm_mt_find(hm_mt_head(hm, h), key, &slot,
+			&prev);
+	if (b == NULL)
+		return OID_NULL;
+
+	PMEMoid value = b->values[slot];
+
+	/* the last pair of the bucket fills the hole */
+	unsigned last = (unsigned)b->n - 1;
+	if (slot != last) {
+		TX_ADD_FIELD_DIRECT(b, keys[slot]);
+		TX_ADD_FIELD_DIRECT(b, values[slot]);
+		b->keys[slot] = b->keys[last];
+		b->values[slot] = b->values[last];
+	}
+	TX_ADD_FIELD_DIRECT(b, n);
+	b->n--;
+
+	if (b->n == 0 && prev != NULL) {
+		TOID(struct hm_mt_bucket) empty = prev->next;
+		TX_ADD_FIELD_DIRECT(prev, next);
+		prev->next = b->next;
+		TX_FREE(empty);
+	}
+
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+	TX_ADD_FIELD_DIRECT(st, count);
+	st->count--;
+
+	return value;
+}
+
+/*
+ * hm_mt_remove -- removes specified value from the hashmap,
+ * returns:
+ * - key's value if successful,
+ * - OID_NULL if value didn't exist or if something bad happened
+ */
+PMEMoid
+hm_mt_remove(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	uint64_t h = hm_mt_hash(hm->seed, key);
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+
+	if (pmemobj_tx_stage() == TX_STAGE_NONE)
+		hm_mt_grow_pending(pop, hashmap);
+
+	PMEMoid value = OID_NULL;
+	TX_BEGIN(pop) {
+		hm_mt_tx_lock(hm, st);
+		value = hm_mt_remove_locked(pop, hm, h, key);
+	} TX_ONABORT {
+		fprintf(stderr, "transaction aborted: %s\n",
+			pmemobj_errormsg());
+		value = OID_NULL;
+	} TX_END
+
+	return value;
+}
+
+/*
+ * hm_mt_foreach -- calls cb for all values from the hashmap
+ *
+ * The pairs of a bucket are copied under its lock and cb is called after
+ * the lock is released, so it may modify the hashmap. Pairs inserted or
+ * moved by a concurrent split while the iteration is in progress may be
+ * missed or visited twice.
+ */
+int
+hm_mt_foreach(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	struct hm_mt_pair *pairs = NULL;
+	size_t cap = 0;
+
+	int ret = 0;
+	for (uint64_t i = 0; ret == 0 && i < hm_mt_nbuckets(hm); ++i) {
+		struct hm_mt_stripe *st = hm_mt_stripe(hm, i);
+		int unlock = hm_mt_rdlock(pop, hm, st);
+
+		size_t n = 0;
+		for (struct hm_mt_bucket *b = hm_mt_bucket(hm, i);
+				b != NULL; b = D_RW(b->next)) {
+			if (n + HM_MT_SLOTS > cap) {
+				size_t ncap = cap ? 2 * cap : 4 * HM_MT_SLOTS;
+				struct hm_mt_pair *p = realloc(pairs,
+						ncap * sizeof (*p));
+				if (p == NULL) {
+					ret = -1;
+					break;
+				}
+				pairs = p;
+				cap = ncap;
+			}
+
+			for (unsigned j = 0; j < b->n; j++) {
+				pairs[n].key = b->keys[j];
+				pairs[n].value = b->values[j];
+				n++;
+			}
+		}
+
+		if (unlock)
+			pmemobj_rwlock_unlock(pop, &st->lock);
+
+		for (size_t j = 0; ret == 0 && j < n; j++)
+			ret = cb(pairs[j].key, pairs[j].value, arg);
+	}
+
+	free(pairs);
+
+	return ret;
+}
+
+/*
+ * hm_mt_debug -- prints complete hashmap state
+ */
+static void
+hm_mt_debug(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, FILE *out)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	uint64_t nbuckets = hm_mt_nbuckets(hm);
+
+	fprintf(out, "seed: %lu\n", hm->seed);
+	fprintf(out, "count: %lu, buckets: %lu\n", hm_mt_count(pop, hashmap),
+		nbuckets);
+
+	for (uint64_t i = 0; i < nbuckets; ++i) {
+		struct hm_mt_bucket *b = hm_mt_bucket(hm, i);
+		if (b->n == 0 && TOID_IS_NULL(b->next))
+			continue;
+
+		int num = 0;
+		fprintf(out, "%lu: ", i);
+		for (; b != NULL; b = D_RW(b->next)) {
+			for (unsigned j = 0; j < b->n; j++) {
+				fprintf(out, "%lu ", b->keys[j]);
+				num++;
+			}
+		}
+		fprintf(out, "(%d)\n", num);
+	}
+}
+
+/*
+ * hm_mt_get -- checks whether specified value is in the hashmap
+ */
+PMEMoid
+hm_mt_get(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	uint64_t h = hm_mt_hash(hm->seed, key);
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+
+	if (pmemobj_tx_stage() == TX_STAGE_NONE)
+		hm_mt_grow_pending(pop, hashmap);
+
+	int unlock = hm_mt_rdlock(pop, hm, st);
+
+	unsigned slot;
+	struct hm_mt_bucket *b = hm_mt_find(hm_mt_head(hm, h), key, &slot,
+			NULL);
+	PMEMoid value = b ? b->values[slot] : OID_NULL;
+
+	if (unlock)
+		pmemobj_rwlock_unlock(pop, &st->lock);
+
+	return value;
+}
+
+/*
+ * hm_mt_lookup -- checks whether specified value exists
+ */
+int
+hm_mt_lookup(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	uint64_t h = hm_mt_hash(hm->seed, key);
+	struct hm_mt_stripe *st = hm_mt_stripe(hm, h);
+
+	if (pmemobj_tx_stage() == TX_STAGE_NONE)
+		hm_mt_grow_pending(pop, hashmap);
+
+	int unlock = hm_mt_rdlock(pop, hm, st);
+
+	unsigned slot;
+	int found = hm_mt_find(hm_mt_head(hm, h), key, &slot, NULL) != NULL;
+
+	if (unlock)
+		pmemobj_rwlock_unlock(pop, &st->lock);
+
+	return found;
+}
+
+/*
+ * hm_mt_count -- returns number of elements
+ */
+size_t
+hm_mt_count(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	size_t count = 0;
+	for (unsigned s = 0; s < HM_MT_STRIPES; s++)
+		count += D_RO(hashmap)->stripes[s].count;
+
+	return count;
+}
+
+/*
+ * hm_mt_init -- recovers hashmap state, called after pmemobj_open
+ *
+ * The locks are reinitialized by libpmemobj and every split is a single
+ * transaction, so only the runtime state left by the previous run is reset.
+ */
+int
+hm_mt_init(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	struct hashmap_mt *hm = D_RW(hashmap);
+	hm->pending = 0;
+	hm->tx_owner = NULL;
+	hm->tx_locked = 0;
+
+	return 0;
+}
+
+/*
+ * hm_mt_new -- allocates new hashmap
+ */
+int
+hm_mt_new(PMEMobjpool *pop, TOID(struct hashmap_mt) *map, void *arg)
+{
+	struct hashmap_args *args = arg;
+	int ret = 0;
+	TX_BEGIN(pop) {
+		*map = TX_ZNEW(struct hashmap_mt);
+
+		struct hashmap_mt *hm = D_RW(*map);
+		hm->seed = args ? args->seed : 0;
+		hm->segments[0] = TX_ZALLOC(struct hm_mt_bucket,
+				HM_MT_INIT_BUCKETS *
+				sizeof (struct hm_mt_bucket));
+		hm->nbuckets = HM_MT_INIT_BUCKETS;
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_mt_check -- checks if specified persistent object is an
+ * instance of hashmap
+ */
+int
+hm_mt_check(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	return TOID_IS_NULL(hashmap) || !TOID_VALID(hashmap);
+}
+
+/*
+ * hm_mt_rebuild -- splits buckets until there are at least nbuckets of
+ * them, or until no stripe is overloaded if nbuckets is 0
+ */
+static int
+hm_mt_rebuild(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	uint64_t nbuckets)
+{
+	if (pmemobj_tx_stage() != TX_STAGE_NONE)
+		return -EINVAL;
+
+	struct hashmap_mt *hm = D_RW(hashmap);
+	int ret = 0;
+
+	pmemobj_mutex_lock(pop, &hm->resize_lock);
+	for (;;) {
+		int grow = 0;
+		if (nbuckets) {
+			grow = hm->nbuckets < nbuckets;
+		} else {
+			for (unsigned s = 0; !grow && s < HM_MT_STRIPES; s++)
+				grow = hm_mt_overloaded(hm, &hm->stripes[s]);
+		}
+
+		if (!grow)
+			break;
+
+		if (hm_mt_split(pop, hashmap)) {
+			ret = -EAGAIN;
+			break;
+		}
+	}
+	pmemobj_mutex_unlock(pop, &hm->resize_lock);
+
+	return ret;
+}
+
+/*
+ * hm_mt_cmd -- execute cmd for hashmap
+ */
+int
+hm_mt_cmd(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		unsigned cmd, uint64_t arg)
+{
+	switch (cmd) {
+		case HASHMAP_CMD_REBUILD:
+			return hm_mt_rebuild(pop, hashmap, arg);
+		case HASHMAP_CMD_DEBUG:
+			if (!arg)
+				return -EINVAL;
+			hm_mt_debug(pop, hashmap, (FILE *)arg);
+			return 0;
+		default:
+			return -EINVAL;
+	}
+}
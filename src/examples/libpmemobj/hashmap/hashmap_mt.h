@@ -0,0 +1,66 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef	HASHMAP_MT_H
+#define	HASHMAP_MT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hashmap.h>
+#include <libpmemobj.h>
+
+#ifndef	HASHMAP_MT_TYPE_OFFSET
+#define	HASHMAP_MT_TYPE_OFFSET 1024
+#endif
+
+struct hashmap_mt;
+TOID_DECLARE(struct hashmap_mt, HASHMAP_MT_TYPE_OFFSET + 0);
+
+int hm_mt_check(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap);
+int hm_mt_new(PMEMobjpool *pop, TOID(struct hashmap_mt) *map, void *arg);
+int hm_mt_init(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap);
+int hm_mt_insert(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		uint64_t key, PMEMoid value);
+int hm_mt_insert_batch(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		const uint64_t *keys, const PMEMoid *values, size_t n);
+PMEMoid hm_mt_remove(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		uint64_t key);
+PMEMoid hm_mt_get(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		uint64_t key);
+int hm_mt_lookup(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		uint64_t key);
+int hm_mt_foreach(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+size_t hm_mt_count(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap);
+int hm_mt_cmd(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		unsigned cmd, uint64_t arg);
+
+#endif /* HASHMAP_MT_H */
@@ -45,8 +45,11 @@
 #include "map_ctree.h"
 #include "map_btree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_mt.h"
 
 POBJ_LAYOUT_BEGIN(data_store);
 POBJ_LAYOUT_ROOT(data_store, struct store_root);
@@ -111,10 +114,16 @@ parse_map_type(const char *type)
 		return MAP_BTREE;
 	else if (strcmp(type, "rbtree") == 0)
 		return MAP_RBTREE;
+	else if (strcmp(type, "bptree") == 0)
+		return MAP_BPTREE;
+	else if (strcmp(type, "art") == 0)
+		return MAP_ART;
 	else if (strcmp(type, "hashmap_atomic") == 0)
 		return MAP_HASHMAP_ATOMIC;
 	else if (strcmp(type, "hashmap_tx") == 0)
 		return MAP_HASHMAP_TX;
+	else if (strcmp(type, "hashmap_mt") == 0)
+		return MAP_HASHMAP_MT;
 	return NULL;
 
 }
@@ -122,7 +131,9 @@ parse_map_type(const char *type)
 int main(int argc, const char *argv[]) {
 	if (argc < 3) {
 		printf("usage: %s "
-			"<ctree|btree|rbtree|hashmap_atomic|hashmap_tx>"
+			"<ctree|btree|rbtree|bptree|art|hashmap_atomic|"
+			"hashmap_tx|"
+			"hashmap_mt>"
 			" file-name [nops]\n", argv[0]);
 		return 1;
 	}
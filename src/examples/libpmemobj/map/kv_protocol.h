@@ -47,6 +47,9 @@
  *
  * Server responds with newline terminated string literals.
  * If invalid message token is received RESP_MSG_UNKNOWN is sent.
+ *
+ * Client may send the next messages without waiting for the responses
+ * (pipelining), the responses are sent in the order of the messages.
  */
 
 enum kv_cmsg {
@@ -57,7 +60,8 @@ enum kv_cmsg {
 	 * The key is limited to 255 characters, the size of a value is limited
 	 * by the pmemobj maximum allocation size (~16 gigabytes).
 	 *
-	 * Operation adds a new key value pair to the map.
+	 * Operation adds a new key value pair to the map, the value of
+	 * an existing key is replaced.
 	 * Returns RESP_MSG_SUCCESS if successful or RESP_MSG_FAIL otherwise.
 	 */
 	CMSG_INSERT,
@@ -84,7 +88,8 @@ enum kv_cmsg {
 	 * BYE client message
 	 * Syntax: BYE\n
 	 *
-	 * Operation terminates the client connection.
+	 * Operation terminates the client connection after the responses
+	 * to the preceding messages are sent.
 	 * No return value.
 	 */
 	CMSG_BYE,
@@ -32,14 +32,34 @@
 
 /*
  * kv_server.c -- persistent tcp key-value store server
+ *
+ * The server runs an event loop per thread (shard). Every shard listens on
+ * its own SO_REUSEPORT socket, so the kernel spreads the connections over
+ * the shards. Clients may pipeline requests: in each loop iteration a shard
+ * gathers all complete messages of its connections into a batch, applies
+ * the batch in a single transaction (group commit) and sends the responses
+ * of each connection with a single vectored write, after the commit.
+ *
+ * The keys are spread by their hash over KV_PARTS maps (partitions), each
+ * guarded by its own lock, as the maps aren't thread-safe. A batch locks
+ * the partitions of its requests in ascending order, exclusively the ones
+ * it modifies, so the shards working on different partitions don't wait
+ * for each other.
+ *
+ * The changes of hashmap_atomic aren't rolled back by an aborted
+ * transaction, so its batches aren't group committed -- every write request
+ * is applied on its own.
  */
 
 #include <uv.h>
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #include "libpmemobj.h"
 
@@ -47,18 +67,24 @@
 #include "map_ctree.h"
 #include "map_btree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_mt.h"
 
 #include "kv_protocol.h"
 
 #define	COUNT_OF(x) (sizeof (x) / sizeof (0[x]))
 
-POBJ_LAYOUT_BEGIN(kv_server);
-POBJ_LAYOUT_ROOT(kv_server, struct root);
-POBJ_LAYOUT_TOID(kv_server, struct map_value);
-POBJ_LAYOUT_TOID(kv_server, uint64_t);
-POBJ_LAYOUT_END(kv_server);
+/* the layout is versioned, as the number of maps is a part of it */
+POBJ_LAYOUT_BEGIN(kv_server_v2);
+POBJ_LAYOUT_ROOT(kv_server_v2, struct root);
+POBJ_LAYOUT_TOID(kv_server_v2, struct map_value);
+POBJ_LAYOUT_TOID(kv_server_v2, uint64_t);
+POBJ_LAYOUT_END(kv_server_v2);
+
+#define	KV_PARTS 16 /* number of maps the keys are spread over */
 
 struct map_value {
 	uint64_t len;
@@ -66,29 +92,87 @@ struct map_value {
 };
 
 struct root {
+	TOID(struct map) maps[KV_PARTS];
+};
+
+struct kv_part {
+	pthread_rwlock_t lock;
 	TOID(struct map) map;
 };
 
 static struct map_ctx *mapc;
 static PMEMobjpool *pop;
-static TOID(struct map) map;
+static struct kv_part parts[KV_PARTS];
+static int group_commit; /* the map changes are transactional */
 
-uv_tcp_t server;
-uv_loop_t *loop;
+#define	MAX_BATCH 1024 /* maximum number of requests in a transaction */
 
-typedef int (*msg_handler)(uv_stream_t *client, const char *msg, size_t len);
+#define	MAX_READ_LEN (64 * 1024) /* 64 kilobytes */
 
 struct write_req {
 	uv_write_t req;
-	uv_buf_t buf;
+	size_t size; /* sizeof (data) */
+	size_t len; /* length of the copied values */
+	char data[];
+};
+
+struct response {
+	const char *msg; /* predefined message, NULL for a copied value */
+	size_t off; /* offset of the value in write_req data */
+	size_t len;
 };
 
+struct kv_shard;
+
 struct client_data {
-	char *buf; /* current message, always NULL terminated */
+	uv_tcp_t handle;
+	uv_shutdown_t shutdown;
+	struct kv_shard *shard;
+
+	char *buf; /* received messages, always NULL terminated */
 	size_t buf_len; /* sizeof (buf) */
-	size_t len; /* actual length of the message (while parsing) */
+	size_t len; /* length of the received data */
+	size_t off; /* offset of the first not handled message */
+
+	struct response *resps; /* responses of the current batch */
+	size_t resps_len; /* number of elements of resps */
+	size_t nresps;
+	struct write_req *wr; /* copied values of the current batch */
+	uv_buf_t *bufs; /* vector of the write */
+	size_t bufs_len;
+
+	int closing; /* 1 after BYE or KILL, 2 once the connection is closed */
+	int pending; /* there are not handled messages */
+	struct client_data *next; /* next client with pending messages */
+};
+
+struct request {
+	struct client_data *client;
+	size_t off; /* offset of the message in the client buffer */
+	size_t len;
+	enum kv_cmsg cmsg; /* MAX_CMSG if unknown */
+	unsigned part; /* partition of the key */
+};
+
+struct kv_shard {
+	pthread_t thread;
+	uv_loop_t loop;
+	uv_tcp_t server;
+	uv_check_t check; /* applies the batch after the I/O callbacks */
+	uv_idle_t idle; /* keeps the loop spinning while messages are left */
+	uv_async_t stop;
+	char *read_buf;
+
+	struct client_data *pending; /* clients with not handled messages */
+	struct request reqs[MAX_BATCH];
 };
 
+static struct kv_shard *shards;
+static int nshards;
+
+typedef int (*msg_handler)(struct client_data *client, const char *msg,
+	size_t len);
+
 /*
  * djb2_hash -- string hashing function by Dan Bernstein
  */
@@ -104,6 +188,15 @@ djb2_hash(const char *str)
 	return hash;
 }
 
+/*
+ * part_of -- returns the partition of the key hash
+ */
+static struct kv_part *
+part_of(uint64_t hash)
+{
+	return &parts[hash % KV_PARTS];
+}
+
 /*
  * write_done_cb -- callback after message write completes
  */
@@ -113,8 +206,8 @@ write_done_cb(uv_write_t *req, int status)
 	struct write_req *wr = (struct write_req *)req;
 	free(wr);
 
-	if (status == -1) {
-		printf("response failed");
+	if (status < 0 && status != UV_ECANCELED) {
+		printf("response failed\n");
 	}
 }
 
@@ -126,37 +219,182 @@ client_close_cb(uv_handle_t *handle)
 {
 	struct client_data *d = handle->data;
 	free(d->buf);
-	free(handle->data);
-	free(handle);
+	free(d->resps);
+	free(d->wr);
+	free(d->bufs);
+	free(d);
 }
 
 /*
- * response_write -- response writing helper
+ * client_unlink -- removes the client from the list of pending clients
  */
 static void
-response_write(uv_stream_t *client, char *resp, size_t len)
+client_unlink(struct client_data *client)
 {
-	struct write_req *wr = malloc(sizeof (struct write_req));
+	if (!client->pending)
+		return;
+
+	struct client_data **prev = &client->shard->pending;
+	while (*prev != client)
+		prev = &(*prev)->next;
+
+	*prev = client->next;
+	client->pending = 0;
+}
+
+/*
+ * client_close -- closes the client connection
+ */
+static void
+client_close(struct client_data *client)
+{
+	if (uv_is_closing((uv_handle_t *)&client->handle))
+		return;
+
+	client->closing = 2;
+	client_unlink(client);
+	uv_close((uv_handle_t *)&client->handle, client_close_cb);
+}
+
+/*
+ * shutdown_cb -- closes the connection after all responses are sent
+ */
+static void
+shutdown_cb(uv_shutdown_t *req, int status)
+{
+	client_close(req->data);
+}
+
+/*
+ * write_req_reserve -- makes room for len more bytes of values
+ */
+static struct write_req *
+write_req_reserve(struct client_data *client, size_t len)
+{
+	struct write_req *wr = client->wr;
+	size_t used = wr ? wr->len : 0;
+	size_t size = wr ? wr->size : 0;
+
+	if (used + len <= size)
+		return wr;
+
+	while (size < used + len)
+		size = size ? size * 2 : MAX_READ_LEN;
+
+	wr = realloc(wr, sizeof (*wr) + size);
 	assert(wr != NULL);
 
-	wr->buf = uv_buf_init(resp, len);
-	uv_write(&wr->req, client, &wr->buf, 1, write_done_cb);
+	wr->size = size;
+	wr->len = used;
+	client->wr = wr;
+
+	return wr;
+}
+
+/*
+ * response_add -- appends the response to the ones of the current batch
+ */
+static void
+response_add(struct client_data *client, const char *msg, size_t off,
+	size_t len)
+{
+	if (client->nresps == client->resps_len) {
+		client->resps_len = client->resps_len ?
+			client->resps_len * 2 : MAX_BATCH;
+		client->resps = realloc(client->resps,
+			client->resps_len * sizeof (*client->resps));
+		assert(client->resps != NULL);
+	}
+
+	struct response *r = &client->resps[client->nresps++];
+	r->msg = msg;
+	r->off = off;
+	r->len = len;
+}
+
+/*
+ * response_write -- response writing helper, the response is copied
+ *	because the value may change before it is sent
+ */
+static void
+response_write(struct client_data *client, const char *resp, size_t len)
+{
+	struct write_req *wr = write_req_reserve(client, len);
+
+	memcpy(wr->data + wr->len, resp, len);
+	response_add(client, NULL, wr->len, len);
+	wr->len += len;
 }
 
 /*
  * response_msg -- predefined message writing helper
  */
 static void
-response_msg(uv_stream_t *client, enum resp_messages msg)
+response_msg(struct client_data *client, enum resp_messages msg)
+{
+	response_add(client, resp_msg[msg], 0, strlen(resp_msg[msg]));
+}
+
+/*
+ * response_flush -- sends all responses of the batch with a single write
+ */
+static void
+response_flush(struct client_data *client)
+{
+	if (client->nresps == 0 || client->closing == 2)
+		return;
+
+	struct write_req *wr = write_req_reserve(client, 0);
+	if (wr == NULL) {
+		wr = malloc(sizeof (*wr));
+		assert(wr != NULL);
+		wr->size = 0;
+		wr->len = 0;
+	}
+
+	if (client->bufs_len < client->nresps) {
+		client->bufs_len = client->resps_len;
+		client->bufs = realloc(client->bufs,
+			client->bufs_len * sizeof (*client->bufs));
+		assert(client->bufs != NULL);
+	}
+
+	for (size_t i = 0; i < client->nresps; ++i) {
+		struct response *r = &client->resps[i];
+		client->bufs[i] = uv_buf_init(r->msg ? (char *)r->msg :
+			wr->data + r->off, r->len);
+	}
+
+	/* libuv copies the vector, the values are freed by write_done_cb */
+	int ret = uv_write(&wr->req, (uv_stream_t *)&client->handle,
+		client->bufs, client->nresps, write_done_cb);
+
+	client->wr = NULL;
+	client->nresps = 0;
+
+	if (ret != 0) {
+		free(wr);
+		printf("response failed\n");
+		client_close(client);
+	}
+}
+
+/*
+ * response_discard -- drops the responses of the aborted batch
+ */
+static void
+response_discard(struct client_data *client)
 {
-	response_write(client, (char *)resp_msg[msg], strlen(resp_msg[msg]));
+	client->nresps = 0;
+	if (client->wr)
+		client->wr->len = 0;
 }
 
 /*
  * cmsg_insert_handler -- handler of INSERT client message
  */
 static int
-cmsg_insert_handler(uv_stream_t *client, const char *msg, size_t len)
+cmsg_insert_handler(struct client_data *client, const char *msg, size_t len)
 {
 	int result = 0;
 	TX_BEGIN(pop) {
@@ -171,12 +409,18 @@ cmsg_insert_handler(uv_stream_t *client, const char *msg, size_t len)
 		int ret = sscanf(msg, "INSERT %254s %s\n", key, D_RW(val)->buf);
 		assert(ret == 2);
 
-		D_RW(val)->len = len;
-
 		/* properly terminate the value */
-		D_RW(val)->buf[strlen(D_RO(val)->buf)] = '\n';
+		size_t vlen = strlen(D_RO(val)->buf);
+		D_RW(val)->buf[vlen] = '\n';
+		D_RW(val)->len = vlen + 1;
 
-		map_insert(mapc, map, djb2_hash(key), val.oid);
+		/* the new value replaces the previous one */
+		uint64_t hash = djb2_hash(key);
+		TOID(struct map) map = part_of(hash)->map;
+		if (map_lookup(mapc, map, hash))
+			map_remove_free(mapc, map, hash);
+
+		map_insert(mapc, map, hash, val.oid);
 	} TX_ONABORT {
 		result = 1;
 	} TX_END
@@ -190,13 +434,14 @@ cmsg_insert_handler(uv_stream_t *client, const char *msg, size_t len)
  * cmsg_remove_handler -- handler of REMOVE client message
  */
 static int
-cmsg_remove_handler(uv_stream_t *client, const char *msg, size_t len)
+cmsg_remove_handler(struct client_data *client, const char *msg, size_t len)
 {
 	char key[MAX_KEY_LEN] = {0};
 	int ret = sscanf(msg, "REMOVE %s\n", key);
 	assert(ret == 1);
 
-	int result = map_remove_free(mapc, map, djb2_hash(key));
+	uint64_t hash = djb2_hash(key);
+	int result = map_remove_free(mapc, part_of(hash)->map, hash);
 
 	response_msg(client, result);
 
@@ -207,19 +452,20 @@ cmsg_remove_handler(uv_stream_t *client, const char *msg, size_t len)
  * cmsg_get_handler -- handler of GET client message
  */
 static int
-cmsg_get_handler(uv_stream_t *client, const char *msg, size_t len)
+cmsg_get_handler(struct client_data *client, const char *msg, size_t len)
 {
 	char key[MAX_KEY_LEN];
 	int ret = sscanf(msg, "GET %s\n", key);
 	assert(ret == 1);
 
+	uint64_t hash = djb2_hash(key);
 	TOID(struct map_value) value;
-	TOID_ASSIGN(value, map_get(mapc, map, djb2_hash(key)));
+	TOID_ASSIGN(value, map_get(mapc, part_of(hash)->map, hash));
 
 	if (TOID_IS_NULL(value)) {
 		response_msg(client, RESP_MSG_NULL);
 	} else {
-		response_write(client, D_RW(value)->buf, D_RO(value)->len);
+		response_write(client, D_RO(value)->buf, D_RO(value)->len);
 	}
 
 	return 0;
@@ -227,138 +473,335 @@ cmsg_get_handler(uv_stream_t *client, const char *msg, size_t len)
 
 /*
  * cmsg_bye_handler -- handler of BYE client message
+ *
+ * The connection is shut down once the responses of the batch are sent.
  */
 static int
-cmsg_bye_handler(uv_stream_t *client, const char *msg, size_t len)
+cmsg_bye_handler(struct client_data *client, const char *msg, size_t len)
 {
-	uv_close((uv_handle_t *)client, client_close_cb);
+	return 0;
+}
 
+/*
+ * cmsg_kill_handler -- handler of KILL client message
+ *
+ * All shards are stopped once the responses of the batch are sent.
+ */
+static int
+cmsg_kill_handler(struct client_data *client, const char *msg, size_t len)
+{
 	return 0;
 }
 
 /*
- * cmsg_bye_handler -- handler of KILL client message
+ * cmsg_unknown_handler -- handler of unknown client message
  */
 static int
-cmsg_kill_handler(uv_stream_t *client, const char *msg, size_t len)
+cmsg_unknown_handler(struct client_data *client, const char *msg, size_t len)
 {
-	uv_close((uv_handle_t *)client, client_close_cb);
-	uv_close((uv_handle_t *)&server, NULL);
+	response_msg(client, RESP_MSG_UNKNOWN);
 
 	return 0;
 }
 
 /* kv protocol implementation */
-msg_handler protocol_impl[MAX_CMSG] = {
+msg_handler protocol_impl[MAX_CMSG + 1] = {
 	cmsg_insert_handler,
 	cmsg_remove_handler,
 	cmsg_get_handler,
 	cmsg_bye_handler,
-	cmsg_kill_handler
+	cmsg_kill_handler,
+	cmsg_unknown_handler
 };
 
 /*
- * cmsg_handle -- handles current client message
+ * cmsg_parse -- returns the type of the client message
  */
-static int
-cmsg_handle(uv_stream_t *client, struct client_data *data)
+static enum kv_cmsg
+cmsg_parse(const char *msg)
 {
-	int ret = 0;
 	int i;
 	for (i = 0; i < MAX_CMSG; ++i)
-		if (strncmp(kv_cmsg_token[i], data->buf,
+		if (strncmp(kv_cmsg_token[i], msg,
 			strlen(kv_cmsg_token[i])) == 0)
 			break;
 
-	if (i == MAX_CMSG) {
-		response_msg(client, RESP_MSG_UNKNOWN);
-	} else {
-		ret = protocol_impl[i](client, data->buf, data->len);
-	}
-
-	data->len = 0; /* reset the message length */
-
-	return ret;
+	return i;
 }
 
 /*
- * cmsg_handle_stream -- handle incoming tcp stream from clients
+ * cmsg_gather -- adds the complete messages of the client to the batch,
+ *	returns the number of added requests
  */
-static int
-cmsg_handle_stream(uv_stream_t *client, struct client_data *data,
-	const char *buf, ssize_t nread)
+static size_t
+cmsg_gather(struct client_data *client, struct request *reqs, size_t max,
+	unsigned *reads, unsigned *writes, int *kill)
 {
+	char key[MAX_KEY_LEN];
+	size_t n = 0;
 	char *last;
-	int ret;
-	size_t len;
 
 	/*
 	 * A single read operation can contain zero or more operations, so this
 	 * has to be handled appropriately. Client messages are terminated by
 	 * newline character.
 	 */
-	while ((last = memchr(buf, '\n', nread)) != NULL) {
-		len = last - buf + 1;
-		nread -= len;
-		assert(data->len + len <= data->buf_len);
-		memcpy(data->buf + data->len, buf, len);
-		data->len += len;
+	while (n < max && !client->closing &&
+		(last = memchr(client->buf + client->off, '\n',
+			client->len - client->off)) != NULL) {
+		struct request *r = &reqs[n++];
+		r->client = client;
+		r->off = client->off;
+		r->len = last - (client->buf + client->off) + 1;
+		r->cmsg = cmsg_parse(client->buf + client->off);
+
+		*last = '\0';
+		client->off += r->len;
+
+		r->part = 0;
+		if ((r->cmsg == CMSG_INSERT || r->cmsg == CMSG_REMOVE ||
+				r->cmsg == CMSG_GET) &&
+				sscanf(client->buf + r->off, "%*s %254s",
+					key) == 1)
+			r->part = (unsigned)(part_of(djb2_hash(key)) - parts);
+
+		switch (r->cmsg) {
+		case CMSG_INSERT:
+		case CMSG_REMOVE:
+			*writes |= 1U << r->part;
+			break;
+		case CMSG_GET:
+			*reads |= 1U << r->part;
+			break;
+		case CMSG_KILL:
+			*kill = 1;
+			/* fallthrough */
+		case CMSG_BYE:
+			client->closing = 1;
+			break;
+		default:
+			break;
+		}
+	}
 
-		if ((ret = cmsg_handle(client, data)) != 0)
-			return ret;
+	return n;
+}
 
-		buf = last + 1;
+/*
+ * batch_apply -- (internal) handles the requests of the batch, in order
+ */
+static void
+batch_apply(struct request *reqs, size_t nreqs)
+{
+	for (size_t i = 0; i < nreqs; ++i) {
+		struct request *r = &reqs[i];
+		protocol_impl[r->cmsg](r->client, r->client->buf + r->off,
+			r->len);
 	}
+}
 
-	if (nread != 0) {
-		memcpy(data->buf + data->len, buf, nread);
-		data->len += nread;
+/*
+ * batch_commit -- applies the batch with writes in a single transaction
+ *
+ * If the transaction aborts, its responses are dropped and the requests
+ * are applied again one by one, so only the failing ones get FAIL. That's
+ * correct only if the map changes of the aborted transaction are rolled
+ * back, so the non-transactional maps always apply them one by one.
+ */
+static void
+batch_commit(struct request *reqs, size_t nreqs)
+{
+	if (!group_commit) {
+		batch_apply(reqs, nreqs);
+		return;
 	}
 
-	return 0;
+	volatile int aborted = 0;
+
+	TX_BEGIN(pop) {
+		batch_apply(reqs, nreqs);
+	} TX_ONABORT {
+		aborted = 1;
+	} TX_END
+
+	if (!aborted)
+		return;
+
+	for (size_t i = 0; i < nreqs; ++i)
+		response_discard(reqs[i].client);
+
+	batch_apply(reqs, nreqs);
+}
+
+/*
+ * parts_lock -- locks the partitions of the batch in ascending order,
+ *	exclusively the modified ones
+ */
+static void
+parts_lock(unsigned reads, unsigned writes)
+{
+	for (unsigned i = 0; i < KV_PARTS; ++i) {
+		if (writes & (1U << i))
+			pthread_rwlock_wrlock(&parts[i].lock);
+		else if (reads & (1U << i))
+			pthread_rwlock_rdlock(&parts[i].lock);
+	}
+}
+
+/*
+ * parts_unlock -- unlocks the partitions of the batch
+ */
+static void
+parts_unlock(unsigned reads, unsigned writes)
+{
+	for (unsigned i = 0; i < KV_PARTS; ++i) {
+		if ((reads | writes) & (1U << i))
+			pthread_rwlock_unlock(&parts[i].lock);
+	}
+}
+
+/*
+ * shard_stop -- stops all the shards
+ */
+static void
+shard_stop(void)
+{
+	for (int i = 0; i < nshards; ++i)
+		uv_async_send(&shards[i].stop);
 }
 
-static uv_buf_t msg_buf = {0};
+/*
+ * idle_cb -- does nothing, the pending messages are handled by check_cb
+ */
+static void
+idle_cb(uv_idle_t *handle)
+{
+}
+
+/*
+ * check_cb -- gathers the pending messages of the shard clients and
+ *	applies them as a single batch
+ */
+static void
+check_cb(uv_check_t *handle)
+{
+	struct kv_shard *shard = handle->data;
+	size_t nreqs = 0;
+	unsigned reads = 0;
+	unsigned writes = 0;
+	int kill = 0;
+
+	struct client_data **prev = &shard->pending;
+	while (*prev != NULL && nreqs < MAX_BATCH) {
+		struct client_data *client = *prev;
+		nreqs += cmsg_gather(client, &shard->reqs[nreqs],
+			MAX_BATCH - nreqs, &reads, &writes, &kill);
+
+		if (client->closing || memchr(client->buf + client->off,
+				'\n', client->len - client->off) == NULL) {
+			*prev = client->next;
+			client->pending = 0;
+		} else {
+			prev = &client->next;
+		}
+	}
+
+	if (nreqs != 0) {
+		parts_lock(reads, writes);
+		if (writes)
+			batch_commit(shard->reqs, nreqs);
+		else
+			batch_apply(shard->reqs, nreqs);
+		parts_unlock(reads, writes);
+	}
+
+	/* the requests of a client are adjacent in the batch */
+	for (size_t i = 0; i < nreqs; ++i) {
+		struct client_data *client = shard->reqs[i].client;
+		if (i + 1 < nreqs && shard->reqs[i + 1].client == client)
+			continue;
+
+		response_flush(client);
+
+		/* drop the handled messages */
+		memmove(client->buf, client->buf + client->off,
+			client->len - client->off + 1);
+		client->len -= client->off;
+		client->off = 0;
+
+		if (client->closing == 1) {
+			client->closing = 2;
+			uv_read_stop((uv_stream_t *)&client->handle);
+			client->shutdown.data = client;
+			if (uv_shutdown(&client->shutdown,
+				(uv_stream_t *)&client->handle,
+				shutdown_cb) != 0)
+				client_close(client);
+		}
+	}
+
+	if (shard->pending != NULL)
+		uv_idle_start(&shard->idle, idle_cb);
+	else
+		uv_idle_stop(&shard->idle);
+
+	if (kill)
+		shard_stop();
+}
 
 /*
  * get_read_buf_cb -- returns buffer for incoming client message
  */
-void
+static void
 get_read_buf_cb(uv_handle_t *handle, size_t size, uv_buf_t *buf)
 {
-	buf->base = msg_buf.base;
-	buf->len = msg_buf.len;
+	struct client_data *d = handle->data;
+
+	/* use only a single buffer per shard for all incoming data */
+	*buf = uv_buf_init(d->shard->read_buf, MAX_READ_LEN);
 }
 
 /*
  * read_cb -- async tcp read from clients
+ *
+ * The data is only appended to the client buffer, the messages are handled
+ * in batches by check_cb.
  */
 static void
 read_cb(uv_stream_t *client, ssize_t nread, const uv_buf_t *buf)
 {
-	if (nread <= 0) {
+	struct client_data *d = client->data;
+
+	if (nread == 0) /* EAGAIN */
+		return;
+
+	if (nread < 0) {
 		printf("client connection closed\n");
-		uv_close((uv_handle_t *)client, client_close_cb);
+		client_close(d);
 
 		return;
 	}
 
-	struct client_data *d = client->data;
-
 	if (d->buf_len < (d->len + nread + 1)) {
-		char *cbuf = realloc(d->buf, d->buf_len + nread + 1);
-		assert(cbuf != NULL);
+		size_t buf_len = d->buf_len ? d->buf_len : MAX_READ_LEN;
+		while (buf_len < d->len + nread + 1)
+			buf_len *= 2;
 
-		/* zero only the new memory */
-		memset(cbuf + d->buf_len, 0, nread + 1);
+		char *cbuf = realloc(d->buf, buf_len);
+		assert(cbuf != NULL);
 
-		d->buf_len += nread + 1;
+		d->buf_len = buf_len;
 		d->buf = cbuf;
 	}
 
-	if (cmsg_handle_stream(client, client->data, buf->base, nread)) {
-		printf("client disconnect\n");
-		uv_close((uv_handle_t *)client, client_close_cb);
+	memcpy(d->buf + d->len, buf->base, nread);
+	d->len += nread;
+	d->buf[d->len] = '\0';
+
+	if (!d->pending && memchr(buf->base, '\n', nread) != NULL) {
+		d->pending = 1;
+		d->next = d->shard->pending;
+		d->shard->pending = d;
 	}
 }
 
@@ -374,54 +817,160 @@ connection_cb(uv_stream_t *server, int status)
 	}
 	printf("new client\n");
 
-	uv_tcp_t *client = malloc(sizeof (uv_tcp_t));
-	assert(client != NULL);
-	client->data = calloc(1, sizeof (struct client_data));
-	assert(client->data != NULL);
+	struct kv_shard *shard = server->data;
 
-	uv_tcp_init(loop, client);
+	struct client_data *d = calloc(1, sizeof (struct client_data));
+	assert(d != NULL);
+	d->shard = shard;
+	d->handle.data = d;
 
-	if (uv_accept(server, (uv_stream_t *)client) == 0) {
-		uv_read_start((uv_stream_t *)client, get_read_buf_cb, read_cb);
+	uv_tcp_init(&shard->loop, &d->handle);
+	uv_tcp_nodelay(&d->handle, 1);
+
+	if (uv_accept(server, (uv_stream_t *)&d->handle) == 0) {
+		uv_read_start((uv_stream_t *)&d->handle, get_read_buf_cb,
+			read_cb);
 	} else {
-		uv_close((uv_handle_t *)client, client_close_cb);
+		client_close(d);
 	}
 }
 
+/*
+ * handle_close_cb -- (internal) closes the handle of the stopped shard
+ */
+static void
+handle_close_cb(uv_handle_t *handle, void *arg)
+{
+	if (uv_is_closing(handle))
+		return;
+
+	if (handle->type == UV_TCP && handle->data != arg)
+		client_close(handle->data);
+	else
+		uv_close(handle, NULL);
+}
+
+/*
+ * stop_cb -- closes all handles of the shard, which ends its loop
+ */
+static void
+stop_cb(uv_async_t *handle)
+{
+	struct kv_shard *shard = handle->data;
+
+	uv_walk(&shard->loop, handle_close_cb, shard);
+}
+
+/*
+ * shard_init -- initializes the loop and the listening socket of the shard
+ */
+static int
+shard_init(struct kv_shard *shard, int port)
+{
+	shard->read_buf = malloc(MAX_READ_LEN);
+	if (shard->read_buf == NULL)
+		return -1;
+
+	uv_loop_init(&shard->loop);
+
+	/*
+	 * Each shard listens on its own socket bound to the same port and
+	 * the kernel distributes the incoming connections between them.
+	 */
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	int one = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one)) ||
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof (one))) {
+		close(fd);
+		return -1;
+	}
+
+	struct sockaddr_in bind_addr;
+	uv_ip4_addr("0.0.0.0", port, &bind_addr);
+	if (bind(fd, (const struct sockaddr *)&bind_addr,
+			sizeof (bind_addr))) {
+		close(fd);
+		return -1;
+	}
+
+	/* tcp server initialization */
+	uv_tcp_init(&shard->loop, &shard->server);
+	shard->server.data = shard;
+	if (uv_tcp_open(&shard->server, fd) ||
+		uv_listen((uv_stream_t *)&shard->server, SOMAXCONN,
+			connection_cb))
+		return -1;
+
+	uv_check_init(&shard->loop, &shard->check);
+	shard->check.data = shard;
+	uv_check_start(&shard->check, check_cb);
+
+	uv_idle_init(&shard->loop, &shard->idle);
+	shard->idle.data = shard;
+
+	uv_async_init(&shard->loop, &shard->stop, stop_cb);
+	shard->stop.data = shard;
+
+	return 0;
+}
+
+/*
+ * shard_run -- runs the shard event loop
+ */
+static void *
+shard_run(void *arg)
+{
+	struct kv_shard *shard = arg;
+
+	int ret = uv_run(&shard->loop, UV_RUN_DEFAULT);
+	assert(ret == 0);
+
+	return NULL;
+}
+
 static const struct {
 	struct map_ops *ops;
 	const char *name;
+	int tx; /* the map changes are rolled back by an aborted transaction */
 } maps[] = {
-	{MAP_HASHMAP_TX, "hashmap_tx"},
-	{MAP_HASHMAP_ATOMIC, "hashmap_atomic"},
-	{MAP_CTREE, "ctree"},
-	{MAP_BTREE, "btree"},
-	{MAP_RBTREE, "rbtree"}
+	{MAP_HASHMAP_TX, "hashmap_tx", 1},
+	{MAP_HASHMAP_ATOMIC, "hashmap_atomic", 0},
+	{MAP_HASHMAP_MT, "hashmap_mt", 1},
+	{MAP_CTREE, "ctree", 1},
+	{MAP_BTREE, "btree", 1},
+	{MAP_RBTREE, "rbtree", 1},
+	{MAP_BPTREE, "bptree", 1},
+	{MAP_ART, "art", 1}
 };
 
 /*
- * get_map_ops_by_string -- parse the type string and return the associated ops
+ * get_map_ops_by_string -- parse the type string and return the associated
+ *	ops, sets group_commit if the map is transactional
  */
 static const struct map_ops *
 get_map_ops_by_string(const char *type)
 {
 	for (int i = 0; i < COUNT_OF(maps); ++i)
-		if (strcmp(maps[i].name, type) == 0)
+		if (strcmp(maps[i].name, type) == 0) {
+			group_commit = maps[i].tx;
 			return maps[i].ops;
+		}
 
 	return NULL;
 }
 
 #define	KV_SIZE	(PMEMOBJ_MIN_POOL)
 
-#define	MAX_READ_LEN (64 * 1024) /* 64 kilobytes */
-
 int
 main(int argc, char *argv[])
 {
 	if (argc < 4) {
-		printf("usage: %s hashmap_tx|hashmap_atomic|ctree|btree|rbtree"
-				" file-name port\n", argv[0]);
+		printf("usage: %s hashmap_tx|hashmap_atomic|hashmap_mt|"
+				"ctree|btree|rbtree|bptree|art "
+				"file-name port [threads]\n", argv[0]);
 		return 1;
 	}
 
@@ -429,14 +978,12 @@ main(int argc, char *argv[])
 	const char *type = argv[1];
 	int port = atoi(argv[3]);
 
-	/* use only a single buffer for all incoming data */
-	void *read_buf = malloc(MAX_READ_LEN);
-	assert(read_buf != NULL);
-
-	msg_buf = uv_buf_init(read_buf, MAX_READ_LEN);
+	nshards = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nshards < 1)
+		nshards = 1;
 
 	if (access(path, F_OK) != 0) {
-		pop = pmemobj_create(path, POBJ_LAYOUT_NAME(kv_server),
+		pop = pmemobj_create(path, POBJ_LAYOUT_NAME(kv_server_v2),
 				KV_SIZE, 0666);
 		if (pop == NULL) {
 			fprintf(stderr, "failed to create pool: %s\n",
@@ -444,7 +991,7 @@ main(int argc, char *argv[])
 			return 1;
 		}
 	} else {
-		pop = pmemobj_open(path, POBJ_LAYOUT_NAME(kv_server));
+		pop = pmemobj_open(path, POBJ_LAYOUT_NAME(kv_server_v2));
 		if (pop == NULL) {
 			fprintf(stderr, "failed to open pool: %s\n",
 					pmemobj_errormsg());
@@ -460,36 +1007,48 @@ main(int argc, char *argv[])
 		return 1;
 	}
 
-	/* initialize the actual map */
+	/* initialize the actual maps */
 	TOID(struct root) root = POBJ_ROOT(pop, struct root);
-	if (TOID_IS_NULL(D_RO(root)->map)) {
-		/* create new if it doesn't exist (a fresh pool) */
-		map_new(mapc, &D_RW(root)->map, NULL);
+	for (int i = 0; i < KV_PARTS; ++i) {
+		if (TOID_IS_NULL(D_RO(root)->maps[i])) {
+			/* create new if it doesn't exist (a fresh pool) */
+			map_new(mapc, &D_RW(root)->maps[i], NULL);
+		}
+		parts[i].map = D_RO(root)->maps[i];
+		pthread_rwlock_init(&parts[i].lock, NULL);
 	}
-	map = D_RO(root)->map;
 
-	loop = uv_default_loop();
+	shards = calloc(nshards, sizeof (struct kv_shard));
+	assert(shards != NULL);
 
-	/* tcp server initialization */
-	uv_tcp_init(loop, &server);
+	for (int i = 0; i < nshards; ++i) {
+		if (shard_init(&shards[i], port)) {
+			perror("server initialization failed");
+			return 1;
+		}
+	}
 
-	struct sockaddr_in bind_addr;
-	uv_ip4_addr("0.0.0.0", port, &bind_addr);
-	int ret = uv_tcp_bind(&server, (const struct sockaddr *)&bind_addr, 0);
-	assert(ret == 0);
+	/* the first shard runs in the main thread */
+	for (int i = 1; i < nshards; ++i) {
+		int ret = pthread_create(&shards[i].thread, NULL, shard_run,
+			&shards[i]);
+		assert(ret == 0);
+	}
 
-	ret = uv_listen((uv_stream_t *)&server, SOMAXCONN, connection_cb);
-	assert(ret == 0);
+	shard_run(&shards[0]);
 
-	ret = uv_run(loop, UV_RUN_DEFAULT);
-	assert(ret == 0);
+	for (int i = 1; i < nshards; ++i)
+		pthread_join(shards[i].thread, NULL);
+
+	/* no more events in the loops, release resources and quit */
+	for (int i = 0; i < nshards; ++i) {
+		uv_loop_close(&shards[i].loop);
+		free(shards[i].read_buf);
+	}
+	free(shards);
 
-	/* no more events in the loop, release resources and quit */
-	uv_loop_delete(loop);
 	map_ctx_free(mapc);
 	pmemobj_close(pop);
 
-	free(read_buf);
-
 	return 0;
 }
@@ -35,6 +35,8 @@
  */
 
 #include <err.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <libpmemobj.h>
@@ -153,12 +155,27 @@ map_remove(struct map_ctx *mapc, TOID(struct map) map, uint64_t key)
 
 /*
  * map_remove_free -- remove and free key value pair
+ *
+ * For the maps without a native remove_free the pair is removed and its
+ * value freed in a single transaction.
  */
 int
 map_remove_free(struct map_ctx *mapc, TOID(struct map) map, uint64_t key)
 {
-	ABORT_NOT_IMPLEMENTED(mapc, remove_free);
-	return mapc->ops->remove_free(mapc->pop, map, key);
+	if (mapc->ops->remove_free)
+		return mapc->ops->remove_free(mapc->pop, map, key);
+
+	ABORT_NOT_IMPLEMENTED(mapc, remove);
+	int ret = 0;
+	TX_BEGIN(mapc->pop) {
+		PMEMoid val = mapc->ops->remove(mapc->pop, map, key);
+		if (!OID_IS_NULL(val))
+			pmemobj_tx_free(val);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
 }
 
 /*
@@ -203,6 +220,159 @@ map_foreach(struct map_ctx *mapc, TOID(struct map) map,
 	return mapc->ops->foreach(mapc->pop, map, cb, arg);
 }
 
+struct range_filter_arg {
+	uint64_t lo;
+	uint64_t hi;
+	int (*cb)(uint64_t key, PMEMoid value, void *arg);
+	void *arg;
+};
+
+/*
+ * range_filter_cb -- (internal) passes only the keys from [lo, hi]
+ */
+static int
+range_filter_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	struct range_filter_arg *f = arg;
+	if (key < f->lo || key > f->hi)
+		return 0;
+
+	return f->cb(key, value, f->arg);
+}
+
+/*
+ * map_range -- iterate through key value pairs with keys from [lo, hi]
+ *
+ * The ordered maps visit the keys in ascending order and skip the parts
+ * of the structure outside of the range. For the others all pairs are
+ * filtered in the foreach order.
+ */
+int
+map_range(struct map_ctx *mapc, TOID(struct map) map,
+		uint64_t lo, uint64_t hi,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	if (mapc->ops->range)
+		return mapc->ops->range(mapc->pop, map, lo, hi, cb, arg);
+
+	ABORT_NOT_IMPLEMENTED(mapc, foreach);
+	struct range_filter_arg f = {lo, hi, cb, arg};
+	return mapc->ops->foreach(mapc->pop, map, range_filter_cb, &f);
+}
+
+struct lower_bound_arg {
+	uint64_t min;
+	uint64_t key;
+	PMEMoid value;
+	int found;
+};
+
+/*
+ * lower_bound_first_cb -- (internal) stops at the first visited key
+ */
+static int
+lower_bound_first_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	struct lower_bound_arg *lb = arg;
+	lb->key = key;
+	lb->value = value;
+	lb->found = 1;
+
+	return 1;
+}
+
+/*
+ * lower_bound_min_cb -- (internal) tracks the smallest key not below min
+ */
+static int
+lower_bound_min_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	struct lower_bound_arg *lb = arg;
+	if (key >= lb->min && (!lb->found || key < lb->key)) {
+		lb->key = key;
+		lb->value = value;
+		lb->found = 1;
+	}
+
+	return 0;
+}
+
+/*
+ * map_lower_bound -- find the smallest key not less than *key
+ *
+ * Returns 1 and updates *key and *value (if not NULL) when such a key
+ * exists, 0 otherwise. Calling it again with *key + 1 walks the map in
+ * key order.
+ */
+int
+map_lower_bound(struct map_ctx *mapc, TOID(struct map) map,
+		uint64_t *key, PMEMoid *value)
+{
+	struct lower_bound_arg lb = {.min = *key, .found = 0};
+
+	if (mapc->ops->range) {
+		mapc->ops->range(mapc->pop, map, *key, UINT64_MAX,
+				lower_bound_first_cb, &lb);
+	} else {
+		ABORT_NOT_IMPLEMENTED(mapc, foreach);
+		mapc->ops->foreach(mapc->pop, map, lower_bound_min_cb, &lb);
+	}
+
+	if (!lb.found)
+		return 0;
+
+	*key = lb.key;
+	if (value)
+		*value = lb.value;
+
+	return 1;
+}
+
+/*
+ * map_insert_batch -- insert n key value pairs in a single transaction
+ */
+int
+map_insert_batch(struct map_ctx *mapc, TOID(struct map) map,
+		const uint64_t *keys, const PMEMoid *values, size_t n)
+{
+	if (mapc->ops->insert_batch)
+		return mapc->ops->insert_batch(mapc->pop, map,
+				keys, values, n);
+
+	ABORT_NOT_IMPLEMENTED(mapc, insert);
+	int ret = 0;
+	TX_BEGIN(mapc->pop) {
+		for (size_t i = 0; i < n; i++) {
+			if (mapc->ops->insert(mapc->pop, map,
+					keys[i], values[i]) &&
+				pmemobj_tx_stage() == TX_STAGE_WORK)
+				pmemobj_tx_abort(EINVAL);
+		}
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * map_get_batch -- get values of n keys, OID_NULL for the missing ones
+ */
+int
+map_get_batch(struct map_ctx *mapc, TOID(struct map) map,
+		const uint64_t *keys, PMEMoid *values, size_t n)
+{
+	if (mapc->ops->get_batch)
+		return mapc->ops->get_batch(mapc->pop, map, keys, values, n);
+
+	ABORT_NOT_IMPLEMENTED(mapc, get);
+	for (size_t i = 0; i < n; i++)
+		values[i] = mapc->ops->get(mapc->pop, map, keys[i]);
+
+	return 0;
+}
+
 /*
  * map_is_empty -- check if map is empty
  */
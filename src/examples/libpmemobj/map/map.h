@@ -72,6 +72,14 @@ struct map_ops {
 	int (*foreach)(PMEMobjpool *pop, TOID(struct map) map,
 			int (*cb)(uint64_t key, PMEMoid value, void *arg),
 			void *arg);
+	int (*range)(PMEMobjpool *pop, TOID(struct map) map,
+			uint64_t lo, uint64_t hi,
+			int (*cb)(uint64_t key, PMEMoid value, void *arg),
+			void *arg);
+	int (*insert_batch)(PMEMobjpool *pop, TOID(struct map) map,
+			const uint64_t *keys, const PMEMoid *values, size_t n);
+	int (*get_batch)(PMEMobjpool *pop, TOID(struct map) map,
+			const uint64_t *keys, PMEMoid *values, size_t n);
 	int (*is_empty)(PMEMobjpool *pop, TOID(struct map) map);
 	size_t (*count)(PMEMobjpool *pop, TOID(struct map) map);
 	int (*cmd)(PMEMobjpool *pop, TOID(struct map) map,
@@ -104,6 +112,16 @@ int map_lookup(struct map_ctx *mapc, TOID(struct map) map, uint64_t key);
 int map_foreach(struct map_ctx *mapc, TOID(struct map) map,
 		int (*cb)(uint64_t key, PMEMoid value, void *arg),
 		void *arg);
+int map_range(struct map_ctx *mapc, TOID(struct map) map,
+		uint64_t lo, uint64_t hi,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg);
+int map_lower_bound(struct map_ctx *mapc, TOID(struct map) map,
+		uint64_t *key, PMEMoid *value);
+int map_insert_batch(struct map_ctx *mapc, TOID(struct map) map,
+		const uint64_t *keys, const PMEMoid *values, size_t n);
+int map_get_batch(struct map_ctx *mapc, TOID(struct map) map,
+		const uint64_t *keys, PMEMoid *values, size_t n);
 int map_is_empty(struct map_ctx *mapc, TOID(struct map) map);
 size_t map_count(struct map_ctx *mapc, TOID(struct map) map);
 int map_cmd(struct map_ctx *mapc, TOID(struct map) map,
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map_art.c -- common interface for maps
+ */
+
+#include <map.h>
+#include <art_map.h>
+
+/*
+ * map_art_check -- wrapper for art_map_check
+ */
+static int
+map_art_check(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_check(pop, art_map);
+}
+
+/*
+ * map_art_new -- wrapper for art_map_new
+ */
+static int
+map_art_new(PMEMobjpool *pop, TOID(struct map) *map, void *arg)
+{
+	TOID(struct art_map) *art_map =
+		(TOID(struct art_map) *)map;
+
+	return art_map_new(pop, art_map, arg);
+}
+
+/*
+ * map_art_delete -- wrapper for art_map_delete
+ */
+static int
+map_art_delete(PMEMobjpool *pop, TOID(struct map) *map)
+{
+	TOID(struct art_map) *art_map =
+		(TOID(struct art_map) *)map;
+
+	return art_map_delete(pop, art_map);
+}
+
+/*
+ * map_art_insert -- wrapper for art_map_insert
+ */
+static int
+map_art_insert(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t key, PMEMoid value)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_insert(pop, art_map, key, value);
+}
+
+/*
+ * map_art_insert_new -- wrapper for art_map_insert_new
+ */
+static int
+map_art_insert_new(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t key, size_t size,
+		unsigned int type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_insert_new(pop, art_map, key, size,
+			type_num, constructor, arg);
+}
+
+/*
+ * map_art_remove -- wrapper for art_map_remove
+ */
+static PMEMoid
+map_art_remove(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_remove(pop, art_map, key);
+}
+
+/*
+ * map_art_remove_free -- wrapper for art_map_remove_free
+ */
+static int
+map_art_remove_free(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_remove_free(pop, art_map, key);
+}
+
+/*
+ * map_art_clear -- wrapper for art_map_clear
+ */
+static int
+map_art_clear(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_clear(pop, art_map);
+}
+
+/*
+ * map_art_get -- wrapper for art_map_get
+ */
+static PMEMoid
+map_art_get(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_get(pop, art_map, key);
+}
+
+/*
+ * map_art_lookup -- wrapper for art_map_lookup
+ */
+static int
+map_art_lookup(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_lookup(pop, art_map, key);
+}
+
+/*
+ * map_art_foreach -- wrapper for art_map_foreach
+ */
+static int
+map_art_foreach(PMEMobjpool *pop, TOID(struct map) map,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_foreach(pop, art_map, cb, arg);
+}
+
+/*
+ * map_art_range -- wrapper for art_map_range
+ */
+static int
+map_art_range(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t lo, uint64_t hi,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_range(pop, art_map, lo, hi, cb, arg);
+}
+
+/*
+ * map_art_is_empty -- wrapper for art_map_is_empty
+ */
+static int
+map_art_is_empty(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct art_map) art_map;
+	TOID_ASSIGN(art_map, map.oid);
+
+	return art_map_is_empty(pop, art_map);
+}
+
+struct map_ops art_map_ops = {
+	.check		= map_art_check,
+	.new		= map_art_new,
+	.delete		= map_art_delete,
+	.init		= NULL,
+	.insert		= map_art_insert,
+	.insert_new	= map_art_insert_new,
+	.remove		= map_art_remove,
+	.remove_free	= map_art_remove_free,
+	.clear		= map_art_clear,
+	.get		= map_art_get,
+	.lookup		= map_art_lookup,
+	.is_empty	= map_art_is_empty,
+	.foreach	= map_art_foreach,
+	.range		= map_art_range,
+	.count		= NULL,
+	.cmd		= NULL,
+};
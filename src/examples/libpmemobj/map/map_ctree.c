@@ -177,6 +177,21 @@ map_ctree_foreach(PMEMobjpool *pop, TOID(struct map) map,
 	return ctree_map_foreach(pop, ctree_map, cb, arg);
 }
 
+/*
+ * map_ctree_range -- wrapper for ctree_map_range
+ */
+static int
+map_ctree_range(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t lo, uint64_t hi,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct ctree_map) ctree_map;
+	TOID_ASSIGN(ctree_map, map.oid);
+
+	return ctree_map_range(pop, ctree_map, lo, hi, cb, arg);
+}
+
 /*
  * map_ctree_is_empty -- wrapper for ctree_map_is_empty
  */
@@ -203,6 +218,7 @@ struct map_ops ctree_map_ops = {
 	.lookup		= map_ctree_lookup,
 	.is_empty	= map_ctree_is_empty,
 	.foreach	= map_ctree_foreach,
+	.range		= map_ctree_range,
 	.count		= NULL,
 	.cmd		= NULL,
 };
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map_hashmap_cpp.c -- common interface for maps
+ */
+
+#include <map.h>
+#include <hashmap_cpp.h>
+
+/*
+ * map_hm_cpp_check -- wrapper for hm_cpp_check
+ */
+static int
+map_hm_cpp_check(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_check(pop, hashmap_cpp);
+}
+
+/*
+ * map_hm_cpp_count -- wrapper for hm_cpp_count
+ */
+static size_t
+map_hm_cpp_count(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_count(pop, hashmap_cpp);
+}
+
+/*
+ * map_hm_cpp_init -- wrapper for hm_cpp_init
+ */
+static int
+map_hm_cpp_init(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_init(pop, hashmap_cpp);
+}
+
+/*
+ * map_hm_cpp_new -- wrapper for hm_cpp_new
+ */
+static int
+map_hm_cpp_new(PMEMobjpool *pop, TOID(struct map) *map, void *arg)
+{
+	TOID(struct hashmap_cpp) *hashmap_cpp =
+		(TOID(struct hashmap_cpp) *)map;
+
+	return hm_cpp_new(pop, hashmap_cpp, arg);
+}
+
+/*
+ * map_hm_cpp_delete -- wrapper for hm_cpp_delete
+ */
+static int
+map_hm_cpp_delete(PMEMobjpool *pop, TOID(struct map) *map)
+{
+	TOID(struct hashmap_cpp) *hashmap_cpp =
+		(TOID(struct hashmap_cpp) *)map;
+
+	return hm_cpp_delete(pop, hashmap_cpp);
+}
+
+/*
+ * map_hm_cpp_insert -- wrapper for hm_cpp_insert
+ */
+static int
+map_hm_cpp_insert(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t key, PMEMoid value)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_insert(pop, hashmap_cpp, key, value);
+}
+
+/*
+ * map_hm_cpp_remove -- wrapper for hm_cpp_remove
+ */
+static PMEMoid
+map_hm_cpp_remove(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_remove(pop, hashmap_cpp, key);
+}
+
+/*
+ * map_hm_cpp_get -- wrapper for hm_cpp_get
+ */
+static PMEMoid
+map_hm_cpp_get(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_get(pop, hashmap_cpp, key);
+}
+
+/*
+ * map_hm_cpp_lookup -- wrapper for hm_cpp_lookup
+ */
+static int
+map_hm_cpp_lookup(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_lookup(pop, hashmap_cpp, key);
+}
+
+/*
+ * map_hm_cpp_foreach -- wrapper for hm_cpp_foreach
+ */
+static int
+map_hm_cpp_foreach(PMEMobjpool *pop, TOID(struct map) map,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_foreach(pop, hashmap_cpp, cb, arg);
+}
+
+/*
+ * map_hm_cpp_cmd -- wrapper for hm_cpp_cmd
+ */
+static int
+map_hm_cpp_cmd(PMEMobjpool *pop, TOID(struct map) map,
+		unsigned cmd, uint64_t arg)
+{
+	TOID(struct hashmap_cpp) hashmap_cpp;
+	TOID_ASSIGN(hashmap_cpp, map.oid);
+
+	return hm_cpp_cmd(pop, hashmap_cpp, cmd, arg);
+}
+
+struct map_ops hashmap_cpp_ops = {
+	.check		= map_hm_cpp_check,
+	.new		= map_hm_cpp_new,
+	.delete		= map_hm_cpp_delete,
+	.init		= map_hm_cpp_init,
+	.insert		= map_hm_cpp_insert,
+	.remove		= map_hm_cpp_remove,
+	.get		= map_hm_cpp_get,
+	.lookup		= map_hm_cpp_lookup,
+	.foreach	= map_hm_cpp_foreach,
+	.count		= map_hm_cpp_count,
+	.cmd		= map_hm_cpp_cmd,
+};
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * map_hashmap_mt.c -- common interface for maps
+ */
+
+#include <map.h>
+#include <hashmap_mt.h>
+
+/*
+ * map_hm_mt_check -- wrapper for hm_mt_check
+ */
+static int
+map_hm_mt_check(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_check(pop, hashmap_mt);
+}
+
+/*
+ * map_hm_mt_count -- wrapper for hm_mt_count
+ */
+static size_t
+map_hm_mt_count(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_count(pop, hashmap_mt);
+}
+
+/*
+ * map_hm_mt_init -- wrapper for hm_mt_init
+ */
+static int
+map_hm_mt_init(PMEMobjpool *pop, TOID(struct map) map)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_init(pop, hashmap_mt);
+}
+
+/*
+ * map_hm_mt_new -- wrapper for hm_mt_new
+ */
+static int
+map_hm_mt_new(PMEMobjpool *pop, TOID(struct map) *map, void *arg)
+{
+	TOID(struct hashmap_mt) *hashmap_mt =
+		(TOID(struct hashmap_mt) *)map;
+
+	return hm_mt_new(pop, hashmap_mt, arg);
+}
+
+/*
+ * map_hm_mt_insert -- wrapper for hm_mt_insert
+ */
+static int
+map_hm_mt_insert(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t key, PMEMoid value)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_insert(pop, hashmap_mt, key, value);
+}
+
+/*
+ * map_hm_mt_insert_batch -- wrapper for hm_mt_insert_batch
+ */
+static int
+map_hm_mt_insert_batch(PMEMobjpool *pop, TOID(struct map) map,
+		const uint64_t *keys, const PMEMoid *values, size_t n)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_insert_batch(pop, hashmap_mt, keys, values, n);
+}
+
+/*
+ * map_hm_mt_remove -- wrapper for hm_mt_remove
+ */
+static PMEMoid
+map_hm_mt_remove(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_remove(pop, hashmap_mt, key);
+}
+
+/*
+ * map_hm_mt_get -- wrapper for hm_mt_get
+ */
+static PMEMoid
+map_hm_mt_get(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_get(pop, hashmap_mt, key);
+}
+
+/*
+ * map_hm_mt_lookup -- wrapper for hm_mt_lookup
+ */
+static int
+map_hm_mt_lookup(PMEMobjpool *pop, TOID(struct map) map, uint64_t key)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_lookup(pop, hashmap_mt, key);
+}
+
+/*
+ * map_hm_mt_foreach -- wrapper for hm_mt_foreach
+ */
+static int
+map_hm_mt_foreach(PMEMobjpool *pop, TOID(struct map) map,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_foreach(pop, hashmap_mt, cb, arg);
+}
+
+/*
+ * map_hm_mt_cmd -- wrapper for hm_mt_cmd
+ */
+static int
+map_hm_mt_cmd(PMEMobjpool *pop, TOID(struct map) map,
+		unsigned cmd, uint64_t arg)
+{
+	TOID(struct hashmap_mt) hashmap_mt;
+	TOID_ASSIGN(hashmap_mt, map.oid);
+
+	return hm_mt_cmd(pop, hashmap_mt, cmd, arg);
+}
+
+struct map_ops hashmap_mt_ops = {
+	.check		= map_hm_mt_check,
+	.new		= map_hm_mt_new,
+	.init		= map_hm_mt_init,
+	.insert		= map_hm_mt_insert,
+	.remove		= map_hm_mt_remove,
+	.get		= map_hm_mt_get,
+	.lookup		= map_hm_mt_lookup,
+	.foreach	= map_hm_mt_foreach,
+	.insert_batch	= map_hm_mt_insert_batch,
+	.count		= map_hm_mt_count,
+	.cmd		= map_hm_mt_cmd,
+};
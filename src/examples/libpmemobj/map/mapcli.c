@@ -43,20 +43,34 @@
 #include "map_ctree.h"
 #include "map_btree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_cpp.h"
+#include "map_hashmap_mt.h"
 #include "hashmap/hashmap.h"
 
 #define	PM_HASHSET_POOL_SIZE	(160 * 1024 * 1024)
 
 POBJ_LAYOUT_BEGIN(map);
 POBJ_LAYOUT_ROOT(map, struct root);
+POBJ_LAYOUT_TOID(map, uint64_t);
 POBJ_LAYOUT_END(map);
 
 struct root {
 	TOID(struct map) map;
 };
 
+/* maximum number of keys of a batch command */
+#define	MAX_BATCH 64
+
+struct key_buf {
+	uint64_t *keys;
+	size_t n;
+	size_t size;
+};
+
 static PMEMobjpool *pop;
 static struct map_ctx *mapc;
 static TOID(struct root) root;
@@ -160,6 +174,172 @@ str_rebuild(const char *str)
 	}
 }
 
+/*
+ * range_collect -- (internal) map_range callback which stores the keys
+ */
+static int
+range_collect(uint64_t key, PMEMoid value, void *arg)
+{
+	struct key_buf *kb = arg;
+	if (kb->n == kb->size) {
+		size_t size = kb->size ? kb->size * 2 : 16;
+		uint64_t *keys = realloc(kb->keys, size * sizeof (*keys));
+		if (keys == NULL)
+			return 1;
+
+		kb->keys = keys;
+		kb->size = size;
+	}
+
+	kb->keys[kb->n++] = key;
+	return 0;
+}
+
+/*
+ * key_cmp -- (internal) qsort comparator of the keys
+ */
+static int
+key_cmp(const void *lhs, const void *rhs)
+{
+	uint64_t l = *(const uint64_t *)lhs;
+	uint64_t r = *(const uint64_t *)rhs;
+
+	return l < r ? -1 : l > r;
+}
+
+/*
+ * str_range -- prints the keys from the specified (as string) range in
+ *	ascending order
+ */
+static void
+str_range(const char *str)
+{
+	uint64_t lo;
+	uint64_t hi;
+	if (sscanf(str, "%lu %lu", &lo, &hi) != 2) {
+		fprintf(stderr, "range: invalid syntax\n");
+		return;
+	}
+
+	struct key_buf kb = {NULL, 0, 0};
+	map_range(mapc, map, lo, hi, range_collect, &kb);
+
+	/* only the ordered maps visit the keys in ascending order */
+	qsort(kb.keys, kb.n, sizeof (*kb.keys), key_cmp);
+	for (size_t i = 0; i < kb.n; i++)
+		printf("%lu ", kb.keys[i]);
+	printf("\n");
+
+	free(kb.keys);
+}
+
+/*
+ * str_lower_bound -- prints the smallest key not less than the specified
+ *	(as string) one
+ */
+static void
+str_lower_bound(const char *str)
+{
+	uint64_t key;
+	if (sscanf(str, "%lu", &key) > 0) {
+		if (map_lower_bound(mapc, map, &key, NULL))
+			printf("%lu\n", key);
+		else
+			printf("none\n");
+	} else {
+		fprintf(stderr, "lower bound: invalid syntax\n");
+	}
+}
+
+/*
+ * str_parse_keys -- (internal) parses up to max keys from a string
+ */
+static size_t
+str_parse_keys(const char *str, uint64_t *keys, size_t max)
+{
+	size_t n = 0;
+	int len;
+	while (n < max && sscanf(str, "%lu%n", &keys[n], &len) > 0) {
+		str += len;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * value_construct -- (internal) constructor of a batch inserted value
+ */
+static int
+value_construct(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	*(uint64_t *)ptr = *(uint64_t *)arg;
+	pmemobj_persist(pop, ptr, sizeof (uint64_t));
+
+	return 0;
+}
+
+/*
+ * str_insert_batch -- inserts the specified (as string) keys in a single
+ *	batch, the value of each key is an object which holds a copy of the key
+ */
+static void
+str_insert_batch(const char *str)
+{
+	uint64_t keys[MAX_BATCH];
+	PMEMoid values[MAX_BATCH];
+
+	size_t n = str_parse_keys(str, keys, MAX_BATCH);
+	if (n == 0) {
+		fprintf(stderr, "batch insert: invalid syntax\n");
+		return;
+	}
+
+	size_t i;
+	for (i = 0; i < n; i++) {
+		TOID(uint64_t) val;
+		if (POBJ_NEW(pop, &val, uint64_t, value_construct, &keys[i]))
+			break;
+		values[i] = val.oid;
+	}
+
+	int ret = i == n ? map_insert_batch(mapc, map, keys, values, n) : -1;
+	if (ret != 0) {
+		while (i > 0)
+			pmemobj_free(&values[--i]);
+	}
+
+	printf("%d\n", ret);
+}
+
+/*
+ * str_get_batch -- prints the values of the specified (as string) keys,
+ *	looked up in a single batch
+ */
+static void
+str_get_batch(const char *str)
+{
+	uint64_t keys[MAX_BATCH];
+	PMEMoid values[MAX_BATCH];
+
+	size_t n = str_parse_keys(str, keys, MAX_BATCH);
+	if (n == 0) {
+		fprintf(stderr, "batch get: invalid syntax\n");
+		return;
+	}
+
+	map_get_batch(mapc, map, keys, values, n);
+	for (size_t i = 0; i < n; i++) {
+		TOID(uint64_t) val;
+		TOID_ASSIGN(val, values[i]);
+		if (TOID_IS_NULL(val))
+			printf("- ");
+		else
+			printf("%lu ", *D_RO(val));
+	}
+	printf("\n");
+}
+
 static void
 help(void)
 {
@@ -171,6 +351,10 @@ help(void)
 	printf("p - print all values\n");
 	printf("d - print debug info\n");
 	printf("b [$value] - rebuild $value (default: 1) times\n");
+	printf("s $lo $hi - print the values from [$lo, $hi]\n");
+	printf("l $value - print the smallest value not less than $value\n");
+	printf("I $value... - insert the values in one batch\n");
+	printf("G $value... - get the values in one batch, - if missing\n");
 	printf("q - quit\n");
 }
 
@@ -200,8 +384,11 @@ int
 main(int argc, char *argv[])
 {
 	if (argc < 3 || argc > 4) {
-		printf("usage: %s hashmap_tx|hashmap_atomic|ctree|btree|rbtree"
-				" file-name [<seed>]\n", argv[0]);
+		printf("usage: %s hashmap_tx|hashmap_atomic|hashmap_cpp|"
+				"hashmap_mt|"
+				"ctree|btree|rbtree|bptree|art "
+				"file-name [<seed>]\n",
+				argv[0]);
 		return 1;
 	}
 
@@ -212,12 +399,20 @@ main(int argc, char *argv[])
 		ops = MAP_HASHMAP_TX;
 	} else if (strcmp(type, "hashmap_atomic") == 0) {
 		ops = MAP_HASHMAP_ATOMIC;
+	} else if (strcmp(type, "hashmap_cpp") == 0) {
+		ops = MAP_HASHMAP_CPP;
+	} else if (strcmp(type, "hashmap_mt") == 0) {
+		ops = MAP_HASHMAP_MT;
 	} else if (strcmp(type, "ctree") == 0) {
 		ops = MAP_CTREE;
 	} else if (strcmp(type, "btree") == 0) {
 		ops = MAP_BTREE;
 	} else if (strcmp(type, "rbtree") == 0) {
 		ops = MAP_RBTREE;
+	} else if (strcmp(type, "bptree") == 0) {
+		ops = MAP_BPTREE;
+	} else if (strcmp(type, "art") == 0) {
+		ops = MAP_ART;
 	} else {
 		fprintf(stderr, "invalid hasmap type -- '%s'\n", type);
 		return 1;
@@ -304,6 +499,18 @@ main(int argc, char *argv[])
 			case 'b':
 				str_rebuild(buf + 1);
 				break;
+			case 's':
+				str_range(buf + 1);
+				break;
+			case 'l':
+				str_lower_bound(buf + 1);
+				break;
+			case 'I':
+				str_insert_batch(buf + 1);
+				break;
+			case 'G':
+				str_get_batch(buf + 1);
+				break;
 			case 'q':
 				fclose(stdin);
 				break;
@@ -53,6 +53,11 @@
 #define	PMEMOBJFS_TRACK_BLOCKS	1
 #endif
 
+/* maximum size of a single file extent */
+#ifndef	PMEMOBJFS_MAX_EXTENT
+#define	PMEMOBJFS_MAX_EXTENT	(1 << 20)
+#endif
+
 #if DEBUG
 static FILE *log_fh;
 static uint64_t log_cnt;
@@ -91,6 +96,7 @@ struct pmemobjfs {
 	uint64_t ioctl_off;
 	uint64_t block_size;
 	uint64_t max_name;
+	uint64_t max_extent;	/* maximum number of blocks in extent */
 };
 
 #define	PMEMOBJFS (struct pmemobjfs *)fuse_get_context()->private_data
@@ -173,18 +179,19 @@ for (entry = ((head)).first; !TOID_IS_NULL(entry) &&\
 	}\
 } while (0)
 
-typedef uint8_t objfs_block_t;
-
 /*
  * pmemobjfs persistent layout
+ *
+ * Version 2 indexes the directories by name hash and stores the file data
+ * in extents, pools in the previous layout fail to open.
  */
-POBJ_LAYOUT_BEGIN(pmemobjfs);
-POBJ_LAYOUT_ROOT(pmemobjfs, struct objfs_super);
-POBJ_LAYOUT_TOID(pmemobjfs, struct objfs_inode);
-POBJ_LAYOUT_TOID(pmemobjfs, struct objfs_dir_entry);
-POBJ_LAYOUT_TOID(pmemobjfs, objfs_block_t);
-POBJ_LAYOUT_TOID(pmemobjfs, char);
-POBJ_LAYOUT_END(pmemobjfs);
+POBJ_LAYOUT_BEGIN(pmemobjfs_v2);
+POBJ_LAYOUT_ROOT(pmemobjfs_v2, struct objfs_super);
+POBJ_LAYOUT_TOID(pmemobjfs_v2, struct objfs_inode);
+POBJ_LAYOUT_TOID(pmemobjfs_v2, struct objfs_dir_entry);
+POBJ_LAYOUT_TOID(pmemobjfs_v2, struct objfs_extent);
+POBJ_LAYOUT_TOID(pmemobjfs_v2, char);
+POBJ_LAYOUT_END(pmemobjfs_v2);
 
 #define	PMEMOBJFS_MIN_BLOCK_SIZE ((size_t)(512 - 64))
 
@@ -202,6 +209,7 @@ struct objfs_super {
  */
 struct objfs_dir_entry {
 	PDLL_ENTRY(struct objfs_dir_entry) pdll; /* list entry */
+	TOID(struct objfs_dir_entry) hnext; /* next entry with same hash */
 	TOID(struct objfs_inode) inode;	/* pointer to inode */
 	char name[];			/* name */
 };
@@ -211,18 +219,26 @@ struct objfs_dir_entry {
  */
 struct objfs_dir {
 	PDLL_HEAD(struct objfs_dir_entry) entries; /* directory entries */
+	TOID(struct map) index;	/* name hash to dir entries map */
 };
 
 /*
- * key == 0 for ctree_map is not allowed
+ * struct objfs_extent -- pmemobjfs file extent, a run of contiguous blocks
+ *
+ * The data past the end of file is always zeroed, so the extents can be
+ * allocated in advance and a truncated file can grow again.
  */
-#define	GET_KEY(off) ((off) + 1)
+struct objfs_extent {
+	uint64_t start;		/* first block */
+	uint64_t nblocks;	/* number of blocks */
+	uint8_t data[];		/* file data */
+};
 
 /*
  * struct objfs_file -- pmemobjfs file structure
  */
 struct objfs_file {
-	TOID(struct map) blocks;	/* blocks map */
+	TOID(struct map) extents;	/* extents map, key is the end block */
 };
 
 /*
@@ -314,6 +330,7 @@ pmemobjfs_inode_init_dir(struct pmemobjfs *objfs,
 {
 	TX_BEGIN(objfs->pop) {
 		PDLL_HEAD_INIT(D_RW(inode)->dir.entries);
+		map_new(objfs->mapc, &D_RW(inode)->dir.index, NULL);
 	} TX_END;
 }
 
@@ -324,7 +341,10 @@ static void
 pmemobjfs_inode_destroy_dir(struct pmemobjfs *objfs,
 		TOID(struct objfs_inode) inode)
 {
-	/* nothing to do */
+	/* the directory is empty, so the index holds no entries */
+	TX_BEGIN(objfs->pop) {
+		map_delete(objfs->mapc, &D_RW(inode)->dir.index);
+	} TX_END
 }
 
 /*
@@ -335,7 +355,7 @@ pmemobjfs_inode_init_file(struct pmemobjfs *objfs,
 		TOID(struct objfs_inode) inode)
 {
 	TX_BEGIN(objfs->pop) {
-		map_new(objfs->mapc, &D_RW(inode)->file.blocks, NULL);
+		map_new(objfs->mapc, &D_RW(inode)->file.extents, NULL);
 	} TX_END
 }
 
@@ -347,7 +367,7 @@ pmemobjfs_inode_destroy_file(struct pmemobjfs *objfs,
 		TOID(struct objfs_inode) inode)
 {
 	TX_BEGIN(objfs->pop) {
-		map_delete(objfs->mapc, &D_RW(inode)->file.blocks);
+		map_delete(objfs->mapc, &D_RW(inode)->file.extents);
 	} TX_END
 }
 
@@ -511,30 +531,36 @@ pmemobjfs_inode_put(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode)
 }
 
 /*
- * pmemobjfs_dir_get_inode -- get inode from dir of given name
+ * pmemobjfs_name_hash -- hash of dir entry name, the dir index key
  */
-static TOID(struct objfs_inode)
-pmemobjfs_dir_get_inode(TOID(struct objfs_inode) inode, const char *name)
+static uint64_t
+pmemobjfs_name_hash(const char *name)
 {
-	log("%s", name);
-	TOID(struct objfs_dir_entry) entry;
-	PDLL_FOREACH(entry, D_RW(inode)->dir.entries, pdll) {
-		if (strcmp(name, D_RO(entry)->name) == 0)
-			return D_RO(entry)->inode;
+	/* FNV-1a */
+	uint64_t hash = 14695981039346656037ULL;
+	for (; *name != '\0'; name++) {
+		hash ^= (uint8_t)*name;
+		hash *= 1099511628211ULL;
 	}
 
-	return TOID_NULL(struct objfs_inode);
+	/* key == 0 for ctree_map is not allowed */
+	return hash ? hash : 1;
 }
 
 /*
  * pmemobjfs_get_dir_entry -- get dir entry from dir of given name
  */
 static TOID(struct objfs_dir_entry)
-pmemobjfs_get_dir_entry(TOID(struct objfs_inode) inode, const char *name)
+pmemobjfs_get_dir_entry(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode, const char *name)
 {
 	log("%s", name);
 	TOID(struct objfs_dir_entry) entry;
-	PDLL_FOREACH(entry, D_RW(inode)->dir.entries, pdll) {
+	TOID_ASSIGN(entry, map_get(objfs->mapc, D_RO(inode)->dir.index,
+				pmemobjfs_name_hash(name)));
+
+	/* walk the entries with the same hash */
+	for (; !TOID_IS_NULL(entry); entry = D_RO(entry)->hnext) {
 		if (strcmp(name, D_RO(entry)->name) == 0)
 			return entry;
 	}
@@ -542,6 +568,77 @@ pmemobjfs_get_dir_entry(TOID(struct objfs_inode) inode, const char *name)
 	return TOID_NULL(struct objfs_dir_entry);
 }
 
+/*
+ * pmemobjfs_dir_get_inode -- get inode from dir of given name
+ */
+static TOID(struct objfs_inode)
+pmemobjfs_dir_get_inode(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode, const char *name)
+{
+	log("%s", name);
+	TOID(struct objfs_dir_entry) entry =
+		pmemobjfs_get_dir_entry(objfs, inode, name);
+
+	if (TOID_IS_NULL(entry))
+		return TOID_NULL(struct objfs_inode);
+
+	return D_RO(entry)->inode;
+}
+
+/*
+ * pmemobjfs_dir_index_insert -- add dir entry to directory index
+ */
+static void
+pmemobjfs_dir_index_insert(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode,
+		TOID(struct objfs_dir_entry) entry)
+{
+	uint64_t key = pmemobjfs_name_hash(D_RO(entry)->name);
+
+	TX_BEGIN(objfs->pop) {
+		/* new entry becomes the head of entries with the same hash */
+		TX_ADD_FIELD(entry, hnext);
+		TOID_ASSIGN(D_RW(entry)->hnext,
+			map_get(objfs->mapc, D_RO(inode)->dir.index, key));
+
+		map_insert(objfs->mapc, D_RW(inode)->dir.index, key,
+				entry.oid);
+	} TX_END
+}
+
+/*
+ * pmemobjfs_dir_index_remove -- remove dir entry from directory index
+ */
+static void
+pmemobjfs_dir_index_remove(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode,
+		TOID(struct objfs_dir_entry) entry)
+{
+	uint64_t key = pmemobjfs_name_hash(D_RO(entry)->name);
+	TOID(struct objfs_dir_entry) next = D_RO(entry)->hnext;
+
+	TX_BEGIN(objfs->pop) {
+		TOID(struct objfs_dir_entry) prev;
+		TOID_ASSIGN(prev, map_get(objfs->mapc,
+					D_RO(inode)->dir.index, key));
+
+		if (TOID_EQUALS(prev, entry)) {
+			if (TOID_IS_NULL(next))
+				map_remove(objfs->mapc,
+					D_RW(inode)->dir.index, key);
+			else
+				map_insert(objfs->mapc,
+					D_RW(inode)->dir.index, key, next.oid);
+		} else {
+			while (!TOID_EQUALS(D_RO(prev)->hnext, entry))
+				prev = D_RO(prev)->hnext;
+
+			TX_ADD_FIELD(prev, hnext);
+			D_RW(prev)->hnext = next;
+		}
+	} TX_END
+}
+
 /*
  * pmemobjfs_inode_lookup_parent -- lookup for parent inode and child name
  */
@@ -581,7 +678,7 @@ pmemobjfs_inode_lookup_parent(struct pmemobjfs *objfs,
 		}
 
 		par = cur;
-		cur = pmemobjfs_dir_get_inode(cur, name);
+		cur = pmemobjfs_dir_get_inode(objfs, cur, name);
 		ch = name;
 		name = slash;
 	}
@@ -625,45 +722,87 @@ pmemobjfs_inode_lookup(struct pmemobjfs *objfs, const char *path,
 }
 
 /*
- * pmemobjfs_file_get_block -- get block at given offset
+ * pmemobjfs_file_get_extent -- get extent which contains given block or,
+ * if there is no such extent, the first extent after the block
  */
-static TOID(objfs_block_t)
-pmemobjfs_file_get_block(struct pmemobjfs *objfs,
-		TOID(struct objfs_inode) inode,
-		uint64_t offset)
+static TOID(struct objfs_extent)
+pmemobjfs_file_get_extent(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode, uint64_t block)
 {
-	TOID(objfs_block_t) block;
-	PMEMoid block_oid =
-		map_get(objfs->mapc, D_RO(inode)->file.blocks, GET_KEY(offset));
-	TOID_ASSIGN(block, block_oid);
-	return block;
+	TOID(struct objfs_extent) extent = TOID_NULL(struct objfs_extent);
+
+	/* the extents are indexed by the end block */
+	uint64_t key = block + 1;
+	PMEMoid oid;
+	if (map_lower_bound(objfs->mapc, D_RO(inode)->file.extents,
+				&key, &oid))
+		TOID_ASSIGN(extent, oid);
+
+	return extent;
 }
 
 /*
- * pmemobjfs_file_get_block_for_write -- get or allocate block at given offset
+ * pmemobjfs_file_alloc_extent -- allocate extent starting at given block
+ *
+ * The extent is at most nblocks long but a write at the end of file
+ * allocates extent proportional to the file size, so streaming writes
+ * end up in a few large extents.
  */
-static TOID(objfs_block_t)
-pmemobjfs_file_get_block_for_write(struct pmemobjfs *objfs,
-		TOID(struct objfs_inode) inode, uint64_t offset)
+static TOID(struct objfs_extent)
+pmemobjfs_file_alloc_extent(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode,
+		uint64_t block, uint64_t nblocks)
 {
-	TOID(objfs_block_t) block =
-		pmemobjfs_file_get_block(objfs, inode, offset);
-	if (TOID_IS_NULL(block)) {
-		TX_BEGIN(objfs->pop) {
-			block = TX_ALLOC(objfs_block_t,
-					objfs->block_size);
-			map_insert(objfs->mapc, D_RW(inode)->file.blocks,
-					GET_KEY(offset), block.oid);
-		} TX_ONABORT {
-			block = TOID_NULL(objfs_block_t);
-		} TX_END
-	} else {
-#if PMEMOBJFS_TRACK_BLOCKS
-		TX_ADD(block);
-#endif
+	/* the first extent after the block limits the new one */
+	TOID(struct objfs_extent) next =
+		pmemobjfs_file_get_extent(objfs, inode, block);
+
+	if (TOID_IS_NULL(next)) {
+		uint64_t fblocks = D_RO(inode)->size / objfs->block_size;
+		if (nblocks < fblocks)
+			nblocks = fblocks;
 	}
 
-	return block;
+	if (nblocks > objfs->max_extent)
+		nblocks = objfs->max_extent;
+
+	if (!TOID_IS_NULL(next) && block + nblocks > D_RO(next)->start)
+		nblocks = D_RO(next)->start - block;
+
+	TOID(struct objfs_extent) extent = TOID_NULL(struct objfs_extent);
+	TX_BEGIN(objfs->pop) {
+		extent = TX_ZALLOC(struct objfs_extent,
+				sizeof (struct objfs_extent) +
+				nblocks * objfs->block_size);
+		D_RW(extent)->start = block;
+		D_RW(extent)->nblocks = nblocks;
+
+		map_insert(objfs->mapc, D_RW(inode)->file.extents,
+				block + nblocks, extent.oid);
+	} TX_ONABORT {
+		extent = TOID_NULL(struct objfs_extent);
+	} TX_END
+
+	return extent;
+}
+
+/*
+ * pmemobjfs_file_get_extent_for_write -- get or allocate extent which
+ * contains given block
+ */
+static TOID(struct objfs_extent)
+pmemobjfs_file_get_extent_for_write(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode, uint64_t block,
+		uint64_t nblocks)
+{
+	TOID(struct objfs_extent) extent =
+		pmemobjfs_file_get_extent(objfs, inode, block);
+
+	if (TOID_IS_NULL(extent) || D_RO(extent)->start > block)
+		extent = pmemobjfs_file_alloc_extent(objfs, inode,
+				block, nblocks);
+
+	return extent;
 }
 
 /*
@@ -687,15 +826,32 @@ pmemobjfs_truncate(struct pmemobjfs *objfs,
 
 	TX_BEGIN(objfs->pop) {
 		uint64_t old_off = D_RO(inode)->size;
-		if (old_off > off) {
-			/* release blocks */
-			uint64_t old_boff = (old_off - 1) / objfs->block_size;
-			uint64_t boff = (off + 1) / objfs->block_size;
-
-			for (uint64_t o = boff; o <= old_boff; o++) {
+		uint64_t bsize = objfs->block_size;
+		TOID(struct objfs_extent) extent = old_off > (uint64_t)off ?
+			pmemobjfs_file_get_extent(objfs, inode, off / bsize) :
+			TOID_NULL(struct objfs_extent);
+
+		while (!TOID_IS_NULL(extent)) {
+			uint64_t start = D_RO(extent)->start;
+			uint64_t end = start + D_RO(extent)->nblocks;
+
+			if (start * bsize < (uint64_t)off) {
+				/* zero the truncated part of the extent */
+				uint64_t zend = end * bsize < old_off ?
+					end * bsize : old_off;
+				uint8_t *data = &D_RW(extent)->data[
+					off - start * bsize];
+				size_t len = zend - off;
+
+				pmemobj_tx_add_range_direct(data, len);
+				memset(data, 0, len);
+			} else {
+				/* release extent */
 				map_remove_free(objfs->mapc,
-					D_RW(inode)->file.blocks, GET_KEY(o));
+					D_RW(inode)->file.extents, end);
 			}
+
+			extent = pmemobjfs_file_get_extent(objfs, inode, end);
 		}
 
 		time_t t = time(NULL);
@@ -735,37 +891,46 @@ pmemobjfs_read(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 	}
 
 	uint64_t fsize = D_RO(inode)->size;
+	if ((uint64_t)offset >= fsize)
+		return 0;
+
+	if (size > fsize - offset)
+		size = fsize - offset;
 
 	size_t sz = size;
-	size_t off = offset;
+	uint64_t off = offset;
 	while (sz > 0) {
-		if (off >= fsize)
-			break;
-
 		uint64_t block_id = off / objfs->block_size;
-		uint64_t block_off = off % objfs->block_size;
-		uint64_t block_size = sz < objfs->block_size ?
-			sz : objfs->block_size;
-
-		TOID(objfs_block_t) block =
-			pmemobjfs_file_get_block(objfs, inode, block_id);
-
-		if (block_off + block_size > objfs->block_size)
-			block_size = objfs->block_size - block_off;
-
-		if (TOID_IS_NULL(block)) {
-			memset(buff, 0, block_size);
+		TOID(struct objfs_extent) extent =
+			pmemobjfs_file_get_extent(objfs, inode, block_id);
+
+		size_t len;
+		if (TOID_IS_NULL(extent)) {
+			/* hole up to the end of file */
+			len = sz;
+			memset(buff, 0, len);
+		} else if (D_RO(extent)->start > block_id) {
+			/* hole up to the next extent */
+			len = D_RO(extent)->start * objfs->block_size - off;
+			if (len > sz)
+				len = sz;
+			memset(buff, 0, len);
 		} else {
-			memcpy(buff, &D_RW(block)[block_off], block_size);
+			uint64_t ext_off =
+				off - D_RO(extent)->start * objfs->block_size;
+			len = D_RO(extent)->nblocks * objfs->block_size -
+				ext_off;
+			if (len > sz)
+				len = sz;
+			memcpy(buff, &D_RO(extent)->data[ext_off], len);
 		}
 
-
-		buff += block_size;
-		off += block_size;
-		sz -= block_size;
+		buff += len;
+		off += len;
+		sz -= len;
 	}
 
-	return size - sz;
+	return size;
 }
 
 /*
@@ -789,28 +954,38 @@ pmemobjfs_write(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 
 	TX_BEGIN(objfs->pop) {
 		size_t sz = size;
-		off_t off = offset;
+		uint64_t off = offset;
 		while (sz > 0) {
 			uint64_t block_id = off / objfs->block_size;
-			uint64_t block_off = off % objfs->block_size;
-			uint64_t block_size = sz < objfs->block_size ?
-				sz : objfs->block_size;
+			uint64_t last_id = (off + sz - 1) / objfs->block_size;
 
-			TOID(objfs_block_t) block =
-				pmemobjfs_file_get_block_for_write(objfs,
-						inode, block_id);
+			uint64_t nblocks = last_id - block_id + 1;
 
-			if (TOID_IS_NULL(block))
-				return -ENOSPC;
+			TOID(struct objfs_extent) extent =
+				pmemobjfs_file_get_extent_for_write(objfs,
+					inode, block_id, nblocks);
 
-			if (block_off + block_size > objfs->block_size)
-				block_size = objfs->block_size - block_off;
+			if (TOID_IS_NULL(extent))
+				pmemobj_tx_abort(ENOSPC);
 
-			memcpy(&D_RW(block)[block_off], buff, block_size);
+			uint64_t ext_off =
+				off - D_RO(extent)->start * objfs->block_size;
+			size_t len = D_RO(extent)->nblocks * objfs->block_size -
+				ext_off;
+			if (len > sz)
+				len = sz;
 
-			buff += block_size;
-			off += block_size;
-			sz -= block_size;
+			uint8_t *data = &D_RW(extent)->data[ext_off];
+#if PMEMOBJFS_TRACK_BLOCKS
+			pmemobj_tx_add_range_direct(data, len);
+			memcpy(data, buff, len);
+#else
+			pmemobj_memcpy_persist(objfs->pop, data, buff, len);
+#endif
+
+			buff += len;
+			off += len;
+			sz -= len;
 		}
 
 		time_t t = time(NULL);
@@ -831,7 +1006,9 @@ pmemobjfs_write(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 	} TX_ONCOMMIT {
 		ret = size;
 	} TX_ONABORT {
-		ret = -ECANCELED;
+		/* a failed extent allocation means the pool is full */
+		int err = pmemobj_tx_errno();
+		ret = err == ENOMEM || err == ENOSPC ? -ENOSPC : -ECANCELED;
 	} TX_END
 
 	return ret;
@@ -857,11 +1034,16 @@ pmemobjfs_fallocate(struct pmemobjfs *objfs,
 	int ret = 0;
 
 	TX_BEGIN(objfs->pop) {
-		/* allocate blocks from requested range */
+		/* allocate extents for holes in requested range */
 		uint64_t b_off = offset / objfs->block_size;
 		uint64_t e_off = (offset + size) / objfs->block_size;
-		for (uint64_t off = b_off; off <= e_off; off++)
-			pmemobjfs_file_get_block_for_write(objfs, inode, off);
+		for (uint64_t off = b_off; off <= e_off; ) {
+			TOID(struct objfs_extent) extent =
+				pmemobjfs_file_get_extent_for_write(objfs,
+					inode, off, e_off - off + 1);
+
+			off = D_RO(extent)->start + D_RO(extent)->nblocks;
+		}
 
 		time_t t = time(NULL);
 		/* update modification time */
@@ -894,6 +1076,7 @@ pmemobjfs_remove_dir_entry(struct pmemobjfs *objfs,
 		pmemobjfs_inode_put(objfs, D_RO(entry)->inode);
 
 		PDLL_REMOVE(D_RW(inode)->dir.entries, entry, pdll);
+		pmemobjfs_dir_index_remove(objfs, inode, entry);
 
 		pmemobjfs_dir_entry_free(objfs, entry);
 	} TX_END
@@ -908,7 +1091,7 @@ pmemobjfs_remove_dir_entry_name(struct pmemobjfs *objfs,
 {
 	TX_BEGIN(objfs->pop) {
 		TOID(struct objfs_dir_entry) entry =
-			pmemobjfs_get_dir_entry(inode, name);
+			pmemobjfs_get_dir_entry(objfs, inode, name);
 
 		pmemobjfs_remove_dir_entry(objfs, inode, entry);
 	} TX_END
@@ -929,8 +1112,9 @@ pmemobjfs_add_dir_entry(struct pmemobjfs *objfs,
 
 	int ret = 0;
 	TX_BEGIN(objfs->pop) {
-		/* insert new dir entry to list */
+		/* insert new dir entry to list and index */
 		PDLL_INSERT_HEAD(D_RW(inode)->dir.entries, entry, pdll);
+		pmemobjfs_dir_index_insert(objfs, inode, entry);
 
 		/* update dir size */
 		TX_ADD_FIELD(inode, size);
@@ -1061,7 +1245,7 @@ pmemobjfs_rmdir(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 		return -ENOTDIR;
 
 	TOID(struct objfs_dir_entry) entry =
-		pmemobjfs_get_dir_entry(inode, name);
+		pmemobjfs_get_dir_entry(objfs, inode, name);
 
 	if (TOID_IS_NULL(entry))
 		return -ENOENT;
@@ -1203,7 +1387,7 @@ pmemobjfs_rename(struct pmemobjfs *objfs,
 
 	/* get source dir entry */
 	TOID(struct objfs_dir_entry) src_entry =
-		pmemobjfs_get_dir_entry(src_parent, src_name);
+		pmemobjfs_get_dir_entry(objfs, src_parent, src_name);
 
 	TOID(struct objfs_inode) src_inode = D_RO(src_entry)->inode;
 
@@ -1425,7 +1609,7 @@ pmemobjfs_unlink(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 		return -ENOTDIR;
 
 	TOID(struct objfs_dir_entry) entry =
-		pmemobjfs_get_dir_entry(inode, name);
+		pmemobjfs_get_dir_entry(objfs, inode, name);
 
 	if (TOID_IS_NULL(entry))
 		return -ENOENT;
@@ -2108,6 +2292,8 @@ pmemobjfs_fuse_init(struct fuse_conn_info *conn)
 	/* fill some runtime information */
 	objfs->block_size = D_RO(super)->block_size;
 	objfs->max_name = objfs->block_size - sizeof (struct objfs_dir_entry);
+	objfs->max_extent = PMEMOBJFS_MAX_EXTENT > objfs->block_size ?
+		PMEMOBJFS_MAX_EXTENT / objfs->block_size : 1;
 	objfs->pool_uuid_lo = super.oid.pool_uuid_lo;
 
 	TX_BEGIN(objfs->pop) {
@@ -2178,7 +2364,7 @@ pmemobjfs_mkfs(const char *fname, size_t size, size_t bsize, mode_t mode)
 
 	objfs->block_size = bsize;
 
-	objfs->pop = pmemobj_create(fname, POBJ_LAYOUT_NAME(pmemobjfs),
+	objfs->pop = pmemobj_create(fname, POBJ_LAYOUT_NAME(pmemobjfs_v2),
 			size, mode);
 	if (!objfs->pop) {
 		fprintf(stderr, "error: %s\n", pmemobj_errormsg());
@@ -2446,7 +2632,7 @@ main(int argc, char *argv[])
 
 	int ret = 0;
 
-	objfs->pop = pmemobj_open(fname, POBJ_LAYOUT_NAME(pmemobjfs));
+	objfs->pop = pmemobj_open(fname, POBJ_LAYOUT_NAME(pmemobjfs_v2));
 	if (objfs->pop == NULL) {
 		perror("pmemobj_open");
 		ret = -1;
@@ -0,0 +1,1073 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * art_map.c -- adaptive radix tree implementation
+ *
+ * The tree branches on one byte of the key at a time, with nodes of 4, 16,
+ * 48 or 256 children. Each node keeps the whole prefix shared by its keys,
+ * (the key bytes above its depth), so a lookup checks it with a single
+ * compare and a mismatch can be split without touching the existing node.
+ * A node is a single object and the children are 8-byte pool offsets, with
+ * the lowest bit set for the leaves. The child arrays of the nodes with 16
+ * or more children start on a cache line of their own.
+ *
+ * The writers are serialized by the map lock, held until the outermost
+ * transaction ends. The lookups, foreach and range take no lock, but they
+ * wait while a transaction of another thread changes the map:
+ * - a node is changed only in a way that a concurrent reader sees either
+ *   the old or the new child for any key byte, or takes a wrong branch
+ *   which the full prefix or key check then rejects,
+ * - everything else (growing, shrinking, replacing a value) builds a new
+ *   object and swaps the single 8-byte offset which points to the old one,
+ * - the readers check the sequence counter of the map before following
+ *   a loaded offset, a transaction keeps it odd from its first change until
+ *   it's committed or rolled back, so the readers never see uncommitted
+ *   changes nor the objects freed by the rollback of an aborted one,
+ * - the unlinked objects are kept on a persistent limbo list until no
+ *   reader which could have seen them is left (epoch-based reclamation).
+ * See tree_map_epoch.h.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "art_map.h"
+#include "tree_map_epoch.h"
+
+#define	ART_MAP_NODE_TYPE (ART_MAP_TYPE_OFFSET + 1)
+#define	ART_MAP_LEAF_TYPE (ART_MAP_TYPE_OFFSET + 2)
+
+#define	ART_MAP_LEAF 1ULL /* tag of the leaf offsets */
+
+/* a node shrinks once it holds this many children */
+#define	ART_MAP_SHRINK16 3
+#define	ART_MAP_SHRINK48 12
+#define	ART_MAP_SHRINK256 37
+
+enum art_map_node_type {
+	ART_NODE4,
+	ART_NODE16,
+	ART_NODE48,
+	ART_NODE256,
+
+	MAX_ART_NODE
+};
+
+static const unsigned art_map_capacity[MAX_ART_NODE] = {4, 16, 48, 256};
+
+struct art_map_node {
+	struct tree_map_retired retired;
+	uint64_t prefix; /* a key from the node, only depth bytes are valid */
+	uint8_t type;
+	uint8_t depth; /* index of the key byte which selects the child */
+	uint16_t n; /* number of children */
+	uint32_t unused;
+};
+
+/* node4 and node16 children are not sorted, new ones are appended */
+struct art_map_node4 {
+	struct art_map_node node;
+	uint8_t keys[4];
+	uint8_t unused[12]; /* makes a 16-byte load of keys safe */
+	uint64_t children[4];
+};
+
+struct art_map_node16 {
+	struct art_map_node node;
+	uint8_t keys[16];
+	uint8_t unused[16];
+	uint64_t children[16];
+};
+
+struct art_map_node48 {
+	struct art_map_node node;
+	uint8_t index[256]; /* 1 + position of the child, 0 if none */
+	uint8_t unused[32];
+	uint64_t children[48]; /* the first n are used */
+};
+
+struct art_map_node256 {
+	struct art_map_node node;
+	uint8_t unused[32];
+	uint64_t children[256];
+};
+
+struct art_map_leaf {
+	struct tree_map_retired retired;
+	uint64_t key;
+	PMEMoid value;
+};
+
+struct art_map {
+	uint64_t root; /* tagged offset of the root */
+	struct tree_map_limbo limbo;
+	PMEMmutex lock; /* serializes the writers */
+};
+
+/*
+ * art_map_ptr -- (internal) returns the object at the (tagged) offset
+ */
+static inline void *
+art_map_ptr(PMEMobjpool *pop, uint64_t off)
+{
+	return (char *)pop + (off & ~ART_MAP_LEAF);
+}
+
+/*
+ * art_map_off -- (internal) returns the offset of the object
+ */
+static inline uint64_t
+art_map_off(PMEMobjpool *pop, const void *ptr)
+{
+	return (uint64_t)((uintptr_t)ptr - (uintptr_t)pop);
+}
+
+/*
+ * art_map_is_leaf -- (internal) checks whether the offset points to a leaf
+ */
+static inline int
+art_map_is_leaf(uint64_t off)
+{
+	return (off & ART_MAP_LEAF) != 0;
+}
+
+/*
+ * art_map_load -- (internal) reads the child offset, which may be changed
+ *	concurrently
+ */
+static inline uint64_t
+art_map_load(const uint64_t *slot)
+{
+	return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * art_map_byte -- (internal) returns the key byte at the depth, the most
+ *	significant one first so the tree is ordered
+ */
+static inline unsigned
+art_map_byte(uint64_t key, unsigned depth)
+{
+	return (unsigned)(key >> (56 - 8 * depth)) & 0xff;
+}
+
+/*
+ * art_map_prefix_matches -- (internal) checks whether the key belongs
+ *	to the subtree of the node
+ */
+static inline int
+art_map_prefix_matches(const struct art_map_node *n, uint64_t key)
+{
+	return n->depth == 0 || ((key ^ n->prefix) >> (64 - 8 * n->depth)) == 0;
+}
+
+/*
+ * art_map_diff_depth -- (internal) returns the index of the first byte
+ *	in which the keys differ
+ */
+static inline unsigned
+art_map_diff_depth(uint64_t a, uint64_t b)
+{
+	assert(a != b);
+
+	return (unsigned)__builtin_clzll(a ^ b) / 8;
+}
+
+/*
+ * art_map_search16 -- (internal) returns the position of the key byte
+ *	among the first n of the 16 bytes, -1 if it's not there
+ */
+static inline int
+art_map_search16(const uint8_t *keys, unsigned c, unsigned n)
+{
+#ifdef __SSE2__
+	__m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c),
+		_mm_loadu_si128((const __m128i *)keys));
+	unsigned mask = (unsigned)_mm_movemask_epi8(cmp) & ((1U << n) - 1);
+
+	return mask ? __builtin_ctz(mask) : -1;
+#else
+	for (unsigned i = 0; i < n; ++i) {
+		if (keys[i] == c)
+			return (int)i;
+	}
+
+	return -1;
+#endif
+}
+
+/*
+ * art_map_find_child -- (internal) returns the slot of the child for the key
+ *	byte, NULL if there is none (a node256 slot may hold 0)
+ */
+static uint64_t *
+art_map_find_child(struct art_map_node *n, unsigned c)
+{
+	unsigned cnt = __atomic_load_n(&n->n, __ATOMIC_ACQUIRE);
+	int i;
+
+	switch (n->type) {
+	case ART_NODE4: {
+		struct art_map_node4 *n4 = (struct art_map_node4 *)n;
+		i = art_map_search16(n4->keys, c, cnt);
+		return i < 0 ? NULL : &n4->children[i];
+	}
+	case ART_NODE16: {
+		struct art_map_node16 *n16 = (struct art_map_node16 *)n;
+		i = art_map_search16(n16->keys, c, cnt);
+		return i < 0 ? NULL : &n16->children[i];
+	}
+	case ART_NODE48: {
+		struct art_map_node48 *n48 = (struct art_map_node48 *)n;
+		i = __atomic_load_n(&n48->index[c], __ATOMIC_ACQUIRE);
+		return i == 0 ? NULL : &n48->children[i - 1];
+	}
+	case ART_NODE256:
+		return &((struct art_map_node256 *)n)->children[c];
+	default:
+		abort();
+	}
+}
+
+/*
+ * art_map_children -- (internal) copies the key bytes and the offsets of
+ *	the children of the node, in key order, returns their number
+ */
+static unsigned
+art_map_children(struct art_map_node *n, uint8_t *keys, uint64_t *children)
+{
+	unsigned cnt = __atomic_load_n(&n->n, __ATOMIC_ACQUIRE);
+	const uint8_t *nkeys = NULL;
+	const uint64_t *nchildren = NULL;
+	unsigned ret = 0;
+
+	switch (n->type) {
+	case ART_NODE4:
+		nkeys = ((struct art_map_node4 *)n)->keys;
+		nchildren = ((struct art_map_node4 *)n)->children;
+		break;
+	case ART_NODE16:
+		nkeys = ((struct art_map_node16 *)n)->keys;
+		nchildren = ((struct art_map_node16 *)n)->children;
+		break;
+	case ART_NODE48: {
+		struct art_map_node48 *n48 = (struct art_map_node48 *)n;
+		for (unsigned c = 0; c < 256; ++c) {
+			unsigned i = __atomic_load_n(&n48->index[c],
+				__ATOMIC_ACQUIRE);
+			if (i == 0)
+				continue;
+
+			keys[ret] = (uint8_t)c;
+			children[ret] = art_map_load(&n48->children[i - 1]);
+			if (children[ret] != 0)
+				ret++;
+		}
+		return ret;
+	}
+	case ART_NODE256: {
+		struct art_map_node256 *n256 = (struct art_map_node256 *)n;
+		for (unsigned c = 0; c < 256; ++c) {
+			keys[ret] = (uint8_t)c;
+			children[ret] = art_map_load(&n256->children[c]);
+			if (children[ret] != 0)
+				ret++;
+		}
+		return ret;
+	}
+	default:
+		abort();
+	}
+
+	/*
+	 * Insertion sort of the (at most 16) appended children. A key byte
+	 * may show up twice while a child is being removed, then the first
+	 * occurrence is the valid one.
+	 */
+	for (unsigned i = 0; i < cnt; ++i) {
+		uint8_t c = nkeys[i];
+		uint64_t child = art_map_load(&nchildren[i]);
+		unsigned j = ret;
+
+		while (j > 0 && keys[j - 1] > c)
+			j--;
+
+		if ((j > 0 && keys[j - 1] == c) || child == 0)
+			continue;
+
+		memmove(&keys[j + 1], &keys[j], ret - j);
+		memmove(&children[j + 1], &children[j],
+			(ret - j) * sizeof (children[0]));
+		keys[j] = c;
+		children[j] = child;
+		ret++;
+	}
+
+	return ret;
+}
+
+/*
+ * art_map_new_leaf -- (internal) allocates a new leaf, returns its tagged
+ *	offset
+ */
+static uint64_t
+art_map_new_leaf(PMEMobjpool *pop, uint64_t key, PMEMoid value)
+{
+	PMEMoid oid = pmemobj_tx_alloc(sizeof (struct art_map_leaf),
+		ART_MAP_LEAF_TYPE);
+	struct art_map_leaf *l = pmemobj_direct(oid);
+
+	l->retired.next = 0;
+	l->retired.epoch = 0;
+	l->key = key;
+	l->value = value;
+
+	return oid.off | ART_MAP_LEAF;
+}
+
+/*
+ * art_map_new_node -- (internal) allocates a new, empty node
+ */
+static struct art_map_node *
+art_map_new_node(enum art_map_node_type type, unsigned depth, uint64_t prefix)
+{
+	static const size_t sizes[MAX_ART_NODE] = {
+		sizeof (struct art_map_node4),
+		sizeof (struct art_map_node16),
+		sizeof (struct art_map_node48),
+		sizeof (struct art_map_node256),
+	};
+
+	struct art_map_node *n = pmemobj_direct(
+		pmemobj_tx_zalloc(sizes[type], ART_MAP_NODE_TYPE));
+
+	n->type = (uint8_t)type;
+	n->depth = (uint8_t)depth;
+	n->prefix = prefix;
+
+	return n;
+}
+
+/*
+ * art_map_add -- (internal) adds a child to a node which isn't full
+ *
+ * For a node reachable by the readers (snapshot is set) the child is
+ * written before it's published by the counter or the index store.
+ */
+static void
+art_map_add(struct art_map_node *n, unsigned c, uint64_t child, int snapshot)
+{
+	unsigned cnt = n->n;
+
+	assert(cnt < art_map_capacity[n->type]);
+
+	switch (n->type) {
+	case ART_NODE4:
+	case ART_NODE16: {
+		uint8_t *keys = n->type == ART_NODE4 ?
+			((struct art_map_node4 *)n)->keys :
+			((struct art_map_node16 *)n)->keys;
+		uint64_t *children = n->type == ART_NODE4 ?
+			((struct art_map_node4 *)n)->children :
+			((struct art_map_node16 *)n)->children;
+
+		/* the slots past the counter are unused, even on abort */
+		if (snapshot)
+			pmemobj_tx_add_range_direct(&n->n, sizeof (n->n));
+
+		keys[cnt] = (uint8_t)c;
+		__atomic_store_n(&children[cnt], child, __ATOMIC_RELEASE);
+		break;
+	}
+	case ART_NODE48: {
+		struct art_map_node48 *n48 = (struct art_map_node48 *)n;
+
+		if (snapshot)
+			pmemobj_tx_add_range_direct(&n->n,
+				(size_t)((char *)&n48->index[c + 1] -
+				(char *)&n->n));
+
+		__atomic_store_n(&n48->children[cnt], child, __ATOMIC_RELEASE);
+		__atomic_store_n(&n48->index[c], (uint8_t)(cnt + 1),
+			__ATOMIC_RELEASE);
+		break;
+	}
+	case ART_NODE256: {
+		struct art_map_node256 *n256 = (struct art_map_node256 *)n;
+
+		if (snapshot) {
+			pmemobj_tx_add_range_direct(&n->n, sizeof (n->n));
+			pmemobj_tx_add_range_direct(&n256->children[c],
+				sizeof (n256->children[c]));
+		}
+
+		__atomic_store_n(&n256->children[c], child, __ATOMIC_RELEASE);
+		break;
+	}
+	default:
+		abort();
+	}
+
+	__atomic_store_n(&n->n, (uint16_t)(cnt + 1), __ATOMIC_RELEASE);
+}
+
+/*
+ * art_map_copy -- (internal) builds a new node of the type with the children
+ *	of the node, except the one of the skipped key byte (if not -1)
+ */
+static struct art_map_node *
+art_map_copy(struct art_map_node *n, enum art_map_node_type type, int skip)
+{
+	uint8_t keys[256];
+	uint64_t children[256];
+	unsigned cnt = art_map_children(n, keys, children);
+
+	struct art_map_node *copy = art_map_new_node(type, n->depth, n->prefix);
+	for (unsigned i = 0; i < cnt; ++i) {
+		if (keys[i] != skip)
+			art_map_add(copy, keys[i], children[i], 0);
+	}
+
+	return copy;
+}
+
+/*
+ * art_map_publish -- (internal) stores the offset in the slot, the object
+ *	it points to has to be complete
+ */
+static void
+art_map_publish(uint64_t *slot, uint64_t off)
+{
+	pmemobj_tx_add_range_direct(slot, sizeof (*slot));
+	__atomic_store_n(slot, off, __ATOMIC_RELEASE);
+}
+
+/*
+ * art_map_retire -- (internal) retires the object at the tagged offset
+ */
+static inline void
+art_map_retire(struct tree_map_op *op, uint64_t off)
+{
+	tree_map_retire(op, off & ~ART_MAP_LEAF);
+}
+
+/*
+ * art_map_new -- allocates a new adaptive radix tree instance
+ */
+int
+art_map_new(PMEMobjpool *pop, TOID(struct art_map) *map, void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(map, sizeof (*map));
+		*map = TX_ZNEW(struct art_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_free_subtree -- (internal) frees the subtree
+ */
+static void
+art_map_free_subtree(PMEMobjpool *pop, uint64_t off)
+{
+	if (!art_map_is_leaf(off)) {
+		uint8_t keys[256];
+		uint64_t children[256];
+		unsigned cnt = art_map_children(art_map_ptr(pop, off),
+			keys, children);
+
+		for (unsigned i = 0; i < cnt; ++i)
+			art_map_free_subtree(pop, children[i]);
+	}
+
+	pmemobj_tx_free(pmemobj_oid(art_map_ptr(pop, off)));
+}
+
+/*
+ * art_map_retire_subtree -- (internal) retires the subtree
+ */
+static void
+art_map_retire_subtree(struct tree_map_op *op, uint64_t off)
+{
+	if (!art_map_is_leaf(off)) {
+		uint8_t keys[256];
+		uint64_t children[256];
+		unsigned cnt = art_map_children(art_map_ptr(op->pop, off),
+			keys, children);
+
+		for (unsigned i = 0; i < cnt; ++i)
+			art_map_retire_subtree(op, children[i]);
+	}
+
+	art_map_retire(op, off);
+}
+
+/*
+ * art_map_clear -- removes all elements from the map
+ */
+int
+art_map_clear(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	struct art_map *m = D_RW(map);
+	struct tree_map_op op;
+	int ret = 0;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+
+		uint64_t root = m->root;
+		if (root != 0) {
+			art_map_publish(&m->root, 0);
+			art_map_retire_subtree(&op, root);
+		}
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_delete -- cleanups and frees adaptive radix tree instance, the map
+ *	must not be in use by any other thread
+ */
+int
+art_map_delete(PMEMobjpool *pop, TOID(struct art_map) *map)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		struct art_map *m = D_RW(*map);
+
+		if (m->root != 0)
+			art_map_free_subtree(pop, m->root);
+
+		tree_map_limbo_free(pop, &m->limbo);
+
+		pmemobj_tx_add_range_direct(map, sizeof (*map));
+		TX_FREE(*map);
+		*map = TOID_NULL(struct art_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_insert -- inserts a new key-value pair into the map, replacing
+ *	the value of an existing key
+ */
+int
+art_map_insert(PMEMobjpool *pop, TOID(struct art_map) map,
+	uint64_t key, PMEMoid value)
+{
+	struct art_map *m = D_RW(map);
+	struct tree_map_op op;
+	int ret = 0;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+
+		uint64_t *ref = &m->root;
+		uint64_t cur;
+		struct art_map_node *n;
+		unsigned d;
+
+		while ((cur = *ref) != 0 && !art_map_is_leaf(cur)) {
+			n = art_map_ptr(pop, cur);
+
+			if (!art_map_prefix_matches(n, key)) {
+				/* the key leaves the path above the node */
+				d = art_map_diff_depth(key, n->prefix);
+				struct art_map_node *up =
+					art_map_new_node(ART_NODE4, d, key);
+				art_map_add(up, art_map_byte(n->prefix, d),
+					cur, 0);
+				art_map_add(up, art_map_byte(key, d),
+					art_map_new_leaf(pop, key, value), 0);
+				art_map_publish(ref, art_map_off(pop, up));
+				break;
+			}
+
+			unsigned c = art_map_byte(key, n->depth);
+			uint64_t *slot = art_map_find_child(n, c);
+			if (slot != NULL && *slot != 0) {
+				ref = slot;
+				continue;
+			}
+
+			uint64_t leaf = art_map_new_leaf(pop, key, value);
+			if (n->n < art_map_capacity[n->type]) {
+				art_map_add(n, c, leaf, 1);
+			} else {
+				/* grow, the copy is a new object */
+				struct art_map_node *big =
+					art_map_copy(n, n->type + 1, -1);
+				art_map_add(big, c, leaf, 0);
+				art_map_publish(ref, art_map_off(pop, big));
+				art_map_retire(&op, cur);
+			}
+			break;
+		}
+
+		if (cur == 0) {
+			art_map_publish(ref, art_map_new_leaf(pop, key, value));
+		} else if (art_map_is_leaf(cur)) {
+			struct art_map_leaf *l = art_map_ptr(pop, cur);
+			uint64_t leaf = art_map_new_leaf(pop, key, value);
+
+			if (l->key == key) {
+				art_map_publish(ref, leaf);
+				art_map_retire(&op, cur);
+			} else {
+				d = art_map_diff_depth(key, l->key);
+				n = art_map_new_node(ART_NODE4, d, key);
+				art_map_add(n, art_map_byte(l->key, d), cur, 0);
+				art_map_add(n, art_map_byte(key, d), leaf, 0);
+				art_map_publish(ref, art_map_off(pop, n));
+			}
+		}
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_insert_new -- allocates a new object and inserts it into the tree
+ */
+int
+art_map_insert_new(PMEMobjpool *pop, TOID(struct art_map) map,
+		uint64_t key, size_t size, unsigned int type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid n = pmemobj_tx_alloc(size, type_num);
+		constructor(pop, pmemobj_direct(n), arg);
+		art_map_insert(pop, map, key, n);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_remove_child -- (internal) removes the child of the key byte
+ *	from the node, the slot points to the node
+ */
+static void
+art_map_remove_child(struct tree_map_op *op, uint64_t *ref,
+	struct art_map_node *n, unsigned c)
+{
+	static const unsigned shrink[MAX_ART_NODE] = {
+		1, ART_MAP_SHRINK16, ART_MAP_SHRINK48, ART_MAP_SHRINK256
+	};
+	unsigned cnt = n->n;
+
+	if (cnt - 1 <= shrink[n->type]) {
+		if (n->type == ART_NODE4) {
+			/* the only child left replaces the node */
+			uint8_t keys[256];
+			uint64_t children[256];
+			art_map_children(n, keys, children);
+			art_map_publish(ref,
+				children[keys[0] == c ? 1 : 0]);
+		} else {
+			struct art_map_node *small =
+				art_map_copy(n, n->type - 1, (int)c);
+			art_map_publish(ref, art_map_off(op->pop, small));
+		}
+
+		art_map_retire(op, art_map_off(op->pop, n));
+		return;
+	}
+
+	switch (n->type) {
+	case ART_NODE4:
+	case ART_NODE16: {
+		uint8_t *keys = n->type == ART_NODE4 ?
+			((struct art_map_node4 *)n)->keys :
+			((struct art_map_node16 *)n)->keys;
+		uint64_t *children = n->type == ART_NODE4 ?
+			((struct art_map_node4 *)n)->children :
+			((struct art_map_node16 *)n)->children;
+		unsigned i = (unsigned)art_map_search16(keys, c, cnt);
+		unsigned last = cnt - 1;
+
+		pmemobj_tx_add_range_direct(&n->n,
+			(size_t)((char *)&keys[i + 1] - (char *)&n->n));
+		pmemobj_tx_add_range_direct(&children[i], sizeof (children[i]));
+
+		/*
+		 * The last child takes the place of the removed one, its key
+		 * byte is found at the old place until the new one is set.
+		 */
+		__atomic_store_n(&children[i], children[last],
+			__ATOMIC_RELEASE);
+		__atomic_store_n(&keys[i], keys[last], __ATOMIC_RELEASE);
+		break;
+	}
+	case ART_NODE48: {
+		struct art_map_node48 *n48 = (struct art_map_node48 *)n;
+		unsigned i = n48->index[c] - 1;
+		unsigned last = cnt - 1;
+		unsigned c_last = (unsigned)((uint8_t *)memchr(n48->index,
+			(int)cnt, sizeof (n48->index)) - n48->index);
+		unsigned top = c > c_last ? c : c_last;
+
+		pmemobj_tx_add_range_direct(&n->n,
+			(size_t)((char *)&n48->index[top + 1] -
+			(char *)&n->n));
+		pmemobj_tx_add_range_direct(&n48->children[i],
+			sizeof (n48->children[i]));
+
+		__atomic_store_n(&n48->index[c], 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&n48->children[i], n48->children[last],
+			__ATOMIC_RELEASE);
+		if (c_last != c)
+			__atomic_store_n(&n48->index[c_last], (uint8_t)(i + 1),
+				__ATOMIC_RELEASE);
+		break;
+	}
+	case ART_NODE256: {
+		struct art_map_node256 *n256 = (struct art_map_node256 *)n;
+
+		pmemobj_tx_add_range_direct(&n->n, sizeof (n->n));
+		art_map_publish(&n256->children[c], 0);
+		break;
+	}
+	default:
+		abort();
+	}
+
+	__atomic_store_n(&n->n, (uint16_t)(cnt - 1), __ATOMIC_RELEASE);
+}
+
+/*
+ * art_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+art_map_remove(PMEMobjpool *pop, TOID(struct art_map) map, uint64_t key)
+{
+	struct art_map *m = D_RW(map);
+	struct tree_map_op op;
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+
+		uint64_t *ref = &m->root;
+		uint64_t *parent_ref = NULL;
+		struct art_map_node *parent = NULL;
+		unsigned c = 0;
+		uint64_t cur;
+
+		while ((cur = *ref) != 0 && !art_map_is_leaf(cur)) {
+			struct art_map_node *n = art_map_ptr(pop, cur);
+			if (!art_map_prefix_matches(n, key))
+				break;
+
+			c = art_map_byte(key, n->depth);
+			uint64_t *slot = art_map_find_child(n, c);
+			if (slot == NULL)
+				break;
+
+			parent_ref = ref;
+			parent = n;
+			ref = slot;
+		}
+
+		if (cur != 0 && art_map_is_leaf(cur)) {
+			struct art_map_leaf *l = art_map_ptr(pop, cur);
+
+			if (l->key == key) {
+				ret = l->value;
+
+				if (parent == NULL)
+					art_map_publish(ref, 0);
+				else
+					art_map_remove_child(&op, parent_ref,
+						parent, c);
+
+				art_map_retire(&op, cur);
+			}
+		}
+	} TX_ONABORT {
+		ret = OID_NULL;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_remove_free -- removes and frees an object from the tree
+ */
+int
+art_map_remove_free(PMEMobjpool *pop, TOID(struct art_map) map,
+		uint64_t key)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid val = art_map_remove(pop, map, key);
+		pmemobj_tx_free(val);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_find -- (internal) returns the leaf of the key, NULL if there is
+ *	none, must be called between tree_map_read_begin and tree_map_read_end
+ */
+static const struct art_map_leaf *
+art_map_find(PMEMobjpool *pop, const struct art_map *m, uint64_t key)
+{
+	const struct tree_map_seq *seq = tree_map_seq(m);
+	const struct art_map_leaf *l;
+	uint64_t cur;
+	uint64_t s;
+
+	do {
+		s = tree_map_seq_begin(seq);
+		cur = art_map_load(&m->root);
+		l = NULL;
+
+		while (cur != 0 && !tree_map_seq_changed(seq, s)) {
+			if (art_map_is_leaf(cur)) {
+				l = art_map_ptr(pop, cur);
+				if (l->key != key)
+					l = NULL;
+				break;
+			}
+
+			struct art_map_node *n = art_map_ptr(pop, cur);
+			if (!art_map_prefix_matches(n, key))
+				break;
+
+			unsigned c = art_map_byte(key, n->depth);
+			const uint64_t *slot = art_map_find_child(n, c);
+			cur = slot == NULL ? 0 : art_map_load(slot);
+		}
+	} while (tree_map_seq_changed(seq, s));
+
+	return l;
+}
+
+/*
+ * art_map_get -- searches for a value of the key
+ */
+PMEMoid
+art_map_get(PMEMobjpool *pop, TOID(struct art_map) map, uint64_t key)
+{
+	struct tree_map_reader *r = tree_map_read_begin();
+
+	const struct art_map_leaf *l = art_map_find(pop, D_RO(map), key);
+	PMEMoid ret = l == NULL ? OID_NULL : l->value;
+
+	tree_map_read_end(r);
+
+	return ret;
+}
+
+/*
+ * art_map_lookup -- searches if a key exists
+ */
+int
+art_map_lookup(PMEMobjpool *pop, TOID(struct art_map) map,
+		uint64_t key)
+{
+	struct tree_map_reader *r = tree_map_read_begin();
+
+	int ret = art_map_find(pop, D_RO(map), key) != NULL;
+
+	tree_map_read_end(r);
+
+	return ret;
+}
+
+/* state of a range traversal */
+struct art_map_range_arg {
+	PMEMobjpool *pop;
+	const struct tree_map_seq *seq;
+	uint64_t s; /* sequence counter value the offsets are checked with */
+	uint64_t lo; /* the smallest key not visited yet */
+	uint64_t hi;
+	int (*cb)(uint64_t key, PMEMoid value, void *arg);
+	void *arg;
+	int ret;
+	int restart;
+};
+
+/*
+ * art_map_range_subtree -- (internal) calls cb for the keys of the subtree
+ *	from [lo, hi], in key order, returns 1 when the traversal has to stop
+ */
+static int
+art_map_range_subtree(struct art_map_range_arg *ra, uint64_t off)
+{
+	/* the offset has been loaded before, check it's still the current */
+	if (tree_map_seq_changed(ra->seq, ra->s)) {
+		ra->restart = 1;
+		return 1;
+	}
+
+	if (art_map_is_leaf(off)) {
+		const struct art_map_leaf *l = art_map_ptr(ra->pop, off);
+		if (l->key < ra->lo || l->key > ra->hi)
+			return 0;
+
+		ra->ret = ra->cb(l->key, l->value, ra->arg);
+		if (ra->ret != 0 || l->key == ra->hi)
+			return 1;
+
+		/* a restarted traversal resumes after this key */
+		ra->lo = l->key + 1;
+		return 0;
+	}
+
+	struct art_map_node *n = art_map_ptr(ra->pop, off);
+	uint8_t keys[256];
+	uint64_t children[256];
+	unsigned cnt = art_map_children(n, keys, children);
+
+	unsigned shift = 56 - 8 * n->depth;
+	uint64_t base = n->depth == 0 ? 0 :
+		n->prefix & (~0ULL << (64 - 8 * n->depth));
+
+	for (unsigned i = 0; i < cnt; ++i) {
+		/* the range of keys under the child */
+		uint64_t first = base | ((uint64_t)keys[i] << shift);
+		uint64_t last = first | ((1ULL << shift) - 1);
+		if (last < ra->lo)
+			continue;
+		if (first > ra->hi)
+			break;
+
+		if (art_map_range_subtree(ra, children[i]))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * art_map_range -- calls cb, in key order, for every key in [lo, hi]
+ *
+ * The callback may modify the map. A traversal which runs into a change of
+ * the map starts again from the root with the keys not visited yet.
+ */
+int
+art_map_range(PMEMobjpool *pop, TOID(struct art_map) map,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (lo > hi)
+		return 0;
+
+	const struct art_map *m = D_RO(map);
+	struct art_map_range_arg ra = {pop, tree_map_seq(m), 0, lo, hi,
+		cb, arg, 0, 0};
+	struct tree_map_reader *r = tree_map_read_begin();
+
+	do {
+		ra.restart = 0;
+		ra.s = tree_map_seq_begin(ra.seq);
+		uint64_t root = art_map_load(&m->root);
+
+		/* the skipped branches have to be checked as well */
+		if ((root == 0 || !art_map_range_subtree(&ra, root)) &&
+				tree_map_seq_changed(ra.seq, ra.s))
+			ra.restart = 1;
+	} while (ra.restart);
+
+	tree_map_read_end(r);
+
+	return ra.ret;
+}
+
+/*
+ * art_map_foreach -- calls cb for every key-value pair in key order
+ */
+int
+art_map_foreach(PMEMobjpool *pop, TOID(struct art_map) map,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	return art_map_range(pop, map, 0, UINT64_MAX, cb, arg);
+}
+
+/*
+ * art_map_is_empty -- checks whether the tree map is empty
+ */
+int
+art_map_is_empty(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	const struct tree_map_seq *seq = tree_map_seq(D_RO(map));
+	uint64_t s;
+	int ret;
+
+	do {
+		s = tree_map_seq_begin(seq);
+		ret = art_map_load(&D_RO(map)->root) == 0;
+	} while (tree_map_seq_changed(seq, s));
+
+	return ret;
+}
+
+/*
+ * art_map_check -- check if given persistent object is a tree map
+ */
+int
+art_map_check(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	return TOID_IS_NULL(map) || !TOID_VALID(map);
+}
@@ -0,0 +1,753 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * bptree_map.c -- B+-tree implementation
+ *
+ * Every node keeps its keys in a sorted array separate from the child
+ * pointers or values, so searching a node reads only the two cache lines
+ * of keys. The unused tail of the array is filled with BPTREE_PAD, which
+ * never compares less than a searched key, so the search always scans the
+ * whole fixed-size array without branching on the number of keys. The scan
+ * compares two keys at a time when the CPU supports SSE4.2, which is checked
+ * at startup (BPTREE_NO_SSE42=1 forces the generic scan). Values
+ * are stored only in the leaves, which are linked in key order for scans.
+ *
+ * A node update snapshots one contiguous span, from the first shifted key up
+ * to the last shifted value or child pointer, instead of the whole node or
+ * of a separate range per array -- each snapshot range larger than a few
+ * words costs the undo log an allocation.
+ *
+ * Removal does not rebalance the tree: a leaf emptied by removals stays
+ * linked and is filled again by later inserts into its key range.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <nmmintrin.h>
+
+#include "bptree_map.h"
+
+#define	BPTREE_ORDER 16 /* max number of keys per node, can't be odd */
+#define	BPTREE_BULK_FILL 12 /* max number of keys per bulk loaded node */
+#define	BPTREE_PAD UINT64_MAX
+
+TOID_DECLARE(struct tree_map_node, BPTREE_MAP_TYPE_OFFSET + 1);
+TOID_DECLARE(struct tree_map_inner, BPTREE_MAP_TYPE_OFFSET + 2);
+TOID_DECLARE(struct tree_map_leaf, BPTREE_MAP_TYPE_OFFSET + 3);
+
+RPTR_DECLARE(struct tree_map_node);
+RPTR_DECLARE(struct tree_map_leaf);
+
+struct tree_map_node {
+	uint64_t keys[BPTREE_ORDER];
+	uint32_t n; /* number of keys */
+	uint32_t leaf;
+};
+
+struct tree_map_inner {
+	struct tree_map_node node;
+	/* slots[i] holds the keys from [keys[i - 1], keys[i]) */
+	RPTR(struct tree_map_node) slots[BPTREE_ORDER + 1];
+};
+
+struct tree_map_leaf {
+	struct tree_map_node node;
+	RPTR(struct tree_map_leaf) next;
+	PMEMoid values[BPTREE_ORDER];
+};
+
+struct bptree_map {
+	RPTR(struct tree_map_node) root;
+};
+
+#define	INNER(_n) ((struct tree_map_inner *)(_n))
+#define	LEAF(_n) ((struct tree_map_leaf *)(_n))
+
+/*
+ * count_less_generic -- (internal) returns the number of keys in the node
+ *	smaller than the given one
+ */
+static unsigned
+count_less_generic(const struct tree_map_node *node, uint64_t key)
+{
+	unsigned cnt = 0;
+	for (int i = 0; i < BPTREE_ORDER; ++i)
+		cnt += node->keys[i] < key;
+
+	return cnt;
+}
+
+/*
+ * count_less_sse42 -- (internal) returns the number of keys in the node
+ *	smaller than the given one, comparing two keys at a time
+ */
+__attribute__((target("sse4.2,popcnt")))
+static unsigned
+count_less_sse42(const struct tree_map_node *node, uint64_t key)
+{
+	unsigned cnt = 0;
+
+	/* SSE compares signed integers, so flip the sign bits first */
+	const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+	const __m128i k = _mm_xor_si128(_mm_set1_epi64x((int64_t)key), sign);
+
+	for (int i = 0; i < BPTREE_ORDER; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&node->keys[i]);
+		__m128i lt = _mm_cmpgt_epi64(k, _mm_xor_si128(v, sign));
+		cnt += (unsigned)__builtin_popcount(
+			_mm_movemask_pd(_mm_castsi128_pd(lt)));
+	}
+
+	return cnt;
+}
+
+static unsigned (*Func_count_less)(const struct tree_map_node *node,
+	uint64_t key) = count_less_generic;
+
+/*
+ * bptree_map_init -- (internal) selects the node search based on CPUID
+ */
+__attribute__((constructor))
+static void
+bptree_map_init(void)
+{
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("sse4.2") ||
+			!__builtin_cpu_supports("popcnt"))
+		return;
+
+	char *e = getenv("BPTREE_NO_SSE42");
+	if (e && strcmp(e, "1") == 0)
+		return;
+
+	Func_count_less = count_less_sse42;
+}
+
+/*
+ * bptree_map_count_less -- (internal) returns the number of keys in the
+ *	node smaller than the given one
+ */
+static inline unsigned
+bptree_map_count_less(const struct tree_map_node *node, uint64_t key)
+{
+	return Func_count_less(node, key);
+}
+
+/*
+ * bptree_map_child_index -- (internal) returns the index of the inner node
+ *	child which can contain the key
+ */
+static inline unsigned
+bptree_map_child_index(const struct tree_map_node *node, uint64_t key)
+{
+	if (key == BPTREE_PAD)
+		return node->n;
+
+	return bptree_map_count_less(node, key + 1);
+}
+
+/*
+ * bptree_map_find_leaf -- (internal) returns the leaf which can contain the key
+ */
+static struct tree_map_leaf *
+bptree_map_find_leaf(PMEMobjpool *pop, const struct bptree_map *map,
+	uint64_t key)
+{
+	struct tree_map_node *n = RPTR_RW(pop, map->root);
+	while (n != NULL && !n->leaf)
+		n = RPTR_RW(pop,
+			INNER(n)->slots[bptree_map_child_index(n, key)]);
+
+	return LEAF(n);
+}
+
+/*
+ * bptree_map_new -- allocates a new B+-tree instance
+ */
+int
+bptree_map_new(PMEMobjpool *pop, TOID(struct bptree_map) *map, void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(map, sizeof (*map));
+		*map = TX_ZNEW(struct bptree_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_new_node -- (internal) allocates a new, empty node
+ */
+static struct tree_map_node *
+bptree_map_new_node(int leaf)
+{
+	struct tree_map_node *node = leaf ?
+		&D_RW(TX_ZNEW(struct tree_map_leaf))->node :
+		&D_RW(TX_ZNEW(struct tree_map_inner))->node;
+
+	for (int i = 0; i < BPTREE_ORDER; ++i)
+		node->keys[i] = BPTREE_PAD;
+	node->leaf = (uint32_t)leaf;
+
+	return node;
+}
+
+/*
+ * bptree_map_clear_node -- (internal) frees the node and its children
+ */
+static void
+bptree_map_clear_node(PMEMobjpool *pop, struct tree_map_node *node)
+{
+	if (node == NULL)
+		return;
+
+	if (!node->leaf) {
+		for (unsigned i = 0; i <= node->n; ++i)
+			bptree_map_clear_node(pop,
+				RPTR_RW(pop, INNER(node)->slots[i]));
+	}
+
+	pmemobj_tx_free(pmemobj_oid(node));
+}
+
+/*
+ * bptree_map_clear -- removes all elements from the map
+ */
+int
+bptree_map_clear(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	int ret = 0;
+	TX_BEGIN(pop) {
+		bptree_map_clear_node(pop, RPTR_RW(pop, D_RO(map)->root));
+
+		TX_ADD_FIELD(map, root);
+		RPTR_ASSIGN_OID(D_RW(map)->root, OID_NULL);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_delete -- cleanups and frees B+-tree instance
+ */
+int
+bptree_map_delete(PMEMobjpool *pop, TOID(struct bptree_map) *map)
+{
+	int ret = 0;
+	TX_BEGIN(pop) {
+		bptree_map_clear(pop, *map);
+		pmemobj_tx_add_range_direct(map, sizeof (*map));
+		TX_FREE(*map);
+		*map = TOID_NULL(struct bptree_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_add_span -- (internal) snapshots the part of a node between
+ *	the two addresses
+ */
+static void
+bptree_map_add_span(const void *begin, const void *end)
+{
+	pmemobj_tx_add_range_direct(begin,
+		(size_t)((const char *)end - (const char *)begin));
+}
+
+/*
+ * bptree_map_leaf_insert_at -- (internal) inserts a pair at the position,
+ *	snapshotting only the shifted part of the leaf
+ */
+static void
+bptree_map_leaf_insert_at(struct tree_map_leaf *leaf, unsigned pos,
+	uint64_t key, PMEMoid value)
+{
+	struct tree_map_node *node = &leaf->node;
+	unsigned cnt = node->n - pos;
+
+	bptree_map_add_span(&node->keys[pos], &leaf->values[node->n + 1]);
+
+	memmove(&node->keys[pos + 1], &node->keys[pos],
+		cnt * sizeof (node->keys[0]));
+	memmove(&leaf->values[pos + 1], &leaf->values[pos],
+		cnt * sizeof (leaf->values[0]));
+
+	node->keys[pos] = key;
+	leaf->values[pos] = value;
+	node->n++;
+}
+
+/*
+ * bptree_map_inner_insert_at -- (internal) inserts a separator key at the
+ *	position along with the child on its right side
+ */
+static void
+bptree_map_inner_insert_at(PMEMobjpool *pop, struct tree_map_inner *inner,
+	unsigned pos, uint64_t key, struct tree_map_node *right)
+{
+	struct tree_map_node *node = &inner->node;
+	unsigned cnt = node->n - pos;
+
+	bptree_map_add_span(&node->keys[pos], &inner->slots[node->n + 2]);
+
+	memmove(&node->keys[pos + 1], &node->keys[pos],
+		cnt * sizeof (node->keys[0]));
+	memmove(&inner->slots[pos + 2], &inner->slots[pos + 1],
+		cnt * sizeof (inner->slots[0]));
+
+	node->keys[pos] = key;
+	RPTR_ASSIGN_DIRECT(pop, inner->slots[pos + 1], right);
+	node->n++;
+}
+
+/*
+ * bptree_map_split_child -- (internal) moves the upper half of a full child
+ *	to a new node and links it into the parent
+ */
+static void
+bptree_map_split_child(PMEMobjpool *pop, struct tree_map_inner *parent,
+	unsigned pos, struct tree_map_node *child)
+{
+	const unsigned half = BPTREE_ORDER / 2;
+	struct tree_map_node *right = bptree_map_new_node(child->leaf);
+	uint64_t sep;
+
+	assert(child->n == BPTREE_ORDER);
+
+	/* only the moved keys and the counter of the child change */
+	bptree_map_add_span(&child->keys[half], &child->n + 1);
+
+	if (child->leaf) {
+		struct tree_map_leaf *l = LEAF(child);
+		struct tree_map_leaf *r = LEAF(right);
+
+		memcpy(right->keys, &child->keys[half],
+			half * sizeof (child->keys[0]));
+		memcpy(r->values, &l->values[half],
+			half * sizeof (l->values[0]));
+		right->n = half;
+
+		r->next = l->next;
+		TX_ADD_FIELD_DIRECT(l, next);
+		RPTR_ASSIGN_DIRECT(pop, l->next, r);
+
+		sep = right->keys[0];
+	} else {
+		struct tree_map_inner *l = INNER(child);
+		struct tree_map_inner *r = INNER(right);
+
+		/* the middle key moves up to the parent */
+		sep = child->keys[half];
+		memcpy(right->keys, &child->keys[half + 1],
+			(half - 1) * sizeof (child->keys[0]));
+		memcpy(r->slots, &l->slots[half + 1],
+			half * sizeof (l->slots[0]));
+		right->n = half - 1;
+	}
+
+	for (unsigned i = half; i < BPTREE_ORDER; ++i)
+		child->keys[i] = BPTREE_PAD;
+	child->n = half;
+
+	bptree_map_inner_insert_at(pop, parent, pos, sep, right);
+}
+
+/*
+ * bptree_map_insert -- inserts a new key-value pair into the map, replacing
+ *	the value of an existing key
+ */
+int
+bptree_map_insert(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t key, PMEMoid value)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		struct bptree_map *m = D_RW(map);
+		struct tree_map_node *n = RPTR_RW(pop, m->root);
+
+		if (n == NULL) {
+			n = bptree_map_new_node(1);
+			TX_ADD_FIELD_DIRECT(m, root);
+			RPTR_ASSIGN_DIRECT(pop, m->root, n);
+		} else if (n->n == BPTREE_ORDER) {
+			/* the tree grows in height */
+			struct tree_map_node *up = bptree_map_new_node(0);
+			RPTR_ASSIGN_DIRECT(pop, INNER(up)->slots[0], n);
+			bptree_map_split_child(pop, INNER(up), 0, n);
+
+			TX_ADD_FIELD_DIRECT(m, root);
+			RPTR_ASSIGN_DIRECT(pop, m->root, up);
+			n = up;
+		}
+
+		/* split the full nodes on the way down */
+		while (!n->leaf) {
+			unsigned i = bptree_map_child_index(n, key);
+			struct tree_map_node *c =
+				RPTR_RW(pop, INNER(n)->slots[i]);
+
+			if (c->n == BPTREE_ORDER) {
+				bptree_map_split_child(pop, INNER(n), i, c);
+				if (key >= n->keys[i])
+					c = RPTR_RW(pop,
+						INNER(n)->slots[i + 1]);
+			}
+
+			n = c;
+		}
+
+		struct tree_map_leaf *leaf = LEAF(n);
+		unsigned pos = bptree_map_count_less(n, key);
+		if (pos < n->n && n->keys[pos] == key) {
+			TX_ADD_FIELD_DIRECT(leaf, values[pos]);
+			leaf->values[pos] = value;
+		} else {
+			bptree_map_leaf_insert_at(leaf, pos, key, value);
+		}
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_insert_new -- allocates a new object and inserts it into the tree
+ */
+int
+bptree_map_insert_new(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key, size_t size, unsigned int type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid n = pmemobj_tx_alloc(size, type_num);
+		constructor(pop, pmemobj_direct(n), arg);
+		bptree_map_insert(pop, map, key, n);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_bulk_spread -- (internal) returns the number of items which
+ *	go to the i-th of nparts parts when n items are spread evenly
+ */
+static size_t
+bptree_map_bulk_spread(size_t n, size_t nparts, size_t i)
+{
+	return n / nparts + (i < n % nparts);
+}
+
+/*
+ * bptree_map_bulk_load -- builds the tree from pairs sorted by the key
+ *
+ * The nodes are built bottom-up and filled up to BPTREE_BULK_FILL keys, which
+ * leaves room for later inserts without immediate splits. The map has to
+ * be empty.
+ */
+int
+bptree_map_bulk_load(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	const uint64_t *keys, const PMEMoid *values, size_t n)
+{
+	for (size_t i = 1; i < n; ++i) {
+		if (keys[i - 1] >= keys[i]) {
+			errno = EINVAL;
+			return 1;
+		}
+	}
+
+	if (!bptree_map_is_empty(pop, map)) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	if (n == 0)
+		return 0;
+
+	size_t cnt = (n + BPTREE_BULK_FILL - 1) / BPTREE_BULK_FILL;
+	struct tree_map_node **level = malloc(cnt * sizeof (*level));
+	uint64_t *lows = malloc(cnt * sizeof (*lows));
+	if (level == NULL || lows == NULL) {
+		free(level);
+		free(lows);
+		return 1;
+	}
+
+	int ret = 0;
+	TX_BEGIN(pop) {
+		/* the map may still hold leaves emptied by removals */
+		bptree_map_clear_node(pop, RPTR_RW(pop, D_RO(map)->root));
+
+		struct tree_map_leaf *prev = NULL;
+		size_t first = 0;
+		for (size_t l = 0; l < cnt; ++l) {
+			struct tree_map_node *node = bptree_map_new_node(1);
+			size_t nkeys = bptree_map_bulk_spread(n, cnt, l);
+
+			memcpy(node->keys, &keys[first],
+				nkeys * sizeof (keys[0]));
+			memcpy(LEAF(node)->values, &values[first],
+				nkeys * sizeof (values[0]));
+			node->n = (uint32_t)nkeys;
+
+			if (prev != NULL)
+				RPTR_ASSIGN_DIRECT(pop, prev->next,
+					LEAF(node));
+			prev = LEAF(node);
+
+			level[l] = node;
+			lows[l] = keys[first];
+			first += nkeys;
+		}
+
+		/* each inner node has one child more than keys */
+		while (cnt > 1) {
+			size_t nparents = (cnt + BPTREE_BULK_FILL) /
+				(BPTREE_BULK_FILL + 1);
+			size_t child = 0;
+
+			for (size_t p = 0; p < nparents; ++p) {
+				struct tree_map_node *node =
+					bptree_map_new_node(0);
+				size_t nchildren = bptree_map_bulk_spread(cnt,
+					nparents, p);
+				uint64_t low = lows[child];
+
+				for (size_t c = 0; c < nchildren; ++c) {
+					if (c != 0)
+						node->keys[c - 1] = lows[child];
+					RPTR_ASSIGN_DIRECT(pop,
+						INNER(node)->slots[c],
+						level[child]);
+					child++;
+				}
+				node->n = (uint32_t)(nchildren - 1);
+
+				level[p] = node;
+				lows[p] = low;
+			}
+
+			cnt = nparents;
+		}
+
+		TX_ADD_FIELD(map, root);
+		RPTR_ASSIGN_DIRECT(pop, D_RW(map)->root, level[0]);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	free(level);
+	free(lows);
+
+	return ret;
+}
+
+/*
+ * bptree_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+bptree_map_remove(PMEMobjpool *pop, TOID(struct bptree_map) map, uint64_t key)
+{
+	struct tree_map_leaf *leaf = bptree_map_find_leaf(pop, D_RO(map), key);
+	if (leaf == NULL)
+		return OID_NULL;
+
+	struct tree_map_node *node = &leaf->node;
+	unsigned pos = bptree_map_count_less(node, key);
+	if (pos == node->n || node->keys[pos] != key)
+		return OID_NULL;
+
+	PMEMoid ret = leaf->values[pos];
+	unsigned cnt = node->n - pos - 1;
+
+	TX_BEGIN(pop) {
+		bptree_map_add_span(&node->keys[pos],
+			&leaf->values[node->n]);
+
+		memmove(&node->keys[pos], &node->keys[pos + 1],
+			cnt * sizeof (node->keys[0]));
+		memmove(&leaf->values[pos], &leaf->values[pos + 1],
+			cnt * sizeof (leaf->values[0]));
+
+		node->n--;
+		node->keys[node->n] = BPTREE_PAD;
+	} TX_ONABORT {
+		ret = OID_NULL;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_remove_free -- removes and frees an object from the tree
+ */
+int
+bptree_map_remove_free(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid val = bptree_map_remove(pop, map, key);
+		pmemobj_tx_free(val);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_get -- searches for a value of the key
+ */
+PMEMoid
+bptree_map_get(PMEMobjpool *pop, TOID(struct bptree_map) map, uint64_t key)
+{
+	const struct tree_map_leaf *leaf =
+		bptree_map_find_leaf(pop, D_RO(map), key);
+	if (leaf == NULL)
+		return OID_NULL;
+
+	unsigned pos = bptree_map_count_less(&leaf->node, key);
+	if (pos == leaf->node.n || leaf->node.keys[pos] != key)
+		return OID_NULL;
+
+	return leaf->values[pos];
+}
+
+/*
+ * bptree_map_lookup -- searches if a key exists
+ */
+int
+bptree_map_lookup(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key)
+{
+	const struct tree_map_leaf *leaf =
+		bptree_map_find_leaf(pop, D_RO(map), key);
+	if (leaf == NULL)
+		return 0;
+
+	unsigned pos = bptree_map_count_less(&leaf->node, key);
+
+	return pos < leaf->node.n && leaf->node.keys[pos] == key;
+}
+
+/*
+ * bptree_map_range -- calls cb, in key order, for every key in [lo, hi]
+ */
+int
+bptree_map_range(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (lo > hi)
+		return 0;
+
+	const struct tree_map_leaf *leaf =
+		bptree_map_find_leaf(pop, D_RO(map), lo);
+	if (leaf == NULL)
+		return 0;
+
+	unsigned pos = bptree_map_count_less(&leaf->node, lo);
+	int ret;
+
+	/* follow the sibling links instead of going back up the tree */
+	while (leaf != NULL) {
+		for (; pos < leaf->node.n; ++pos) {
+			if (leaf->node.keys[pos] > hi)
+				return 0;
+
+			ret = cb(leaf->node.keys[pos], leaf->values[pos], arg);
+			if (ret != 0)
+				return ret;
+		}
+
+		leaf = RPTR_RO(pop, leaf->next);
+		pos = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * bptree_map_foreach -- calls cb for every key-value pair in key order
+ */
+int
+bptree_map_foreach(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	return bptree_map_range(pop, map, 0, UINT64_MAX, cb, arg);
+}
+
+/*
+ * bptree_map_is_empty -- checks whether the tree map is empty
+ */
+int
+bptree_map_is_empty(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	const struct tree_map_leaf *leaf =
+		bptree_map_find_leaf(pop, D_RO(map), 0);
+
+	for (; leaf != NULL; leaf = RPTR_RO(pop, leaf->next)) {
+		if (leaf->node.n != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * bptree_map_check -- check if given persistent object is a tree map
+ */
+int
+bptree_map_check(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	return TOID_IS_NULL(map) || !TOID_VALID(map);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * bptree_map.h -- TreeMap sorted collection implementation
+ */
+
+#ifndef	BPTREE_MAP_H
+#define	BPTREE_MAP_H
+
+#include <libpmemobj.h>
+
+#ifndef	BPTREE_MAP_TYPE_OFFSET
+#define	BPTREE_MAP_TYPE_OFFSET 1020
+#endif
+
+struct bptree_map;
+TOID_DECLARE(struct bptree_map, BPTREE_MAP_TYPE_OFFSET + 0);
+
+int bptree_map_check(PMEMobjpool *pop, TOID(struct bptree_map) map);
+int bptree_map_new(PMEMobjpool *pop, TOID(struct bptree_map) *map,
+	void *arg);
+int bptree_map_delete(PMEMobjpool *pop, TOID(struct bptree_map) *map);
+int bptree_map_insert(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t key, PMEMoid value);
+int bptree_map_insert_new(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key, size_t size, unsigned int type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg);
+int bptree_map_bulk_load(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	const uint64_t *keys, const PMEMoid *values, size_t n);
+PMEMoid bptree_map_remove(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key);
+int bptree_map_remove_free(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key);
+int bptree_map_clear(PMEMobjpool *pop, TOID(struct bptree_map) map);
+PMEMoid bptree_map_get(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key);
+int bptree_map_lookup(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key);
+int bptree_map_foreach(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+int bptree_map_range(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+int bptree_map_is_empty(PMEMobjpool *pop, TOID(struct bptree_map) map);
+
+#endif /* BPTREE_MAP_H */
@@ -32,6 +32,10 @@
 
 /*
  * btree_map.c -- textbook implementation of btree /w preemptive splitting
+ *
+ * The nodes reference each other with 8-byte pool-relative pointers, which
+ * keeps the node small and lets the tree be walked without the pool lookup
+ * of pmemobj_direct().
  */
 
 #include <assert.h>
@@ -41,6 +45,8 @@
 
 TOID_DECLARE(struct tree_map_node, BTREE_MAP_TYPE_OFFSET + 1);
 
+RPTR_DECLARE(struct tree_map_node);
+
 #define	BTREE_ORDER 8 /* can't be odd */
 #define	BTREE_MIN ((BTREE_ORDER / 2) - 1) /* min number of keys per node */
 
@@ -55,11 +61,11 @@ struct tree_map_node_item {
 struct tree_map_node {
 	int n; /* number of occupied slots */
 	struct tree_map_node_item items[BTREE_ORDER - 1];
-	TOID(struct tree_map_node) slots[BTREE_ORDER];
+	RPTR(struct tree_map_node) slots[BTREE_ORDER];
 };
 
 struct btree_map {
-	TOID(struct tree_map_node) root;
+	RPTR(struct tree_map_node) root;
 };
 
 /*
@@ -80,17 +86,37 @@ btree_map_new(PMEMobjpool *pop, TOID(struct btree_map) *map, void *arg)
 	return ret;
 }
 
+/*
+ * btree_map_new_node -- (internal) allocates a new, empty node
+ */
+static struct tree_map_node *
+btree_map_new_node(void)
+{
+	return D_RW(TX_ZNEW(struct tree_map_node));
+}
+
+/*
+ * btree_map_free_node -- (internal) frees a node
+ */
+static void
+btree_map_free_node(struct tree_map_node *node)
+{
+	pmemobj_tx_free(pmemobj_oid(node));
+}
+
 /*
  * btree_map_clear_node -- (internal) removes all elements from the node
  */
 static void
-btree_map_clear_node(TOID(struct tree_map_node) node)
+btree_map_clear_node(PMEMobjpool *pop, struct tree_map_node *node)
 {
-	for (int i = 0; i < D_RO(node)->n; ++i) {
-		btree_map_clear_node(D_RO(node)->slots[i]);
-	}
+	if (node == NULL)
+		return;
+
+	for (int i = 0; i <= node->n; ++i)
+		btree_map_clear_node(pop, RPTR_RW(pop, node->slots[i]));
 
-	TX_FREE(node);
+	btree_map_free_node(node);
 }
 
 
@@ -102,7 +128,10 @@ btree_map_clear(PMEMobjpool *pop, TOID(struct btree_map) map)
 {
 	int ret = 0;
 	TX_BEGIN(pop) {
-		btree_map_clear_node(D_RO(map)->root);
+		btree_map_clear_node(pop, RPTR_RW(pop, D_RO(map)->root));
+
+		TX_ADD(map);
+		RPTR_ASSIGN_OID(D_RW(map)->root, OID_NULL);
 	} TX_ONABORT {
 		ret = 1;
 	} TX_END
@@ -134,72 +163,75 @@ btree_map_delete(PMEMobjpool *pop, TOID(struct btree_map) *map)
  * btree_map_insert_item_at -- (internal) inserts an item at position
  */
 static void
-btree_map_insert_item_at(TOID(struct tree_map_node) node, int pos,
+btree_map_insert_item_at(struct tree_map_node *node, int pos,
 	struct tree_map_node_item item)
 {
-	D_RW(node)->items[pos] = item;
-	D_RW(node)->n += 1;
+	node->items[pos] = item;
+	node->n += 1;
 }
 
 /*
  * btree_map_insert_empty -- (internal) inserts an item into an empty node
  */
 static void
-btree_map_insert_empty(TOID(struct btree_map) map,
+btree_map_insert_empty(PMEMobjpool *pop, struct btree_map *map,
 	struct tree_map_node_item item)
 {
-	TX_ADD_FIELD(map, root);
-	D_RW(map)->root = TX_ZNEW(struct tree_map_node);
+	struct tree_map_node *root = btree_map_new_node();
+
+	TX_ADD_FIELD_DIRECT(map, root);
+	RPTR_ASSIGN_DIRECT(pop, map->root, root);
 
-	btree_map_insert_item_at(D_RO(map)->root, 0, item);
+	btree_map_insert_item_at(root, 0, item);
 }
 
 /*
  * btree_map_insert_node -- (internal) inserts and makes space for new node
  */
 static void
-btree_map_insert_node(TOID(struct tree_map_node) node, int p,
+btree_map_insert_node(PMEMobjpool *pop, struct tree_map_node *node, int p,
 	struct tree_map_node_item item,
-	TOID(struct tree_map_node) left, TOID(struct tree_map_node) right)
+	struct tree_map_node *left, struct tree_map_node *right)
 {
-	TX_ADD(node);
-	if (D_RO(node)->items[p].key != 0) { /* move all existing data */
-		memmove(&D_RW(node)->items[p + 1], &D_RW(node)->items[p],
+	TX_ADD_DIRECT(node);
+	if (node->items[p].key != 0) { /* move all existing data */
+		memmove(&node->items[p + 1], &node->items[p],
 		sizeof (struct tree_map_node_item) * ((BTREE_ORDER - 2 - p)));
 
-		memmove(&D_RW(node)->slots[p + 1], &D_RW(node)->slots[p],
-		sizeof (TOID(struct tree_map_node)) * ((BTREE_ORDER - 1 - p)));
+		memmove(&node->slots[p + 1], &node->slots[p],
+		sizeof (node->slots[0]) * ((BTREE_ORDER - 1 - p)));
 	}
-	D_RW(node)->slots[p] = left;
-	D_RW(node)->slots[p + 1] = right;
+	RPTR_ASSIGN_DIRECT(pop, node->slots[p], left);
+	RPTR_ASSIGN_DIRECT(pop, node->slots[p + 1], right);
 	btree_map_insert_item_at(node, p, item);
 }
 
 /*
  * btree_map_create_split_node -- (internal) splits a node into two
  */
-static TOID(struct tree_map_node)
-btree_map_create_split_node(TOID(struct tree_map_node) node,
+static struct tree_map_node *
+btree_map_create_split_node(struct tree_map_node *node,
 	struct tree_map_node_item *m)
 {
-	TOID(struct tree_map_node) right = TX_ZNEW(struct tree_map_node);
+	struct tree_map_node *right = btree_map_new_node();
+
+	TX_ADD_DIRECT(node);
 
 	int c = (BTREE_ORDER / 2);
-	*m = D_RO(node)->items[c - 1]; /* select median item */
-	D_RW(node)->items[c - 1] = EMPTY_ITEM;
+	*m = node->items[c - 1]; /* select median item */
+	node->items[c - 1] = EMPTY_ITEM;
 
 	/* move everything right side of median to the new node */
 	for (int i = c; i < BTREE_ORDER; ++i) {
 		if (i != BTREE_ORDER - 1) {
-			D_RW(right)->items[D_RW(right)->n++] =
-				D_RO(node)->items[i];
+			right->items[right->n++] = node->items[i];
 
-			D_RW(node)->items[i] = EMPTY_ITEM;
+			node->items[i] = EMPTY_ITEM;
 		}
-		D_RW(right)->slots[i - c] = D_RO(node)->slots[i];
-		D_RW(node)->slots[i] = TOID_NULL(struct tree_map_node);
+		right->slots[i - c] = node->slots[i];
+		RPTR_ASSIGN_OID(node->slots[i], OID_NULL);
 	}
-	D_RW(node)->n = c - 1;
+	node->n = c - 1;
 
 	return right;
 }
@@ -207,30 +239,29 @@ btree_map_create_split_node(TOID(struct tree_map_node) node,
 /*
  * btree_map_find_dest_node -- (internal) finds a place to insert the new key at
  */
-static TOID(struct tree_map_node)
-btree_map_find_dest_node(TOID(struct btree_map) map,
-	TOID(struct tree_map_node) n, TOID(struct tree_map_node) parent,
+static struct tree_map_node *
+btree_map_find_dest_node(PMEMobjpool *pop, struct btree_map *map,
+	struct tree_map_node *n, struct tree_map_node *parent,
 	uint64_t key, int *p)
 {
-	if (D_RO(n)->n == BTREE_ORDER - 1) { /* node is full, perform a split */
+	if (n->n == BTREE_ORDER - 1) { /* node is full, perform a split */
 		struct tree_map_node_item m;
-		TOID(struct tree_map_node) right =
+		struct tree_map_node *right =
 			btree_map_create_split_node(n, &m);
 
-		if (!TOID_IS_NULL(parent)) {
-			btree_map_insert_node(parent, *p, m, n, right);
+		if (parent != NULL) {
+			btree_map_insert_node(pop, parent, *p, m, n, right);
 			if (key > m.key) /* select node to continue search */
 				n = right;
 		} else { /* replacing root node, the tree grows in height */
-			TOID(struct tree_map_node) up =
-				TX_ZNEW(struct tree_map_node);
-			D_RW(up)->n = 1;
-			D_RW(up)->items[0] = m;
-			D_RW(up)->slots[0] = n;
-			D_RW(up)->slots[1] = right;
-
-			TX_ADD_FIELD(map, root);
-			D_RW(map)->root = up;
+			struct tree_map_node *up = btree_map_new_node();
+			up->n = 1;
+			up->items[0] = m;
+			RPTR_ASSIGN_DIRECT(pop, up->slots[0], n);
+			RPTR_ASSIGN_DIRECT(pop, up->slots[1], right);
+
+			TX_ADD_FIELD_DIRECT(map, root);
+			RPTR_ASSIGN_DIRECT(pop, map->root, up);
 			n = up;
 		}
 	}
@@ -243,10 +274,10 @@ btree_map_find_dest_node(TOID(struct btree_map) map,
 		 * The key either fits somewhere in the middle or at the
 		 * right edge of the node.
 		 */
-		if (D_RO(n)->n == i || D_RO(n)->items[i].key > key) {
-			return TOID_IS_NULL(D_RO(n)->slots[i]) ? n :
-				btree_map_find_dest_node(map,
-					D_RO(n)->slots[i], n, key, p);
+		if (n->n == i || n->items[i].key > key) {
+			return RPTR_IS_NULL(n->slots[i]) ? n :
+				btree_map_find_dest_node(pop, map,
+					RPTR_RW(pop, n->slots[i]), n, key, p);
 		}
 	}
 
@@ -254,19 +285,20 @@ btree_map_find_dest_node(TOID(struct btree_map) map,
 	 * The key is bigger than the last node element, go one level deeper
 	 * in the rightmost child.
 	 */
-	return btree_map_find_dest_node(map, D_RO(n)->slots[i], n, key, p);
+	return btree_map_find_dest_node(pop, map, RPTR_RW(pop, n->slots[i]),
+		n, key, p);
 }
 
 /*
  * btree_map_insert_item -- (internal) inserts and makes space for new item
  */
 static void
-btree_map_insert_item(TOID(struct tree_map_node) node, int p,
+btree_map_insert_item(struct tree_map_node *node, int p,
 	struct tree_map_node_item item)
 {
-	TX_ADD(node);
-	if (D_RO(node)->items[p].key != 0) {
-		memmove(&D_RW(node)->items[p + 1], &D_RW(node)->items[p],
+	TX_ADD_DIRECT(node);
+	if (node->items[p].key != 0) {
+		memmove(&node->items[p + 1], &node->items[p],
 		sizeof (struct tree_map_node_item) * ((BTREE_ORDER - 2 - p)));
 	}
 	btree_map_insert_item_at(node, p, item);
@@ -278,7 +310,8 @@ btree_map_insert_item(TOID(struct tree_map_node) node, int p,
 int
 btree_map_is_empty(PMEMobjpool *pop, TOID(struct btree_map) map)
 {
-	return TOID_IS_NULL(D_RO(map)->root) || D_RO(D_RO(map)->root)->n == 0;
+	return RPTR_IS_NULL(D_RO(map)->root) ||
+		RPTR_RO(pop, D_RO(map)->root)->n == 0;
 }
 
 /*
@@ -291,14 +324,13 @@ btree_map_insert(PMEMobjpool *pop, TOID(struct btree_map) map,
 	struct tree_map_node_item item = {key, value};
 	TX_BEGIN(pop) {
 		if (btree_map_is_empty(pop, map)) {
-			btree_map_insert_empty(map, item);
+			btree_map_insert_empty(pop, D_RW(map), item);
 		} else {
 			int p; /* position at the dest node to insert */
-			TOID(struct tree_map_node) parent =
-				TOID_NULL(struct tree_map_node);
-			TOID(struct tree_map_node) dest =
-				btree_map_find_dest_node(map, D_RW(map)->root,
-					parent, key, &p);
+			struct tree_map_node *dest =
+				btree_map_find_dest_node(pop, D_RW(map),
+					RPTR_RW(pop, D_RO(map)->root),
+					NULL, key, &p);
 
 			btree_map_insert_item(dest, p, item);
 		}
@@ -311,99 +343,99 @@ btree_map_insert(PMEMobjpool *pop, TOID(struct btree_map) map,
  * btree_map_rotate_right -- (internal) takes one element from right sibling
  */
 static void
-btree_map_rotate_right(TOID(struct tree_map_node) rsb,
-	TOID(struct tree_map_node) node,
-	TOID(struct tree_map_node) parent, int p)
+btree_map_rotate_right(struct tree_map_node *rsb,
+	struct tree_map_node *node,
+	struct tree_map_node *parent, int p)
 {
 	/* move the separator from parent to the deficient node */
-	struct tree_map_node_item sep = D_RO(parent)->items[p];
-	btree_map_insert_item(node, D_RO(node)->n, sep);
+	struct tree_map_node_item sep = parent->items[p];
+	btree_map_insert_item(node, node->n, sep);
 
 	/* the first element of the right sibling is the new separator */
-	TX_ADD_FIELD(parent, items[p]);
-	D_RW(parent)->items[p] = D_RO(rsb)->items[0];
+	TX_ADD_FIELD_DIRECT(parent, items[p]);
+	parent->items[p] = rsb->items[0];
 
 	/* the nodes are not necessarily leafs, so copy also the slot */
-	TX_ADD_FIELD(node, slots[D_RO(node)->n]);
-	D_RW(node)->slots[D_RO(node)->n] = D_RO(rsb)->slots[0];
+	TX_ADD_FIELD_DIRECT(node, slots[node->n]);
+	node->slots[node->n] = rsb->slots[0];
 
-	TX_ADD(rsb);
-	D_RW(rsb)->n -= 1; /* it loses one element, but still > min */
+	TX_ADD_DIRECT(rsb);
+	rsb->n -= 1; /* it loses one element, but still > min */
 
 	/* move all existing elements back by one array slot */
-	memmove(D_RW(rsb)->items, D_RO(rsb)->items + 1,
-		sizeof (struct tree_map_node_item) * (D_RO(rsb)->n));
-	memmove(D_RW(rsb)->slots, D_RO(rsb)->slots + 1,
-		sizeof (TOID(struct tree_map_node)) * (D_RO(rsb)->n + 1));
+	memmove(rsb->items, rsb->items + 1,
+		sizeof (struct tree_map_node_item) * (rsb->n));
+	memmove(rsb->slots, rsb->slots + 1,
+		sizeof (rsb->slots[0]) * (rsb->n + 1));
 }
 
 /*
  * btree_map_rotate_left -- (internal) takes one element from left sibling
  */
 static void
-btree_map_rotate_left(TOID(struct tree_map_node) lsb,
-	TOID(struct tree_map_node) node,
-	TOID(struct tree_map_node) parent, int p)
+btree_map_rotate_left(struct tree_map_node *lsb,
+	struct tree_map_node *node,
+	struct tree_map_node *parent, int p)
 {
 	/* move the separator from parent to the deficient node */
-	struct tree_map_node_item sep = D_RO(parent)->items[p - 1];
+	struct tree_map_node_item sep = parent->items[p - 1];
 	btree_map_insert_item(node, 0, sep);
 
 	/* the last element of the left sibling is the new separator */
-	TX_ADD_FIELD(parent, items[p - 1]);
-	D_RW(parent)->items[p - 1] = D_RO(lsb)->items[D_RO(lsb)->n - 1];
+	TX_ADD_FIELD_DIRECT(parent, items[p - 1]);
+	parent->items[p - 1] = lsb->items[lsb->n - 1];
 
-	TX_ADD(node);
+	TX_ADD_DIRECT(node);
 	/* rotate the node children */
-	memmove(D_RW(node)->slots + 1, D_RO(node)->slots,
-		sizeof (TOID(struct tree_map_node)) * (D_RO(node)->n));
+	memmove(node->slots + 1, node->slots,
+		sizeof (node->slots[0]) * (node->n));
 
 	/* the nodes are not necessarily leafs, so copy also the slot */
-	D_RW(node)->slots[0] = D_RO(lsb)->slots[D_RO(lsb)->n];
+	node->slots[0] = lsb->slots[lsb->n];
 
-	TX_ADD_FIELD(lsb, n);
-	D_RW(lsb)->n -= 1; /* it loses one element, but still > min */
+	TX_ADD_FIELD_DIRECT(lsb, n);
+	lsb->n -= 1; /* it loses one element, but still > min */
 }
 
 /*
  * btree_map_merge -- (internal) merges node and right sibling
  */
 static void
-btree_map_merge(TOID(struct btree_map) map, TOID(struct tree_map_node) rn,
-	TOID(struct tree_map_node) node,
-	TOID(struct tree_map_node) parent, int p)
+btree_map_merge(PMEMobjpool *pop, struct btree_map *map,
+	struct tree_map_node *rn, struct tree_map_node *node,
+	struct tree_map_node *parent, int p)
 {
-	struct tree_map_node_item sep = D_RO(parent)->items[p];
+	struct tree_map_node_item sep = parent->items[p];
 
-	TX_ADD(node);
+	TX_ADD_DIRECT(node);
 	/* add separator to the deficient node */
-	D_RW(node)->items[D_RW(node)->n++] = sep;
+	node->items[node->n++] = sep;
 
 	/* copy right sibling data to node */
-	memcpy(&D_RW(node)->items[D_RO(node)->n], D_RO(rn)->items,
-	sizeof (struct tree_map_node_item) * D_RO(rn)->n);
-	memcpy(&D_RW(node)->slots[D_RO(node)->n], D_RO(rn)->slots,
-	sizeof (TOID(struct tree_map_node)) * (D_RO(rn)->n + 1));
+	memcpy(&node->items[node->n], rn->items,
+	sizeof (struct tree_map_node_item) * rn->n);
+	memcpy(&node->slots[node->n], rn->slots,
+	sizeof (rn->slots[0]) * (rn->n + 1));
 
-	D_RW(node)->n += D_RO(rn)->n;
+	node->n += rn->n;
 
-	TX_FREE(rn); /* right node is now empty */
+	btree_map_free_node(rn); /* right node is now empty */
 
-	TX_ADD(parent);
-	D_RW(parent)->n -= 1;
+	TX_ADD_DIRECT(parent);
+	parent->n -= 1;
 
 	/* move everything to the right of the separator by one array slot */
-	memmove(D_RW(parent)->items + p, D_RW(parent)->items + p + 1,
-	sizeof (struct tree_map_node_item) * (D_RO(parent)->n - p));
+	memmove(parent->items + p, parent->items + p + 1,
+	sizeof (struct tree_map_node_item) * (parent->n - p));
 
-	memmove(D_RW(parent)->slots + p + 1, D_RW(parent)->slots + p + 2,
-	sizeof (TOID(struct tree_map_node)) * (D_RO(parent)->n - p + 1));
+	memmove(parent->slots + p + 1, parent->slots + p + 2,
+	sizeof (parent->slots[0]) * (parent->n - p + 1));
 
 	/* if the parent is empty then the tree shrinks in height */
-	if (D_RO(parent)->n == 0 && TOID_EQUALS(parent, D_RO(map)->root)) {
-		TX_ADD(map);
-		TX_FREE(D_RO(map)->root);
-		D_RW(map)->root = node;
+	if (parent->n == 0 && RPTR_RO(pop, map->root) == parent) {
+		TX_ADD_DIRECT(map);
+		btree_map_free_node(parent);
+		RPTR_ASSIGN_DIRECT(pop, map->root, node);
 	}
 }
 
@@ -411,109 +443,109 @@ btree_map_merge(TOID(struct btree_map) map, TOID(struct tree_map_node) rn,
  * btree_map_rebalance -- (internal) performs tree rebalance
  */
 static void
-btree_map_rebalance(TOID(struct btree_map) map, TOID(struct tree_map_node) node,
-	TOID(struct tree_map_node) parent, int p)
+btree_map_rebalance(PMEMobjpool *pop, struct btree_map *map,
+	struct tree_map_node *node, struct tree_map_node *parent, int p)
 {
-	TOID(struct tree_map_node) rsb = p >= D_RO(parent)->n ?
-		TOID_NULL(struct tree_map_node) : D_RO(parent)->slots[p + 1];
-	TOID(struct tree_map_node) lsb = p == 0 ?
-		TOID_NULL(struct tree_map_node) : D_RO(parent)->slots[p - 1];
+	struct tree_map_node *rsb = p >= parent->n ?
+		NULL : RPTR_RW(pop, parent->slots[p + 1]);
+	struct tree_map_node *lsb = p == 0 ?
+		NULL : RPTR_RW(pop, parent->slots[p - 1]);
 
-	if (!TOID_IS_NULL(rsb) && D_RO(rsb)->n > BTREE_MIN)
+	if (rsb != NULL && rsb->n > BTREE_MIN)
 		btree_map_rotate_right(rsb, node, parent, p);
-	else if (!TOID_IS_NULL(lsb) && D_RO(lsb)->n > BTREE_MIN)
+	else if (lsb != NULL && lsb->n > BTREE_MIN)
 		btree_map_rotate_left(lsb, node, parent, p);
-	else if (TOID_IS_NULL(rsb)) /* always merge with rightmost node */
-		btree_map_merge(map, node, lsb, parent, p - 1);
+	else if (rsb == NULL) /* always merge with rightmost node */
+		btree_map_merge(pop, map, node, lsb, parent, p - 1);
 	else
-		btree_map_merge(map, rsb, node, parent, p);
+		btree_map_merge(pop, map, rsb, node, parent, p);
 }
 
 /*
  * btree_map_get_leftmost_leaf -- (internal) searches for the successor
  */
-static TOID(struct tree_map_node)
-btree_map_get_leftmost_leaf(TOID(struct btree_map) map,
-	TOID(struct tree_map_node) n, TOID(struct tree_map_node) *p)
+static struct tree_map_node *
+btree_map_get_leftmost_leaf(PMEMobjpool *pop,
+	struct tree_map_node *n, struct tree_map_node **p)
 {
-	if (TOID_IS_NULL(D_RO(n)->slots[0]))
+	if (RPTR_IS_NULL(n->slots[0]))
 		return n;
 
 	*p = n;
 
-	return btree_map_get_leftmost_leaf(map, D_RO(n)->slots[0], p);
+	return btree_map_get_leftmost_leaf(pop, RPTR_RW(pop, n->slots[0]), p);
 }
 
 /*
  * btree_map_remove_from_node -- (internal) removes element from node
  */
 static void
-btree_map_remove_from_node(TOID(struct btree_map) map,
-	TOID(struct tree_map_node) node,
-	TOID(struct tree_map_node) parent, int p)
-{
-	if (TOID_IS_NULL(D_RO(node)->slots[0])) { /* leaf */
-		TX_ADD(node);
-		if (D_RO(node)->n == 1 || p == BTREE_ORDER - 2)
-			D_RW(node)->items[p] = EMPTY_ITEM;
-		else if (D_RO(node)->n != 1) {
-			memmove(&D_RW(node)->items[p],
-				&D_RW(node)->items[p + 1],
+btree_map_remove_from_node(PMEMobjpool *pop, struct btree_map *map,
+	struct tree_map_node *node,
+	struct tree_map_node *parent, int p)
+{
+	if (RPTR_IS_NULL(node->slots[0])) { /* leaf */
+		TX_ADD_DIRECT(node);
+		if (node->n == 1 || p == BTREE_ORDER - 2)
+			node->items[p] = EMPTY_ITEM;
+		else if (node->n != 1) {
+			memmove(&node->items[p],
+				&node->items[p + 1],
 				sizeof (struct tree_map_node_item) *
-				(D_RO(node)->n - p));
+				(node->n - p));
 		}
 
-		D_RW(node)->n -= 1;
+		node->n -= 1;
 		return;
 	}
 
 	/* can't delete from non-leaf nodes, remove successor */
-	TOID(struct tree_map_node) rchild = D_RW(node)->slots[p + 1];
-	TOID(struct tree_map_node) lp = node;
-	TOID(struct tree_map_node) lm =
-		btree_map_get_leftmost_leaf(map, rchild, &lp);
+	struct tree_map_node *rchild = RPTR_RW(pop, node->slots[p + 1]);
+	struct tree_map_node *lp = node;
+	struct tree_map_node *lm =
+		btree_map_get_leftmost_leaf(pop, rchild, &lp);
 
-	TX_ADD_FIELD(node, items[p]);
-	D_RW(node)->items[p] = D_RO(lm)->items[0];
+	TX_ADD_FIELD_DIRECT(node, items[p]);
+	node->items[p] = lm->items[0];
 
-	btree_map_remove_from_node(map, lm, lp, 0);
+	btree_map_remove_from_node(pop, map, lm, lp, 0);
 
-	if (D_RO(lm)->n < BTREE_MIN) /* right child can be deficient now */
-		btree_map_rebalance(map, lm, lp,
-			TOID_EQUALS(lp, node) ? p + 1 : 0);
+	if (lm->n < BTREE_MIN) /* right child can be deficient now */
+		btree_map_rebalance(pop, map, lm, lp,
+			lp == node ? p + 1 : 0);
 }
 
 #define	NODE_CONTAINS_ITEM(_n, _i, _k)\
-(_i != D_RO(_n)->n && D_RO(_n)->items[_i].key == _k)
+(_i != (_n)->n && (_n)->items[_i].key == _k)
 
 #define	NODE_CHILD_CAN_CONTAIN_ITEM(_n, _i, _k)\
-(_i == D_RO(_n)->n || D_RO(_n)->items[_i].key > _k) &&\
-!TOID_IS_NULL(D_RO(_n)->slots[_i])
+(_i == (_n)->n || (_n)->items[_i].key > _k) &&\
+!RPTR_IS_NULL((_n)->slots[_i])
 
 /*
  * btree_map_remove_item -- (internal) removes item from node
  */
 static PMEMoid
-btree_map_remove_item(TOID(struct btree_map) map,
-	TOID(struct tree_map_node) node, TOID(struct tree_map_node) parent,
+btree_map_remove_item(PMEMobjpool *pop, struct btree_map *map,
+	struct tree_map_node *node, struct tree_map_node *parent,
 	uint64_t key, int p)
 {
 	PMEMoid ret = OID_NULL;
-	for (int i = 0; i <= D_RO(node)->n; ++i) {
+	for (int i = 0; i <= node->n; ++i) {
 		if (NODE_CONTAINS_ITEM(node, i, key)) {
-			ret = D_RO(node)->items[i].value;
-			btree_map_remove_from_node(map, node, parent, i);
+			ret = node->items[i].value;
+			btree_map_remove_from_node(pop, map, node, parent, i);
 			break;
 		} else if (NODE_CHILD_CAN_CONTAIN_ITEM(node, i, key)) {
-			ret = btree_map_remove_item(map, D_RO(node)->slots[i],
-				node, key, i);
+			ret = btree_map_remove_item(pop, map,
+				RPTR_RW(pop, node->slots[i]), node, key, i);
 			break;
 		}
 	}
 
 	/* check for deficient nodes walking up */
-	if (!TOID_IS_NULL(parent) && D_RO(node)->n < BTREE_MIN)
-		btree_map_rebalance(map, node, parent, p);
+	if (parent != NULL && node->n < BTREE_MIN)
+		btree_map_rebalance(pop, map, node, parent, p);
 
 	return ret;
 }
@@ -525,9 +557,12 @@ PMEMoid
 btree_map_remove(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
 {
 	PMEMoid ret = OID_NULL;
+	if (RPTR_IS_NULL(D_RO(map)->root))
+		return ret;
+
 	TX_BEGIN(pop) {
-		ret = btree_map_remove_item(map, D_RW(map)->root,
-				TOID_NULL(struct tree_map_node), key, 0);
+		ret = btree_map_remove_item(pop, D_RW(map),
+				RPTR_RW(pop, D_RO(map)->root), NULL, key, 0);
 	} TX_END
 
 	return ret;
@@ -537,13 +572,15 @@ btree_map_remove(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
  * btree_map_get_in_node -- (internal) searches for a value in the node
  */
 static PMEMoid
-btree_map_get_in_node(TOID(struct tree_map_node) node, uint64_t key)
+btree_map_get_in_node(PMEMobjpool *pop, const struct tree_map_node *node,
+	uint64_t key)
 {
-	for (int i = 0; i <= D_RO(node)->n; ++i) {
+	for (int i = 0; i <= node->n; ++i) {
 		if (NODE_CONTAINS_ITEM(node, i, key))
-			return D_RO(node)->items[i].value;
+			return node->items[i].value;
 		else if (NODE_CHILD_CAN_CONTAIN_ITEM(node, i, key))
-			return btree_map_get_in_node(D_RO(node)->slots[i], key);
+			return btree_map_get_in_node(pop,
+					RPTR_RO(pop, node->slots[i]), key);
 	}
 
 	return OID_NULL;
@@ -555,23 +592,24 @@ btree_map_get_in_node(TOID(struct tree_map_node) node, uint64_t key)
 PMEMoid
 btree_map_get(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
 {
-	if (TOID_IS_NULL(D_RO(map)->root))
+	if (RPTR_IS_NULL(D_RO(map)->root))
 		return OID_NULL;
-	return btree_map_get_in_node(D_RO(map)->root, key);
+	return btree_map_get_in_node(pop, RPTR_RO(pop, D_RO(map)->root), key);
 }
 
 /*
  * btree_map_lookup_in_node -- (internal) searches for key if exists
  */
 static int
-btree_map_lookup_in_node(TOID(struct tree_map_node) node, uint64_t key)
+btree_map_lookup_in_node(PMEMobjpool *pop, const struct tree_map_node *node,
+	uint64_t key)
 {
-	for (int i = 0; i <= D_RO(node)->n; ++i) {
+	for (int i = 0; i <= node->n; ++i) {
 		if (NODE_CONTAINS_ITEM(node, i, key))
 			return 1;
 		else if (NODE_CHILD_CAN_CONTAIN_ITEM(node, i, key))
-			return btree_map_lookup_in_node(
-					D_RO(node)->slots[i], key);
+			return btree_map_lookup_in_node(pop,
+					RPTR_RO(pop, node->slots[i]), key);
 	}
 
 	return 0;
@@ -583,27 +621,29 @@ btree_map_lookup_in_node(TOID(struct tree_map_node) node, uint64_t key)
 int
 btree_map_lookup(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
 {
-	if (TOID_IS_NULL(D_RO(map)->root))
+	if (RPTR_IS_NULL(D_RO(map)->root))
 		return 0;
-	return btree_map_lookup_in_node(D_RO(map)->root, key);
+	return btree_map_lookup_in_node(pop, RPTR_RO(pop, D_RO(map)->root),
+		key);
 }
 
 /*
  * btree_map_foreach_node -- (internal) recursively traverses tree
  */
 static int
-btree_map_foreach_node(const TOID(struct tree_map_node) p,
+btree_map_foreach_node(PMEMobjpool *pop, const struct tree_map_node *p,
 	int (*cb)(uint64_t key, PMEMoid, void *arg), void *arg)
 {
-	if (TOID_IS_NULL(p))
+	if (p == NULL)
 		return 0;
 
-	for (int i = 0; i <= D_RO(p)->n; ++i) {
-		if (btree_map_foreach_node(D_RO(p)->slots[i], cb, arg) != 0)
+	for (int i = 0; i <= p->n; ++i) {
+		if (btree_map_foreach_node(pop, RPTR_RO(pop, p->slots[i]),
+				cb, arg) != 0)
 			return 1;
 
-		if (i != D_RO(p)->n && D_RO(p)->items[i].key != 0) {
-			if (cb(D_RO(p)->items[i].key, D_RO(p)->items[i].value,
+		if (i != p->n && p->items[i].key != 0) {
+			if (cb(p->items[i].key, p->items[i].value,
 					arg) != 0)
 				return 1;
 		}
@@ -618,7 +658,62 @@ int
 btree_map_foreach(PMEMobjpool *pop, TOID(struct btree_map) map,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
 {
-	return btree_map_foreach_node(D_RO(map)->root, cb, arg);
+	return btree_map_foreach_node(pop, RPTR_RO(pop, D_RO(map)->root),
+		cb, arg);
+}
+
+/*
+ * btree_map_range_node -- (internal) traverses the subtree in key order,
+ *	skipping the children which cannot hold keys from [lo, hi]
+ */
+static int
+btree_map_range_node(PMEMobjpool *pop, const struct tree_map_node *p,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (p == NULL)
+		return 0;
+
+	int ret;
+	for (int i = 0; i <= p->n; ++i) {
+		/* slots[i] holds keys between items[i - 1] and items[i] */
+		if ((i == p->n || p->items[i].key > lo) &&
+				(i == 0 || p->items[i - 1].key < hi)) {
+			ret = btree_map_range_node(pop,
+				RPTR_RO(pop, p->slots[i]), lo, hi, cb, arg);
+			if (ret != 0)
+				return ret;
+		}
+
+		if (i == p->n || p->items[i].key < lo)
+			continue;
+
+		if (p->items[i].key > hi)
+			break;
+
+		if (p->items[i].key != 0) {
+			ret = cb(p->items[i].key, p->items[i].value, arg);
+			if (ret != 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * btree_map_range -- calls cb, in key order, for every key in [lo, hi]
+ */
+int
+btree_map_range(PMEMobjpool *pop, TOID(struct btree_map) map,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (lo > hi)
+		return 0;
+
+	return btree_map_range_node(pop, RPTR_RO(pop, D_RO(map)->root),
+		lo, hi, cb, arg);
 }
 
 /*
@@ -32,6 +32,15 @@
 
 /*
  * ctree_map.c -- Crit-bit trie implementation
+ *
+ * The writers are serialized by the map lock, held until the outermost
+ * transaction ends. The lookups, foreach and range take no lock, but
+ * they wait while a transaction of another thread changes the map.
+ * A writer holds the sequence counter of the map odd until its outermost
+ * transaction commits or is rolled back, and the readers validate each
+ * entry they have loaded against the counter before following it, so they
+ * never see an uncommitted or torn entry. The unlinked internal nodes are
+ * retired instead of freed (see tree_map_epoch.h).
  */
 
 #include <assert.h>
@@ -39,6 +48,7 @@
 #include <stdlib.h>
 
 #include "ctree_map.h"
+#include "tree_map_epoch.h"
 
 #define	BIT_IS_SET(n, i) (!!((n) & (1ULL << (i))))
 
@@ -50,12 +60,15 @@ struct tree_map_entry {
 };
 
 struct tree_map_node {
+	struct tree_map_retired retired;
 	int diff; /* most significant differing bit */
 	struct tree_map_entry entries[2];
 };
 
 struct ctree_map {
 	struct tree_map_entry root;
+	struct tree_map_limbo limbo;
+	PMEMmutex lock; /* serializes the writers */
 };
 
 /*
@@ -67,6 +80,45 @@ find_crit_bit(uint64_t lhs, uint64_t rhs)
 	return 64 - __builtin_clzll(lhs ^ rhs) - 1;
 }
 
+/*
+ * ctree_map_set_entry -- (internal) changes an entry reachable by the readers
+ */
+static void
+ctree_map_set_entry(struct ctree_map *m, struct tree_map_entry *p,
+	struct tree_map_entry e)
+{
+	pmemobj_tx_add_range_direct(p, sizeof (*p));
+
+	__atomic_store_n(&p->key, e.key, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->slot.pool_uuid_lo, e.slot.pool_uuid_lo,
+		__ATOMIC_RELAXED);
+	__atomic_store_n(&p->slot.off, e.slot.off, __ATOMIC_RELAXED);
+}
+
+/*
+ * ctree_map_load -- (internal) reads an entry which may be changed
+ *	concurrently
+ */
+static inline void
+ctree_map_load(const struct tree_map_entry *p, struct tree_map_entry *e)
+{
+	e->key = __atomic_load_n(&p->key, __ATOMIC_RELAXED);
+	e->slot.pool_uuid_lo = __atomic_load_n(&p->slot.pool_uuid_lo,
+		__ATOMIC_RELAXED);
+	e->slot.off = __atomic_load_n(&p->slot.off, __ATOMIC_RELAXED);
+}
+
+/*
+ * ctree_map_is_node -- (internal) checks if the entry points to an internal
+ *	node, their entries have the key 0
+ */
+static inline int
+ctree_map_is_node(struct tree_map_entry e)
+{
+	return e.key == 0 && !OID_IS_NULL(e.slot) &&
+		OID_INSTANCEOF(e.slot, struct tree_map_node);
+}
+
 /*
  * ctree_map_new -- allocates a new crit-bit tree instance
  */
@@ -86,17 +138,26 @@ ctree_map_new(PMEMobjpool *pop, TOID(struct ctree_map) *map, void *arg)
 }
 
 /*
- * ctree_map_clear_node -- (internal) clears this node and its children
+ * ctree_map_clear_node -- (internal) clears this node and its children,
+ *	the internal nodes are retired unless op is NULL
  */
 static void
-ctree_map_clear_node(PMEMoid p)
+ctree_map_clear_node(struct tree_map_op *op, PMEMoid p)
 {
+	if (OID_IS_NULL(p))
+		return;
+
 	if (OID_INSTANCEOF(p, struct tree_map_node)) {
 		TOID(struct tree_map_node) node;
 		TOID_ASSIGN(node, p);
 
-		ctree_map_clear_node(D_RW(node)->entries[0].slot);
-		ctree_map_clear_node(D_RW(node)->entries[1].slot);
+		ctree_map_clear_node(op, D_RW(node)->entries[0].slot);
+		ctree_map_clear_node(op, D_RW(node)->entries[1].slot);
+
+		if (op != NULL) {
+			tree_map_retire(op, p.off);
+			return;
+		}
 	}
 
 	pmemobj_tx_free(p);
@@ -109,24 +170,38 @@ ctree_map_clear_node(PMEMoid p)
 int
 ctree_map_clear(PMEMobjpool *pop, TOID(struct ctree_map) map)
 {
-	TX_BEGIN(pop) {
-		ctree_map_clear_node(D_RW(map)->root.slot);
-		TX_ADD_FIELD(map, root);
-		D_RW(map)->root.slot = OID_NULL;
+	struct ctree_map *m = D_RW(map);
+	struct tree_map_op op;
+	int ret = 0;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+
+		PMEMoid root = m->root.slot;
+		struct tree_map_entry empty = {0, OID_NULL};
+		ctree_map_set_entry(m, &m->root, empty);
+		ctree_map_clear_node(&op, root);
+	} TX_ONABORT {
+		ret = 1;
 	} TX_END
 
-	return 0;
+	return ret;
 }
 
 /*
- * ctree_map_delete -- cleanups and frees crit-bit tree instance
+ * ctree_map_delete -- cleanups and frees crit-bit tree instance, the map
+ *	must not be in use by any other thread
  */
 int
 ctree_map_delete(PMEMobjpool *pop, TOID(struct ctree_map) *map)
 {
 	int ret = 0;
 	TX_BEGIN(pop) {
-		ctree_map_clear(pop, *map);
+		struct ctree_map *m = D_RW(*map);
+
+		ctree_map_clear_node(NULL, m->root.slot);
+		tree_map_limbo_free(pop, &m->limbo);
+
 		pmemobj_tx_add_range_direct(map, sizeof (*map));
 		TX_FREE(*map);
 		*map = TOID_NULL(struct ctree_map);
@@ -141,9 +216,10 @@ ctree_map_delete(PMEMobjpool *pop, TOID(struct ctree_map) *map)
  * ctree_map_insert_leaf -- (internal) inserts a new leaf at the position
  */
 static void
-ctree_map_insert_leaf(struct tree_map_entry *p,
+ctree_map_insert_leaf(struct ctree_map *m,
 	struct tree_map_entry e, int diff)
 {
+	struct tree_map_entry *p = &m->root;
 	TOID(struct tree_map_node) new_node = TX_NEW(struct tree_map_node);
 	D_RW(new_node)->diff = diff;
 
@@ -167,9 +243,8 @@ ctree_map_insert_leaf(struct tree_map_entry *p,
 	/* insert the found destination in the other slot */
 	D_RW(new_node)->entries[!d] = *p;
 
-	pmemobj_tx_add_range_direct(p, sizeof (*p));
-	p->key = 0;
-	p->slot = new_node.oid;
+	struct tree_map_entry link = {0, new_node.oid};
+	ctree_map_set_entry(m, p, link);
 }
 
 /*
@@ -202,26 +277,30 @@ int
 ctree_map_insert(PMEMobjpool *pop, TOID(struct ctree_map) map,
 	uint64_t key, PMEMoid value)
 {
-	struct tree_map_entry *p = &D_RW(map)->root;
+	struct ctree_map *m = D_RW(map);
+	struct tree_map_op op;
 	int ret = 0;
 
-	/* descend the path until a best matching key is found */
-	TOID(struct tree_map_node) node;
-	while (!OID_IS_NULL(p->slot) &&
-		OID_INSTANCEOF(p->slot, struct tree_map_node)) {
-		TOID_ASSIGN(node, p->slot);
-		p = &D_RW(node)->entries[BIT_IS_SET(key, D_RW(node)->diff)];
-	}
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
 
-	struct tree_map_entry e = {key, value};
-	TX_BEGIN(pop) {
-		if (p->key == 0 || p->key == key) {
-			pmemobj_tx_add_range_direct(p, sizeof (*p));
-			*p = e;
-		} else {
-			ctree_map_insert_leaf(&D_RW(map)->root, e,
-					find_crit_bit(p->key, key));
+		struct tree_map_entry *p = &m->root;
+
+		/* descend the path until a best matching key is found */
+		TOID(struct tree_map_node) node;
+		while (!OID_IS_NULL(p->slot) &&
+			OID_INSTANCEOF(p->slot, struct tree_map_node)) {
+			TOID_ASSIGN(node, p->slot);
+			p = &D_RW(node)->entries[
+				BIT_IS_SET(key, D_RW(node)->diff)];
 		}
+
+		struct tree_map_entry e = {key, value};
+		if (p->key == 0 || p->key == key)
+			ctree_map_set_entry(m, p, e);
+		else
+			ctree_map_insert_leaf(m, e,
+					find_crit_bit(p->key, key));
 	} TX_ONABORT {
 		ret = 1;
 	} TX_END
@@ -233,10 +312,10 @@ ctree_map_insert(PMEMobjpool *pop, TOID(struct ctree_map) map,
  * ctree_map_get_leaf -- (internal) searches for a leaf of the key
  */
 static struct tree_map_entry *
-ctree_map_get_leaf(TOID(struct ctree_map) map, uint64_t key,
+ctree_map_get_leaf(struct ctree_map *m, uint64_t key,
 	struct tree_map_entry **parent)
 {
-	struct tree_map_entry *n = &D_RW(map)->root;
+	struct tree_map_entry *n = &m->root;
 	struct tree_map_entry *p = NULL;
 
 	TOID(struct tree_map_node) node;
@@ -278,24 +357,22 @@ ctree_map_remove_free(PMEMobjpool *pop, TOID(struct ctree_map) map,
 }
 
 /*
- * ctree_map_remove -- removes key-value pair from the map
+ * ctree_map_remove_leaf -- (internal) unlinks the leaf of the key
  */
-PMEMoid
-ctree_map_remove(PMEMobjpool *pop, TOID(struct ctree_map) map, uint64_t key)
+static PMEMoid
+ctree_map_remove_leaf(struct tree_map_op *op, struct ctree_map *m,
+	uint64_t key)
 {
 	struct tree_map_entry *parent = NULL;
-	struct tree_map_entry *leaf = ctree_map_get_leaf(map, key, &parent);
+	struct tree_map_entry *leaf = ctree_map_get_leaf(m, key, &parent);
 	if (leaf == NULL)
 		return OID_NULL;
 
 	PMEMoid ret = leaf->slot;
 
 	if (parent == NULL) { /* root */
-		TX_BEGIN(pop) {
-			pmemobj_tx_add_range_direct(leaf, sizeof (*leaf));
-			leaf->key = 0;
-			leaf->slot = OID_NULL;
-		} TX_END
+		struct tree_map_entry empty = {0, OID_NULL};
+		ctree_map_set_entry(m, leaf, empty);
 	} else {
 		/*
 		 * In this situation:
@@ -303,31 +380,78 @@ ctree_map_remove(PMEMobjpool *pop, TOID(struct ctree_map) map, uint64_t key)
 		 *	/     \
 		 *   LEFT   RIGHT
 		 * there's no point in leaving the parent internal node
-		 * so it's swapped with the remaining node and then also freed.
+		 * so it's swapped with the remaining node and then retired.
 		 */
-		TX_BEGIN(pop) {
-			struct tree_map_entry *dest = parent;
-			TOID(struct tree_map_node) node;
-			TOID_ASSIGN(node, parent->slot);
-			pmemobj_tx_add_range_direct(dest, sizeof (*dest));
-			*dest = D_RW(node)->entries[
-				D_RO(node)->entries[0].key == leaf->key];
-
-			TX_FREE(node);
-		} TX_END
+		TOID(struct tree_map_node) node;
+		TOID_ASSIGN(node, parent->slot);
+		ctree_map_set_entry(m, parent, D_RO(node)->entries[
+			D_RO(node)->entries[0].key == leaf->key]);
+
+		tree_map_retire(op, node.oid.off);
 	}
 
 	return ret;
 }
 
+/*
+ * ctree_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+ctree_map_remove(PMEMobjpool *pop, TOID(struct ctree_map) map, uint64_t key)
+{
+	struct ctree_map *m = D_RW(map);
+	struct tree_map_op op;
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+		ret = ctree_map_remove_leaf(&op, m, key);
+	} TX_ONABORT {
+		ret = OID_NULL;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * ctree_map_find -- (internal) searches for a value of the key without
+ *	taking the lock
+ */
+static int
+ctree_map_find(const struct ctree_map *m, uint64_t key, PMEMoid *value)
+{
+	const struct tree_map_seq *seq = tree_map_seq(m);
+	struct tree_map_reader *r = tree_map_read_begin();
+	struct tree_map_entry e;
+	uint64_t s;
+
+	do {
+		s = tree_map_seq_begin(seq);
+		ctree_map_load(&m->root, &e);
+		while (!tree_map_seq_changed(seq, s) && ctree_map_is_node(e)) {
+			const struct tree_map_node *n = pmemobj_direct(e.slot);
+			ctree_map_load(&n->entries[BIT_IS_SET(key, n->diff)],
+				&e);
+		}
+	} while (tree_map_seq_changed(seq, s));
+
+	tree_map_read_end(r);
+
+	if (OID_IS_NULL(e.slot) || e.key != key)
+		return 0;
+
+	*value = e.slot;
+	return 1;
+}
+
 /*
  * ctree_map_get -- searches for a value of the key
  */
 PMEMoid
 ctree_map_get(PMEMobjpool *pop, TOID(struct ctree_map) map, uint64_t key)
 {
-	struct tree_map_entry *entry = ctree_map_get_leaf(map, key, NULL);
-	return entry ? entry->slot : OID_NULL;
+	PMEMoid value;
+	return ctree_map_find(D_RO(map), key, &value) ? value : OID_NULL;
 }
 
 /*
@@ -337,44 +461,138 @@ int
 ctree_map_lookup(PMEMobjpool *pop, TOID(struct ctree_map) map,
 		uint64_t key)
 {
-	struct tree_map_entry *entry = ctree_map_get_leaf(map, key, NULL);
-	return entry != NULL;
+	PMEMoid value;
+	return ctree_map_find(D_RO(map), key, &value);
 }
 
+/* state of a range traversal */
+struct ctree_map_range_arg {
+	const struct tree_map_seq *seq;
+	uint64_t s; /* sequence counter value the entries are checked with */
+	uint64_t lo; /* the smallest key not visited yet */
+	uint64_t hi;
+	int (*cb)(uint64_t key, PMEMoid value, void *arg);
+	void *arg;
+	int ret;
+	int restart;
+};
+
 /*
- * ctree_map_foreach_node -- (internal) recursively traverses tree
+ * ctree_map_any_key -- (internal) returns the key of any leaf in the subtree,
+ *	or 1 if the map has changed
  */
 static int
-ctree_map_foreach_node(struct tree_map_entry e,
-	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+ctree_map_any_key(struct ctree_map_range_arg *ra, struct tree_map_entry e,
+	uint64_t *key)
 {
-	int ret = 0;
+	while (!tree_map_seq_changed(ra->seq, ra->s) &&
+			ctree_map_is_node(e)) {
+		const struct tree_map_node *n = pmemobj_direct(e.slot);
+		ctree_map_load(&n->entries[0], &e);
+	}
 
-	if (OID_INSTANCEOF(e.slot, struct tree_map_node)) {
-		TOID(struct tree_map_node) node;
-		TOID_ASSIGN(node, e.slot);
+	*key = e.key;
+	return tree_map_seq_changed(ra->seq, ra->s);
+}
 
-		if (ctree_map_foreach_node(D_RO(node)->entries[0],
-					cb, arg) == 0)
-			ctree_map_foreach_node(D_RO(node)->entries[1], cb, arg);
-	} else { /* leaf */
-		ret = cb(e.key, e.slot, arg);
+/*
+ * ctree_map_range_node -- (internal) traverses the subtree in key order,
+ *	skipping the branches which cannot hold keys from [lo, hi], returns 1
+ *	when the traversal has to stop
+ */
+static int
+ctree_map_range_node(struct ctree_map_range_arg *ra, struct tree_map_entry e)
+{
+	/* the entry has been loaded before, check it's still the current one */
+	if (tree_map_seq_changed(ra->seq, ra->s)) {
+		ra->restart = 1;
+		return 1;
 	}
 
-	return ret;
+	if (!ctree_map_is_node(e)) { /* leaf */
+		if (e.key < ra->lo || e.key > ra->hi)
+			return 0;
+
+		ra->ret = ra->cb(e.key, e.slot, ra->arg);
+		if (ra->ret != 0 || e.key == ra->hi)
+			return 1;
+
+		/* a restarted traversal resumes after this key */
+		ra->lo = e.key + 1;
+		return 0;
+	}
+
+	const struct tree_map_node *n = pmemobj_direct(e.slot);
+	struct tree_map_entry left;
+	struct tree_map_entry right;
+	ctree_map_load(&n->entries[0], &left);
+	ctree_map_load(&n->entries[1], &right);
+
+	/*
+	 * All keys below the node share the bits above the critical one,
+	 * so the smallest key of the right branch is that common prefix
+	 * with only the critical bit set.
+	 */
+	uint64_t any;
+	if (ctree_map_any_key(ra, left, &any)) {
+		ra->restart = 1;
+		return 1;
+	}
+
+	int diff = n->diff;
+	uint64_t low_mask = (1ULL << diff) - 1;
+	uint64_t split = (any & ~low_mask) | (1ULL << diff);
+
+	if (ra->lo < split && ctree_map_range_node(ra, left))
+		return 1;
+
+	if (ra->hi >= split)
+		return ctree_map_range_node(ra, right);
+
+	return 0;
 }
 
 /*
- * ctree_map_foreach -- initiates recursive traversal
+ * ctree_map_range -- calls cb, in key order, for every key in [lo, hi]
+ *
+ * A traversal which runs into a change of the map starts again from the root
+ * with the keys not visited yet.
  */
 int
-ctree_map_foreach(PMEMobjpool *pop, TOID(struct ctree_map) map,
+ctree_map_range(PMEMobjpool *pop, TOID(struct ctree_map) map,
+	uint64_t lo, uint64_t hi,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
 {
-	if (OID_IS_NULL(D_RO(map)->root.slot))
+	if (lo > hi)
 		return 0;
 
-	return ctree_map_foreach_node(D_RO(map)->root, cb, arg);
+	const struct ctree_map *m = D_RO(map);
+	struct ctree_map_range_arg ra = {tree_map_seq(m), 0, lo, hi,
+		cb, arg, 0, 0};
+	struct tree_map_reader *r = tree_map_read_begin();
+	struct tree_map_entry e;
+
+	do {
+		ra.restart = 0;
+		ra.s = tree_map_seq_begin(ra.seq);
+		ctree_map_load(&m->root, &e);
+		if (!OID_IS_NULL(e.slot))
+			ctree_map_range_node(&ra, e);
+	} while (ra.restart);
+
+	tree_map_read_end(r);
+
+	return ra.ret;
+}
+
+/*
+ * ctree_map_foreach -- calls cb for every key, in key order
+ */
+int
+ctree_map_foreach(PMEMobjpool *pop, TOID(struct ctree_map) map,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	return ctree_map_range(pop, map, 0, UINT64_MAX, cb, arg);
 }
 
 /*
@@ -383,7 +601,8 @@ ctree_map_foreach(PMEMobjpool *pop, TOID(struct ctree_map) map,
 int
 ctree_map_is_empty(PMEMobjpool *pop, TOID(struct ctree_map) map)
 {
-	return D_RO(map)->root.key == 0;
+	return __atomic_load_n(&D_RO(map)->root.slot.off,
+		__ATOMIC_RELAXED) == 0;
 }
 
 /*
@@ -66,6 +66,9 @@ int ctree_map_lookup(PMEMobjpool *pop, TOID(struct ctree_map) map,
 		uint64_t key);
 int ctree_map_foreach(PMEMobjpool *pop, TOID(struct ctree_map) map,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+int ctree_map_range(PMEMobjpool *pop, TOID(struct ctree_map) map,
+	uint64_t lo, uint64_t hi,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
 int ctree_map_is_empty(PMEMobjpool *pop, TOID(struct ctree_map) map);
 
 #endif /* CTREE_MAP_H */
@@ -32,11 +32,23 @@
 
 /*
  * rbtree.c -- red-black tree implementation /w sentinel nodes
+ *
+ * The writers are serialized by the map lock, held until the outermost
+ * transaction ends. The lookups, foreach and range take no lock, but
+ * they wait while a transaction of another thread changes the map:
+ * - a writer holds the sequence counter of the map odd until its outermost
+ *   transaction commits or is rolled back,
+ * - the readers validate each link they have loaded against the counter
+ *   before following it, so the rotations, the removals and the rollback
+ *   are never seen half done,
+ * - the removed nodes are retired instead of freed (see tree_map_epoch.h).
+ * The key and the value of a node never change.
  */
 
 #include <assert.h>
 #include <errno.h>
 #include "rbtree_map.h"
+#include "tree_map_epoch.h"
 
 TOID_DECLARE(struct tree_map_node, RBTREE_MAP_TYPE_OFFSET + 1);
 
@@ -82,6 +94,7 @@ enum rb_children {
 };
 
 struct tree_map_node {
+	struct tree_map_retired retired;
 	uint64_t key;
 	PMEMoid value;
 	enum rb_color color;
@@ -92,8 +105,41 @@ struct tree_map_node {
 struct rbtree_map {
 	TOID(struct tree_map_node) sentinel;
 	TOID(struct tree_map_node) root;
+	struct tree_map_limbo limbo;
+	PMEMmutex lock; /* serializes the writers */
 };
 
+/*
+ * rbtree_map_publish -- (internal) stores a link reachable by the readers,
+ *	all the nodes are in the same pool so only the offset changes
+ */
+static void
+rbtree_map_publish(TOID(struct tree_map_node) *dst,
+	TOID(struct tree_map_node) n)
+{
+	pmemobj_tx_add_range_direct(dst, sizeof (*dst));
+	__atomic_store_n(&dst->oid.off, n.oid.off, __ATOMIC_RELEASE);
+}
+
+/*
+ * rbtree_map_link -- (internal) reads a link which may be changed
+ *	concurrently
+ */
+static inline uint64_t
+rbtree_map_link(const TOID(struct tree_map_node) *link)
+{
+	return __atomic_load_n(&link->oid.off, __ATOMIC_RELAXED);
+}
+
+/*
+ * rbtree_map_node -- (internal) returns the node at the offset
+ */
+static inline const struct tree_map_node *
+rbtree_map_node(PMEMobjpool *pop, uint64_t off)
+{
+	return (const struct tree_map_node *)((char *)pop + off);
+}
+
 /*
  * rbtree_map_new -- allocates a new red-black tree instance
  */
@@ -127,20 +173,25 @@ rbtree_map_new(PMEMobjpool *pop, TOID(struct rbtree_map) *map, void *arg)
 }
 
 /*
- * rbtree_map_clear_node -- (internal) clears this node and its children
+ * rbtree_map_clear_node -- (internal) clears this node and its children,
+ *	the nodes are retired unless op is NULL
  */
 static void
-rbtree_map_clear_node(TOID(struct rbtree_map) map, TOID(struct tree_map_node) p)
+rbtree_map_clear_node(struct tree_map_op *op, TOID(struct rbtree_map) map,
+	TOID(struct tree_map_node) p)
 {
 	TOID(struct tree_map_node) s = D_RO(map)->sentinel;
 
 	if (!NODE_IS_NULL(D_RO(p)->slots[RB_LEFT]))
-		rbtree_map_clear_node(map, D_RO(p)->slots[RB_LEFT]);
+		rbtree_map_clear_node(op, map, D_RO(p)->slots[RB_LEFT]);
 
 	if (!NODE_IS_NULL(D_RO(p)->slots[RB_RIGHT]))
-		rbtree_map_clear_node(map, D_RO(p)->slots[RB_RIGHT]);
+		rbtree_map_clear_node(op, map, D_RO(p)->slots[RB_RIGHT]);
 
-	TX_FREE(p);
+	if (op != NULL)
+		tree_map_retire(op, p.oid.off);
+	else
+		TX_FREE(p);
 }
 
 
@@ -150,30 +201,41 @@ rbtree_map_clear_node(TOID(struct rbtree_map) map, TOID(struct tree_map_node) p)
 int
 rbtree_map_clear(PMEMobjpool *pop, TOID(struct rbtree_map) map)
 {
-	TX_BEGIN(pop) {
-		rbtree_map_clear_node(map, D_RW(map)->root);
-		TX_ADD_FIELD(map, root);
-		TX_ADD_FIELD(map, sentinel);
+	struct rbtree_map *m = D_RW(map);
+	struct tree_map_op op;
+	int ret = 0;
 
-		TX_FREE(D_RW(map)->sentinel);
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
 
-		D_RW(map)->root = TOID_NULL(struct tree_map_node);
-		D_RW(map)->sentinel = TOID_NULL(struct tree_map_node);
+		TOID(struct tree_map_node) first = RB_FIRST(map);
+		if (!TOID_EQUALS(first, m->sentinel)) {
+			rbtree_map_publish(&RB_FIRST(map), m->sentinel);
+			rbtree_map_clear_node(&op, map, first);
+		}
+	} TX_ONABORT {
+		ret = 1;
 	} TX_END
 
-	return 0;
+	return ret;
 }
 
 
 /*
- * rbtree_map_delete -- cleanups and frees red-black tree instance
+ * rbtree_map_delete -- cleanups and frees red-black tree instance, the map
+ *	must not be in use by any other thread
  */
 int
 rbtree_map_delete(PMEMobjpool *pop, TOID(struct rbtree_map) *map)
 {
 	int ret = 0;
 	TX_BEGIN(pop) {
-		rbtree_map_clear(pop, *map);
+		struct rbtree_map *m = D_RW(*map);
+
+		rbtree_map_clear_node(NULL, *map, m->root);
+		TX_FREE(m->sentinel);
+		tree_map_limbo_free(pop, &m->limbo);
+
 		pmemobj_tx_add_range_direct(map, sizeof (*map));
 		TX_FREE(*map);
 		*map = TOID_NULL(struct rbtree_map);
@@ -193,18 +255,24 @@ rbtree_map_rotate(TOID(struct rbtree_map) map,
 {
 	TOID(struct tree_map_node) child = D_RO(node)->slots[!c];
 	TOID(struct tree_map_node) s = D_RO(map)->sentinel;
+	TOID(struct tree_map_node) grandchild = D_RO(child)->slots[c];
+	TOID(struct tree_map_node) parent = NODE_P(node);
+	TOID(struct tree_map_node) *link = &NODE_PARENT_AT(node,
+		NODE_LOCATION(node));
 
 	TX_ADD(node);
 	TX_ADD(child);
+	if (!TOID_EQUALS(grandchild, s))
+		TX_ADD_FIELD(grandchild, parent);
+	pmemobj_tx_add_range_direct(link, sizeof (*link));
 
-	D_RW(node)->slots[!c] = D_RO(child)->slots[c];
-
-	if (!TOID_EQUALS(D_RO(child)->slots[c], s))
-		TX_SET(D_RW(child)->slots[c], parent, node);
+	D_RW(node)->slots[!c] = grandchild;
 
-	NODE_P(child) = NODE_P(node);
+	if (!TOID_EQUALS(grandchild, s))
+		D_RW(grandchild)->parent = node;
 
-	TX_SET(NODE_P(node), slots[NODE_LOCATION(node)], child);
+	D_RW(child)->parent = parent;
+	*link = child;
 
 	D_RW(child)->slots[c] = node;
 	D_RW(node)->parent = child;
@@ -230,8 +298,7 @@ rbtree_map_insert_bst(TOID(struct rbtree_map) map, TOID(struct tree_map_node) n)
 
 	TX_SET(n, parent, parent);
 
-	pmemobj_tx_add_range_direct(dst, sizeof (*dst));
-	*dst = n;
+	rbtree_map_publish(dst, n);
 }
 
 /*
@@ -269,9 +336,13 @@ int
 rbtree_map_insert(PMEMobjpool *pop, TOID(struct rbtree_map) map,
 	uint64_t key, PMEMoid value)
 {
+	struct rbtree_map *m = D_RW(map);
+	struct tree_map_op op;
 	int ret = 0;
 
-	TX_BEGIN(pop) {
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+
 		TOID(struct tree_map_node) n = TX_ZNEW(struct tree_map_node);
 		D_RW(n)->key = key;
 		D_RW(n)->value = value;
@@ -284,6 +355,8 @@ rbtree_map_insert(PMEMobjpool *pop, TOID(struct rbtree_map) map,
 					NODE_LOCATION(NODE_P(n)));
 
 		TX_SET(RB_FIRST(map), color, COLOR_BLACK);
+	} TX_ONABORT {
+		ret = 1;
 	} TX_END
 
 	return ret;
@@ -385,10 +458,11 @@ rbtree_map_repair(TOID(struct rbtree_map) map, TOID(struct tree_map_node) n)
 }
 
 /*
- * rbtree_map_remove -- removes key-value pair from the map
+ * rbtree_map_remove_node -- (internal) unlinks the node of the key
  */
-PMEMoid
-rbtree_map_remove(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
+static PMEMoid
+rbtree_map_remove_node(struct tree_map_op *op, TOID(struct rbtree_map) map,
+	uint64_t key)
 {
 	PMEMoid ret = OID_NULL;
 
@@ -408,45 +482,157 @@ rbtree_map_remove(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
 	TOID(struct tree_map_node) x = NODE_IS_NULL(D_RO(y)->slots[RB_LEFT]) ?
 			D_RO(y)->slots[RB_RIGHT] : D_RO(y)->slots[RB_LEFT];
 
-	TX_BEGIN(pop) {
-		TX_SET(x, parent, NODE_P(y));
-		if (TOID_EQUALS(NODE_P(x), r)) {
-			TX_SET(r, slots[RB_LEFT], x);
-		} else {
-			TX_SET(NODE_P(y), slots[NODE_LOCATION(y)], x);
-		}
+	TX_SET(x, parent, NODE_P(y));
+	if (TOID_EQUALS(NODE_P(x), r)) {
+		TX_SET(r, slots[RB_LEFT], x);
+	} else {
+		TX_SET(NODE_P(y), slots[NODE_LOCATION(y)], x);
+	}
 
-		if (D_RO(y)->color == COLOR_BLACK)
-			rbtree_map_repair(map, x);
+	if (D_RO(y)->color == COLOR_BLACK)
+		rbtree_map_repair(map, x);
 
-		if (!TOID_EQUALS(y, n)) {
-			TX_ADD(y);
-			D_RW(y)->slots[RB_LEFT] = D_RO(n)->slots[RB_LEFT];
-			D_RW(y)->slots[RB_RIGHT] = D_RO(n)->slots[RB_RIGHT];
-			D_RW(y)->parent = D_RO(n)->parent;
-			D_RW(y)->color = D_RO(n)->color;
-			TX_SET(D_RW(n)->slots[RB_LEFT], parent, y);
-			TX_SET(D_RW(n)->slots[RB_RIGHT], parent, y);
+	if (!TOID_EQUALS(y, n)) {
+		TX_ADD(y);
+		D_RW(y)->slots[RB_LEFT] = D_RO(n)->slots[RB_LEFT];
+		D_RW(y)->slots[RB_RIGHT] = D_RO(n)->slots[RB_RIGHT];
+		D_RW(y)->parent = D_RO(n)->parent;
+		D_RW(y)->color = D_RO(n)->color;
+		TX_SET(D_RW(n)->slots[RB_LEFT], parent, y);
+		TX_SET(D_RW(n)->slots[RB_RIGHT], parent, y);
 
-			TX_SET(NODE_P(n), slots[NODE_LOCATION(n)], y);
-		}
-		TX_FREE(n);
+		TX_SET(NODE_P(n), slots[NODE_LOCATION(n)], y);
+	}
+
+	tree_map_retire(op, n.oid.off);
+
+	return ret;
+}
+
+/*
+ * rbtree_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+rbtree_map_remove(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
+{
+	struct rbtree_map *m = D_RW(map);
+	struct tree_map_op op;
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &m->lock, TX_LOCK_NONE) {
+		tree_map_op_begin(&op, pop, m, &m->limbo);
+		ret = rbtree_map_remove_node(&op, map, key);
+	} TX_ONABORT {
+		ret = OID_NULL;
 	} TX_END
 
 	return ret;
 }
 
+/*
+ * rbtree_map_seek -- (internal) returns the offset of the node with the
+ *	smallest key not less than the given one, 0 if there is none, without
+ *	taking the lock
+ *
+ * The result is valid for the sequence counter value stored in *s.
+ */
+static uint64_t
+rbtree_map_seek(PMEMobjpool *pop, const struct rbtree_map *m, uint64_t key,
+	uint64_t *s)
+{
+	const struct tree_map_seq *seq = tree_map_seq(m);
+	const struct tree_map_node *root =
+		rbtree_map_node(pop, m->root.oid.off);
+	uint64_t sentinel = m->sentinel.oid.off;
+	uint64_t found;
+
+	do {
+		*s = tree_map_seq_begin(seq);
+		found = 0;
+
+		uint64_t dst = rbtree_map_link(&root->slots[RB_LEFT]);
+		while (dst != sentinel && !tree_map_seq_changed(seq, *s)) {
+			const struct tree_map_node *n =
+				rbtree_map_node(pop, dst);
+			if (n->key == key) {
+				found = dst;
+				break;
+			}
+
+			if (key < n->key) {
+				found = dst;
+				dst = rbtree_map_link(&n->slots[RB_LEFT]);
+			} else {
+				dst = rbtree_map_link(&n->slots[RB_RIGHT]);
+			}
+		}
+	} while (tree_map_seq_changed(seq, *s));
+
+	return found;
+}
+
+/*
+ * rbtree_map_next -- (internal) finds the successor of the node at *off
+ *	without taking the lock, returns 1 if the map has changed since s
+ *
+ * *off is set to the offset of the successor, 0 if there is none.
+ */
+static int
+rbtree_map_next(PMEMobjpool *pop, const struct rbtree_map *m, uint64_t s,
+	uint64_t *off)
+{
+	const struct tree_map_seq *seq = tree_map_seq(m);
+	uint64_t sentinel = m->sentinel.oid.off;
+	uint64_t n = *off;
+	const struct tree_map_node *node = rbtree_map_node(pop, n);
+	uint64_t dst = rbtree_map_link(&node->slots[RB_RIGHT]);
+
+	if (dst != sentinel) {
+		while (!tree_map_seq_changed(seq, s)) {
+			node = rbtree_map_node(pop, dst);
+			uint64_t left = rbtree_map_link(&node->slots[RB_LEFT]);
+			if (left == sentinel)
+				break;
+
+			dst = left;
+		}
+	} else {
+		dst = rbtree_map_link(&node->parent);
+		while (!tree_map_seq_changed(seq, s)) {
+			node = rbtree_map_node(pop, dst);
+			if (n != rbtree_map_link(&node->slots[RB_RIGHT]))
+				break;
+
+			n = dst;
+			dst = rbtree_map_link(&node->parent);
+		}
+		if (dst == m->root.oid.off)
+			dst = 0;
+	}
+
+	if (tree_map_seq_changed(seq, s))
+		return 1;
+
+	*off = dst;
+	return 0;
+}
+
 /*
  * rbtree_map_get -- searches for a value of the key
  */
 PMEMoid
 rbtree_map_get(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
 {
-	TOID(struct tree_map_node) node = rbtree_map_find_node(map, key);
-	if (TOID_IS_NULL(node))
-		return OID_NULL;
+	PMEMoid ret = OID_NULL;
+	uint64_t s;
+
+	struct tree_map_reader *r = tree_map_read_begin();
+	uint64_t off = rbtree_map_seek(pop, D_RO(map), key, &s);
+	if (off != 0 && rbtree_map_node(pop, off)->key == key)
+		ret = rbtree_map_node(pop, off)->value;
+	tree_map_read_end(r);
 
-	return D_RO(node)->value;
+	return ret;
 }
 
 /*
@@ -455,44 +641,57 @@ rbtree_map_get(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
 int
 rbtree_map_lookup(PMEMobjpool *pop, TOID(struct rbtree_map) map, uint64_t key)
 {
-	TOID(struct tree_map_node) node = rbtree_map_find_node(map, key);
-	if (TOID_IS_NULL(node))
-		return 0;
+	uint64_t s;
+
+	struct tree_map_reader *r = tree_map_read_begin();
+	uint64_t off = rbtree_map_seek(pop, D_RO(map), key, &s);
+	int ret = off != 0 && rbtree_map_node(pop, off)->key == key;
+	tree_map_read_end(r);
 
-	return 1;
+	return ret;
 }
 
 /*
- * rbtree_map_foreach_node -- (internal) recursively traverses tree
+ * rbtree_map_range -- calls cb, in key order, for every key in [lo, hi]
  */
-static int
-rbtree_map_foreach_node(TOID(struct rbtree_map) map,
-	TOID(struct tree_map_node) p,
+int
+rbtree_map_range(PMEMobjpool *pop, TOID(struct rbtree_map) map,
+	uint64_t lo, uint64_t hi,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
 {
-	int ret = 0;
-
-	if (TOID_EQUALS(p, D_RO(map)->sentinel))
+	if (lo > hi)
 		return 0;
 
-	if ((ret = rbtree_map_foreach_node(map,
-		D_RO(p)->slots[RB_LEFT], cb, arg)) == 0) {
-		if ((ret = cb(D_RO(p)->key, D_RO(p)->value, arg)) == 0)
-			rbtree_map_foreach_node(map,
-				D_RO(p)->slots[RB_RIGHT], cb, arg);
+	const struct rbtree_map *m = D_RO(map);
+	int ret = 0;
+	uint64_t s;
+
+	struct tree_map_reader *r = tree_map_read_begin();
+	uint64_t off = rbtree_map_seek(pop, m, lo, &s);
+	while (off != 0) {
+		const struct tree_map_node *n = rbtree_map_node(pop, off);
+		uint64_t key = n->key;
+		if (key > hi || (ret = cb(key, n->value, arg)) != 0 ||
+			key == hi)
+			break;
+
+		/* after a change of the map the next key is searched again */
+		if (rbtree_map_next(pop, m, s, &off))
+			off = rbtree_map_seek(pop, m, key + 1, &s);
 	}
+	tree_map_read_end(r);
 
 	return ret;
 }
 
 /*
- * rbtree_map_foreach -- initiates recursive traversal
+ * rbtree_map_foreach -- calls cb for every key, in key order
  */
 int
 rbtree_map_foreach(PMEMobjpool *pop, TOID(struct rbtree_map) map,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
 {
-	return rbtree_map_foreach_node(map, RB_FIRST(map), cb, arg);
+	return rbtree_map_range(pop, map, 0, UINT64_MAX, cb, arg);
 }
 
 /*
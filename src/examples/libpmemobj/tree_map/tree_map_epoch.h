@@ -0,0 +1,480 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tree_map_epoch.h -- lockless reads support shared by the tree maps
+ *
+ * The writers of a map are serialized by its lock, the readers take none
+ * and never delay a writer:
+ * - a writer makes the sequence counter of the map odd before its first
+ *   change and even again once the outermost transaction has committed or
+ *   its changes have been rolled back, the readers check the counter before
+ *   following the offsets they have loaded and restart when it has changed
+ *   in the meantime, so a read never returns uncommitted data nor follows
+ *   an offset into an object allocated by a transaction which is then
+ *   aborted,
+ * - the map is changed in place, there's no committed copy to read while
+ *   the counter is odd, so a reader waits (yielding the processor) for the
+ *   transaction of another thread to end, a long transaction which changes
+ *   the map stalls all of its readers until it ends,
+ * - the objects unlinked by a writer are kept on a persistent limbo list
+ *   until no read which could have seen them is left (epoch-based
+ *   reclamation), so a reader never follows an offset into freed memory.
+ * A read done by the thread which changes the map within the same
+ * transaction sees the changes and doesn't wait.
+ *
+ * Each file which includes it has its own epoch, reader registry and
+ * sequence counters.
+ */
+
+#ifndef	TREE_MAP_EPOCH_H
+#define	TREE_MAP_EPOCH_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libpmemobj.h>
+
+#define	TREE_MAP_CACHELINE 64
+#define	TREE_MAP_SEQS 64 /* buckets of sequence counters, a power of two */
+
+/* the objects on the limbo list start with it */
+struct tree_map_retired {
+	uint64_t next; /* offset of the next retired object */
+	uint64_t epoch; /* reader epoch at the time of the unlink */
+};
+
+/* the persistent list of the retired objects, a part of the map */
+struct tree_map_limbo {
+	uint64_t head; /* the oldest retired object */
+	uint64_t tail;
+	uint64_t session; /* process which retired the objects on the list */
+};
+
+/* state of a single write operation */
+struct tree_map_op {
+	PMEMobjpool *pop;
+	struct tree_map_limbo *limbo;
+	struct tree_map_seq *seq;
+	uint64_t tail; /* limbo tail at the beginning of the operation */
+};
+
+/* per-thread reader state */
+struct tree_map_reader {
+	uint64_t epoch; /* epoch at the beginning of the read, 0 if none */
+	unsigned nesting;
+	int used;
+	struct tree_map_reader *next;
+	char padding[TREE_MAP_CACHELINE - 24];
+};
+
+/* the sequence counter of a map, odd while a transaction changes the map */
+struct tree_map_seq {
+	uint64_t seq;
+	const void *map;
+	const void *owner; /* the writer thread, until its transaction ends */
+	int retired; /* the transaction has unlinked an object */
+	struct tree_map_seq *next; /* in the bucket */
+	char padding[TREE_MAP_CACHELINE - 40];
+};
+
+static uint64_t tree_map_epoch = 1;
+static uint64_t tree_map_session;
+static struct tree_map_reader *tree_map_readers;
+static pthread_once_t tree_map_readers_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tree_map_readers_key;
+static __thread struct tree_map_reader *tree_map_self;
+static __thread char tree_map_me; /* its address identifies the thread */
+static struct tree_map_seq *tree_map_seqs[TREE_MAP_SEQS];
+
+/*
+ * tree_map_reader_release -- (internal) returns the reader state of an
+ *	exiting thread for reuse
+ */
+static void
+tree_map_reader_release(void *arg)
+{
+	struct tree_map_reader *r = arg;
+
+	__atomic_store_n(&r->epoch, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * tree_map_readers_init -- (internal) initializes the process-wide state
+ */
+static void
+tree_map_readers_init(void)
+{
+	if (pthread_key_create(&tree_map_readers_key,
+			tree_map_reader_release)) {
+		perror("pthread_key_create");
+		abort();
+	}
+
+	/* tells apart the objects retired by the previous runs */
+	tree_map_session = ((uint64_t)getpid() << 32) ^
+		(uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&tree_map_session;
+	if (tree_map_session == 0)
+		tree_map_session = 1;
+}
+
+/*
+ * tree_map_reader_get -- (internal) returns the reader state of the thread
+ */
+static struct tree_map_reader *
+tree_map_reader_get(void)
+{
+	if (tree_map_self != NULL)
+		return tree_map_self;
+
+	pthread_once(&tree_map_readers_once, tree_map_readers_init);
+
+	struct tree_map_reader *r =
+		__atomic_load_n(&tree_map_readers, __ATOMIC_ACQUIRE);
+	for (; r != NULL; r = r->next) {
+		if (!__atomic_load_n(&r->used, __ATOMIC_RELAXED) &&
+			__sync_bool_compare_and_swap(&r->used, 0, 1))
+			break;
+	}
+
+	if (r == NULL) {
+		if (posix_memalign((void **)&r, TREE_MAP_CACHELINE,
+				sizeof (*r))) {
+			perror("posix_memalign");
+			abort();
+		}
+		memset(r, 0, sizeof (*r));
+		r->used = 1;
+
+		/* the readers are never unlinked, so there is no ABA */
+		do {
+			r->next = __atomic_load_n(&tree_map_readers,
+				__ATOMIC_ACQUIRE);
+		} while (!__sync_bool_compare_and_swap(&tree_map_readers,
+				r->next, r));
+	}
+
+	pthread_setspecific(tree_map_readers_key, r);
+	tree_map_self = r;
+
+	return r;
+}
+
+/*
+ * tree_map_read_begin -- protects the objects seen from now on from being
+ *	freed
+ */
+static inline struct tree_map_reader *
+tree_map_read_begin(void)
+{
+	struct tree_map_reader *r = tree_map_reader_get();
+
+	/* a nested read keeps the epoch of the outer one */
+	if (r->nesting++ != 0)
+		return r;
+
+	/*
+	 * A writer which has missed the store may have already freed
+	 * the objects of the loaded epoch, then the epoch has changed.
+	 */
+	uint64_t epoch;
+	do {
+		epoch = __atomic_load_n(&tree_map_epoch, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&r->epoch, epoch, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&tree_map_epoch, __ATOMIC_SEQ_CST) != epoch);
+
+	return r;
+}
+
+/*
+ * tree_map_read_end -- counterpart of tree_map_read_begin
+ */
+static inline void
+tree_map_read_end(struct tree_map_reader *r)
+{
+	if (--r->nesting == 0)
+		__atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * tree_map_min_epoch -- (internal) returns the oldest epoch of the running
+ *	reads, UINT64_MAX if there are none
+ */
+static uint64_t
+tree_map_min_epoch(void)
+{
+	uint64_t min = UINT64_MAX;
+
+	/* orders the unlinks of the writer before the loads below */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	struct tree_map_reader *r =
+		__atomic_load_n(&tree_map_readers, __ATOMIC_ACQUIRE);
+	for (; r != NULL; r = r->next) {
+		uint64_t e = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST);
+		if (e != 0 && e < min)
+			min = e;
+	}
+
+	return min;
+}
+
+/*
+ * tree_map_seq -- returns the sequence counter of the map
+ *
+ * The counters are kept in DRAM and never freed, a map created at the address
+ * of a deleted one reuses its counter.
+ */
+static struct tree_map_seq *
+tree_map_seq(const void *map)
+{
+	uintptr_t h = (uintptr_t)map / TREE_MAP_CACHELINE;
+	struct tree_map_seq **bucket =
+		&tree_map_seqs[(h ^ (h >> 8)) & (TREE_MAP_SEQS - 1)];
+	struct tree_map_seq *head = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+	struct tree_map_seq *checked = NULL; /* the counters from it on */
+	struct tree_map_seq *c = NULL;
+
+	for (;;) {
+		for (struct tree_map_seq *e = head; e != checked; e = e->next) {
+			if (e->map == map) {
+				free(c);
+				return e;
+			}
+		}
+
+		if (c == NULL) {
+			if (posix_memalign((void **)&c, TREE_MAP_CACHELINE,
+					sizeof (*c))) {
+				perror("posix_memalign");
+				abort();
+			}
+			memset(c, 0, sizeof (*c));
+			c->map = map;
+		}
+
+		/* the counters are only added at the head, there is no ABA */
+		c->next = head;
+		if (__sync_bool_compare_and_swap(bucket, head, c))
+			return c;
+
+		checked = head;
+		head = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+	}
+}
+
+/*
+ * tree_map_seq_begin -- returns the sequence counter value to validate the
+ *	loads of a reader with, waits for the transaction changing the map
+ *	if it's not the one of the calling thread
+ */
+static inline uint64_t
+tree_map_seq_begin(const struct tree_map_seq *c)
+{
+	uint64_t s;
+	while (((s = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE)) & 1) &&
+			__atomic_load_n(&c->owner, __ATOMIC_RELAXED) !=
+			&tree_map_me)
+		sched_yield();
+
+	return s;
+}
+
+/*
+ * tree_map_seq_changed -- checks if the values loaded since
+ *	tree_map_seq_begin may be inconsistent or not committed
+ */
+static inline int
+tree_map_seq_changed(const struct tree_map_seq *c, uint64_t s)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&c->seq, __ATOMIC_RELAXED) != s;
+}
+
+/*
+ * tree_map_release -- (internal) ends the change of the map once the
+ *	transaction has been committed or rolled back, starts a new epoch
+ *	if it unlinked any object, the reads which begin from now on can't
+ *	see them
+ */
+static void
+tree_map_release(PMEMobjpool *pop, enum pobj_tx_stage stage, void *arg)
+{
+	struct tree_map_seq *c = arg;
+
+	if (c->retired)
+		__atomic_add_fetch(&tree_map_epoch, 1, __ATOMIC_SEQ_CST);
+
+	__atomic_store_n(&c->owner, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * tree_map_hold -- (internal) starts a change of the map which lasts until
+ *	the outermost transaction ends, the map lock must be held
+ */
+static void
+tree_map_hold(struct tree_map_seq *c)
+{
+	if (__atomic_load_n(&c->owner, __ATOMIC_RELAXED) == &tree_map_me)
+		return;
+
+	int err = pmemobj_tx_on_end(tree_map_release, c);
+	if (err) {
+		pmemobj_tx_abort(err);
+		return;
+	}
+
+	c->retired = 0;
+	__atomic_store_n(&c->owner, &tree_map_me, __ATOMIC_RELAXED);
+	__atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*
+ * tree_map_retire -- appends an unlinked object to the limbo list
+ *
+ * The object can still be in use by the running reads, it's freed by one
+ * of the following writes.
+ */
+static inline void
+tree_map_retire(struct tree_map_op *op, uint64_t off)
+{
+	struct tree_map_limbo *l = op->limbo;
+	struct tree_map_retired *r =
+		(struct tree_map_retired *)((char *)op->pop + off);
+
+	/* the header of a linked object is unused, it needs no snapshot */
+	r->next = 0;
+	r->epoch = __atomic_load_n(&tree_map_epoch, __ATOMIC_SEQ_CST);
+
+	pmemobj_tx_add_range_direct(&l->head, 2 * sizeof (l->head));
+
+	if (l->tail == 0) {
+		l->head = off;
+	} else {
+		struct tree_map_retired *tail = (struct tree_map_retired *)
+			((char *)op->pop + l->tail);
+
+		/* only the tail from before the operation is reachable */
+		if (l->tail == op->tail)
+			pmemobj_tx_add_range_direct(&tail->next,
+				sizeof (tail->next));
+		tail->next = off;
+	}
+	l->tail = off;
+
+	op->seq->retired = 1;
+}
+
+/*
+ * tree_map_reclaim -- (internal) frees the retired objects which no running
+ *	read can use anymore
+ */
+static void
+tree_map_reclaim(struct tree_map_op *op)
+{
+	struct tree_map_limbo *l = op->limbo;
+	uint64_t min = tree_map_min_epoch();
+
+	/* no read of the previous runs can still be going on */
+	if (l->session != tree_map_session) {
+		pmemobj_tx_add_range_direct(&l->session, sizeof (l->session));
+		l->session = tree_map_session;
+		min = UINT64_MAX;
+	}
+
+	uint64_t head = l->head;
+	if (head == 0 || ((struct tree_map_retired *)
+			((char *)op->pop + head))->epoch >= min)
+		return;
+
+	pmemobj_tx_add_range_direct(&l->head, 2 * sizeof (l->head));
+
+	while (head != 0) {
+		struct tree_map_retired *r = (struct tree_map_retired *)
+			((char *)op->pop + head);
+		if (r->epoch >= min)
+			break;
+
+		head = r->next;
+		pmemobj_tx_free(pmemobj_oid(r));
+	}
+
+	l->head = head;
+	if (head == 0)
+		l->tail = 0;
+	op->tail = l->tail;
+}
+
+/*
+ * tree_map_op_begin -- prepares a write operation, must be called within
+ *	a transaction holding the map lock, before the first change of the map
+ */
+static inline void
+tree_map_op_begin(struct tree_map_op *op, PMEMobjpool *pop, const void *map,
+	struct tree_map_limbo *limbo)
+{
+	pthread_once(&tree_map_readers_once, tree_map_readers_init);
+
+	op->pop = pop;
+	op->limbo = limbo;
+	op->seq = tree_map_seq(map);
+	op->tail = limbo->tail;
+
+	tree_map_hold(op->seq);
+	tree_map_reclaim(op);
+}
+
+/*
+ * tree_map_limbo_free -- frees all the retired objects, must be called
+ *	within a transaction when the map is not in use by any other thread
+ */
+static inline void
+tree_map_limbo_free(PMEMobjpool *pop, struct tree_map_limbo *limbo)
+{
+	for (uint64_t off = limbo->head; off != 0; ) {
+		struct tree_map_retired *r = (struct tree_map_retired *)
+			((char *)pop + off);
+		off = r->next;
+		pmemobj_tx_free(pmemobj_oid(r));
+	}
+}
+
+#endif /* TREE_MAP_EPOCH_H */
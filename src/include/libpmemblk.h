@@ -74,6 +74,8 @@ const char *pmemblk_check_version(
 PMEMblkpool *pmemblk_open(const char *path, size_t bsize);
 PMEMblkpool *pmemblk_create(const char *path, size_t bsize,
 		size_t poolsize, mode_t mode);
+PMEMblkpool *pmemblk_create_csum(const char *path, size_t bsize,
+		size_t poolsize, mode_t mode);
 void pmemblk_close(PMEMblkpool *pbp);
 int pmemblk_check(const char *path, size_t bsize);
 size_t pmemblk_bsize(PMEMblkpool *pbp);
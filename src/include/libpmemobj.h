@@ -104,6 +104,16 @@ void pmemobj_set_funcs(
 		void *(*realloc_func)(void *ptr, size_t size),
 		char *(*strdup_func)(const char *s));
 
+/*
+ * Options of the pool file mappings, applied to pools opened or created
+ * after pmemobj_set_mmap_opts() is called.
+ */
+#define	PMEMOBJ_MMAP_HUGEPAGE	(1U << 0) /* madvise(MADV_HUGEPAGE) */
+#define	PMEMOBJ_MMAP_WILLNEED	(1U << 1) /* madvise(MADV_WILLNEED) */
+#define	PMEMOBJ_MMAP_PREFAULT	(1U << 2) /* fault in the pool on open */
+
+void pmemobj_set_mmap_opts(unsigned flags, unsigned prefault_threads);
+
 const char *pmemobj_errormsg(void);
 
 /*
@@ -306,6 +316,11 @@ TOID_DECLARE_ROOT(t);
 PMEMobjpool *pmemobj_pool_by_ptr(const void *addr);
 PMEMobjpool *pmemobj_pool_by_oid(PMEMoid oid);
 
+/*
+ * Returns the handle of an object from its direct pointer.
+ */
+PMEMoid pmemobj_oid(const void *addr);
+
 extern int _pobj_cache_invalidate;
 extern __thread struct _pobj_pcache {
 	PMEMobjpool *pop;
@@ -345,6 +360,80 @@ pmemobj_direct(PMEMoid oid)
 #define	D_RW	DIRECT_RW
 #define	D_RO	DIRECT_RO
 
+/*
+ * Pool-relative pointers
+ *
+ * RPTR(t) is an 8-byte alternative to TOID(t) for data structures which
+ * never reference objects from other pools. It holds only the offset of
+ * the object within its pool, so it is resolved against the pool handle
+ * with a single addition instead of the pool lookup done by
+ * pmemobj_direct(). Since the offset does not depend on where the pointer
+ * itself is stored, structures containing RPTRs may be freely copied
+ * and moved within the pool. The pointer type is declared separately from
+ * the typed OID, with RPTR_DECLARE(t).
+ */
+#define	RPTR(t)\
+union _toid_##t##_rptr
+
+/*
+ * Declaration of typed pool-relative pointer
+ */
+#define	RPTR_DECLARE(t)\
+RPTR(t)\
+{\
+	uint64_t off;\
+	t *_type;\
+}
+
+static inline void *
+_pobj_rptr_direct(PMEMobjpool *pop, uint64_t off)
+{
+	return off == 0 ? NULL : (void *)((uintptr_t)pop + off);
+}
+
+#define	RPTR_IS_NULL(r)	((r).off == 0)
+#define	RPTR_EQUALS(lhs, rhs)	((lhs).off == (rhs).off)
+
+#define	RPTR_RW(pop, r)\
+((__typeof__(*(r)._type) *)_pobj_rptr_direct((pop), (r).off))
+#define	RPTR_RO(pop, r)\
+((const __typeof__(*(r)._type) *)_pobj_rptr_direct((pop), (r).off))
+
+/*
+ * Assigns a typed OID, the types of both pointers must match
+ */
+#define	RPTR_ASSIGN(r, o) (\
+{\
+	__typeof__((r)._type) _pobj_type = (o)._type; (void)_pobj_type;\
+	(r).off = (o).oid.off;\
+	(r);\
+})
+
+/*
+ * Assigns an untyped object handle
+ */
+#define	RPTR_ASSIGN_OID(r, o) (\
+{\
+	(r).off = (o).off;\
+	(r);\
+})
+
+/*
+ * Assigns a direct pointer to an object from the pool pop
+ */
+#define	RPTR_ASSIGN_DIRECT(pop, r, p) (\
+{\
+	__typeof__((r)._type) _pobj_p = (p);\
+	(r).off = _pobj_p == NULL ? 0 :\
+		(uint64_t)((uintptr_t)_pobj_p - (uintptr_t)(pop));\
+	(r);\
+})
+
+/*
+ * Converts to an object handle, which can be assigned to a typed OID
+ */
+#define	RPTR_OID(pop, r) pmemobj_oid(RPTR_RO(pop, r))
+
 /*
  * Non-transactional atomic allocations
  *
@@ -483,23 +572,57 @@ PMEMoid pmemobj_first(PMEMobjpool *pop);
  */
 PMEMoid pmemobj_next(PMEMoid oid);
 
-#define	POBJ_FIRST_TYPE_NUM(pop, type_num) (\
-{ PMEMoid _pobj_ret = pmemobj_first(pop);\
-while (!OID_IS_NULL(_pobj_ret) &&\
-	pmemobj_type_num(_pobj_ret) != type_num) {\
-	_pobj_ret = pmemobj_next(_pobj_ret);\
-};\
-_pobj_ret; })
+/*
+ * Returns the first object of the specified type.
+ */
+PMEMoid pmemobj_first_type_num(PMEMobjpool *pop, uint64_t type_num);
+
+/*
+ * Returns the next object of the same type as oid.
+ */
+PMEMoid pmemobj_next_type_num(PMEMoid oid);
+
+/*
+ * Matches objects of any type in pmemobj_cursor_open and
+ * pmemobj_foreach_parallel.
+ */
+#define	POBJ_ANY_TYPE_NUM UINT64_MAX
+
+typedef struct pmemobjcursor PMEMobjcursor;
+
+/*
+ * Starts a sequential iteration through the objects of the specified type.
+ */
+PMEMobjcursor *pmemobj_cursor_open(PMEMobjpool *pop, uint64_t type_num);
+
+/*
+ * Returns the next object of the iteration, OID_NULL at its end.
+ */
+PMEMoid pmemobj_cursor_next(PMEMobjcursor *cur);
+
+/*
+ * Ends the iteration.
+ */
+void pmemobj_cursor_close(PMEMobjcursor *cur);
+
+/*
+ * Callback for pmemobj_foreach_parallel, a non-zero return value stops
+ * the iteration.
+ */
+typedef int (*pmemobj_foreach_cb)(PMEMoid oid, void *arg);
+
+/*
+ * Calls cb for every object of the specified type, using nthreads threads.
+ */
+int pmemobj_foreach_parallel(PMEMobjpool *pop, uint64_t type_num,
+	pmemobj_foreach_cb cb, void *arg, unsigned nthreads);
+
+#define	POBJ_FIRST_TYPE_NUM(pop, type_num)\
+pmemobj_first_type_num((pop), (type_num))
 
 #define	POBJ_FIRST(pop, t) ((TOID(t))POBJ_FIRST_TYPE_NUM(pop, TOID_TYPE_NUM(t)))
 
-#define	POBJ_NEXT_TYPE_NUM(o) (\
-{ PMEMoid _pobj_ret = o;\
-do {\
-	_pobj_ret = pmemobj_next(_pobj_ret);\
-} while (!OID_IS_NULL(_pobj_ret) &&\
-	pmemobj_type_num(_pobj_ret) != pmemobj_type_num(o));\
-_pobj_ret; })
+#define	POBJ_NEXT_TYPE_NUM(o) pmemobj_next_type_num(o)
 
 #define	POBJ_NEXT(o) ((__typeof__(o))POBJ_NEXT_TYPE_NUM(o.oid))
 
@@ -589,16 +712,21 @@ for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH_SAFE")\
  * Iterates through every object of the specified type.
  */
 #define	POBJ_FOREACH_TYPE(pop, var)\
-POBJ_FOREACH(pop, var.oid)\
-if (pmemobj_type_num(var.oid) == TOID_TYPE_NUM_OF(var))
+for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH")\
+	(var).oid = pmemobj_first_type_num((pop), TOID_TYPE_NUM_OF(var));\
+		(var).oid.off != 0;\
+		(var).oid = pmemobj_next_type_num((var).oid))
 
 /*
  * Safe variant of POBJ_FOREACH_TYPE in which pmemobj_free on var
  * is allowed.
  */
 #define	POBJ_FOREACH_SAFE_TYPE(pop, var, nvar)\
-POBJ_FOREACH_SAFE(pop, var.oid, nvar.oid)\
-if (pmemobj_type_num(var.oid) == TOID_TYPE_NUM_OF(var))
+for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH_SAFE")\
+	(var).oid = pmemobj_first_type_num((pop), TOID_TYPE_NUM_OF(var));\
+		(var).oid.off != 0 &&\
+		((nvar).oid = pmemobj_next_type_num((var).oid), 1);\
+		(var).oid = (nvar).oid)
 
 /*
  * Non-transactional persistent atomic circular doubly-linked list
@@ -753,6 +881,68 @@ pmemobj_list_move((pop),\
 	(listelm).oid,\
 	1 /* before */, (elm).oid)
 
+/*
+ * Non-transactional persistent atomic singly-linked FIFO queue
+ *
+ * The head and the tail of the queue are protected by separate locks, so
+ * producers and consumers don't contend with each other unless the queue
+ * holds at most one element.
+ */
+#define	POBJ_QUEUE_ENTRY(type)\
+struct {\
+	TOID(type) pe_next;\
+}
+
+#define	POBJ_QUEUE_HEAD(name, type)\
+struct name {\
+	PMEMmutex head_lock;\
+	TOID(type) pe_first;\
+	uint64_t pe_unused[6];\
+	PMEMmutex tail_lock;\
+	TOID(type) pe_last;\
+}
+
+int pmemobj_queue_push(PMEMobjpool *pop, size_t pe_offset, void *head,
+	PMEMoid oid);
+
+PMEMoid pmemobj_queue_push_new(PMEMobjpool *pop, size_t pe_offset, void *head,
+	size_t size, uint64_t type_num, pmemobj_constr constructor, void *arg);
+
+int pmemobj_queue_pop(PMEMobjpool *pop, size_t pe_offset, void *head,
+	PMEMoid *oidp);
+
+#define	POBJ_QUEUE_FIRST(head)	((head)->pe_first)
+#define	POBJ_QUEUE_LAST(head)	((head)->pe_last)
+#define	POBJ_QUEUE_EMPTY(head)	(TOID_IS_NULL((head)->pe_first))
+#define	POBJ_QUEUE_NEXT(elm, field)	(D_RO(elm)->field.pe_next)
+
+#define	POBJ_QUEUE_FOREACH(var, head, field)\
+for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_QUEUE_FOREACH")\
+	(var) = POBJ_QUEUE_FIRST((head));\
+	!TOID_IS_NULL((var));\
+	(var) = POBJ_QUEUE_NEXT((var), field))
+
+#define	POBJ_QUEUE_PUSH(pop, head, elm, field)\
+pmemobj_queue_push((pop),\
+	offsetof(__typeof__ (*(POBJ_QUEUE_FIRST(head)._type)), field),\
+	(head), (elm).oid)
+
+#define	POBJ_QUEUE_PUSH_NEW(pop, head, field, size, constr, arg)\
+pmemobj_queue_push_new((pop),\
+	offsetof(__typeof__ (*(POBJ_QUEUE_FIRST(head)._type)), field),\
+	(head), (size), TOID_TYPE_NUM_OF(POBJ_QUEUE_FIRST(head)),\
+	(constr), (arg))
+
+#define	POBJ_QUEUE_POP(pop, head, field, oidp)\
+pmemobj_queue_pop((pop),\
+	offsetof(__typeof__ (*(POBJ_QUEUE_FIRST(head)._type)), field),\
+	(head), (oidp))
+
+#define	POBJ_QUEUE_POP_FREE(pop, head, field)\
+pmemobj_queue_pop((pop),\
+	offsetof(__typeof__ (*(POBJ_QUEUE_FIRST(head)._type)), field),\
+	(head), NULL)
+
 /*
  * Transactions
  *
@@ -775,6 +965,13 @@ enum pobj_tx_stage {
  */
 enum pobj_tx_stage pmemobj_tx_stage(void);
 
+/*
+ * Returns an identifier of the transaction in progress, unique within
+ * the calling thread. Nested transactions share the identifier of the
+ * outermost one. Returns 0 if the current stage is not TX_STAGE_WORK.
+ */
+uint64_t pmemobj_tx_id(void);
+
 enum pobj_tx_lock {
 	TX_LOCK_NONE,
 	TX_LOCK_MUTEX,	/* PMEMmutex */
@@ -791,11 +988,33 @@ enum pobj_tx_lock {
  */
 int pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...);
 
+/*
+ * Starts a new read-only transaction in the current thread.
+ *
+ * Works like pmemobj_tx_begin, but the transaction doesn't use a lane nor
+ * any persistent state and rwlocks are acquired for reading. Any attempt to
+ * modify, allocate or free an object within it aborts the transaction with
+ * EPERM. Transactions nested in a read-only transaction are read-only too.
+ */
+int pmemobj_tx_begin_ro(PMEMobjpool *pop, jmp_buf env, ...);
+
 /*
  * Adds lock of given type to current transaction.
  */
 int pmemobj_tx_lock(enum pobj_tx_lock type, void *lockp);
 
+typedef void (*pmemobj_tx_callback)(PMEMobjpool *pop,
+	enum pobj_tx_stage stage, void *arg);
+
+/*
+ * Registers a function to be called once the outermost transaction ends,
+ * with TX_STAGE_ONCOMMIT after it has been committed, or TX_STAGE_ONABORT
+ * after the changes of an aborted one have been rolled back. The functions
+ * are called in the order of registration, before the transaction locks
+ * are released, and must not modify the pool.
+ */
+int pmemobj_tx_on_end(pmemobj_tx_callback func, void *arg);
+
 /*
  * Aborts current transaction
  *
@@ -850,7 +1069,7 @@ int pmemobj_tx_errno(void);
 #define	TX_ONABORT_CHECK do {} while (0)
 #endif
 
-#define	_POBJ_TX_BEGIN(pop, ...)\
+#define	_POBJ_TX_BEGIN_COMMON(begin, pop, ...)\
 {\
 	jmp_buf _tx_env;\
 	int _stage;\
@@ -858,7 +1077,7 @@ int pmemobj_tx_errno(void);
 	if (setjmp(_tx_env)) {\
 		errno = pmemobj_tx_errno();\
 	} else {\
-		_pobj_errno = pmemobj_tx_begin(pop, _tx_env, __VA_ARGS__,\
+		_pobj_errno = begin(pop, _tx_env, __VA_ARGS__,\
 				TX_LOCK_NONE);\
 		if (_pobj_errno)\
 			errno = _pobj_errno;\
@@ -867,11 +1086,19 @@ int pmemobj_tx_errno(void);
 		switch (_stage) {\
 			case TX_STAGE_WORK:
 
+#define	_POBJ_TX_BEGIN(pop, ...)\
+_POBJ_TX_BEGIN_COMMON(pmemobj_tx_begin, pop, __VA_ARGS__)
+
 #define	TX_BEGIN_LOCK(pop, ...)\
 _POBJ_TX_BEGIN(pop, ##__VA_ARGS__)
 
 #define	TX_BEGIN(pop) _POBJ_TX_BEGIN(pop, TX_LOCK_NONE)
 
+#define	TX_BEGIN_RO_LOCK(pop, ...)\
+_POBJ_TX_BEGIN_COMMON(pmemobj_tx_begin_ro, pop, ##__VA_ARGS__)
+
+#define	TX_BEGIN_RO(pop) TX_BEGIN_RO_LOCK(pop, TX_LOCK_NONE)
+
 #define	TX_ONABORT\
 				pmemobj_tx_process();\
 				break;\
@@ -40,31 +40,151 @@
 #include "libpmemobj/detail/pexceptions.hpp"
 #include "libpmemobj.h"
 
+#include <cstddef>
+#include <cstdint>
+
 namespace nvml {
 
 namespace detail {
 
+	/*
+	 * Per-thread filter of memory already added to the current transaction.
+	 *
+	 * Each entry of the direct-mapped table describes the part of a single
+	 * cache line which has been snapshotted within the transaction with
+	 * the given identifier. Colliding lines simply evict each other, so
+	 * a lookup may miss a snapshotted range, but it never reports a range
+	 * which has not been added. Entries of finished transactions are
+	 * invalidated by the identifier, the table is never cleared.
+	 */
+	class snapshot_filter {
+	public:
+		/*
+		 * Checks whether the whole range is known to be snapshotted.
+		 */
+		static bool contains(uint64_t txid, const void *addr,
+				std::size_t len) noexcept
+		{
+			uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+			uintptr_t end = begin + len;
+
+			for (uintptr_t line = begin & ~(line_size - 1);
+					line < end; line += line_size) {
+				const entry &e = table()[index(line)];
+				if (e.line != line || e.txid != txid)
+					return false;
+
+				if (offset(begin, line) < e.lo ||
+						offset(end, line) > e.hi)
+					return false;
+			}
+
+			return true;
+		}
+
+		/*
+		 * Records a range which has been added to the transaction.
+		 */
+		static void insert(uint64_t txid, const void *addr,
+				std::size_t len) noexcept
+		{
+			uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+			uintptr_t end = begin + len;
+			std::size_t n = 0;
+
+			/* lines past the table size would evict each other */
+			for (uintptr_t line = begin & ~(line_size - 1);
+					line < end && n < entries;
+					line += line_size, ++n) {
+				entry &e = table()[index(line)];
+				uint8_t lo = offset(begin, line);
+				uint8_t hi = offset(end, line);
+
+				/* extend the entry if the ranges touch */
+				if (e.line == line && e.txid == txid &&
+						lo <= e.hi && hi >= e.lo) {
+					if (lo < e.lo)
+						e.lo = lo;
+					if (hi > e.hi)
+						e.hi = hi;
+				} else {
+					e.line = line;
+					e.txid = txid;
+					e.lo = lo;
+					e.hi = hi;
+				}
+			}
+		}
+
+	private:
+		static const uintptr_t line_size = 64;
+		static const std::size_t entries = 256;
+
+		struct entry {
+			uintptr_t line;
+			uint64_t txid;
+			uint8_t lo;
+			uint8_t hi;
+		};
+
+		static std::size_t index(uintptr_t line) noexcept
+		{
+			return (line / line_size) & (entries - 1);
+		}
+
+		/*
+		 * Offset of addr clamped to the given cache line.
+		 */
+		static uint8_t offset(uintptr_t addr, uintptr_t line) noexcept
+		{
+			if (addr <= line)
+				return 0;
+			if (addr >= line + line_size)
+				return static_cast<uint8_t>(line_size);
+
+			return static_cast<uint8_t>(addr - line);
+		}
+
+		static entry *table() noexcept
+		{
+			static thread_local entry t[entries];
+
+			return t;
+		}
+	};
+
 	/*
 	 * Conditionally add an object to a transaction.
 	 *
 	 * Adds `*that` to the transaction if it is within a pmemobj pool and
-	 * there is an active transaction. Does nothing otherwise.
+	 * there is an active transaction. Does nothing otherwise, or if the
+	 * object is already known to be snapshotted in this transaction.
 	 *
 	 * @param[in] that pointer to the object being added to the transaction.
+	 * @param[in] count number of consecutive objects to be added.
 	 */
 	template<typename T>
-	inline void conditional_add_to_tx(const T *that)
+	inline void conditional_add_to_tx(const T *that, std::size_t count = 1)
 	{
-		/* 'that' is not in any open pool */
-		if (!pmemobj_pool_by_ptr(that))
+		uint64_t txid = pmemobj_tx_id();
+
+		/* no transaction in progress */
+		if (txid == 0)
+			return;
+
+		std::size_t len = sizeof (*that) * count;
+		if (snapshot_filter::contains(txid, that, len))
 			return;
 
-		if (pmemobj_tx_stage() != TX_STAGE_WORK)
+		/* 'that' is not in any open pool */
+		if (!pmemobj_pool_by_ptr(that))
 			return;
 
-		if (pmemobj_tx_add_range_direct(that, sizeof (*that)))
+		if (pmemobj_tx_add_range_direct(that, len))
 			throw transaction_error("Could not add an object to the"
 					" transaction.");
+
+		snapshot_filter::insert(txid, that, len);
 	}
 
 	/*
@@ -38,7 +38,11 @@
 #ifndef LIBPMEMOBJ_MAKE_ATOMIC_IMPL_HPP
 #define LIBPMEMOBJ_MAKE_ATOMIC_IMPL_HPP
 
+#include <cstring>
 #include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "libpmemobj/detail/integer_sequence.hpp"
 #include "libpmemobj/detail/destroyer.hpp"
@@ -51,13 +55,14 @@ namespace detail {
 	/*
 	 * Calls the objects constructor.
 	 *
-	 * Unpacks the tuple to get constructor's parameters.
+	 * Unpacks the tuple to get constructor's parameters. The tuple holds
+	 * references, which are forwarded with their original value category.
 	 */
 	template<typename T, size_t... Indices, typename... Args>
 	void create_object(void *ptr, index_sequence<Indices...>,
 			std::tuple<Args...> &tuple)
 	{
-		new (ptr) T(std::get<Indices>(tuple)...);
+		new (ptr) T(std::forward<Args>(std::get<Indices>(tuple))...);
 	}
 
 	/*
@@ -85,6 +90,9 @@ namespace detail {
 	/*
 	 * Constructor used for atomic array allocations.
 	 *
+	 * Trivially default-constructible elements are value-initialized by
+	 * zeroing the whole array at once.
+	 *
 	 * Returns -1 if an exception was thrown during T's construction,
 	 * 0 otherwise.
 	 */
@@ -93,6 +101,11 @@ namespace detail {
 	{
 		std::size_t N = *static_cast<std::size_t*>(arg);
 
+		if (std::is_trivially_default_constructible<T>::value) {
+			pmemobj_memset_persist(pop, ptr, 0, sizeof(T) * N);
+			return 0;
+		}
+
 		T *tptr = static_cast<T*>(ptr);
 		try {
 			for (std::size_t i = 0; i < N; ++i)
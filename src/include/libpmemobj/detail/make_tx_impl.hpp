@@ -0,0 +1,117 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * make_tx_impl.hpp -- implementation details of transactional allocation
+ * and construction.
+ */
+
+#ifndef LIBPMEMOBJ_MAKE_TX_IMPL_HPP
+#define LIBPMEMOBJ_MAKE_TX_IMPL_HPP
+
+#include <new>
+#include <type_traits>
+
+#include "libpmemobj/detail/common.hpp"
+#include "libpmemobj/detail/destroyer.hpp"
+#include "libpmemobj/detail/pexceptions.hpp"
+#include "libpmemobj.h"
+
+namespace nvml {
+
+namespace detail {
+
+	/*
+	 * Transactionally allocates memory for n objects of type I.
+	 *
+	 * If zero is set the memory is zeroed by the allocator, which is
+	 * how trivially default-constructible types get value-initialized
+	 * without running any constructor. Otherwise the new memory is
+	 * recorded as snapshotted - it is already tracked as an allocation
+	 * of this transaction, so the writes done by the constructors do
+	 * not have to reach the undo log.
+	 *
+	 * Returns OID_NULL if the allocation failed.
+	 */
+	template<typename I>
+	PMEMoid tx_alloc(std::size_t n, bool zero)
+	{
+		uint64_t txid = pmemobj_tx_id();
+		if (txid == 0)
+			throw transaction_scope_error("refusing to allocate "
+				"memory outside of transaction scope");
+
+		if (n > PMEMOBJ_MAX_ALLOC_SIZE / sizeof (I))
+			return OID_NULL;
+
+		PMEMoid oid = zero ?
+			pmemobj_tx_zalloc(sizeof (I) * n, type_num<I>()) :
+			pmemobj_tx_alloc(sizeof (I) * n, type_num<I>());
+
+		if (!zero && !OID_IS_NULL(oid))
+			snapshot_filter::insert(txid, pmemobj_direct(oid),
+					sizeof (I) * n);
+
+		return oid;
+	}
+
+	/*
+	 * Default-constructs n objects of type I in place.
+	 *
+	 * If one of the constructors throws, the objects constructed so far
+	 * are destroyed. Types which cannot throw skip the bookkeeping.
+	 */
+	template<typename I>
+	void construct_array(I *first, std::size_t n)
+	{
+		if (std::is_nothrow_default_constructible<I>::value) {
+			for (std::size_t i = 0; i < n; ++i)
+				::new (first + i) I();
+			return;
+		}
+
+		std::size_t i = 0;
+		try {
+			for (; i < n; ++i)
+				::new (first + i) I();
+		} catch (...) {
+			while (i-- > 0)
+				destroy<I>(first[i]);
+			throw;
+		}
+	}
+
+}  /* namespace detail */
+
+}  /* namespace nvml */
+
+#endif /* LIBPMEMOBJ_MAKE_TX_IMPL_HPP */
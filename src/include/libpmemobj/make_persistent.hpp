@@ -41,9 +41,12 @@
 #include "libpmemobj/detail/common.hpp"
 #include "libpmemobj/detail/pexceptions.hpp"
 #include "libpmemobj/detail/check_persistent_ptr_array.hpp"
+#include "libpmemobj/detail/make_tx_impl.hpp"
 #include "libpmemobj.h"
 
 #include <new>
+#include <type_traits>
+#include <utility>
 
 namespace nvml {
 
@@ -53,7 +56,11 @@ namespace obj {
 	 * Transactionally allocate and construct an object of type T.
 	 *
 	 * This function can be used to Transactionally allocate an object.
-	 * Cannot be used for array types.
+	 * Cannot be used for array types. The arguments are perfectly
+	 * forwarded to the constructor, whose writes to the fresh object are
+	 * not added to the undo log. A trivially default-constructible object
+	 * created without arguments is zeroed by the allocator instead of
+	 * being constructed.
 	 *
 	 * @param[in,out] args a list of parameters passed to the constructor.
 	 *
@@ -67,18 +74,20 @@ namespace obj {
 	typename detail::pp_if_not_array<T>::type
 	make_persistent(Args &&... args)
 	{
-		if (pmemobj_tx_stage() != TX_STAGE_WORK)
-			throw transaction_scope_error("refusing to allocate "
-				"memory outside of transaction scope");
+		const bool zero = sizeof...(Args) == 0 &&
+			std::is_trivially_default_constructible<T>::value;
 
-		persistent_ptr<T> ptr = pmemobj_tx_alloc(sizeof (T),
-			detail::type_num<T>());
+		persistent_ptr<T> ptr = detail::tx_alloc<T>(1, zero);
 
 		if (ptr == nullptr)
 			throw transaction_alloc_error("failed to allocate "
 				"persistent memory object");
+
+		if (zero)
+			return ptr;
+
 		try {
-			new (ptr.get()) T(args...);
+			new (ptr.get()) T(std::forward<Args>(args)...);
 		} catch (...) {
 			pmemobj_tx_free(*ptr.raw_ptr());
 			throw;
@@ -41,9 +41,12 @@
 #include "libpmemobj/detail/destroyer.hpp"
 #include "libpmemobj/detail/array_traits.hpp"
 #include "libpmemobj/detail/check_persistent_ptr_array.hpp"
+#include "libpmemobj/detail/make_tx_impl.hpp"
 #include "libpmemobj/detail/pexceptions.hpp"
 #include "libpmemobj.h"
 
+#include <type_traits>
+
 namespace nvml {
 
 namespace obj {
@@ -52,7 +55,9 @@ namespace obj {
 	 * Transactionally allocate and construct an array of objects of type T.
 	 *
 	 * This function can be used to Transactionally allocate an array.
-	 * Cannot be used for simple objects.
+	 * Cannot be used for simple objects. Arrays of trivially
+	 * default-constructible types are zeroed by the allocator in one go,
+	 * without constructing the elements one by one.
 	 *
 	 * @param[in] N the number of array elements.
 	 *
@@ -67,24 +72,21 @@ namespace obj {
 	{
 		typedef typename detail::pp_array_type<T>::type I;
 
-		if (pmemobj_tx_stage() != TX_STAGE_WORK)
-			throw transaction_scope_error("refusing to allocate "
-				"memory outside of transaction scope");
+		const bool zero =
+			std::is_trivially_default_constructible<I>::value;
 
-		persistent_ptr<T> ptr = pmemobj_tx_alloc(sizeof (I) * N,
-			detail::type_num<I>());
+		persistent_ptr<T> ptr = detail::tx_alloc<I>(N, zero);
 
 		if (ptr == nullptr)
 			throw transaction_alloc_error("failed to allocate "
 				"persistent memory array");
 
-		std::size_t i;
+		if (zero)
+			return ptr;
+
 		try {
-			for (i = 0; i < N; ++i)
-				::new (ptr.get() + i) I();
+			detail::construct_array<I>(ptr.get(), N);
 		} catch (...) {
-			for (std::size_t j = 1; j <= i; ++j)
-				detail::destroy<I>(ptr[i - j]);
 			pmemobj_tx_free(*ptr.raw_ptr());
 			throw;
 		}
@@ -96,7 +98,9 @@ namespace obj {
 	 * Transactionally allocate and construct an array of objects of type T.
 	 *
 	 * This function can be used to Transactionally allocate an array.
-	 * Cannot be used for simple objects.
+	 * Cannot be used for simple objects. Arrays of trivially
+	 * default-constructible types are zeroed by the allocator in one go,
+	 * without constructing the elements one by one.
 	 *
 	 * @return persistent_ptr<T[N]> on success
 	 *
@@ -112,24 +116,21 @@ namespace obj {
 			N = detail::pp_array_elems<T>::elems
 		};
 
-		if (pmemobj_tx_stage() != TX_STAGE_WORK)
-			throw transaction_scope_error("refusing to allocate "
-				"memory outside of transaction scope");
+		const bool zero =
+			std::is_trivially_default_constructible<I>::value;
 
-		persistent_ptr<T> ptr = pmemobj_tx_alloc(sizeof (I) * N,
-			detail::type_num<I>());
+		persistent_ptr<T> ptr = detail::tx_alloc<I>(N, zero);
 
 		if (ptr == nullptr)
 			throw transaction_alloc_error("failed to allocate "
 				"persistent memory array");
 
-		std::size_t i;
+		if (zero)
+			return ptr;
+
 		try {
-			for (i = 0; i < N; ++i)
-				::new (ptr.get() + i) I();
+			detail::construct_array<I>(ptr.get(), N);
 		} catch (...) {
-			for (std::size_t j = 1; j <= i; ++j)
-				detail::destroy<I>(ptr[i - j]);
 			pmemobj_tx_free(*ptr.raw_ptr());
 			throw;
 		}
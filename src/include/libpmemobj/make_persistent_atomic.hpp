@@ -67,10 +67,11 @@ namespace obj {
 			typename detail::pp_if_not_array<T>::type &ptr,
 			Args &&...args)
 	{
-		auto arg_pack = std::make_tuple(args...);
+		auto arg_pack = std::forward_as_tuple(
+			std::forward<Args>(args)...);
 		auto ret = pmemobj_alloc(pool.get_handle(), ptr.raw_ptr(),
 			sizeof (T), detail::type_num<T>(),
-			&detail::obj_constructor<T, Args...>,
+			&detail::obj_constructor<T, Args &&...>,
 			static_cast<void*>(&arg_pack));
 
 		if (ret != 0)
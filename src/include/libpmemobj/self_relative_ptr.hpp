@@ -0,0 +1,297 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * self_relative_ptr.hpp -- compact persistent pointer within a pool
+ */
+
+#ifndef PMEMOBJ_SELF_RELATIVE_PTR_HPP
+#define PMEMOBJ_SELF_RELATIVE_PTR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "libpmemobj/detail/common.hpp"
+#include "libpmemobj/persistent_ptr.hpp"
+#include "libpmemobj.h"
+
+namespace nvml
+{
+
+namespace obj
+{
+
+	/**
+	 * Compact persistent pointer to an object in the same pool.
+	 *
+	 * The self_relative_ptr holds the distance between its own location
+	 * and the pointed-to object, which takes 8 bytes instead of the 16
+	 * bytes of a persistent_ptr and is dereferenced with a single
+	 * addition, without the pool lookup done by pmemobj_direct. The
+	 * pointer and the object must reside in the same pool.
+	 *
+	 * The distance is stored biased by one, so that zeroed memory reads
+	 * as a null pointer while a pointer embedded in an object may still
+	 * point to that object. Copying recomputes the distance for the new
+	 * location, thus the type is not trivially copyable and must not be
+	 * moved with memcpy.
+	 */
+	template<typename T>
+	class self_relative_ptr
+	{
+	public:
+		typedef T element_type;
+
+		/**
+		 * Default constructor, zeroes the pointer.
+		 */
+		self_relative_ptr() noexcept : offset(0)
+		{
+		}
+
+		/**
+		 * Nullptr constructor.
+		 */
+		self_relative_ptr(std::nullptr_t) noexcept : offset(0)
+		{
+		}
+
+		/**
+		 * Constructor from a direct pointer to a persistent object.
+		 */
+		explicit self_relative_ptr(element_type *ptr) noexcept :
+			offset(offset_to(ptr))
+		{
+		}
+
+		/**
+		 * Explicit conversion from a persistent_ptr.
+		 */
+		explicit self_relative_ptr(const persistent_ptr<T> &ptr)
+			noexcept : offset(offset_to(ptr.get()))
+		{
+		}
+
+		/**
+		 * Copy constructor, recomputes the distance for this location.
+		 */
+		self_relative_ptr(const self_relative_ptr &r) noexcept :
+			offset(offset_to(r.get()))
+		{
+		}
+
+		/**
+		 * Assignment operator.
+		 *
+		 * Self-relative pointer assignment within a transaction
+		 * automatically registers this operation so that a rollback
+		 * is possible.
+		 */
+		self_relative_ptr &
+		operator=(const self_relative_ptr &r)
+		{
+			return assign(r.get());
+		}
+
+		/**
+		 * Nullptr assignment operator.
+		 */
+		self_relative_ptr &
+		operator=(std::nullptr_t)
+		{
+			return assign(nullptr);
+		}
+
+		/**
+		 * Assignment from a persistent_ptr.
+		 */
+		self_relative_ptr &
+		operator=(const persistent_ptr<T> &r)
+		{
+			return assign(r.get());
+		}
+
+		/**
+		 * Dereference operator.
+		 */
+		element_type &
+		operator*() const noexcept
+		{
+			return *get();
+		}
+
+		/**
+		 * Member access operator.
+		 */
+		element_type *
+		operator->() const noexcept
+		{
+			return get();
+		}
+
+		/**
+		 * Get a direct pointer.
+		 *
+		 * @return a direct pointer to the object or nullptr.
+		 */
+		element_type *
+		get() const noexcept
+		{
+			if (offset == 0)
+				return nullptr;
+
+			return reinterpret_cast<element_type *>(
+				reinterpret_cast<intptr_t>(this) + offset + 1);
+		}
+
+		/**
+		 * Get the object handle.
+		 *
+		 * Unlike get(), this looks up the pool of the object.
+		 *
+		 * @return PMEMoid of the object or OID_NULL.
+		 */
+		PMEMoid
+		raw() const noexcept
+		{
+			return pmemobj_oid(get());
+		}
+
+		/**
+		 * Explicit conversion to a persistent_ptr.
+		 */
+		explicit operator persistent_ptr<T>() const noexcept
+		{
+			return persistent_ptr<T>(raw());
+		}
+
+		/**
+		 * Checks if the pointer is not null.
+		 */
+		explicit operator bool() const noexcept
+		{
+			return offset != 0;
+		}
+
+	private:
+		/*
+		 * Biased distance between this and ptr.
+		 */
+		std::ptrdiff_t
+		offset_to(const element_type *ptr) const noexcept
+		{
+			if (ptr == nullptr)
+				return 0;
+
+			return reinterpret_cast<intptr_t>(ptr) -
+				reinterpret_cast<intptr_t>(this) - 1;
+		}
+
+		self_relative_ptr &
+		assign(const element_type *ptr)
+		{
+			detail::conditional_add_to_tx(this);
+			this->offset = offset_to(ptr);
+
+			return *this;
+		}
+
+		std::ptrdiff_t offset;
+	};
+
+	/**
+	 * Equality operator.
+	 */
+	template<typename T, typename Y>
+	inline bool
+	operator==(const self_relative_ptr<T> &lhs,
+		const self_relative_ptr<Y> &rhs) noexcept
+	{
+		return lhs.get() == rhs.get();
+	}
+
+	/**
+	 * Inequality operator.
+	 */
+	template<typename T, typename Y>
+	inline bool
+	operator!=(const self_relative_ptr<T> &lhs,
+		const self_relative_ptr<Y> &rhs) noexcept
+	{
+		return !(lhs == rhs);
+	}
+
+	/**
+	 * Equality operator with nullptr.
+	 */
+	template<typename T>
+	inline bool
+	operator==(const self_relative_ptr<T> &lhs, std::nullptr_t) noexcept
+	{
+		return !bool(lhs);
+	}
+
+	/**
+	 * Equality operator with nullptr.
+	 */
+	template<typename T>
+	inline bool
+	operator==(std::nullptr_t, const self_relative_ptr<T> &rhs) noexcept
+	{
+		return !bool(rhs);
+	}
+
+	/**
+	 * Inequality operator with nullptr.
+	 */
+	template<typename T>
+	inline bool
+	operator!=(const self_relative_ptr<T> &lhs, std::nullptr_t) noexcept
+	{
+		return bool(lhs);
+	}
+
+	/**
+	 * Inequality operator with nullptr.
+	 */
+	template<typename T>
+	inline bool
+	operator!=(std::nullptr_t, const self_relative_ptr<T> &rhs) noexcept
+	{
+		return bool(rhs);
+	}
+
+}  /* namespace obj */
+
+}  /* namespace nvml */
+
+#endif /* PMEMOBJ_SELF_RELATIVE_PTR_HPP */
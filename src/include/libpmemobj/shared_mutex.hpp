@@ -49,7 +49,9 @@ namespace obj {
 	 * This class is an implementation of a PMEM-resident share_mutex
 	 * which mimics in behavior the C++11 std::mutex. This class
 	 * satisfies all requirements of the SharedMutex and StandardLayoutType
-	 * concepts.
+	 * concepts. When the PMEMOBJ_RWLOCK_READER_BIAS environment variable
+	 * is set, shared ownership is taken without writing to any cache line
+	 * shared with other readers.
 	 */
 	class shared_mutex
 	{
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * string.hpp -- persistent character string
+ */
+
+#ifndef PMEMOBJ_STRING_HPP
+#define PMEMOBJ_STRING_HPP
+
+#include "libpmemobj/vector.hpp"
+
+#include <cstring>
+#include <string>
+
+namespace nvml {
+
+namespace obj {
+
+	/**
+	 * Persistent null-terminated character string.
+	 *
+	 * The characters, including the terminating null, are stored in
+	 * a persistent vector, so they are contiguous in persistent memory
+	 * and grow geometrically. Appending snapshots only the terminator
+	 * that gets overwritten, replacing the contents snapshots the old
+	 * ones. All modifiers must be called within an active transaction.
+	 */
+	class string
+	{
+	public:
+		typedef std::size_t size_type;
+
+		static const size_type npos = static_cast<size_type>(-1);
+
+		/**
+		 * Default constructor, creates an empty string.
+		 */
+		string() = default;
+
+		/**
+		 * Creates a string holding a copy of s.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		string(const char *s)
+		{
+			assign(s);
+		}
+
+		string(const std::string &s)
+		{
+			assign(s.c_str(), s.size());
+		}
+
+		string(const string &) = delete;
+
+		string &operator=(const string &) = delete;
+
+		string &operator=(const char *s)
+		{
+			return assign(s);
+		}
+
+		string &operator=(const std::string &s)
+		{
+			return assign(s.c_str(), s.size());
+		}
+
+		/**
+		 * Replaces the contents with a copy of the first n characters
+		 * of s.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 * @throw transaction_error if the old contents could not be
+		 * added to the transaction.
+		 */
+		string &assign(const char *s, size_type n)
+		{
+			/* the old contents are snapshotted before removal */
+			chars.clear();
+
+			return append(s, n);
+		}
+
+		string &assign(const char *s)
+		{
+			return assign(s, strlen(s));
+		}
+
+		/**
+		 * Appends the first n characters of s.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		string &append(const char *s, size_type n)
+		{
+			size_type len = size();
+
+			/* the old terminator is overwritten, keep it */
+			chars.resize(len + n + 1);
+			char *dst = chars.range(len, 1);
+			if (n != 0)
+				memcpy(dst, s, n);
+			dst[n] = '\0';
+
+			/*
+			 * The rest lies past the old size, it is either not
+			 * committed or snapshotted by an earlier removal in
+			 * this transaction - just persist it.
+			 */
+			if (n != 0)
+				pmemobj_persist(pmemobj_pool_by_ptr(dst),
+						dst + 1, n);
+
+			return *this;
+		}
+
+		string &append(const char *s)
+		{
+			return append(s, strlen(s));
+		}
+
+		string &operator+=(const char *s)
+		{
+			return append(s);
+		}
+
+		string &operator+=(char c)
+		{
+			return append(&c, 1);
+		}
+
+		/**
+		 * Removes all characters, the capacity is left unchanged.
+		 */
+		void clear()
+		{
+			chars.clear();
+		}
+
+		/**
+		 * Returns a pointer to the null-terminated contents.
+		 */
+		const char *c_str() const noexcept
+		{
+			return chars.empty() ? "" : chars.data();
+		}
+
+		const char *data() const noexcept
+		{
+			return c_str();
+		}
+
+		/**
+		 * Returns a volatile copy of the contents.
+		 */
+		std::string str() const
+		{
+			return std::string(c_str(), size());
+		}
+
+		size_type size() const noexcept
+		{
+			return chars.empty() ? 0 : chars.size() - 1;
+		}
+
+		size_type length() const noexcept
+		{
+			return size();
+		}
+
+		size_type capacity() const noexcept
+		{
+			return chars.capacity() == 0 ? 0 : chars.capacity() - 1;
+		}
+
+		bool empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		void reserve(size_type n)
+		{
+			chars.reserve(n + 1);
+		}
+
+		char operator[](size_type n) const noexcept
+		{
+			return chars[n];
+		}
+
+		/**
+		 * Writable access to a single character.
+		 *
+		 * Adds only that character to the active transaction.
+		 */
+		char &operator[](size_type n)
+		{
+			return chars[n];
+		}
+
+		int compare(const char *s) const noexcept
+		{
+			return strcmp(c_str(), s);
+		}
+
+		int compare(const string &s) const noexcept
+		{
+			return compare(s.c_str());
+		}
+
+		/**
+		 * Returns the position of the first occurrence of c at or
+		 * after pos, or npos if there is none.
+		 */
+		size_type find(char c, size_type pos = 0) const noexcept
+		{
+			if (pos >= size())
+				return npos;
+
+			const char *p = static_cast<const char *>(
+				memchr(c_str() + pos, c, size() - pos));
+
+			return p == nullptr ? npos :
+				static_cast<size_type>(p - c_str());
+		}
+
+	private:
+		vector<char> chars;
+	};
+
+	inline bool operator==(const string &lhs, const char *rhs) noexcept
+	{
+		return lhs.compare(rhs) == 0;
+	}
+
+	inline bool operator!=(const string &lhs, const char *rhs) noexcept
+	{
+		return lhs.compare(rhs) != 0;
+	}
+
+	inline bool operator==(const string &lhs, const string &rhs) noexcept
+	{
+		return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+	}
+
+	inline bool operator!=(const string &lhs, const string &rhs) noexcept
+	{
+		return !(lhs == rhs);
+	}
+
+	inline bool operator<(const string &lhs, const string &rhs) noexcept
+	{
+		return lhs.compare(rhs) < 0;
+	}
+
+}  /* namespace obj */
+
+}  /* namespace nvml */
+
+#endif /* PMEMOBJ_STRING_HPP */
@@ -40,6 +40,7 @@
 #include <functional>
 
 #include "libpmemobj/pool.hpp"
+#include "libpmemobj/detail/common.hpp"
 #include "libpmemobj/detail/pexceptions.hpp"
 #include "libpmemobj.h"
 
@@ -51,12 +52,14 @@ namespace obj {
 	 * C++ transaction handler class.
 	 *
 	 * This class is the pmemobj transaction handler. Scoped transactions
-	 * are handled through two internal classes: @ref manual and
-	 * @ref automatic.
+	 * are handled through three internal classes: @ref manual,
+	 * @ref automatic and @ref read_only.
 	 * - @ref manual transactions need to be committed manually, otherwise
 	 *	they will be aborted on object destruction.\n
 	 * - @ref automatic transactions are only available in C++17. They
-	 *	handle transaction commit/abort automatically.
+	 *	handle transaction commit/abort automatically.\n
+	 * - @ref read_only transactions only take the locks, they cannot
+	 *	modify anything.
 	 * This class also exposes a closure-like transaction API.
 	 */
 	class transaction
@@ -140,6 +143,87 @@ namespace obj {
 			manual &operator=(manual &&p) = delete;
 		};
 
+		/**
+		 * C++ read-only scope transaction class.
+		 *
+		 * This class is one of pmemobj transaction handlers. It takes
+		 * the locks for the duration of the scope, but uses no lane,
+		 * undo log nor persistent state, the read-write locks are
+		 * acquired for reading. Any attempt to modify, allocate or
+		 * free an object within the scope aborts the transaction and
+		 * the operation throws. Transactions nested in the scope are
+		 * read-only too. There is nothing to roll back, so the
+		 * transaction is always committed on object destruction.
+		 */
+		class read_only {
+		public:
+			/**
+			 * RAII constructor with pmem resident locks.
+			 *
+			 * Start pmemobj read-only transaction and add list of
+			 * locks to new transaction. The list of locks may be
+			 * empty.
+			 *
+			 * @param[in,out] pop pool object.
+			 * @param[in,out] locks locks of obj::mutex or
+			 *	obj::shared_mutex type.
+			 *
+			 * @throw nvml::transaction_error when
+			 * pmemobj_tx_begin_ro function or locks adding failed.
+			 */
+			template<typename... L>
+			read_only(obj::pool_base &pop, L &... locks)
+			{
+				if (pmemobj_tx_begin_ro(pop.get_handle(), NULL,
+							TX_LOCK_NONE) != 0)
+					throw transaction_error(
+						"failed to start transaction");
+
+				int err = add_lock(locks...);
+
+				if (err) {
+					pmemobj_tx_abort(EINVAL);
+					pmemobj_tx_end();
+					throw transaction_error("failed to"
+							" add lock");
+				}
+			}
+
+			/**
+			 * Destructor.
+			 *
+			 * End pmemobj read-only transaction, committing it if
+			 * it has not been ended before.
+			 */
+			~read_only() noexcept
+			{
+				if (pmemobj_tx_stage() == TX_STAGE_WORK)
+					pmemobj_tx_commit();
+
+				pmemobj_tx_end();
+			}
+
+			/**
+			 * Deleted copy constructor.
+			 */
+			read_only(const read_only &p) = delete;
+
+			/**
+			 * Deleted move constructor.
+			 */
+			read_only(const read_only &&p) = delete;
+
+			/**
+			 * Deleted assignment operator.
+			 */
+			read_only &operator=(const read_only &p) = delete;
+
+			/**
+			 * Deleted move assignment operator.
+			 */
+			read_only &operator=(read_only &&p) = delete;
+		};
+
 #ifdef __cpp_lib_uncaught_exceptions
 		/**
 		 * C++ automatic scope transaction class.
@@ -333,6 +417,36 @@ namespace obj {
 			return pmemobj_tx_errno();
 		}
 
+		/**
+		 * Add an object, or an array of objects, to the transaction.
+		 *
+		 * The whole range is snapshotted with a single undo log entry
+		 * and remembered by the calling thread, so subsequent writes
+		 * to the p<> members of the object within the same
+		 * transaction do not add anything to the undo log.
+		 *
+		 * @param[in] addr pointer to the first object.
+		 * @param[in] num number of consecutive objects.
+		 *
+		 * @throw transaction_error if called outside of the work
+		 *	stage or the range could not be added.
+		 */
+		template<typename T>
+		static void snapshot(const T *addr, size_t num = 1)
+		{
+			uint64_t txid = pmemobj_tx_id();
+			if (txid == 0)
+				throw transaction_error("wrong stage for"
+						" snapshot");
+
+			if (pmemobj_tx_add_range_direct(addr, sizeof (T) * num))
+				throw transaction_error("Could not add an object"
+						" to the transaction.");
+
+			detail::snapshot_filter::insert(txid, addr,
+					sizeof (T) * num);
+		}
+
 		/**
 		 * Execute a closure-like transaction and lock `locks`.
 		 *
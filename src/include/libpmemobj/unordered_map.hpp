@@ -0,0 +1,584 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * unordered_map.hpp -- persistent concurrent hash map
+ */
+
+#ifndef PMEMOBJ_UNORDERED_MAP_HPP
+#define PMEMOBJ_UNORDERED_MAP_HPP
+
+#include "libpmemobj/detail/common.hpp"
+#include "libpmemobj/detail/pexceptions.hpp"
+#include "libpmemobj/make_persistent.hpp"
+#include "libpmemobj/make_persistent_array.hpp"
+#include "libpmemobj/persistent_ptr.hpp"
+#include "libpmemobj/shared_mutex.hpp"
+#include "libpmemobj/p.hpp"
+#include "libpmemobj.h"
+
+#include <functional>
+#include <cerrno>
+
+namespace nvml {
+
+namespace obj {
+
+	/**
+	 * Persistent concurrent hash map with separate chaining.
+	 *
+	 * The map is split into a fixed number of stripes, each with its
+	 * own lock and bucket array. A key always belongs to the same
+	 * stripe, so operations on keys from different stripes run in
+	 * parallel. Lookups take the stripe lock in shared mode.
+	 *
+	 * Modifiers called outside of a transaction run in their own
+	 * transaction. Called within an active transaction they join it
+	 * and the stripe lock is held until the outermost transaction
+	 * ends, which makes the change isolated. The bucket array of
+	 * a stripe is doubled by the insert that brings its load factor
+	 * above one, under the lock of that stripe only, so the map grows
+	 * regardless of whether the inserts are transactional.
+	 *
+	 * The map can be embedded in a zero-initialized persistent object
+	 * (e.g. the pool root) without an explicit construction.
+	 */
+	template<typename Key, typename T, typename Hash = std::hash<Key>,
+		typename KeyEqual = std::equal_to<Key>>
+	class unordered_map
+	{
+	public:
+		typedef Key key_type;
+		typedef T mapped_type;
+		typedef std::size_t size_type;
+
+		/**
+		 * Number of lock stripes.
+		 */
+		static const size_type stripes = 64;
+
+		unordered_map()
+		{
+			for (size_type i = 0; i < stripes; ++i) {
+				locks[i].count = 0;
+				locks[i].nbuckets = 0;
+				locks[i].buckets = nullptr;
+			}
+		}
+
+		unordered_map(const unordered_map &) = delete;
+
+		unordered_map &operator=(const unordered_map &) = delete;
+
+		/**
+		 * Destructor.
+		 *
+		 * Frees all the nodes, it is only effective within an active
+		 * transaction, e.g. when invoked by delete_persistent.
+		 */
+		~unordered_map()
+		{
+			if (pmemobj_tx_stage() != TX_STAGE_WORK)
+				return;
+
+			try {
+				clear();
+			} catch (...) {
+				/* the transaction has been aborted */
+			}
+		}
+
+		/**
+		 * Inserts the key with the given value, if not yet present.
+		 *
+		 * @return true if the element was inserted, false if the key
+		 * already exists.
+		 *
+		 * @throw transaction_error if the operation could not be
+		 * completed, transaction_alloc_error on allocation failure.
+		 */
+		bool insert(const Key &key, const T &value)
+		{
+			return insert_common(key, value, false);
+		}
+
+		/**
+		 * Inserts the key or replaces the value of an existing one.
+		 *
+		 * @return true if the element was inserted, false if the
+		 * value was assigned.
+		 *
+		 * @throw transaction_error if the operation could not be
+		 * completed, transaction_alloc_error on allocation failure.
+		 */
+		bool insert_or_assign(const Key &key, const T &value)
+		{
+			return insert_common(key, value, true);
+		}
+
+		/**
+		 * Removes the element with the given key.
+		 *
+		 * @return number of elements removed (0 or 1).
+		 *
+		 * @throw transaction_error if the operation could not be
+		 * completed.
+		 */
+		size_type erase(const Key &key)
+		{
+			size_type h = hash(key);
+			stripe &s = stripe_of(h);
+			size_type ret = 0;
+
+			if (s.nbuckets == 0)
+				return 0;
+
+			exec_tx(&s.lock, [&] {
+				if (s.nbuckets == 0)
+					return;
+
+				persistent_ptr<node> *prev = &bucket(s, h);
+				for (; *prev != nullptr; prev = &(*prev)->next) {
+					if (!KeyEqual()((*prev)->key, key))
+						continue;
+
+					persistent_ptr<node> n = *prev;
+					*prev = n->next;
+					delete_persistent<node>(n);
+					s.count = s.count - 1;
+					ret = 1;
+					break;
+				}
+			});
+
+			return ret;
+		}
+
+		/**
+		 * Looks up the key and copies its value.
+		 *
+		 * @return true if the key was found.
+		 *
+		 * @throw lock_error if the stripe could not be locked.
+		 */
+		bool find(const Key &key, T &value) const
+		{
+			size_type h = hash(key);
+			stripe &s = stripe_of(h);
+			read_guard guard(s.lock);
+
+			const node *n = lookup(s, h, key);
+			if (n == nullptr)
+				return false;
+
+			value = n->value;
+			return true;
+		}
+
+		/**
+		 * Returns the number of elements with the given key.
+		 */
+		size_type count(const Key &key) const
+		{
+			size_type h = hash(key);
+			stripe &s = stripe_of(h);
+			read_guard guard(s.lock);
+
+			return lookup(s, h, key) == nullptr ? 0 : 1;
+		}
+
+		/**
+		 * Calls f(key, value) for each element of the map.
+		 *
+		 * The stripes are locked one at a time, so f must not modify
+		 * the map.
+		 */
+		template<typename F>
+		void for_each(F f) const
+		{
+			for (size_type i = 0; i < stripes; ++i) {
+				stripe &s = locks[i];
+				read_guard guard(s.lock);
+
+				for (size_type b = 0; b < s.nbuckets; ++b)
+					for (const node *n = s.buckets[b].get();
+						n != nullptr; n = n->next.get())
+						f(n->key, n->value);
+			}
+		}
+
+		/**
+		 * Returns the number of elements.
+		 *
+		 * The per-stripe counters are summed without locking, the
+		 * value is exact only in absence of concurrent modifications.
+		 */
+		size_type size() const noexcept
+		{
+			size_type sum = 0;
+			for (size_type i = 0; i < stripes; ++i)
+				sum += locks[i].count;
+
+			return sum;
+		}
+
+		bool empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		/**
+		 * Returns the total number of buckets of all the stripes,
+		 * summed without locking like size().
+		 */
+		size_type bucket_count() const noexcept
+		{
+			size_type sum = 0;
+			for (size_type i = 0; i < stripes; ++i)
+				sum += locks[i].nbuckets;
+
+			return sum;
+		}
+
+		float load_factor() const noexcept
+		{
+			size_type n = bucket_count();
+
+			return n == 0 ? 0.0f : static_cast<float>(size()) / n;
+		}
+
+		/**
+		 * Sets the number of buckets to at least n, and no less than
+		 * needed to keep the load factor below one.
+		 *
+		 * The stripes are resized one at a time, each under its own
+		 * lock. Outside of a transaction every stripe is resized in
+		 * a separate one.
+		 *
+		 * @throw transaction_error if the operation could not be
+		 * completed, transaction_alloc_error on allocation failure.
+		 */
+		void rehash(size_type n)
+		{
+			size_type per_stripe = (n + stripes - 1) / stripes;
+
+			for (size_type i = 0; i < stripes; ++i) {
+				stripe &s = locks[i];
+
+				exec_tx(&s.lock, [&] {
+					size_type count = s.count;
+
+					resize(s, per_stripe < count ?
+						count : per_stripe);
+				});
+			}
+		}
+
+		/**
+		 * Removes all elements and frees the bucket arrays.
+		 *
+		 * The stripes are cleared one at a time, like in rehash().
+		 *
+		 * @throw transaction_error if the operation could not be
+		 * completed.
+		 */
+		void clear()
+		{
+			for (size_type i = 0; i < stripes; ++i) {
+				stripe &s = locks[i];
+
+				exec_tx(&s.lock, [&] {
+					clear_stripe(s);
+				});
+			}
+		}
+
+	private:
+		struct node {
+			node(const Key &k, const T &v,
+					const persistent_ptr<node> &n) :
+				key(k), value(v), next(n)
+			{
+			}
+
+			void assign(const T &v)
+			{
+				detail::conditional_add_to_tx(&value);
+				value = v;
+			}
+
+			Key key;
+			T value;
+			persistent_ptr<node> next;
+		};
+
+		/*
+		 * A lock with the bucket array and the counter of elements it
+		 * protects, padded to avoid false sharing between the stripes.
+		 */
+		struct stripe {
+			shared_mutex lock;
+			p<size_type> count;
+			p<size_type> nbuckets;
+			persistent_ptr<persistent_ptr<node>[]> buckets;
+			char padding[sizeof (PMEMrwlock) -
+				2 * sizeof (size_type) - sizeof (PMEMoid)];
+		};
+
+		/*
+		 * Holds a stripe lock for reading. Within a transaction the
+		 * lock is added to it instead, as it may be already held by
+		 * the transaction for writing.
+		 */
+		class read_guard {
+		public:
+			read_guard(shared_mutex &m) : mtx(m),
+				in_tx(pmemobj_tx_stage() == TX_STAGE_WORK)
+			{
+				if (!in_tx)
+					mtx.lock_shared();
+				else if (pmemobj_tx_lock(TX_LOCK_RWLOCK,
+						mtx.native_handle()))
+					throw transaction_error("failed to add"
+						" a lock to the transaction");
+			}
+
+			~read_guard()
+			{
+				if (!in_tx)
+					mtx.unlock_shared();
+			}
+
+			read_guard(const read_guard &) = delete;
+
+			read_guard &operator=(const read_guard &) = delete;
+
+		private:
+			shared_mutex &mtx;
+			bool in_tx;
+		};
+
+		/* the stripe index is taken from the low bits of the hash */
+		static const size_type stripe_shift = 6;
+
+		static_assert((size_type(1) << stripe_shift) == stripes,
+			"stripe_shift does not match the number of stripes");
+
+		/*
+		 * Scrambles the user-provided hash, as the bucket and stripe
+		 * indexes are taken from its low bits.
+		 */
+		static size_type hash(const Key &key)
+		{
+			uint64_t h = Hash()(key);
+
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+
+			return static_cast<size_type>(h);
+		}
+
+		stripe &stripe_of(size_type h) const
+		{
+			return locks[h & (stripes - 1)];
+		}
+
+		static persistent_ptr<node> &
+		bucket(const stripe &s, size_type h)
+		{
+			size_type b = (h >> stripe_shift) & (s.nbuckets - 1);
+
+			return s.buckets[b];
+		}
+
+		static const node *lookup(const stripe &s, size_type h,
+			const Key &key)
+		{
+			if (s.nbuckets == 0)
+				return nullptr;
+
+			const node *n = bucket(s, h).get();
+			for (; n != nullptr; n = n->next.get())
+				if (KeyEqual()(n->key, key))
+					return n;
+
+			return nullptr;
+		}
+
+		bool insert_common(const Key &key, const T &value, bool assign)
+		{
+			size_type h = hash(key);
+			stripe &s = stripe_of(h);
+			bool inserted = false;
+
+			exec_tx(&s.lock, [&] {
+				if (s.nbuckets == 0)
+					resize(s, 1);
+
+				persistent_ptr<node> &head = bucket(s, h);
+				for (node *n = head.get(); n != nullptr;
+						n = n->next.get()) {
+					if (!KeyEqual()(n->key, key))
+						continue;
+
+					if (assign)
+						n->assign(value);
+					return;
+				}
+
+				head = make_persistent<node>(key, value, head);
+				s.count = s.count + 1;
+				inserted = true;
+
+				if (s.count > s.nbuckets)
+					resize(s, 2 * s.nbuckets);
+			});
+
+			return inserted;
+		}
+
+		/*
+		 * Relinks the nodes of the stripe into a new bucket array,
+		 * the stripe lock has to be held by the transaction.
+		 */
+		void resize(stripe &s, size_type n)
+		{
+			size_type count = 1;
+			while (count < n)
+				count *= 2;
+
+			if (count == s.nbuckets)
+				return;
+
+			persistent_ptr<persistent_ptr<node>[]> nb =
+				make_persistent<persistent_ptr<node>[]>(count);
+
+			for (size_type b = 0; b < s.nbuckets; ++b) {
+				persistent_ptr<node> n = s.buckets[b];
+				while (n != nullptr) {
+					persistent_ptr<node> next = n->next;
+					persistent_ptr<node> &head = nb[
+						(hash(n->key) >> stripe_shift) &
+						(count - 1)];
+					n->next = head;
+
+					/*
+					 * The new array is tracked by the
+					 * transaction, no need for a snapshot.
+					 */
+					*head.raw_ptr() = n.raw();
+					n = next;
+				}
+			}
+
+			if (s.buckets != nullptr)
+				pmemobj_tx_free(*s.buckets.raw_ptr());
+
+			s.buckets = nb;
+			s.nbuckets = count;
+		}
+
+		/*
+		 * Frees the nodes and the bucket array of the stripe, the
+		 * stripe lock has to be held by the transaction.
+		 */
+		void clear_stripe(stripe &s)
+		{
+			for (size_type b = 0; b < s.nbuckets; ++b) {
+				persistent_ptr<node> n = s.buckets[b];
+				while (n != nullptr) {
+					persistent_ptr<node> next = n->next;
+					delete_persistent<node>(n);
+					n = next;
+				}
+			}
+
+			if (s.buckets != nullptr)
+				pmemobj_tx_free(*s.buckets.raw_ptr());
+
+			s.buckets = nullptr;
+			s.nbuckets = 0;
+			s.count = 0;
+		}
+
+		/*
+		 * Runs f with the lock (if any) added to the active
+		 * transaction, or within a new one.
+		 */
+		template<typename F>
+		void exec_tx(shared_mutex *lock, F f)
+		{
+			bool nested = pmemobj_tx_stage() == TX_STAGE_WORK;
+
+			if (!nested && pmemobj_tx_begin(
+					pmemobj_pool_by_ptr(this), NULL,
+					TX_LOCK_NONE) != 0)
+				throw transaction_error(
+					"failed to start transaction");
+
+			try {
+				if (lock != nullptr && pmemobj_tx_lock(
+						TX_LOCK_RWLOCK,
+						lock->native_handle()))
+					throw transaction_error("failed to add"
+						" a lock to the transaction");
+
+				f();
+			} catch (...) {
+				if (nested)
+					throw;
+
+				if (pmemobj_tx_stage() == TX_STAGE_WORK)
+					pmemobj_tx_abort(ECANCELED);
+				pmemobj_tx_end();
+				throw;
+			}
+
+			if (nested)
+				return;
+
+			if (pmemobj_tx_stage() == TX_STAGE_WORK)
+				pmemobj_tx_commit();
+
+			if (pmemobj_tx_end() != 0)
+				throw transaction_error("transaction aborted");
+		}
+
+		mutable stripe locks[stripes];
+	};
+
+}  /* namespace obj */
+
+}  /* namespace nvml */
+
+#endif /* PMEMOBJ_UNORDERED_MAP_HPP */
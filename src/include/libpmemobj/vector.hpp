@@ -0,0 +1,499 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vector.hpp -- persistent contiguous array container
+ */
+
+#ifndef PMEMOBJ_VECTOR_HPP
+#define PMEMOBJ_VECTOR_HPP
+
+#include "libpmemobj/detail/common.hpp"
+#include "libpmemobj/detail/pexceptions.hpp"
+#include "libpmemobj/persistent_ptr.hpp"
+#include "libpmemobj/p.hpp"
+#include "libpmemobj.h"
+
+#include <new>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace nvml {
+
+namespace obj {
+
+	/**
+	 * Persistent sequence container with contiguous storage.
+	 *
+	 * The elements live in a single persistent memory object which is
+	 * reallocated transactionally, with geometric growth, when the
+	 * capacity is exceeded. Modifiers snapshot only the part of the
+	 * container they change: appending an element adds the size field
+	 * to the transaction and persists the new slot, writing an element
+	 * snapshots just that element, removing elements snapshots them
+	 * before they are destroyed, so the slots past the size are either
+	 * not committed or restored on abort. All modifiers must be called
+	 * within an active transaction.
+	 *
+	 * The container can be embedded in a zero-initialized persistent
+	 * object (e.g. the pool root) without an explicit construction.
+	 */
+	template<typename T>
+	class vector
+	{
+	public:
+		typedef T value_type;
+		typedef std::size_t size_type;
+		typedef T &reference;
+		typedef const T &const_reference;
+		typedef const T *const_iterator;
+
+		/**
+		 * Default constructor, creates an empty vector.
+		 */
+		vector() : _data(nullptr), _size(0), _capacity(0)
+		{
+		}
+
+		/**
+		 * Fill constructor.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		vector(size_type count, const T &value = T()) :
+			_data(nullptr), _size(0), _capacity(0)
+		{
+			resize(count, value);
+		}
+
+		/*
+		 * Persistent containers are not copyable, the elements would
+		 * have to be reallocated in the current transaction.
+		 */
+		vector(const vector &) = delete;
+
+		vector &operator=(const vector &) = delete;
+
+		/**
+		 * Destructor.
+		 *
+		 * Destroys all the elements and transactionally frees the
+		 * storage. It is only effective within an active transaction,
+		 * e.g. when invoked by delete_persistent.
+		 */
+		~vector()
+		{
+			if (pmemobj_tx_stage() != TX_STAGE_WORK)
+				return;
+
+			try {
+				destroy_range(0, _size, true);
+			} catch (transaction_error &) {
+				/* the transaction is aborted, nothing changed */
+				return;
+			}
+
+			if (_data != nullptr)
+				pmemobj_tx_free(*_data.raw_ptr());
+		}
+
+		/**
+		 * Element access operator.
+		 *
+		 * Adds the element to the active transaction, if any.
+		 */
+		reference operator[](size_type n)
+		{
+			T *elem = _data.get() + n;
+			detail::conditional_add_to_tx(elem);
+
+			return *elem;
+		}
+
+		/**
+		 * Read-only element access operator.
+		 */
+		const_reference operator[](size_type n) const noexcept
+		{
+			return _data.get()[n];
+		}
+
+		/**
+		 * Bounds-checked element access.
+		 *
+		 * @throw std::out_of_range if n is not a valid position.
+		 */
+		reference at(size_type n)
+		{
+			if (n >= _size)
+				throw std::out_of_range("vector::at");
+
+			return (*this)[n];
+		}
+
+		/**
+		 * Bounds-checked read-only element access.
+		 *
+		 * @throw std::out_of_range if n is not a valid position.
+		 */
+		const_reference at(size_type n) const
+		{
+			if (n >= _size)
+				throw std::out_of_range("vector::at");
+
+			return (*this)[n];
+		}
+
+		/**
+		 * Returns a writable pointer to count consecutive elements.
+		 *
+		 * The whole range is added to the active transaction with
+		 * a single snapshot, which is cheaper than accessing each
+		 * element separately.
+		 *
+		 * @throw std::out_of_range if the range is not within the
+		 * container.
+		 * @throw transaction_error if the range could not be added to
+		 * the transaction.
+		 */
+		T *range(size_type start, size_type count)
+		{
+			if (start > _size || count > _size - start)
+				throw std::out_of_range("vector::range");
+
+			T *first = _data.get() + start;
+			detail::conditional_add_to_tx(first, count);
+
+			return first;
+		}
+
+		reference front()
+		{
+			return (*this)[0];
+		}
+
+		const_reference front() const noexcept
+		{
+			return (*this)[0];
+		}
+
+		reference back()
+		{
+			return (*this)[_size - 1];
+		}
+
+		const_reference back() const noexcept
+		{
+			return (*this)[_size - 1];
+		}
+
+		/**
+		 * Returns a read-only pointer to the underlying storage.
+		 */
+		const T *data() const noexcept
+		{
+			return _data.get();
+		}
+
+		const_iterator begin() const noexcept
+		{
+			return _data.get();
+		}
+
+		const_iterator end() const noexcept
+		{
+			return _data.get() + _size;
+		}
+
+		bool empty() const noexcept
+		{
+			return _size.get_ro() == 0;
+		}
+
+		size_type size() const noexcept
+		{
+			return _size;
+		}
+
+		size_type capacity() const noexcept
+		{
+			return _capacity;
+		}
+
+		size_type max_size() const noexcept
+		{
+			return std::numeric_limits<size_type>::max() / sizeof (T);
+		}
+
+		/**
+		 * Increases the capacity to at least n elements.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		void reserve(size_type n)
+		{
+			check_tx_stage();
+
+			if (n > _capacity)
+				realloc(n);
+		}
+
+		/**
+		 * Reduces the capacity to the current size.
+		 */
+		void shrink_to_fit()
+		{
+			check_tx_stage();
+
+			if (_capacity > _size)
+				realloc(_size);
+		}
+
+		/**
+		 * Appends a copy of value to the end of the container.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		void push_back(const T &value)
+		{
+			emplace_back(value);
+		}
+
+		/**
+		 * Constructs a new element in place at the end of the
+		 * container.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 */
+		template<typename... Args>
+		void emplace_back(Args &&... args)
+		{
+			check_tx_stage();
+
+			if (_size == _capacity)
+				realloc(grow_capacity(_size + 1));
+
+			T *slot = _data.get() + _size;
+			::new (slot) T(std::forward<Args>(args)...);
+
+			/*
+			 * The slot is past the size, it has either never been
+			 * committed or was snapshotted when its element was
+			 * removed - it only has to be made durable before the
+			 * size is committed.
+			 */
+			pmemobj_persist(pmemobj_pool_by_ptr(slot), slot,
+					sizeof (T));
+
+			_size = _size + 1;
+		}
+
+		/**
+		 * Removes the last element of the container.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_error if the element could not be added
+		 * to the transaction.
+		 */
+		void pop_back()
+		{
+			check_tx_stage();
+
+			if (_size == 0)
+				return;
+
+			_size = _size - 1;
+			destroy_range(_size, 1);
+		}
+
+		/**
+		 * Resizes the container to contain count elements.
+		 *
+		 * Additional elements are copy-constructed from value.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_alloc_error on allocation failure.
+		 * @throw transaction_error if the removed elements could not be
+		 * added to the transaction.
+		 */
+		void resize(size_type count, const T &value = T())
+		{
+			check_tx_stage();
+
+			size_type old_size = _size;
+			if (count <= old_size) {
+				_size = count;
+				destroy_range(count, old_size - count);
+				return;
+			}
+
+			if (count > _capacity)
+				realloc(count > 2 * old_size ?
+						count : grow_capacity(count));
+
+			T *first = _data.get() + old_size;
+			for (size_type i = 0; i < count - old_size; ++i)
+				::new (first + i) T(value);
+
+			pmemobj_persist(pmemobj_pool_by_ptr(first), first,
+					sizeof (T) * (count - old_size));
+
+			_size = count;
+		}
+
+		/**
+		 * Removes all elements, the capacity is left unchanged.
+		 *
+		 * @throw transaction_scope_error if called outside of an
+		 * active transaction
+		 * @throw transaction_error if the elements could not be added
+		 * to the transaction.
+		 */
+		void clear()
+		{
+			check_tx_stage();
+
+			size_type old_size = _size;
+			_size = 0;
+			destroy_range(0, old_size);
+		}
+
+	private:
+		void check_tx_stage() const
+		{
+			if (pmemobj_tx_stage() != TX_STAGE_WORK)
+				throw transaction_scope_error("refusing to "
+					"modify a vector outside of "
+					"transaction scope");
+		}
+
+		/*
+		 * Capacity after growing to hold at least n elements.
+		 */
+		size_type grow_capacity(size_type n) const
+		{
+			size_type cap = _capacity == 0 ? 1 : _capacity.get_ro();
+			while (cap < n && cap <= max_size() / 2)
+				cap *= 2;
+
+			return cap < n ? n : cap;
+		}
+
+		/*
+		 * Destroys count elements from start.
+		 *
+		 * The elements are snapshotted first, so an abort restores
+		 * them even if the slots are reused by the same transaction.
+		 * The snapshot is skipped only for storage which is being
+		 * freed, if the destructors leave it untouched.
+		 */
+		void destroy_range(size_type start, size_type count,
+				bool freed = false)
+		{
+			if (count == 0)
+				return;
+
+			T *first = _data.get() + start;
+			if (!freed || !std::is_trivially_destructible<T>::value)
+				detail::conditional_add_to_tx(first, count);
+
+			for (size_type i = 0; i < count; ++i)
+				first[i].~T();
+		}
+
+		/*
+		 * Moves the elements to a new object of the given capacity.
+		 *
+		 * The new object is tracked by the transaction and flushed
+		 * on commit, the old one is freed transactionally, so only
+		 * the pointer and capacity fields have to be snapshotted.
+		 */
+		void realloc(size_type capacity)
+		{
+			if (capacity > max_size())
+				throw transaction_alloc_error("vector capacity "
+					"too large");
+
+			persistent_ptr<T[]> ndata = nullptr;
+			if (capacity != 0) {
+				ndata = pmemobj_tx_alloc(sizeof (T) * capacity,
+						detail::type_num<T>());
+				if (ndata == nullptr)
+					throw transaction_alloc_error("failed "
+						"to allocate persistent memory "
+						"array");
+			}
+
+			T *src = _data.get();
+			T *dst = ndata.get();
+			size_type i = 0;
+			try {
+				for (; i < _size; ++i)
+					::new (dst + i) T(src[i]);
+			} catch (...) {
+				while (i-- > 0)
+					dst[i].~T();
+				pmemobj_tx_free(*ndata.raw_ptr());
+				throw;
+			}
+
+			destroy_range(0, _size, true);
+			if (_data != nullptr &&
+					pmemobj_tx_free(*_data.raw_ptr()) != 0)
+				throw transaction_alloc_error("failed to free "
+					"persistent memory array");
+
+			_data = ndata;
+			_capacity = capacity;
+		}
+
+		persistent_ptr<T[]> _data;
+		p<size_type> _size;
+		p<size_type> _capacity;
+	};
+
+}  /* namespace obj */
+
+}  /* namespace nvml */
+
+#endif /* PMEMOBJ_VECTOR_HPP */
@@ -55,7 +55,30 @@ typedef struct vmem VMEM;	/* opaque type internal to libvmem */
 
 #define	VMEM_MIN_POOL ((size_t)(1024 * 1024 * 14)) /* min pool size: 14MB */
 
+/*
+ * Tunables for vmem_create_ext(), zeroed fields select the defaults.
+ *
+ * Threads allocating from a pool are spread over its arenas, so a pool
+ * with at least as many arenas as allocating threads gives each thread
+ * an arena of its own.  Each arena in use holds at least one 4MB chunk
+ * of the pool.
+ */
+struct vmem_opts {
+	unsigned narenas;	/* number of arenas (4 per CPU) */
+	unsigned flags;		/* VMEM_OPT_* */
+	size_t tcache_max;	/* largest size cached per thread (32KB) */
+	int lg_dirty_mult;	/* log2 of active to dirty pages ratio (3) */
+};
+
+#define	VMEM_OPT_NO_TCACHE	(1 << 0)	/* no per-thread caches */
+#define	VMEM_OPT_NO_PURGE	(1 << 1)	/* never purge dirty pages */
+#define	VMEM_OPT_INTERLEAVE	(1 << 2)	/* spread over NUMA nodes */
+
 VMEM *vmem_create(const char *dir, size_t size);
+VMEM *vmem_create_ext(const char *dir, size_t size,
+		const struct vmem_opts *opts);
+VMEM *vmem_create_numa(const char *const dirs[], unsigned ndirs, size_t size,
+		const struct vmem_opts *opts);
 VMEM *vmem_create_in_region(void *addr, size_t size);
 void vmem_delete(VMEM *vmp);
 int vmem_check(VMEM *vmp);
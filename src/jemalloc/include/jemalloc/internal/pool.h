@@ -58,6 +58,14 @@ struct pool_s {
 	unsigned narenas_total;
 	unsigned narenas_auto;
 
+	/*
+	 * Largest size class served from the thread caches, 0 if the thread
+	 * caches are disabled for this pool.  Never above tcache_maxclass.
+	 */
+	size_t tcache_maxclass;
+	/* Per pool value of opt_lg_dirty_mult. */
+	ssize_t lg_dirty_mult;
+
 	/* Tree of chunks that are stand-alone huge allocations. */
 	extent_tree_t	huge;
 	/* Protects chunk-related data structures. */
@@ -126,7 +134,7 @@ struct tsd_pool_s {
 /******************************************************************************/
 #ifdef JEMALLOC_H_EXTERNS
 
-bool pool_new(pool_t *pool, unsigned pool_id);
+bool pool_new(pool_t *pool, unsigned pool_id, const pool_opts_t *opts);
 void pool_destroy(pool_t *pool);
 
 extern malloc_mutex_t	pools_lock;
@@ -399,7 +399,7 @@ malloc_init_base_pool(void)
 		return (true);
 	}
 
-	if (pool_new(&base_pool, 0)) {
+	if (pool_new(&base_pool, 0, NULL)) {
 		malloc_mutex_unlock(&pool_base_lock);
 		return (true);
 	}
@@ -1479,6 +1479,14 @@ void pools_shared_data_destroy(void)
 
 pool_t *
 je_pool_create(void *addr, size_t size, int zeroed)
+{
+
+	return (je_pool_create_ext(addr, size, zeroed, NULL));
+}
+
+pool_t *
+je_pool_create_ext(void *addr, size_t size, int zeroed,
+    const pool_opts_t *opts)
 {
 	if (malloc_init())
 		return (NULL);
@@ -1542,7 +1550,7 @@ je_pool_create(void *addr, size_t size, int zeroed)
 	pool->base_past_addr = (void *)((uintptr_t)addr + size);
 
 	/* prepare pool and internal structures */
-	if (pool_new(pool, pool_id)) {
+	if (pool_new(pool, pool_id, opts)) {
 		assert(pools[pool_id] == NULL);
 		malloc_mutex_unlock(&pools_lock);
 		pools_shared_data_destroy();
@@ -4,8 +4,11 @@
 malloc_mutex_t	pool_base_lock = MALLOC_MUTEX_INITIALIZER;
 malloc_mutex_t	pools_lock = MALLOC_MUTEX_INITIALIZER;
 
-/* Initialize pool and create its base arena. */
-bool pool_new(pool_t *pool, unsigned pool_id)
+/*
+ * Initialize pool and create its base arena.  The settings not given in opts
+ * (or all of them if opts is NULL) are taken from the global options.
+ */
+bool pool_new(pool_t *pool, unsigned pool_id, const pool_opts_t *opts)
 {
 	pool->pool_id = pool_id;
 
@@ -33,6 +36,24 @@ bool pool_new(pool_t *pool, unsigned pool_id)
 	pool->ctl_stats_mapped = 0;
 
 	pool->narenas_auto = opt_narenas;
+	pool->tcache_maxclass = tcache_maxclass;
+	pool->lg_dirty_mult = opt_lg_dirty_mult;
+	if (opts != NULL) {
+		if (opts->narenas != 0)
+			pool->narenas_auto = opts->narenas;
+		if (opts->flags & POOL_OPT_NO_TCACHE)
+			pool->tcache_maxclass = 0;
+		else if (opts->tcache_max != 0 &&
+		    opts->tcache_max < tcache_maxclass) {
+			/* small size classes are always cached */
+			pool->tcache_maxclass = opts->tcache_max <
+			    SMALL_MAXCLASS ? SMALL_MAXCLASS : opts->tcache_max;
+		}
+		if (opts->flags & POOL_OPT_NO_PURGE)
+			pool->lg_dirty_mult = -1;
+		else if (opts->lg_dirty_mult != 0)
+			pool->lg_dirty_mult = opts->lg_dirty_mult;
+	}
 	/*
 	 * Make sure that the arenas array can be allocated.  In practice, this
 	 * limit is enough to allow the allocator to function, but the ctl
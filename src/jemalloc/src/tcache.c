@@ -289,6 +289,13 @@ tcache_get_hard(tcache_t *tcache, pool_t *pool, bool create)
 			tcache_enabled_set(false); /* Memoize. */
 			return (NULL);
 		}
+		if (pool->tcache_maxclass == 0) {
+			/* Thread caches are disabled for this pool. */
+			tsd_tcache_t *tsd = tcache_tsd_get();
+			tsd->seqno[pool->pool_id] = pool->seqno;
+			tsd->tcaches[pool->pool_id] = TCACHE_STATE_DISABLED;
+			return (NULL);
+		}
 		return (tcache_create(choose_arena(&dummy)));
 	}
 	if (tcache == TCACHE_STATE_PURGATORY) {
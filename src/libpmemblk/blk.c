@@ -337,12 +337,15 @@ pmemblk_runtime_init(PMEMblkpool *pbp, size_t bsize, int rdonly, int is_pmem)
 
 	ns_cb.ns_is_zeroed = pbp->is_zeroed;
 
+	int csum = (le32toh(pbp->hdr.incompat_features) &
+			BLK_FORMAT_INCOMPAT_CSUM) != 0;
+
 	/* things free by "goto err" if not NULL */
 	struct btt *bttp = NULL;
 	pthread_mutex_t *locks = NULL;
 
 	bttp = btt_init(pbp->datasize, (uint32_t)bsize, pbp->hdr.poolset_uuid,
-			(unsigned)ncpus * 2, pbp, &ns_cb);
+			(unsigned)ncpus * 2, csum, pbp, &ns_cb);
 
 	if (bttp == NULL)
 		goto err;	/* btt_init set errno, called LOG */
@@ -391,14 +394,17 @@ err:
 }
 
 /*
- * pmemblk_create -- create a block memory pool
+ * pmemblk_create_common -- (internal) create a block memory pool
+ *
+ * The incompat argument carries the optional pool features (like
+ * per-block checksums) to be recorded in the pool header.
  */
-PMEMblkpool *
-pmemblk_create(const char *path, size_t bsize, size_t poolsize,
-		mode_t mode)
+static PMEMblkpool *
+pmemblk_create_common(const char *path, size_t bsize, size_t poolsize,
+		mode_t mode, uint32_t incompat)
 {
-	LOG(3, "path %s bsize %zu poolsize %zu mode %o",
-			path, bsize, poolsize, mode);
+	LOG(3, "path %s bsize %zu poolsize %zu mode %o incompat %#x",
+			path, bsize, poolsize, mode, incompat);
 
 	/* check if bsize is valid */
 	if (bsize == 0) {
@@ -417,7 +423,7 @@ pmemblk_create(const char *path, size_t bsize, size_t poolsize,
 
 	if (util_pool_create(&set, path, poolsize, PMEMBLK_MIN_POOL,
 			BLK_HDR_SIG, BLK_FORMAT_MAJOR,
-			BLK_FORMAT_COMPAT, BLK_FORMAT_INCOMPAT,
+			BLK_FORMAT_COMPAT, incompat,
 			BLK_FORMAT_RO_COMPAT) != 0) {
 		LOG(2, "cannot create pool or pool set");
 		return NULL;
@@ -470,6 +476,31 @@ err:
 	return NULL;
 }
 
+/*
+ * pmemblk_create -- create a block memory pool
+ */
+PMEMblkpool *
+pmemblk_create(const char *path, size_t bsize, size_t poolsize,
+		mode_t mode)
+{
+	return pmemblk_create_common(path, bsize, poolsize, mode,
+			BLK_FORMAT_INCOMPAT);
+}
+
+/*
+ * pmemblk_create_csum -- create a block memory pool with block checksums
+ *
+ * Every block written to such a pool is stored along with its CRC32C,
+ * which is verified by each pmemblk_read().
+ */
+PMEMblkpool *
+pmemblk_create_csum(const char *path, size_t bsize, size_t poolsize,
+		mode_t mode)
+{
+	return pmemblk_create_common(path, bsize, poolsize, mode,
+			BLK_FORMAT_INCOMPAT | BLK_FORMAT_INCOMPAT_CSUM);
+}
+
 
 /*
  * pmemblk_open_common -- (internal) open a block memory pool
@@ -489,7 +520,7 @@ pmemblk_open_common(const char *path, size_t bsize, int cow)
 
 	if (util_pool_open(&set, path, cow, PMEMBLK_MIN_POOL,
 			BLK_HDR_SIG, BLK_FORMAT_MAJOR,
-			BLK_FORMAT_COMPAT, BLK_FORMAT_INCOMPAT,
+			BLK_FORMAT_COMPAT, BLK_FORMAT_INCOMPAT_SUPPORTED,
 			BLK_FORMAT_RO_COMPAT) != 0) {
 		LOG(2, "cannot open pool or pool set");
 		return NULL;
@@ -45,6 +45,11 @@
 #define	BLK_FORMAT_INCOMPAT 0x0000
 #define	BLK_FORMAT_RO_COMPAT 0x0000
 
+/* optional incompat features, recorded in the pool header at create time */
+#define	BLK_FORMAT_INCOMPAT_CSUM 0x0001	/* per-block CRC32C checksums */
+#define	BLK_FORMAT_INCOMPAT_SUPPORTED\
+	(BLK_FORMAT_INCOMPAT | BLK_FORMAT_INCOMPAT_CSUM)
+
 struct pmemblk {
 	struct pool_hdr hdr;	/* memory pool header */
 
@@ -129,12 +129,16 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <endian.h>
+#if defined(__x86_64__) || defined(__amd64__)
+#include <nmmintrin.h>
+#endif
 
 #include "out.h"
 #include "util.h"
 #include "btt.h"
 #include "btt_layout.h"
 #include "sys_util.h"
+#include "cpu.h"
 
 /*
  * The opaque btt handle containing state tracked by this module
@@ -173,6 +177,10 @@ struct btt {
 	uint32_t nfree;			/* available flog entries */
 	uint64_t nlba;			/* total number of external LBAs */
 	unsigned narena;		/* number of arenas */
+	int csum;			/* new layouts carry block checksums */
+
+	/* CRC32C routine used for block checksums, picked by btt_init() */
+	uint32_t (*crc32c)(const void *addr, size_t len);
 
 	/* run-time state kept for each arena */
 	struct arena {
@@ -268,6 +276,118 @@ static const struct btt_flog Zflog;
 static const unsigned Nseq[] = { 0, 2, 3, 1 };
 #define	NSEQ(seq) (Nseq[(seq) & 3])
 
+/*
+ * Lookup table for the portable CRC32C (Castagnoli, reflected polynomial
+ * 0x82F63B78) routine, used when the CPU lacks the SSE4.2 crc32 instruction.
+ */
+static const uint32_t Crc32c_table[256] = {
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4,
+	0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+	0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+	0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+	0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b,
+	0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54,
+	0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+	0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+	0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+	0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5,
+	0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45,
+	0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+	0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+	0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+	0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48,
+	0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687,
+	0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+	0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+	0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+	0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8,
+	0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096,
+	0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+	0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+	0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+	0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9,
+	0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36,
+	0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+	0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+	0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+	0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043,
+	0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3,
+	0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+	0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+	0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+	0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652,
+	0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d,
+	0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+	0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+	0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+	0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2,
+	0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530,
+	0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+	0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+	0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+	0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f,
+	0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90,
+	0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+	0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+	0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+	0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321,
+	0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81,
+	0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+	0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
+};
+
+/*
+ * crc32c_generic -- (internal) portable, table-driven CRC32C
+ */
+static uint32_t
+crc32c_generic(const void *addr, size_t len)
+{
+	const uint8_t *p = addr;
+	uint32_t crc = ~0U;
+
+	while (len--)
+		crc = Crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+#if defined(__x86_64__) || defined(__amd64__)
+/*
+ * crc32c_sse42 -- (internal) CRC32C using the SSE4.2 crc32 instruction
+ *
+ * Processes eight bytes per instruction once the pointer is aligned.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(const void *addr, size_t len)
+{
+	const uint8_t *p = addr;
+	uint64_t crc = ~0U;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = _mm_crc32_u8((uint32_t)crc, *p++);
+
+	for (; len >= 8; len -= 8, p += 8)
+		crc = _mm_crc32_u64(crc, *(const uint64_t *)p);
+
+	for (; len; len--)
+		crc = _mm_crc32_u8((uint32_t)crc, *p++);
+
+	return ~(uint32_t)crc;
+}
+#endif
+
 /*
  * invalid_lba -- (internal) set errno and return true if lba is invalid
  *
@@ -894,6 +1014,15 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 	flog_size = roundup(flog_size, BTT_ALIGNMENT);
 
 	uint32_t internal_lbasize = bttp->lbasize;
+	if (bttp->csum) {
+		if (internal_lbasize > UINT32_MAX - BTT_CSUM_SIZE) {
+			errno = EINVAL;
+			ERR("!Invalid lba size for block checksums: %u",
+					internal_lbasize);
+			return -1;
+		}
+		internal_lbasize += BTT_CSUM_SIZE;
+	}
 	if (internal_lbasize < BTT_MIN_LBA_SIZE)
 		internal_lbasize = BTT_MIN_LBA_SIZE;
 	internal_lbasize =
@@ -1038,6 +1167,8 @@ write_layout(struct btt *bttp, unsigned lane, int write)
 		memcpy(info.sig, Sig, BTTINFO_SIG_LEN);
 		memcpy(info.uuid, bttp->uuid, BTTINFO_UUID_LEN);
 		memcpy(info.parent_uuid, bttp->parent_uuid, BTTINFO_UUID_LEN);
+		if (bttp->csum)
+			info.flags = htole32(BTTINFO_FLAG_CSUM);
 		info.major = htole16(BTTINFO_MAJOR_VERSION);
 		info.minor = htole16(BTTINFO_MINOR_VERSION);
 		info.external_lbasize = htole32(bttp->lbasize);
@@ -1139,6 +1270,13 @@ read_layout(struct btt *bttp, unsigned lane)
 			return -1;
 		}
 
+		if (!(info.flags & BTTINFO_FLAG_CSUM) != !bttp->csum) {
+			/* the data blocks would be interpreted wrongly */
+			ERR("inconsistent block checksum setting");
+			errno = EINVAL;
+			return -1;
+		}
+
 		if (info.nfree == 0) {
 			ERR("invalid nfree");
 			errno = EINVAL;
@@ -1253,9 +1391,10 @@ lba_to_arena_lba(struct btt *bttp, uint64_t lba,
  */
 struct btt *
 btt_init(uint64_t rawsize, uint32_t lbasize, uint8_t parent_uuid[],
-		unsigned maxlane, void *ns, const struct ns_callback *ns_cbp)
+		unsigned maxlane, int csum, void *ns,
+		const struct ns_callback *ns_cbp)
 {
-	LOG(3, "rawsize %ju lbasize %u", rawsize, lbasize);
+	LOG(3, "rawsize %ju lbasize %u csum %d", rawsize, lbasize, csum);
 
 	if (rawsize < BTT_MIN_SIZE) {
 		ERR("rawsize smaller than BTT_MIN_SIZE %u", BTT_MIN_SIZE);
@@ -1274,9 +1413,16 @@ btt_init(uint64_t rawsize, uint32_t lbasize, uint8_t parent_uuid[],
 	memcpy(bttp->parent_uuid, parent_uuid, BTTINFO_UUID_LEN);
 	bttp->rawsize = rawsize;
 	bttp->lbasize = lbasize;
+	bttp->csum = csum;
 	bttp->ns = ns;
 	bttp->ns_cbp = ns_cbp;
 
+	bttp->crc32c = crc32c_generic;
+#if defined(__x86_64__) || defined(__amd64__)
+	if (is_cpu_sse42_present())
+		bttp->crc32c = crc32c_sse42;
+#endif
+
 	/*
 	 * Load up layout, if it exists.
 	 *
@@ -1331,6 +1477,31 @@ btt_nlba(struct btt *bttp)
 	return bttp->nlba;
 }
 
+/*
+ * verify_csum -- (internal) check a block read against its stored checksum
+ *
+ * Returns 0 if the checksum matches, otherwise -1/errno.
+ */
+static int
+verify_csum(struct btt *bttp, unsigned lane, const void *buf,
+		uint64_t csum_off)
+{
+	LOG(3, "bttp %p lane %u csum_off %ju", bttp, lane, csum_off);
+
+	uint32_t csum;
+	if ((*bttp->ns_cbp->nsread)(bttp->ns, lane, &csum,
+				sizeof (csum), csum_off) < 0)
+		return -1;
+
+	if (le32toh(csum) != (*bttp->crc32c)(buf, bttp->lbasize)) {
+		ERR("EIO due to block checksum mismatch");
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * btt_read -- read a block from a btt namespace
  *
@@ -1433,6 +1604,10 @@ btt_read(struct btt *bttp, unsigned lane, uint64_t lba, void *buf)
 	int readret = (*bttp->ns_cbp->nsread)(bttp->ns, lane, buf,
 					bttp->lbasize, data_block_off);
 
+	if (readret == 0 && (arenap->flags & BTTINFO_FLAG_CSUM))
+		readret = verify_csum(bttp, lane, buf,
+				data_block_off + bttp->lbasize);
+
 	/* done with read, so clear out rtt entry */
 	arenap->rtt[lane] = BTT_MAP_ENTRY_ERROR;
 
@@ -1599,6 +1774,15 @@ btt_write(struct btt *bttp, unsigned lane, uint64_t lba, const void *buf)
 				bttp->lbasize, data_block_off) < 0)
 		return -1;
 
+	/* the checksum lands in the same free block, ahead of the map update */
+	if (arenap->flags & BTTINFO_FLAG_CSUM) {
+		uint32_t csum = htole32((*bttp->crc32c)(buf, bttp->lbasize));
+		if ((*bttp->ns_cbp->nswrite)(bttp->ns, lane, &csum,
+				sizeof (csum),
+				data_block_off + bttp->lbasize) < 0)
+			return -1;
+	}
+
 	/*
 	 * Make the new block active atomically by updating the on-media flog
 	 * and then updating the map.
@@ -49,7 +49,8 @@ struct ns_callback {
 };
 
 struct btt *btt_init(uint64_t rawsize, uint32_t lbasize, uint8_t parent_uuid[],
-		unsigned maxlane, void *ns, const struct ns_callback *ns_cbp);
+		unsigned maxlane, int csum, void *ns,
+		const struct ns_callback *ns_cbp);
 unsigned btt_nlane(struct btt *bttp);
 size_t btt_nlba(struct btt *bttp);
 int btt_read(struct btt *bttp, unsigned lane, uint64_t lba, void *buf);
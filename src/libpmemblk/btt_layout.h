@@ -76,6 +76,7 @@ struct btt_info {
  */
 #define	BTTINFO_FLAG_ERROR	0x00000001 /* error state (read-only) */
 #define	BTTINFO_FLAG_ERROR_MASK	0x00000001 /* all error bits */
+#define	BTTINFO_FLAG_CSUM	0x00000002 /* data blocks carry a CRC32C */
 
 /*
  * Current on-media format versions.
@@ -119,3 +120,11 @@ struct btt_flog {
 #define	BTT_MIN_LBA_SIZE (size_t)512
 #define	BTT_INTERNAL_LBA_ALIGNMENT 256U
 #define	BTT_DEFAULT_NFREE 256
+
+/*
+ * When BTTINFO_FLAG_CSUM is set, each internal block holds the CRC32C of
+ * the external block right after the data, in the internal_lbasize padding.
+ * The checksum is written together with the data into the free block, so
+ * it becomes visible atomically with the map update.
+ */
+#define	BTT_CSUM_SIZE 4
@@ -120,18 +120,28 @@ ctree_free_internal_recursive(void *dst)
 #endif
 
 /*
- * ctree_delete -- cleanups and frees crit-bit tree instance
+ * ctree_clear_unlocked -- removes all the keys from the tree
  */
 void
-ctree_delete(struct ctree *t)
+ctree_clear_unlocked(struct ctree *t)
 {
 #if	CTREE_FAST_RECURSIVE_DELETE
 	if (t->root)
 		ctree_free_internal_recursive(t->root);
+	t->root = NULL;
 #else
 	while (t->root)
 		ctree_remove_unlocked(t, 0, 0);
 #endif
+}
+
+/*
+ * ctree_delete -- cleanups and frees crit-bit tree instance
+ */
+void
+ctree_delete(struct ctree *t)
+{
+	ctree_clear_unlocked(t);
 
 	util_mutex_destroy(&t->lock);
 
@@ -316,6 +326,69 @@ ctree_find_le(struct ctree *t, uint64_t *key)
 	return ret;
 }
 
+/*
+ * ctree_find_ge_unlocked -- searches for a (greater or equal) key in the tree
+ */
+uint64_t
+ctree_find_ge_unlocked(struct ctree *t, uint64_t *key)
+{
+	struct node_leaf *dst = t->root;
+	struct node *a = NULL;
+
+	while (NODE_IS_INTERNAL(dst)) {
+		a = NODE_INTERNAL_GET(dst);
+		dst = a->slots[BIT_IS_SET(*key, a->diff)];
+	}
+
+	if (dst == NULL || dst->key == *key)
+		goto out;
+
+	unsigned diff = find_crit_bit(dst->key, *key);
+
+	struct node *top = NULL;
+	dst = t->root;
+	while (NODE_IS_INTERNAL(dst)) {
+		a = NODE_INTERNAL_GET(dst);
+		if (a->diff < diff)
+			break;
+
+		if (BIT_IS_SET(*key, a->diff)) {
+			dst = a->slots[1];
+		} else {
+			top = a->slots[1];
+			dst = a->slots[0];
+		}
+	}
+
+	if (BIT_IS_SET(*key, diff))
+		dst = (struct node_leaf *)top;
+
+	while (NODE_IS_INTERNAL(dst)) {
+		a = NODE_INTERNAL_GET(dst);
+		dst = a->slots[0];
+	}
+
+	if (dst && dst->key < *key)
+		dst = NULL;
+
+out:
+	*key = dst ? dst->key : 0;
+	uint64_t ret = dst ? dst->value : 0;
+	return ret;
+}
+
+/*
+ * ctree_find_ge -- searches for a (greater or equal) key in the tree
+ */
+uint64_t
+ctree_find_ge(struct ctree *t, uint64_t *key)
+{
+	util_mutex_lock(&t->lock);
+	uint64_t ret = ctree_find_ge_unlocked(t, key);
+	util_mutex_unlock(&t->lock);
+	return ret;
+}
+
 /*
  * ctree_remove_unlocked -- removes a (greater or equal) key from the tree
  */
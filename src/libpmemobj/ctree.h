@@ -38,6 +38,7 @@ struct ctree;
 
 struct ctree *ctree_new(void);
 void ctree_delete(struct ctree *t);
+void ctree_clear_unlocked(struct ctree *t);
 
 int ctree_insert(struct ctree *t, uint64_t key, uint64_t value);
 int ctree_insert_unlocked(struct ctree *t, uint64_t key, uint64_t value);
@@ -48,6 +49,9 @@ uint64_t ctree_find_unlocked(struct ctree *t, uint64_t key);
 uint64_t ctree_find_le(struct ctree *t, uint64_t *key);
 uint64_t ctree_find_le_unlocked(struct ctree *t, uint64_t *key);
 
+uint64_t ctree_find_ge(struct ctree *t, uint64_t *key);
+uint64_t ctree_find_ge_unlocked(struct ctree *t, uint64_t *key);
+
 uint64_t ctree_remove(struct ctree *t, uint64_t key, int eq);
 uint64_t ctree_remove_unlocked(struct ctree *t, uint64_t key, int eq);
 
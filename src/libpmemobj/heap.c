@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
@@ -56,6 +57,9 @@
 
 #define	MAX_RUN_LOCKS 1024
 
+/* upper limit of the threads writing zone headers in heap_init */
+#define	HEAP_INIT_THREADS_MAX 64
+
 #define	USE_PER_LANE_BUCKETS
 
 #define	EMPTY_MEMORY_BLOCK (struct memory_block)\
@@ -77,6 +81,14 @@
 
 #define	BIT_IS_CLR(a, i)	(!((a) & (1ULL << (i))))
 
+/*
+ * Number of chunks in a single part of the heap handed out by
+ * heap_iter_init_part, 64 megabytes.
+ */
+#define	HEAP_ITER_PART_CHUNKS 256
+#define	HEAP_ITER_ZONE_PARTS\
+	((MAX_CHUNK + HEAP_ITER_PART_CHUNKS - 1) / HEAP_ITER_PART_CHUNKS)
+
 /*
  * The last size that is handled by runs.
  */
@@ -225,11 +237,11 @@ heap_chunk_write_footer(PMEMobjpool *pop, struct chunk_header *hdr,
  */
 static void
 heap_chunk_init(PMEMobjpool *pop, struct chunk_header *hdr,
-	uint16_t type, uint32_t size_idx)
+	uint16_t type, uint16_t flags, uint32_t size_idx)
 {
 	struct chunk_header nhdr = {
 		.type = type,
-		.flags = 0,
+		.flags = flags,
 		.size_idx = size_idx
 	};
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(pop, hdr, sizeof (*hdr));
@@ -250,7 +262,8 @@ heap_zone_init(PMEMobjpool *pop, uint32_t zone_id)
 	uint32_t size_idx = get_zone_size_idx(zone_id, pop->heap->max_zone,
 			pop->heap_size);
 
-	heap_chunk_init(pop, &z->chunk_headers[0], CHUNK_TYPE_FREE, size_idx);
+	heap_chunk_init(pop, &z->chunk_headers[0], CHUNK_TYPE_FREE, 0,
+		size_idx);
 
 	struct zone_header nhdr = {
 		.size_idx = size_idx,
@@ -289,8 +302,12 @@ heap_init_run(PMEMobjpool *pop, struct bucket *b, struct chunk_header *hdr,
 
 	pop->persist(pop, run->bitmap, sizeof (run->bitmap));
 
+	struct chunk_header nhdr = *hdr;
+	nhdr.type = CHUNK_TYPE_RUN;
+	nhdr.flags &= (uint16_t)~CHUNK_FLAG_ZEROED;
+
 	VALGRIND_ADD_TO_TX(hdr, sizeof (*hdr));
-	hdr->type = CHUNK_TYPE_RUN;
+	*hdr = nhdr; /* write the entire header (8 bytes) at once */
 	VALGRIND_REMOVE_FROM_TX(hdr, sizeof (*hdr));
 
 	pop->persist(pop, hdr, sizeof (*hdr));
@@ -976,9 +993,11 @@ heap_resize_chunk(PMEMobjpool *pop,
 	struct chunk_header *old_hdr = &z->chunk_headers[chunk_id];
 	struct chunk_header *new_hdr = &z->chunk_headers[new_chunk_id];
 
+	/* both parts of a zeroed chunk remain zeroed */
+	uint16_t flags = old_hdr->flags;
 	uint32_t rem_size_idx = old_hdr->size_idx - new_size_idx;
-	heap_chunk_init(pop, new_hdr, CHUNK_TYPE_FREE, rem_size_idx);
-	heap_chunk_init(pop, old_hdr, CHUNK_TYPE_FREE, new_size_idx);
+	heap_chunk_init(pop, new_hdr, CHUNK_TYPE_FREE, flags, rem_size_idx);
+	heap_chunk_init(pop, old_hdr, CHUNK_TYPE_FREE, flags, new_size_idx);
 
 	struct bucket *def_bucket = pop->heap->default_bucket;
 	struct memory_block m = {new_chunk_id, zone_id, rem_size_idx, 0};
@@ -1071,6 +1090,8 @@ chunk_get_chunk_hdr_value(struct chunk_header hdr, uint16_t type,
 
 	hdr.type = type;
 	hdr.size_idx = size_idx;
+	/* the contents of a used or freed chunk are unknown */
+	hdr.flags &= (uint16_t)~CHUNK_FLAG_ZEROED;
 	memcpy(&val, &hdr, sizeof (val));
 
 	return val;
@@ -1115,6 +1136,30 @@ heap_prep_block_header_operation(PMEMobjpool *pop, struct memory_block m,
 			~bmask, OPERATION_AND);
 }
 
+/*
+ * heap_block_clear_zeroed -- drops the zeroed flag of a reserved chunk,
+ *	returns 1 if the data of the block is known to be all zeroes
+ *
+ * The flag is persistently cleared before any data is written to the block,
+ * so that a chunk which is not zeroed can never be flagged as such.
+ */
+int
+heap_block_clear_zeroed(PMEMobjpool *pop, struct memory_block m)
+{
+	struct zone *z = ZID_TO_ZONE(pop->heap->layout, m.zone_id);
+	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
+
+	if (hdr->type != CHUNK_TYPE_FREE || !(hdr->flags & CHUNK_FLAG_ZEROED))
+		return 0;
+
+	struct chunk_header nhdr = *hdr;
+	nhdr.flags &= (uint16_t)~CHUNK_FLAG_ZEROED;
+	*hdr = nhdr; /* write the entire header (8 bytes) at once */
+	pop->persist(pop, hdr, sizeof (*hdr));
+
+	return 1;
+}
+
 /*
  * heap_get_block_data -- returns pointer to the data of a block
  */
@@ -1268,6 +1313,22 @@ int heap_get_adjacent_free_block(PMEMobjpool *pop, struct bucket *b,
 	}
 }
 
+/*
+ * heap_block_run_lock -- returns the lock of the run the memory block belongs
+ *	to, or NULL if the block is a chunk
+ */
+pthread_mutex_t *
+heap_block_run_lock(PMEMobjpool *pop, struct memory_block m)
+{
+	struct zone *z = ZID_TO_ZONE(pop->heap->layout, m.zone_id);
+	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
+
+	if (hdr->type != CHUNK_TYPE_RUN)
+		return NULL;
+
+	return heap_get_run_lock(pop, m.chunk_id);
+}
+
 /*
  * heap_lock_if_run -- acquire a run lock
  */
@@ -1444,7 +1505,7 @@ heap_degrade_run_if_empty(PMEMobjpool *pop, struct bucket *b,
 
 	m.block_off = 0;
 	m.size_idx = 1;
-	heap_chunk_init(pop, hdr, CHUNK_TYPE_FREE, m.size_idx);
+	heap_chunk_init(pop, hdr, CHUNK_TYPE_FREE, 0, m.size_idx);
 
 	struct memory_block fm = heap_free_block(pop, defb, m, ctx);
 	operation_process(ctx);
@@ -1669,13 +1730,88 @@ heap_vg_open(PMEMobjpool *pop)
 }
 #endif
 
+/*
+ * heap_init_zone -- (internal) writes the initial headers of a zone
+ */
+static void
+heap_init_zone(PMEMobjpool *pop, struct heap_layout *layout,
+	uint32_t zone_id, unsigned zones, int zeroed)
+{
+	struct zone *z = ZID_TO_ZONE(layout, zone_id);
+
+	if (!zeroed) {
+		memset(&z->header, 0, sizeof (struct zone_header));
+		memset(&z->chunk_headers, 0, sizeof (struct chunk_header));
+
+		pmem_msync(&z->header, sizeof (struct zone_header));
+		pmem_msync(&z->chunk_headers, sizeof (struct chunk_header));
+
+		/* only explicitly allocated chunks should be accessible */
+		VALGRIND_DO_MAKE_MEM_NOACCESS(pop, &z->chunk_headers,
+			sizeof (struct chunk_header));
+
+		return;
+	}
+
+	/*
+	 * The whole zone reads as zeroes, so instead of clearing the headers
+	 * the zone is initialized right away, as a single free chunk which
+	 * is flagged as zeroed.
+	 */
+	uint32_t size_idx = get_zone_size_idx(zone_id, zones, pop->heap_size);
+
+	struct chunk_header nhdr = {
+		.type = CHUNK_TYPE_FREE,
+		.flags = CHUNK_FLAG_ZEROED,
+		.size_idx = size_idx
+	};
+	z->chunk_headers[0] = nhdr; /* write the entire header at once */
+	pmem_msync(&z->chunk_headers[0], sizeof (struct chunk_header));
+
+	struct zone_header zhdr = {
+		.size_idx = size_idx,
+		.magic = ZONE_HEADER_MAGIC,
+	};
+	z->header = zhdr; /* write the entire header at once */
+	pmem_msync(&z->header, sizeof (struct zone_header));
+}
+
+struct heap_init_arg {
+	PMEMobjpool *pop;
+	struct heap_layout *layout;
+	unsigned zones;
+	int zeroed;
+	unsigned next; /* next zone to be initialized */
+};
+
+/*
+ * heap_init_worker -- (internal) initializes zones until none are left
+ */
+static void *
+heap_init_worker(void *arg)
+{
+	struct heap_init_arg *a = arg;
+
+	unsigned zone_id;
+	while ((zone_id = __sync_fetch_and_add(&a->next, 1)) < a->zones)
+		heap_init_zone(a->pop, a->layout, zone_id, a->zones, a->zeroed);
+
+	return NULL;
+}
+
 /*
  * heap_init -- initializes the heap
  *
+ * If the pool is known to be zeroed (all of its files were just created),
+ * the zones are initialized up front and their chunks are flagged as
+ * zeroed, so that the allocations do not have to clear them again.
+ * The zones lie gigabytes apart, so their headers are written by
+ * multiple threads.
+ *
  * If successful function returns zero. Otherwise an error number is returned.
  */
 int
-heap_init(PMEMobjpool *pop)
+heap_init(PMEMobjpool *pop, int zeroed)
 {
 	if (pop->heap_size < HEAP_MIN_SIZE)
 		return EINVAL;
@@ -1687,22 +1823,29 @@ heap_init(PMEMobjpool *pop)
 	heap_write_header(&layout->header, pop->heap_size);
 	pmem_msync(&layout->header, sizeof (struct heap_header));
 
-	unsigned zones = heap_max_zone(pop->heap_size);
-	for (unsigned i = 0; i < zones; ++i) {
-		memset(&ZID_TO_ZONE(layout, i)->header, 0,
-				sizeof (struct zone_header));
-		memset(&ZID_TO_ZONE(layout, i)->chunk_headers, 0,
-				sizeof (struct chunk_header));
+	struct heap_init_arg arg = {pop, layout,
+		heap_max_zone(pop->heap_size), zeroed, 0};
+
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned nthreads = ncpus > 1 ? (unsigned)ncpus - 1 : 0;
+	if (nthreads > arg.zones - 1)
+		nthreads = arg.zones - 1;
+	if (nthreads > HEAP_INIT_THREADS_MAX)
+		nthreads = HEAP_INIT_THREADS_MAX;
+
+	pthread_t threads[HEAP_INIT_THREADS_MAX];
+	unsigned started = 0;
+	for (; started < nthreads; ++started) {
+		if (pthread_create(&threads[started], NULL,
+				heap_init_worker, &arg) != 0)
+			break;
+	}
 
-		pmem_msync(&ZID_TO_ZONE(layout, i)->header,
-				sizeof (struct zone_header));
-		pmem_msync(&ZID_TO_ZONE(layout, i)->chunk_headers,
-				sizeof (struct zone_header));
+	heap_init_worker(&arg);
 
-		/* only explicitly allocated chunks should be accessible */
-		VALGRIND_DO_MAKE_MEM_NOACCESS(pop,
-			&ZID_TO_ZONE(layout, i)->chunk_headers,
-			sizeof (struct chunk_header));
+	for (unsigned i = 0; i < started; ++i) {
+		if ((errno = pthread_join(threads[i], NULL)))
+			FATAL("!pthread_join");
 	}
 
 	return 0;
@@ -1796,7 +1939,8 @@ heap_verify_chunk_header(struct chunk_header *hdr)
 		return -1;
 	}
 
-	if (hdr->flags & CHUNK_FLAG_ZEROED) {
+	if ((hdr->flags & CHUNK_FLAG_ZEROED) &&
+			hdr->type != CHUNK_TYPE_FREE) {
 		ERR("heap: invalid chunk flags");
 		return -1;
 	}
@@ -1974,3 +2118,163 @@ heap_foreach_object(PMEMobjpool *pop, object_callback cb, void *arg,
 				ZID_TO_ZONE(layout, i), start) != 0)
 			break;
 }
+
+/*
+ * heap_iter_init -- positions the iterator at the beginning of the heap
+ */
+void
+heap_iter_init(PMEMobjpool *pop, struct heap_iter *it)
+{
+	struct heap_layout *layout = heap_get_layout(pop);
+
+	it->zone_id = 0;
+	it->zone_end = heap_max_zone(layout->header.size);
+	it->chunk_id = 0;
+	it->chunk_end = UINT32_MAX;
+	it->block_id = 0;
+}
+
+/*
+ * heap_iter_init_after -- positions the iterator right after the given
+ *	memory block
+ */
+void
+heap_iter_init_after(PMEMobjpool *pop, struct heap_iter *it,
+	struct memory_block m)
+{
+	heap_iter_init(pop, it);
+
+	struct zone *z = ZID_TO_ZONE(heap_get_layout(pop), m.zone_id);
+	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
+
+	it->zone_id = m.zone_id;
+	if (hdr->type == CHUNK_TYPE_RUN) {
+		it->chunk_id = m.chunk_id;
+		it->block_id = m.block_off + m.size_idx;
+	} else {
+		it->chunk_id = m.chunk_id + hdr->size_idx;
+	}
+}
+
+/*
+ * heap_iter_init_part -- positions the iterator at the beginning of the given
+ *	part of the heap and limits it to that part
+ *
+ * Every zone is divided into parts of HEAP_ITER_PART_CHUNKS chunks, an object
+ * belongs to the part which contains its first chunk. Returns non-zero if
+ * the part is beyond the end of the heap.
+ */
+int
+heap_iter_init_part(PMEMobjpool *pop, struct heap_iter *it, unsigned part)
+{
+	heap_iter_init(pop, it);
+
+	uint32_t zone_id = part / HEAP_ITER_ZONE_PARTS;
+	if (zone_id >= it->zone_end)
+		return 1;
+
+	it->zone_id = zone_id;
+	it->zone_end = zone_id + 1;
+	it->chunk_end = (part % HEAP_ITER_ZONE_PARTS + 1) *
+		HEAP_ITER_PART_CHUNKS;
+
+	struct zone *z = ZID_TO_ZONE(heap_get_layout(pop), zone_id);
+	if (z->header.magic == 0)
+		return 0;
+
+	/* find the first chunk of the part which is not a continuation */
+	uint32_t chunk_begin = it->chunk_end - HEAP_ITER_PART_CHUNKS;
+	while (it->chunk_id < chunk_begin && it->chunk_id < z->header.size_idx)
+		it->chunk_id += z->chunk_headers[it->chunk_id].size_idx;
+
+	return 0;
+}
+
+/*
+ * heap_run_next -- (internal) returns the first object in the run starting
+ *	at or after the iterator's block
+ */
+static struct allocation_header *
+heap_run_next(struct heap_iter *it, struct chunk_run *run)
+{
+	uint64_t bs = run->block_size;
+	uint64_t nallocs = RUN_NALLOCS(bs);
+
+	uint64_t i = it->block_id;
+	while (i < nallocs) {
+		uint64_t v = run->bitmap[i / BITS_PER_VALUE];
+		uint64_t bit = i % BITS_PER_VALUE;
+
+		/* skip the rest of the empty bitmap value at once */
+		if ((v >> bit) == 0) {
+			i += BITS_PER_VALUE - bit;
+			continue;
+		}
+
+		if (BIT_IS_CLR(v, bit)) {
+			++i;
+			continue;
+		}
+
+		struct allocation_header *alloc = (struct allocation_header *)
+			(run->data + i * bs);
+		it->block_id = (uint32_t)(i + alloc->size / bs);
+
+		/* the caller is about to look at this object, fetch the next */
+		__builtin_prefetch(run->data + it->block_id * bs);
+
+		return alloc;
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_iter_next -- returns the offset of the next object in the heap and
+ *	advances the iterator past it, 0 if there are no more objects
+ *
+ * The returned object may be freed before the next call.
+ */
+uint64_t
+heap_iter_next(PMEMobjpool *pop, struct heap_iter *it)
+{
+	struct heap_layout *layout = heap_get_layout(pop);
+
+	for (; it->zone_id < it->zone_end; ++it->zone_id) {
+		struct zone *z = ZID_TO_ZONE(layout, it->zone_id);
+		if (z->header.magic == 0)
+			goto next_zone;
+
+		uint32_t chunk_end = z->header.size_idx < it->chunk_end ?
+			z->header.size_idx : it->chunk_end;
+
+		while (it->chunk_id < chunk_end) {
+			struct chunk_header *hdr =
+				&z->chunk_headers[it->chunk_id];
+			struct chunk *chunk = &z->chunks[it->chunk_id];
+
+			if (hdr->type == CHUNK_TYPE_RUN) {
+				struct allocation_header *alloc = heap_run_next(
+					it, (struct chunk_run *)chunk);
+				if (alloc != NULL)
+					return OBJ_PTR_TO_OFF(pop, alloc);
+			}
+
+			it->chunk_id += hdr->size_idx;
+			it->block_id = 0;
+
+			/* headers of the following chunks and the run bitmap */
+			__builtin_prefetch(hdr + hdr->size_idx);
+			__builtin_prefetch(chunk + hdr->size_idx);
+
+			if (hdr->type == CHUNK_TYPE_USED)
+				return OBJ_PTR_TO_OFF(pop, chunk);
+		}
+
+next_zone:
+		it->chunk_id = 0;
+		it->block_id = 0;
+	}
+
+	return 0;
+}
@@ -75,6 +75,7 @@ struct bucket *heap_get_chunk_bucket(PMEMobjpool *pop,
 struct bucket *heap_get_auxiliary_bucket(PMEMobjpool *pop, size_t size);
 void heap_drain_to_auxiliary(PMEMobjpool *pop, struct bucket *auxb,
 	uint32_t size_idx);
+int heap_block_clear_zeroed(PMEMobjpool *pop, struct memory_block m);
 void *heap_get_block_data(PMEMobjpool *pop, struct memory_block m);
 void heap_prep_block_header_operation(PMEMobjpool *pop, struct memory_block m,
 	enum heap_op op, struct operation_context *ctx);
@@ -85,6 +86,7 @@ struct memory_block heap_coalesce(PMEMobjpool *pop,
 int heap_get_adjacent_free_block(PMEMobjpool *pop, struct bucket *b,
 	struct memory_block *m, struct memory_block cnt, int prev);
 
+pthread_mutex_t *heap_block_run_lock(PMEMobjpool *pop, struct memory_block m);
 void heap_lock_if_run(PMEMobjpool *pop, struct memory_block m);
 void heap_unlock_if_run(PMEMobjpool *pop, struct memory_block m);
 
@@ -104,6 +106,22 @@ typedef int (*object_callback)(uint64_t off, void *arg);
 void heap_foreach_object(PMEMobjpool *pop, object_callback cb,
 	void *arg, struct memory_block start);
 
+/* position of a sequential walk through the objects in the heap */
+struct heap_iter {
+	uint32_t zone_id;
+	uint32_t zone_end;	/* first zone past the walk */
+	uint32_t chunk_id;
+	uint32_t chunk_end;	/* first chunk past the walk, in every zone */
+	uint32_t block_id;	/* next block of the run at chunk_id */
+};
+
+void heap_iter_init(PMEMobjpool *pop, struct heap_iter *it);
+void heap_iter_init_after(PMEMobjpool *pop, struct heap_iter *it,
+	struct memory_block m);
+int heap_iter_init_part(PMEMobjpool *pop, struct heap_iter *it,
+	unsigned part);
+uint64_t heap_iter_next(PMEMobjpool *pop, struct heap_iter *it);
+
 size_t heap_get_chunk_block_size(PMEMobjpool *pop, struct memory_block m);
 
 #ifdef DEBUG
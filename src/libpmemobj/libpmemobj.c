@@ -119,6 +119,21 @@ pmemobj_set_funcs(
 	util_set_alloc_funcs(malloc_func, free_func, realloc_func, strdup_func);
 }
 
+/*
+ * pmemobj_set_mmap_opts -- set the options of the pool file mappings
+ */
+void
+pmemobj_set_mmap_opts(unsigned flags, unsigned prefault_threads)
+{
+	LOG(3, "flags %#x prefault_threads %u", flags, prefault_threads);
+
+	COMPILE_ERROR_ON(PMEMOBJ_MMAP_HUGEPAGE != UTIL_MMAP_HUGEPAGE);
+	COMPILE_ERROR_ON(PMEMOBJ_MMAP_WILLNEED != UTIL_MMAP_WILLNEED);
+	COMPILE_ERROR_ON(PMEMOBJ_MMAP_PREFAULT != UTIL_MMAP_PREFAULT);
+
+	util_set_mmap_opts(flags, prefault_threads);
+}
+
 /*
  * pmemobj_errormsg -- return last error message
  */
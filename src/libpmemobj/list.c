@@ -571,7 +571,7 @@ static int
 list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head, PMEMoid dest, int before,
 	size_t size, int (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp)
+	size_t usable_size, int zeroed, void *arg), void *arg, PMEMoid *oidp)
 {
 	LOG(3, NULL);
 	ASSERT(oob_head != NULL || user_head != NULL);
@@ -716,7 +716,7 @@ err_pmalloc:
 int
 list_insert_new_oob(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t size, int (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp)
+	size_t usable_size, int zeroed, void *arg), void *arg, PMEMoid *oidp)
 {
 	return list_insert_new(pop, oob_head, 0, NULL, OID_NULL,
 			0, size, constructor, arg, oidp);
@@ -740,7 +740,7 @@ int
 list_insert_new_user(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head, PMEMoid dest, int before,
 	size_t size, int (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp)
+	size_t usable_size, int zeroed, void *arg), void *arg, PMEMoid *oidp)
 {
 	int ret;
 	if (user_head) {
@@ -987,6 +987,190 @@ list_remove_free_user(PMEMobjpool *pop, struct list_head *oob_head,
 	return 0;
 }
 
+/*
+ * list_oob_entry -- (internal) returns the oob list entry of an object
+ */
+static inline struct list_entry *
+list_oob_entry(PMEMobjpool *pop, uint64_t obj_doffset)
+{
+	uint64_t entry_off = obj_doffset;
+	u64_add_offset(&entry_off, OOB_ENTRY_OFF_REV);
+
+	return (struct list_entry *)OBJ_OFF_TO_PTR(pop, entry_off);
+}
+
+/*
+ * list_oob_front -- (internal) collects offsets of up to max first objects
+ *	of a non-empty oob list
+ */
+static size_t
+list_oob_front(PMEMobjpool *pop, struct list_head *oob_head,
+	uint64_t *offs, size_t max)
+{
+	uint64_t first = oob_head->pe_first.off;
+	uint64_t off = first;
+	size_t n = 0;
+
+	ASSERTne(first, 0);
+
+	do {
+		offs[n++] = off;
+		off = list_oob_entry(pop, off)->pe_next.off;
+	} while (n < max && off != first);
+
+	return n;
+}
+
+/*
+ * list_oob_detach_front -- (internal) fills entries which detach the first
+ *	n objects from the oob list, returns the number of entries
+ *
+ * The objects are detached as a whole, their own list entries are left
+ * untouched.
+ */
+static size_t
+list_oob_detach_front(PMEMobjpool *pop, uint64_t *offs, size_t n,
+	struct operation_entry *entries, void *arg)
+{
+	struct list_head *oob_head = arg;
+
+	ASSERTeq(oob_head->pe_first.off, offs[0]);
+
+	uint64_t last = list_oob_entry(pop, offs[0])->pe_prev.off;
+	uint64_t next = list_oob_entry(pop, offs[n - 1])->pe_next.off;
+
+	entries[0].ptr = &oob_head->pe_first.off;
+	entries[0].type = OPERATION_SET;
+
+	if (next == offs[0]) {
+		/* all elements are removed */
+		entries[0].value = 0;
+
+		return 1;
+	}
+
+	entries[0].value = next;
+
+	/* set next->prev = last and last->next = next */
+	entries[1].ptr = &list_oob_entry(pop, next)->pe_prev.off;
+	entries[1].value = last;
+	entries[1].type = OPERATION_SET;
+
+	entries[2].ptr = &list_oob_entry(pop, last)->pe_next.off;
+	entries[2].value = next;
+	entries[2].type = OPERATION_SET;
+
+	return 3;
+}
+
+/*
+ * list_remove_free_oob_all -- remove and free all objects from oob list
+ *
+ * pop         - pmemobj pool handle
+ * oob_head    - oob list head
+ *
+ * The objects are detached from the front of the list and freed in batches.
+ * The list update and the heap metadata changes of a whole batch are applied
+ * using a single redo log.
+ */
+void
+list_remove_free_oob_all(PMEMobjpool *pop, struct list_head *oob_head)
+{
+	LOG(3, NULL);
+	ASSERTne(oob_head, NULL);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+
+	pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+
+	uint64_t offs[PFREE_BATCH_MAX];
+	while (oob_head->pe_first.off != 0) {
+		size_t n = list_oob_front(pop, oob_head, offs,
+				PFREE_BATCH_MAX);
+
+		pfree_batch(pop, section->redo, offs, n,
+				list_oob_detach_front, oob_head);
+	}
+
+	pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+
+	lane_release(pop);
+}
+
+/*
+ * list_remove_oob_all -- remove all objects from oob list
+ *
+ * pop         - pmemobj pool handle
+ * oob_head    - oob list head
+ *
+ * The objects are detached from the front of the list in batches, a single
+ * redo log updates the list and clears the entries of the whole batch.
+ */
+void
+list_remove_oob_all(PMEMobjpool *pop, struct list_head *oob_head)
+{
+	LOG(3, NULL);
+	ASSERTne(oob_head, NULL);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+
+	pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+
+	/* list update and next and prev offsets of each removed element */
+	uint64_t offs[(REDO_NUM_ENTRIES - 3) / 2];
+	struct operation_entry entries[3];
+
+	while (oob_head->pe_first.off != 0) {
+		size_t n = list_oob_front(pop, oob_head, offs,
+				(REDO_NUM_ENTRIES - 3) / 2);
+		size_t nentries = list_oob_detach_front(pop, offs, n,
+				entries, oob_head);
+
+		size_t redo_index = 0;
+		for (size_t i = 0; i < nentries; ++i)
+			redo_log_store(pop, redo, redo_index++,
+				OBJ_PTR_TO_OFF(pop, entries[i].ptr),
+				entries[i].value);
+
+		for (size_t i = 0; i < n; ++i) {
+			struct list_entry *entry_ptr =
+				list_oob_entry(pop, offs[i]);
+
+			redo_log_store(pop, redo, redo_index++,
+				OBJ_PTR_TO_OFF(pop, &entry_ptr->pe_next.off),
+				0);
+			redo_log_store(pop, redo, redo_index++,
+				OBJ_PTR_TO_OFF(pop, &entry_ptr->pe_prev.off),
+				0);
+		}
+
+		redo_log_set_last(pop, redo, redo_index - 1);
+
+		redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+	}
+
+	pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+
+	lane_release(pop);
+}
+
 /*
  * list_remove -- remove object from list
  *
@@ -1277,6 +1461,301 @@ err:
 	return ret;
 }
 
+/*
+ * queue_entry_ptr -- (internal) returns the queue entry of an element
+ */
+static inline struct queue_entry *
+queue_entry_ptr(PMEMobjpool *pop, uint64_t obj_doffset, size_t pe_offset)
+{
+	return (struct queue_entry *)OBJ_OFF_TO_PTR(pop,
+			obj_doffset + pe_offset);
+}
+
+/*
+ * queue_fill_entry_persist -- (internal) terminates the entry of an element
+ *	which is about to become the last one
+ *
+ * The element isn't reachable from the queue yet, so the redo log is not
+ * needed.
+ */
+static void
+queue_fill_entry_persist(PMEMobjpool *pop, struct queue_entry *entry_ptr)
+{
+	VALGRIND_ADD_TO_TX(entry_ptr, sizeof (*entry_ptr));
+	entry_ptr->pe_next.pool_uuid_lo = pop->uuid_lo;
+	entry_ptr->pe_next.off = 0;
+	VALGRIND_REMOVE_FROM_TX(entry_ptr, sizeof (*entry_ptr));
+
+	pop->persist(pop, entry_ptr, sizeof (*entry_ptr));
+}
+
+/*
+ * queue_lock_tail -- (internal) grabs the tail lock and, if the queue is
+ *	empty, the head lock as well
+ *
+ * The head lock is always acquired before the tail lock. Returns 1 if both
+ * locks are held.
+ */
+static int
+queue_lock_tail(PMEMobjpool *pop, struct queue_head *head)
+{
+	pmemobj_mutex_lock_nofail(pop, &head->tail_lock);
+	if (head->pe_last.off != 0)
+		return 0;
+
+	/* pushing to an empty queue modifies the first element too */
+	pmemobj_mutex_unlock_nofail(pop, &head->tail_lock);
+	pmemobj_mutex_lock_nofail(pop, &head->head_lock);
+	pmemobj_mutex_lock_nofail(pop, &head->tail_lock);
+
+	return 1;
+}
+
+/*
+ * queue_link -- (internal) appends an element to the queue using redo log
+ */
+static size_t
+queue_link(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index,
+	size_t pe_offset, struct queue_head *head, uint64_t obj_doffset)
+{
+	if (head->pe_last.off == 0) {
+		/* the queue is empty, the head lock is held as well */
+		ASSERTeq(head->pe_first.off, 0);
+		redo_index = list_set_oid_redo_log(pop, redo, redo_index,
+				&head->pe_first, obj_doffset, 1);
+	} else {
+		struct queue_entry *last_ptr = queue_entry_ptr(pop,
+				head->pe_last.off, pe_offset);
+		ASSERTeq(last_ptr->pe_next.off, 0);
+		redo_index = list_set_oid_redo_log(pop, redo, redo_index,
+				&last_ptr->pe_next, obj_doffset, 1);
+	}
+
+	return list_set_oid_redo_log(pop, redo, redo_index,
+			&head->pe_last, obj_doffset, 1);
+}
+
+/*
+ * queue_unlock_tail -- (internal) releases the locks taken by
+ *	queue_lock_tail
+ */
+static void
+queue_unlock_tail(PMEMobjpool *pop, struct queue_head *head, int both)
+{
+	pmemobj_mutex_unlock_nofail(pop, &head->tail_lock);
+	if (both)
+		pmemobj_mutex_unlock_nofail(pop, &head->head_lock);
+}
+
+/*
+ * list_queue_push -- appends an existing object to the queue
+ *
+ * pop       - pmemobj pool handle
+ * pe_offset - offset to queue entry relative to user data
+ * head      - queue head
+ * oid       - target object ID
+ */
+int
+list_queue_push(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, PMEMoid oid)
+{
+	LOG(3, NULL);
+	ASSERTne(head, NULL);
+	ASSERTne(oid.off, 0);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+
+	queue_fill_entry_persist(pop, queue_entry_ptr(pop, oid.off, pe_offset));
+
+	int both = queue_lock_tail(pop, head);
+
+	size_t redo_index = queue_link(pop, redo, 0, pe_offset, head, oid.off);
+
+	redo_log_set_last(pop, redo, redo_index - 1);
+
+	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+	queue_unlock_tail(pop, head, both);
+
+	lane_release(pop);
+
+	return 0;
+}
+
+/*
+ * list_queue_push_new -- allocates a new object and appends it to the queue
+ *
+ * pop         - pmemobj pool handle
+ * pe_offset   - offset to queue entry relative to user data
+ * head        - queue head
+ * size        - size of allocation, will be increased by OBJ_OOB_SIZE
+ * constructor - object's constructor
+ * arg         - argument for object's constructor
+ * oidp        - pointer to target object ID
+ *
+ * The object is allocated and constructed before the queue is locked.
+ */
+int
+list_queue_push_new(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, size_t size, pmalloc_constr constructor,
+	void *arg, PMEMoid *oidp)
+{
+	LOG(3, NULL);
+	ASSERTne(head, NULL);
+
+	int ret;
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+	uint64_t sec_off_off = OBJ_PTR_TO_OFF(pop, &section->obj_offset);
+
+	/* increase allocation size by oob header size */
+	size += OBJ_OOB_SIZE;
+
+	if (constructor)
+		ret = pmalloc_construct(pop, &section->obj_offset, size,
+				constructor, arg);
+	else
+		ret = pmalloc(pop, &section->obj_offset, size);
+
+	if (ret) {
+		ERR("!pmalloc");
+		goto err_pmalloc;
+	}
+
+	uint64_t obj_doffset = section->obj_offset;
+
+	queue_fill_entry_persist(pop,
+			queue_entry_ptr(pop, obj_doffset, pe_offset));
+
+	int both = queue_lock_tail(pop, head);
+
+	size_t redo_index = queue_link(pop, redo, 0, pe_offset, head,
+			obj_doffset);
+
+	/* clear the obj_offset in lane section */
+	redo_log_store_last(pop, redo, redo_index, sec_off_off, 0);
+
+	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+	queue_unlock_tail(pop, head, both);
+
+	if (oidp != NULL) {
+		oidp->off = obj_doffset;
+		oidp->pool_uuid_lo = pop->uuid_lo;
+	}
+
+err_pmalloc:
+	lane_release(pop);
+
+	return ret;
+}
+
+/*
+ * list_queue_pop -- removes the first object from the queue
+ *
+ * pop       - pmemobj pool handle
+ * pe_offset - offset to queue entry relative to user data
+ * head      - queue head
+ * oidp      - pointer to target object ID, the object is freed if NULL
+ *
+ * If oidp points to persistent memory, it's set atomically with removing
+ * the object from the queue. Returns ENOENT if the queue is empty.
+ */
+int
+list_queue_pop(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, PMEMoid *oidp)
+{
+	LOG(3, NULL);
+	ASSERTne(head, NULL);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+	uint64_t sec_off_off = OBJ_PTR_TO_OFF(pop, &section->obj_offset);
+
+	pmemobj_mutex_lock_nofail(pop, &head->head_lock);
+
+	uint64_t obj_doffset = head->pe_first.off;
+	if (obj_doffset == 0) {
+		pmemobj_mutex_unlock_nofail(pop, &head->head_lock);
+		lane_release(pop);
+		return ENOENT;
+	}
+
+	struct queue_entry *entry_ptr = queue_entry_ptr(pop, obj_doffset,
+			pe_offset);
+
+	/*
+	 * Only the last element can be modified by a concurrent push, in
+	 * which case the tail has to be locked as well.
+	 */
+	int tail_locked = 0;
+	if (entry_ptr->pe_next.off == 0) {
+		pmemobj_mutex_lock_nofail(pop, &head->tail_lock);
+		tail_locked = 1;
+	}
+
+	uint64_t next_offset = entry_ptr->pe_next.off;
+
+	size_t redo_index = list_set_oid_redo_log(pop, redo, 0,
+			&head->pe_first, next_offset, 1);
+
+	if (next_offset == 0) {
+		ASSERT(tail_locked);
+		ASSERTeq(head->pe_last.off, obj_doffset);
+		redo_index = list_set_oid_redo_log(pop, redo, redo_index,
+				&head->pe_last, 0, 1);
+	}
+
+	int valid_oidp = oidp != NULL && OBJ_PTR_IS_VALID(pop, oidp);
+
+	if (oidp == NULL) {
+		/* the object is freed after it's removed from the queue */
+		redo_log_store_last(pop, redo, redo_index, sec_off_off,
+				obj_doffset);
+	} else {
+		if (valid_oidp)
+			redo_index = list_set_oid_redo_log(pop, redo,
+					redo_index, oidp, obj_doffset, 0);
+
+		redo_log_set_last(pop, redo, redo_index - 1);
+	}
+
+	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+	if (oidp != NULL && !valid_oidp) {
+		oidp->off = obj_doffset;
+		oidp->pool_uuid_lo = pop->uuid_lo;
+	}
+
+	if (tail_locked)
+		pmemobj_mutex_unlock_nofail(pop, &head->tail_lock);
+	pmemobj_mutex_unlock_nofail(pop, &head->head_lock);
+
+	if (oidp == NULL)
+		pfree(pop, &section->obj_offset);
+
+	lane_release(pop);
+
+	return 0;
+}
+
 /*
  * lane_list_recovery -- (internal) recover the list section of the lane
  */
@@ -1288,6 +1767,10 @@ lane_list_recovery(PMEMobjpool *pop, struct lane_section_layout *section_layout)
 	struct lane_list_section *section =
 		(struct lane_list_section *)section_layout;
 
+	/*
+	 * The redo log of a batched free carries heap metadata changes too.
+	 * Replaying them here is safe, the heap has not been populated yet.
+	 */
 	redo_log_recover(pop, section->redo, REDO_NUM_ENTRIES);
 
 	if (section->obj_offset) {
@@ -58,6 +58,23 @@ struct list_head {
 	PMEMmutex lock;
 };
 
+struct queue_entry {
+	PMEMoid pe_next;
+};
+
+/*
+ * queue_head -- head of the singly-linked FIFO queue
+ *
+ * Each end of the queue lives in its own cache line along with its lock.
+ */
+struct queue_head {
+	PMEMmutex head_lock;
+	PMEMoid pe_first;
+	uint64_t unused[6];
+	PMEMmutex tail_lock;
+	PMEMoid pe_last;
+};
+
 int list_insert_new_oob(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t size, pmalloc_constr constructor, void *arg, PMEMoid *oidp);
 
@@ -76,6 +93,10 @@ int list_remove_free_user(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head,
 	PMEMoid *oidp);
 
+void list_remove_free_oob_all(PMEMobjpool *pop, struct list_head *oob_head);
+
+void list_remove_oob_all(PMEMobjpool *pop, struct list_head *oob_head);
+
 int list_remove(PMEMobjpool *pop,
 	ssize_t pe_offset, struct list_head *head,
 	PMEMoid oid);
@@ -88,3 +109,13 @@ int list_move(PMEMobjpool *pop,
 void list_move_oob(PMEMobjpool *pop,
 	struct list_head *head_old, struct list_head *head_new,
 	PMEMoid oid);
+
+int list_queue_push(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, PMEMoid oid);
+
+int list_queue_push_new(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, size_t size, pmalloc_constr constructor,
+	void *arg, PMEMoid *oidp);
+
+int list_queue_pop(PMEMobjpool *pop, size_t pe_offset,
+	struct queue_head *head, PMEMoid *oidp);
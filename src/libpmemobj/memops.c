@@ -54,7 +54,7 @@ enum operation_entry_type {
 };
 
 #define	MAX_TRANSIENT_ENTRIES 10
-#define	MAX_PERSITENT_ENTRIES 10
+#define	MAX_PERSITENT_ENTRIES OPERATION_MAX_ENTRIES
 
 /*
  * operation_context -- context of an ongoing palloc operation
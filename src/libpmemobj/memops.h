@@ -48,6 +48,9 @@ struct operation_entry {
 	enum operation_type type;
 };
 
+/* maximum number of persistent entries in a single operation */
+#define	OPERATION_MAX_ENTRIES 32
+
 struct operation_context;
 
 struct operation_context *operation_init(PMEMobjpool *pop,
@@ -47,6 +47,8 @@
 #include "redo.h"
 #include "memops.h"
 #include "pmalloc.h"
+#include "heap.h"
+#include "type_index.h"
 #include "list.h"
 #include "cuckoo.h"
 #include "ctree.h"
@@ -55,6 +57,13 @@
 #include "heap_layout.h"
 #include "valgrind_internal.h"
 
+/* state of an iteration through the objects of a pool */
+struct pmemobjcursor {
+	PMEMobjpool *pop;
+	uint64_t type_num;
+	struct heap_iter iter;
+};
+
 static struct cuckoo *pools_ht; /* hash table used for searching by UUID */
 static struct ctree *pools_tree; /* tree used for searching by address */
 
@@ -67,6 +76,19 @@ __thread struct _pobj_pcache _pobj_cached_pool;
  */
 static int Open_cow;
 
+/*
+ * User may decide to keep the state of all pmem-resident locks in DRAM using
+ * PMEMOBJ_DRAM_LOCKS environment variable.
+ */
+static int Dram_locks;
+
+/*
+ * User may decide to make all pmem-resident rwlocks reader-biased using
+ * PMEMOBJ_RWLOCK_READER_BIAS environment variable. This implies keeping the
+ * state of the locks in DRAM.
+ */
+static int Rwlock_reader_bias;
+
 /*
  * obj_init -- initialization of obj
  *
@@ -85,6 +107,14 @@ obj_init(void)
 		Open_cow = atoi(env);
 #endif
 
+	char *locks_env = getenv("PMEMOBJ_DRAM_LOCKS");
+	if (locks_env)
+		Dram_locks = atoi(locks_env);
+
+	char *bias_env = getenv("PMEMOBJ_RWLOCK_READER_BIAS");
+	if (bias_env)
+		Rwlock_reader_bias = atoi(bias_env);
+
 	pools_ht = cuckoo_new();
 	if (pools_ht == NULL)
 		FATAL("!cuckoo_new");
@@ -92,6 +122,8 @@ obj_init(void)
 	pools_tree = ctree_new();
 	if (pools_tree == NULL)
 		FATAL("!ctree_new");
+
+	tx_init();
 }
 
 /*
@@ -105,6 +137,7 @@ obj_fini(void)
 	LOG(3, NULL);
 	cuckoo_delete(pools_ht);
 	ctree_delete(pools_tree);
+	tx_fini();
 }
 
 /*
@@ -462,9 +495,11 @@ pmemobj_boot(PMEMobjpool *pop)
  * pmemobj_descr_create -- (internal) create obj pool descriptor
  */
 static int
-pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
+pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize,
+	int zeroed)
 {
-	LOG(3, "pop %p layout %s poolsize %zu", pop, layout, poolsize);
+	LOG(3, "pop %p layout %s poolsize %zu zeroed %d", pop, layout,
+		poolsize, zeroed);
 
 	ASSERTeq(poolsize % Pagesize, 0);
 
@@ -500,7 +535,7 @@ pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 	pop->heap_size = poolsize - pop->heap_offset;
 
 	/* initialize heap prior to storing the checksum */
-	if ((errno = heap_init(pop)) != 0) {
+	if ((errno = heap_init(pop, zeroed)) != 0) {
 		ERR("!heap_init");
 		return -1;
 	}
@@ -634,22 +669,30 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 	 */
 	pop->rdonly = rdonly;
 	pop->lanes = NULL;
+	pop->type_index = NULL;
+	pop->lock_table = NULL;
+
+	if (Dram_locks || Rwlock_reader_bias) {
+		pop->lock_table = sync_lock_table_new(Rwlock_reader_bias);
+		if (pop->lock_table == NULL)
+			return -1;
+	}
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
 
 	if (boot) {
 		if ((errno = pmemobj_boot(pop)) != 0)
-			return -1;
+			goto err;
 
 		if ((errno = cuckoo_insert(pools_ht, pop->uuid_lo, pop)) != 0) {
 			ERR("!cuckoo_insert");
-			return -1;
+			goto err;
 		}
 
 		if ((errno = ctree_insert(pools_tree, (uint64_t)pop, pop->size))
 				!= 0) {
 			ERR("!ctree_insert");
-			return -1;
+			goto err;
 		}
 	}
 
@@ -662,6 +705,16 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 	util_range_none(pop->addr, sizeof (struct pool_hdr));
 
 	return 0;
+
+err:
+	if (pop->lock_table != NULL) {
+		int oerrno = errno;
+		sync_lock_table_delete(pop->lock_table);
+		pop->lock_table = NULL;
+		errno = oerrno;
+	}
+
+	return -1;
 }
 
 /*
@@ -693,6 +746,16 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 
 	ASSERT(set->nreplicas > 0);
 
+	/*
+	 * The heap of a zeroed pool is created with its chunks flagged as
+	 * zeroed, which older versions of the library do not understand.
+	 */
+	if (set->zeroed && util_poolset_incompat_set(set,
+			OBJ_FORMAT_INCOMPAT_ZEROED) != 0) {
+		LOG(2, "cannot set pool features");
+		goto err;
+	}
+
 	PMEMobjpool *pop;
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
@@ -706,7 +769,8 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 		pop->size = rep->repsize;
 
 		/* create pool descriptor */
-		if (pmemobj_descr_create(pop, layout, set->poolsize) != 0) {
+		if (pmemobj_descr_create(pop, layout, set->poolsize,
+				set->zeroed) != 0) {
 			LOG(2, "descriptor creation failed");
 			goto err;
 		}
@@ -802,7 +866,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 
 	if (util_pool_open(&set, path, cow, PMEMOBJ_MIN_POOL,
 			OBJ_HDR_SIG, OBJ_FORMAT_MAJOR,
-			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT,
+			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT_SUPPORTED,
 			OBJ_FORMAT_RO_COMPAT) != 0) {
 		LOG(2, "cannot open pool or pool set");
 		return NULL;
@@ -932,10 +996,16 @@ pmemobj_cleanup(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	if (pop->type_index != NULL)
+		type_index_delete(pop->type_index);
+
 	heap_cleanup(pop);
 
 	lane_cleanup(pop);
 
+	if (pop->lock_table != NULL)
+		sync_lock_table_delete(pop->lock_table);
+
 	VALGRIND_DO_DESTROY_MEMPOOL(pop);
 
 	/* unmap all the replicas */
@@ -1053,6 +1123,22 @@ pmemobj_pool_by_ptr(const void *addr)
 	return (PMEMobjpool *)key;
 }
 
+/*
+ * pmemobj_oid -- returns the object handle of the object at the address
+ */
+PMEMoid
+pmemobj_oid(const void *addr)
+{
+	LOG(3, "addr %p", addr);
+
+	PMEMobjpool *pop = pmemobj_pool_by_ptr(addr);
+	if (pop == NULL)
+		return OID_NULL;
+
+	PMEMoid oid = {pop->uuid_lo, (uintptr_t)addr - (uintptr_t)pop};
+	return oid;
+}
+
 /* arguments for constructor_alloc_bytype */
 struct carg_bytype {
 	type_num_t user_type;
@@ -1066,7 +1152,7 @@ struct carg_bytype {
  */
 static int
 constructor_alloc_bytype(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
 
@@ -1084,10 +1170,14 @@ constructor_alloc_bytype(PMEMobjpool *pop, void *ptr,
 
 	pop->flush(pop, pobj, sizeof (*pobj));
 
-	if (carg->zero_init)
+	if (carg->zero_init && !zeroed) {
 		pop->memset_persist(pop, ptr, 0, usable_size);
-	else
+	} else {
+		/* a zeroed block does not have to be cleared again */
+		if (carg->zero_init)
+			VALGRIND_DO_MAKE_MEM_DEFINED(pop, ptr, usable_size);
 		pop->drain(pop);
+	}
 
 	int ret = 0;
 	if (carg->constructor)
@@ -1200,7 +1290,8 @@ obj_free(PMEMobjpool *pop, PMEMoid *oidp)
  * constructor_realloc -- (internal) constructor for pmemobj_realloc
  */
 static int
-constructor_realloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+constructor_realloc(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
 
@@ -1226,7 +1317,11 @@ constructor_realloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
 		size_t grow_len = usable_size - carg->old_size;
 		void *new_data_ptr = (void *)((uintptr_t)ptr + carg->old_size);
 
-		pop->memset_persist(pop, new_data_ptr, 0, grow_len);
+		if (zeroed)
+			VALGRIND_DO_MAKE_MEM_DEFINED(pop, new_data_ptr,
+				grow_len);
+		else
+			pop->memset_persist(pop, new_data_ptr, 0, grow_len);
 	}
 
 	return 0;
@@ -1295,7 +1390,7 @@ obj_realloc_common(PMEMobjpool *pop,
  */
 static int
 constructor_zrealloc_root(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
 
@@ -1309,7 +1404,7 @@ constructor_zrealloc_root(PMEMobjpool *pop, void *ptr,
 
 	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
 
-	constructor_realloc(pop, ptr, usable_size, arg);
+	constructor_realloc(pop, ptr, usable_size, zeroed, arg);
 	if (ptr != carg->ptr) {
 		pobj->size = carg->new_size | OBJ_INTERNAL_OBJECT_MASK;
 		pop->flush(pop, &pobj->size, sizeof (pobj->size));
@@ -1540,7 +1635,7 @@ struct carg_root {
  */
 static int
 constructor_alloc_root(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
 
@@ -1560,6 +1655,8 @@ constructor_alloc_root(PMEMobjpool *pop, void *ptr,
 
 	if (carg->constructor)
 		ret = carg->constructor(pop, ptr, carg->arg);
+	else if (zeroed)
+		VALGRIND_DO_MAKE_MEM_DEFINED(pop, ptr, usable_size);
 	else
 		pop->memset_persist(pop, ptr, 0, usable_size);
 
@@ -1738,6 +1835,239 @@ pmemobj_next(PMEMoid oid)
 	return ret;
 }
 
+/*
+ * pmemobj_first_type_num -- returns the first object of the specified type
+ */
+PMEMoid
+pmemobj_first_type_num(PMEMobjpool *pop, uint64_t type_num)
+{
+	LOG(3, "pop %p type_num %ju", pop, type_num);
+
+	PMEMoid ret = {0, 0};
+
+	uint64_t off = 0;
+	if (type_index_find_ge(pop, type_num, &off) != 0) {
+		/* the index is not available, walk all the objects */
+		ret = pmemobj_first(pop);
+		while (!OID_IS_NULL(ret) && pmemobj_type_num(ret) != type_num)
+			ret = pmemobj_next(ret);
+
+		return ret;
+	}
+
+	if (off != 0) {
+		ret.off = off;
+		ret.pool_uuid_lo = pop->uuid_lo;
+	}
+
+	return ret;
+}
+
+/*
+ * pmemobj_next_type_num -- returns the next object of the same type
+ */
+PMEMoid
+pmemobj_next_type_num(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016jx", oid.off);
+
+	if (oid.off == 0)
+		return OID_NULL;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	uint64_t type_num = OOB_HEADER_FROM_OID(pop, oid)->type_num;
+
+	PMEMoid ret = {0, 0};
+
+	uint64_t off = oid.off + 1;
+	if (type_index_find_ge(pop, type_num, &off) != 0) {
+		/* the index is not available, walk all the objects */
+		ret = oid;
+		do {
+			ret = pmemobj_next(ret);
+		} while (!OID_IS_NULL(ret) &&
+			pmemobj_type_num(ret) != type_num);
+
+		return ret;
+	}
+
+	if (off != 0) {
+		ret.off = off;
+		ret.pool_uuid_lo = pop->uuid_lo;
+	}
+
+	return ret;
+}
+
+/*
+ * obj_iter_next -- (internal) returns the next user object of the specified
+ *	type from the heap iterator
+ */
+static PMEMoid
+obj_iter_next(PMEMobjpool *pop, struct heap_iter *it, uint64_t type_num)
+{
+	uint64_t off;
+	while ((off = heap_iter_next(pop, it)) != 0) {
+		off += sizeof (struct allocation_header) + OBJ_OOB_SIZE;
+
+		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, off);
+		if (oobh->size & OBJ_INTERNAL_OBJECT_MASK)
+			continue;
+
+		if (type_num != POBJ_ANY_TYPE_NUM && oobh->type_num != type_num)
+			continue;
+
+		PMEMoid ret = {pop->uuid_lo, off};
+		return ret;
+	}
+
+	return OID_NULL;
+}
+
+/*
+ * pmemobj_cursor_open -- starts an iteration through the objects of the pool
+ */
+PMEMobjcursor *
+pmemobj_cursor_open(PMEMobjpool *pop, uint64_t type_num)
+{
+	LOG(3, "pop %p type_num %ju", pop, type_num);
+
+	PMEMobjcursor *cur = Malloc(sizeof (*cur));
+	if (cur == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	cur->pop = pop;
+	cur->type_num = type_num;
+	heap_iter_init(pop, &cur->iter);
+
+	return cur;
+}
+
+/*
+ * pmemobj_cursor_next -- returns the next object of the iteration
+ */
+PMEMoid
+pmemobj_cursor_next(PMEMobjcursor *cur)
+{
+	return obj_iter_next(cur->pop, &cur->iter, cur->type_num);
+}
+
+/*
+ * pmemobj_cursor_close -- ends the iteration
+ */
+void
+pmemobj_cursor_close(PMEMobjcursor *cur)
+{
+	LOG(3, "cur %p", cur);
+
+	Free(cur);
+}
+
+/* arguments of the pmemobj_foreach_parallel workers */
+struct obj_foreach_args {
+	PMEMobjpool *pop;
+	uint64_t type_num;
+	pmemobj_foreach_cb cb;
+	void *arg;
+
+	unsigned next_part; /* next part of the heap to be taken by a worker */
+	int ret; /* first non-zero value returned by the callback */
+};
+
+/*
+ * obj_foreach_worker -- (internal) visits the objects in the consecutive
+ *	parts of the heap that are not taken by other workers yet
+ */
+static void *
+obj_foreach_worker(void *arg)
+{
+	struct obj_foreach_args *args = arg;
+	struct heap_iter it;
+
+	while (args->ret == 0) {
+		unsigned part = __sync_fetch_and_add(&args->next_part, 1);
+		if (heap_iter_init_part(args->pop, &it, part) != 0)
+			break;
+
+		PMEMoid oid;
+		while (!OID_IS_NULL(oid = obj_iter_next(args->pop, &it,
+				args->type_num))) {
+			int ret = args->cb(oid, args->arg);
+			if (ret != 0) {
+				__sync_bool_compare_and_swap(&args->ret, 0,
+					ret);
+				return NULL;
+			}
+
+			if (args->ret != 0)
+				return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * pmemobj_foreach_parallel -- calls the callback for every object of the
+ *	specified type using multiple threads
+ */
+int
+pmemobj_foreach_parallel(PMEMobjpool *pop, uint64_t type_num,
+	pmemobj_foreach_cb cb, void *arg, unsigned nthreads)
+{
+	LOG(3, "pop %p type_num %ju cb %p arg %p nthreads %u", pop, type_num,
+		cb, arg, nthreads);
+
+	if (nthreads == 0) {
+		ERR("invalid number of threads");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct obj_foreach_args args = {pop, type_num, cb, arg, 0, 0};
+
+	/*
+	 * The heap is handed out to the workers part by part, so if some of
+	 * the threads cannot be started the remaining ones, including the
+	 * calling one, simply visit more parts.
+	 */
+	pthread_t *threads = Malloc(sizeof (pthread_t) * nthreads);
+	unsigned started = 0;
+	if (threads == NULL) {
+		LOG(2, "!Malloc");
+	} else {
+		for (; started < nthreads - 1; ++started) {
+			int ret = pthread_create(&threads[started], NULL,
+				obj_foreach_worker, &args);
+			if (ret != 0) {
+				errno = ret;
+				LOG(2, "!pthread_create");
+				break;
+			}
+		}
+	}
+
+	obj_foreach_worker(&args);
+
+	for (unsigned i = 0; i < started; ++i) {
+		int ret = pthread_join(threads[i], NULL);
+		if (ret != 0) {
+			errno = ret;
+			FATAL("!pthread_join");
+		}
+	}
+
+	Free(threads);
+
+	return args.ret;
+}
+
 /*
  * pmemobj_list_insert -- adds object to a list
  */
@@ -1832,6 +2162,93 @@ pmemobj_list_remove(PMEMobjpool *pop, size_t pe_offset, void *head,
 	}
 }
 
+/*
+ * pmemobj_queue_push -- appends object to a queue
+ */
+int
+pmemobj_queue_push(PMEMobjpool *pop, size_t pe_offset, void *head,
+		PMEMoid oid)
+{
+	LOG(3, "pop %p pe_offset %zu head %p oid.off 0x%016jx",
+	    pop, pe_offset, head, oid.off);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	if (pe_offset >= pop->size) {
+		ERR("pe_offset (%lu) too big", pe_offset);
+		return EINVAL;
+	}
+
+	if (OBJ_OID_IS_NULL(oid)) {
+		ERR("cannot push a NULL object");
+		return EINVAL;
+	}
+
+	return list_queue_push(pop, pe_offset, head, oid);
+}
+
+/*
+ * pmemobj_queue_push_new -- allocates new object and appends it to a queue
+ */
+PMEMoid
+pmemobj_queue_push_new(PMEMobjpool *pop, size_t pe_offset, void *head,
+		size_t size, uint64_t type_num,
+		pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p pe_offset %zu head %p size %zu type_num %lu",
+	    pop, pe_offset, head, size, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return OID_NULL;
+	}
+
+	if (pe_offset >= pop->size) {
+		ERR("pe_offset (%lu) too big", pe_offset);
+		errno = EINVAL;
+		return OID_NULL;
+	}
+
+	struct carg_bytype carg;
+
+	carg.user_type = (type_num_t)type_num;
+	carg.constructor = constructor;
+	carg.arg = arg;
+	carg.zero_init = 0;
+
+	PMEMoid retoid = OID_NULL;
+	list_queue_push_new(pop, pe_offset, head, size,
+			constructor_alloc_bytype, &carg, &retoid);
+	return retoid;
+}
+
+/*
+ * pmemobj_queue_pop -- removes the first object from a queue
+ */
+int
+pmemobj_queue_pop(PMEMobjpool *pop, size_t pe_offset, void *head,
+		PMEMoid *oidp)
+{
+	LOG(3, "pop %p pe_offset %zu head %p oidp %p",
+	    pop, pe_offset, head, oidp);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (pe_offset >= pop->size) {
+		ERR("pe_offset (%lu) too big", pe_offset);
+		return EINVAL;
+	}
+
+	return list_queue_pop(pop, pe_offset, head, oidp);
+}
+
 /*
  * pmemobj_list_move -- moves object between lists
  */
@@ -47,6 +47,11 @@
 #define	OBJ_FORMAT_INCOMPAT 0x0000
 #define	OBJ_FORMAT_RO_COMPAT 0x0000
 
+/* optional incompat features, recorded in the pool header at create time */
+#define	OBJ_FORMAT_INCOMPAT_ZEROED 0x0001	/* chunks flagged as zeroed */
+#define	OBJ_FORMAT_INCOMPAT_SUPPORTED\
+	(OBJ_FORMAT_INCOMPAT | OBJ_FORMAT_INCOMPAT_ZEROED)
+
 /* size of the persistent part of PMEMOBJ pool descriptor (2kB) */
 #define	OBJ_DSC_P_SIZE		2048
 /* size of unused part of the persistent part of PMEMOBJ pool descriptor */
@@ -165,7 +170,9 @@ struct pmemobjpool {
 
 	PMEMmutex rootlock;	/* root object lock */
 	int is_master_replica;
-	char unused2[1816];
+	struct type_index *type_index; /* volatile per-type object index */
+	struct lock_table *lock_table; /* DRAM state of pmem-resident locks */
+	char unused2[1800];
 };
 
 /*
@@ -274,3 +281,6 @@ OBJ_OID_IS_VALID(PMEMobjpool *pop, PMEMoid oid)
 
 void obj_init(void);
 void obj_fini(void);
+
+void tx_init(void);
+void tx_fini(void);
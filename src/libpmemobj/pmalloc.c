@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 
 #include "libpmemobj.h"
 #include "util.h"
@@ -48,6 +49,8 @@
 #include "heap.h"
 #include "bucket.h"
 #include "heap_layout.h"
+#include "type_index.h"
+#include "sys_util.h"
 #include "valgrind_internal.h"
 
 enum alloc_op_redo {
@@ -189,6 +192,9 @@ alloc_prep_block(PMEMobjpool *pop, struct memory_block m,
 
 	ASSERT((uint64_t)block_data % _POBJ_CL_ALIGNMENT == 0);
 
+	/* must be done before anything is written to the block */
+	int zeroed = heap_block_clear_zeroed(pop, m);
+
 	/* mark everything (including headers) as accessible */
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(pop, block_data, real_size);
 	/* mark space as allocated */
@@ -198,7 +204,8 @@ alloc_prep_block(PMEMobjpool *pop, struct memory_block m,
 
 	int ret = 0;
 	if (constructor != NULL)
-		ret = constructor(pop, userdatap, real_size - ALLOC_OFF, arg);
+		ret = constructor(pop, userdatap, real_size - ALLOC_OFF,
+			zeroed, arg);
 
 	if (!ret)
 		*offset_value = OBJ_PTR_TO_OFF(pop, userdatap);
@@ -227,6 +234,10 @@ palloc_operation(PMEMobjpool *pop,
 
 	int ret = 0;
 
+	/* indexed offset and type of the existing object */
+	uint64_t old_off = 0;
+	uint64_t old_type = 0;
+
 	struct lane_section *lane;
 	lane_hold(pop, &lane, LANE_SECTION_ALLOCATOR);
 
@@ -234,6 +245,12 @@ palloc_operation(PMEMobjpool *pop,
 		alloc = ALLOC_GET_HEADER(pop, off);
 		b = heap_get_chunk_bucket(pop, alloc->chunk_id, alloc->zone_id);
 		m = get_mblock_from_alloc(pop, alloc);
+
+		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, off);
+		if (!(oobh->size & OBJ_INTERNAL_OBJECT_MASK)) {
+			old_off = off;
+			old_type = oobh->type_num;
+		}
 	}
 
 	/* if allocation or reallocation, reserve new memory */
@@ -325,6 +342,8 @@ palloc_operation(PMEMobjpool *pop,
 
 	operation_process(ctx);
 
+	type_index_update(pop, old_off, old_type, offset_value);
+
 	if (!MEMORY_BLOCK_IS_EMPTY(nb)) {
 		heap_unlock_if_run(pop, nb);
 	}
@@ -437,26 +456,157 @@ pfree(PMEMobjpool *pop, uint64_t *off)
 }
 
 /*
- * pmalloc_search_cb -- (internal) foreach callback. If the argument is equal
- *	to the current object offset then sets the argument to UINT64_MAX.
- *	If the argument is UINT64_MAX it breaks the iteration and sets the
- *	argument to the current object offset.
+ * pfree_batch_block -- a memory block freed by pfree_batch
  */
-static int
-pmalloc_search_cb(uint64_t off, void *arg)
+struct pfree_batch_block {
+	struct bucket *b;
+	struct memory_block m; /* the freed block */
+	struct memory_block rb; /* the reclaimed, coalesced block */
+
+	/* indexed offset and type of the object */
+	uint64_t old_off;
+	uint64_t old_type;
+};
+
+/*
+ * pfree_batch_lock -- (internal) acquires the run locks of the leading blocks
+ *	of the batch, returns the number of blocks that can be freed
+ *
+ * Only the first lock is waited for, the remaining ones are merely tried.
+ * The batch never blocks while holding a run lock, so it cannot deadlock with
+ * operations which acquire their run locks in a different order.
+ */
+static size_t
+pfree_batch_lock(PMEMobjpool *pop, struct pfree_batch_block *blocks,
+	size_t nblocks, pthread_mutex_t **locks, size_t *nlocks)
 {
-	uint64_t *prev = arg;
+	*nlocks = 0;
+
+	for (size_t i = 0; i < nblocks; ++i) {
+		pthread_mutex_t *lock = heap_block_run_lock(pop, blocks[i].m);
+		if (lock == NULL)
+			continue;
+
+		size_t l;
+		for (l = 0; l < *nlocks; ++l)
+			if (locks[l] == lock)
+				break;
+
+		if (l != *nlocks)
+			continue;
 
-	if (*prev == UINT64_MAX) {
-		*prev = off;
+		if (*nlocks == 0)
+			util_mutex_lock(lock);
+		else if (pthread_mutex_trylock(lock) != 0)
+			return i;
 
-		return 1;
+		locks[(*nlocks)++] = lock;
 	}
 
-	if (off == *prev)
-		*prev = UINT64_MAX;
+	return nblocks;
+}
 
-	return 0;
+/*
+ * pfree_batch -- deallocates a number of memory blocks at once
+ *
+ * All of the heap metadata changes, along with the entries provided by the
+ * callback, are applied atomically using a single redo log, which must have
+ * room for OPERATION_MAX_ENTRIES entries. The blocks are freed in order, if
+ * some of the run locks are contended only the leading blocks are freed.
+ *
+ * Returns the number of freed blocks, always at least one.
+ */
+size_t
+pfree_batch(PMEMobjpool *pop, struct redo_log *redo,
+	uint64_t *offs, size_t noffs, pfree_batch_cb cb, void *arg)
+{
+	ASSERTne(noffs, 0);
+	ASSERT(noffs <= PFREE_BATCH_MAX);
+
+	struct pfree_batch_block blocks[PFREE_BATCH_MAX];
+	pthread_mutex_t *locks[PFREE_BATCH_MAX];
+	struct operation_entry entries[PFREE_BATCH_MAX_ENTRIES];
+
+	for (size_t i = 0; i < noffs; ++i) {
+		struct pfree_batch_block *blk = &blocks[i];
+		struct allocation_header *alloc =
+			ALLOC_GET_HEADER(pop, offs[i]);
+
+		blk->b = heap_get_chunk_bucket(pop,
+			alloc->chunk_id, alloc->zone_id);
+		blk->m = get_mblock_from_alloc(pop, alloc);
+
+		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, offs[i]);
+		if (!(oobh->size & OBJ_INTERNAL_OBJECT_MASK)) {
+			blk->old_off = offs[i];
+			blk->old_type = oobh->type_num;
+		} else {
+			blk->old_off = 0;
+			blk->old_type = 0;
+		}
+
+#ifdef DEBUG
+		if (!heap_block_is_allocated(pop, blk->m)) {
+			ERR("Double free or heap corruption");
+			ASSERT(0);
+		}
+#endif /* DEBUG */
+	}
+
+	struct operation_context *ctx = operation_init(pop, redo);
+	if (ctx == NULL)
+		FATAL("Failed to initialize memory operation context");
+
+	size_t nlocks;
+	size_t nfree = pfree_batch_lock(pop, blocks, noffs, locks, &nlocks);
+	ASSERTne(nfree, 0);
+
+	size_t nentries = cb(pop, offs, nfree, entries, arg);
+	ASSERT(nentries <= PFREE_BATCH_MAX_ENTRIES);
+	operation_add_entries(ctx, entries, nentries);
+
+	for (size_t i = 0; i < nfree; ++i)
+		blocks[i].rb = heap_free_block(pop, blocks[i].b, blocks[i].m,
+			ctx);
+
+	operation_process(ctx);
+
+	for (size_t i = 0; i < nfree; ++i)
+		type_index_update(pop, blocks[i].old_off, blocks[i].old_type,
+			0);
+
+	for (size_t l = 0; l < nlocks; ++l)
+		util_mutex_unlock(locks[l]);
+
+	for (size_t i = 0; i < nfree; ++i) {
+		VALGRIND_DO_MEMPOOL_FREE(pop,
+			(char *)heap_get_block_data(pop, blocks[i].m) +
+			ALLOC_OFF);
+
+		/* we might have been operating on inactive run */
+		if (blocks[i].b != NULL)
+			CNT_OP(blocks[i].b, insert, pop, blocks[i].rb);
+	}
+
+	/* every run is degraded only once, after all its blocks are back */
+	for (size_t i = 0; i < nfree; ++i) {
+		struct bucket *b = blocks[i].b;
+		if (b == NULL || b->type != BUCKET_RUN)
+			continue;
+
+		size_t j;
+		for (j = 0; j < i; ++j)
+			if (blocks[j].m.chunk_id == blocks[i].m.chunk_id &&
+				blocks[j].m.zone_id == blocks[i].m.zone_id)
+				break;
+
+		if (j == i)
+			heap_degrade_run_if_empty(pop, b, blocks[i].rb);
+	}
+
+	operation_delete(ctx);
+
+	return nfree;
 }
 
 /*
@@ -465,15 +615,14 @@ pmalloc_search_cb(uint64_t off, void *arg)
 uint64_t
 pmalloc_first(PMEMobjpool *pop)
 {
-	uint64_t off_search = UINT64_MAX;
-	struct memory_block m = {0, 0, 0, 0};
-
-	heap_foreach_object(pop, pmalloc_search_cb, &off_search, m);
+	struct heap_iter it;
+	heap_iter_init(pop, &it);
 
-	if (off_search == UINT64_MAX)
+	uint64_t off = heap_iter_next(pop, &it);
+	if (off == 0)
 		return 0;
 
-	return off_search + sizeof (struct allocation_header);
+	return off + sizeof (struct allocation_header);
 }
 
 /*
@@ -485,16 +634,14 @@ pmalloc_next(PMEMobjpool *pop, uint64_t off)
 	struct allocation_header *alloc = ALLOC_GET_HEADER(pop, off);
 	struct memory_block m = get_mblock_from_alloc(pop, alloc);
 
-	uint64_t off_search = off - ALLOC_OFF;
-
-	heap_foreach_object(pop, pmalloc_search_cb, &off_search, m);
+	struct heap_iter it;
+	heap_iter_init_after(pop, &it, m);
 
-	if (off_search == (off - ALLOC_OFF) ||
-		off_search == 0 ||
-		off_search == UINT64_MAX)
+	uint64_t next = heap_iter_next(pop, &it);
+	if (next == 0)
 		return 0;
 
-	return off_search + sizeof (struct allocation_header);
+	return next + sizeof (struct allocation_header);
 }
 
 /*
@@ -35,10 +35,25 @@
  */
 
 typedef int (*pmalloc_constr)(PMEMobjpool *pop, void *ptr,
-		size_t usable_size, void *arg);
+		size_t usable_size, int zeroed, void *arg);
+
+/*
+ * Maximum number of blocks freed by a single pfree_batch call and of the
+ * entries the caller may apply along with them.
+ */
+#define	PFREE_BATCH_MAX_ENTRIES 4
+#define	PFREE_BATCH_MAX (OPERATION_MAX_ENTRIES - PFREE_BATCH_MAX_ENTRIES)
+
+/*
+ * Called by pfree_batch once the number of blocks that are going to be freed
+ * is known, fills the entries that are applied together with the frees and
+ * returns their number.
+ */
+typedef size_t (*pfree_batch_cb)(PMEMobjpool *pop, uint64_t *offs,
+		size_t nfree, struct operation_entry *entries, void *arg);
 
 int heap_boot(PMEMobjpool *pop);
-int heap_init(PMEMobjpool *pop);
+int heap_init(PMEMobjpool *pop, int zeroed);
 void heap_vg_open(PMEMobjpool *pop);
 void heap_cleanup(PMEMobjpool *pop);
 int heap_check(PMEMobjpool *pop);
@@ -62,3 +77,5 @@ uint64_t pmalloc_next(PMEMobjpool *pop, uint64_t off);
 
 size_t pmalloc_usable_size(PMEMobjpool *pop, uint64_t off);
 void pfree(PMEMobjpool *pop, uint64_t *off);
+size_t pfree_batch(PMEMobjpool *pop, struct redo_log *redo,
+	uint64_t *offs, size_t noffs, pfree_batch_cb cb, void *arg);
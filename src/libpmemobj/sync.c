@@ -35,6 +35,8 @@
  */
 
 #include <errno.h>
+#include <sched.h>
+#include <time.h>
 
 #include "libpmem.h"
 #include "libpmemobj.h"
@@ -51,34 +53,361 @@
 #include "valgrind_internal.h"
 
 #define	GET_MUTEX(pop, mutexp)\
-get_lock((pop)->run_id,\
+get_lock((pop),\
 	&(mutexp)->pmemmutex.runid,\
 	&(mutexp)->pmemmutex.mutex,\
 	(void *)pthread_mutex_init,\
 	sizeof ((mutexp)->pmemmutex.mutex))
 
 #define	GET_RWLOCK(pop, rwlockp)\
-get_lock((pop)->run_id,\
+get_lock((pop),\
 	&(rwlockp)->pmemrwlock.runid,\
 	&(rwlockp)->pmemrwlock.rwlock,\
-	(void *)pthread_rwlock_init,\
+	READER_BIASED(pop) ?\
+	(void *)rwlock_init_biased : (void *)pthread_rwlock_init,\
 	sizeof ((rwlockp)->pmemrwlock.rwlock))
 
+#define	READER_BIASED(pop)\
+((pop)->lock_table != NULL && (pop)->lock_table->readers != NULL)
+
 
 #define	GET_COND(pop, condp)\
-get_lock((pop)->run_id,\
+get_lock((pop),\
 	&(condp)->pmemcond.runid,\
 	&(condp)->pmemcond.cond,\
 	(void *)pthread_cond_init,\
 	sizeof ((condp)->pmemcond.cond))
 
+/* number of slots in the first chunk of the lock table */
+#define	LOCK_TABLE_CHUNK0_BITS 10
+#define	LOCK_TABLE_CHUNK0 (1ULL << LOCK_TABLE_CHUNK0_BITS)
+
+/* each next chunk is twice as big as the previous one */
+#define	LOCK_TABLE_MAX_CHUNKS 40
+
+/* initial number of entries of the slot owners hash table */
+#define	LOCK_OWNERS_INIT 1024
+
+/* number of visible reader slots of a reader-biased lock table */
+#define	VISIBLE_READERS_BITS 10
+#define	VISIBLE_READERS (1U << VISIBLE_READERS_BITS)
+
+/* number of read locks a thread can hold at once without the rwlock */
+#define	FAST_READS_MAX 8
+
+/* number of slow read locks after which a revoked reader bias is restored */
+#define	READER_BIAS_INHIBIT 1024
+
+/*
+ * Volatile lock, padded to the cache line size so that two locks never share
+ * a line.
+ */
+union lock_slot {
+	pthread_mutex_t mutex;
+	pthread_rwlock_t rwlock;
+	pthread_cond_t cond;
+	struct {
+		pthread_rwlock_t rwlock;
+		volatile uint32_t rbias; /* readers may skip the rwlock */
+		volatile uint32_t inhibit; /* slow reads left until rbias */
+	} biased;
+	char padding[_POBJ_CL_ALIGNMENT];
+};
+
+/*
+ * Slot announcing a reader of a reader-biased rwlock, which holds the lock
+ * without touching the shared state of the pthread rwlock.
+ */
+union reader_slot {
+	void *volatile lock;
+	char padding[_POBJ_CL_ALIGNMENT];
+};
+
+/*
+ * Read locks taken by the current thread through the visible reader slots.
+ */
+static __thread struct {
+	union lock_slot *lock;
+	union reader_slot *slot;
+} Fast_reads[FAST_READS_MAX];
+static __thread unsigned Fast_nreads;
+
+/*
+ * Serializes the slot lookups of all the lock tables, they are done only
+ * when a lock is initialized.
+ */
+static pthread_mutex_t Lock_owners_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Entry of the hash table which maps the address of a pmem-resident lock to
+ * its slot.
+ */
+struct lock_owner {
+	const void *lock; /* NULL if the entry is empty */
+	uint64_t slot;
+};
+
+/*
+ * DRAM resident table of locks, used instead of the lock state embedded in
+ * pmem-resident objects. Chunks are never moved or freed before the pool is
+ * closed, so a slot address stays valid for the whole run.
+ *
+ * A lock is initialized again within the run whenever its memory is zeroed
+ * or reallocated, it gets the slot it had before, so the table never holds
+ * more slots than there were distinct lock addresses.
+ */
+struct lock_table {
+	uint64_t nslots; /* number of slots handed out */
+	union lock_slot *chunks[LOCK_TABLE_MAX_CHUNKS];
+	void *chunks_raw[LOCK_TABLE_MAX_CHUNKS]; /* unaligned allocations */
+
+	/* slots of the locks initialized so far, by lock address */
+	struct lock_owner *owners;
+	uint64_t owners_size; /* power of two */
+
+	/* visible readers of all the rwlocks, NULL if not reader-biased */
+	union reader_slot *readers;
+	void *readers_raw;
+};
+
+/*
+ * lock_table_align -- (internal) align an allocation to the cache line size
+ *
+ * pmemobj_set_funcs does not provide an aligned allocator, so every
+ * allocation is padded and its unaligned address is kept for Free.
+ */
+static inline void *
+lock_table_align(void *raw)
+{
+	return (void *)(((uintptr_t)raw + _POBJ_CL_ALIGNMENT - 1) &
+		~((uintptr_t)_POBJ_CL_ALIGNMENT - 1));
+}
+
+/*
+ * sync_lock_table_new -- allocate an empty DRAM lock table
+ *
+ * If reader_bias is set, read locks of the rwlocks are announced in a table
+ * of visible reader slots and a writer has to sweep it.
+ */
+struct lock_table *
+sync_lock_table_new(int reader_bias)
+{
+	LOG(3, "reader_bias %d", reader_bias);
+
+	COMPILE_ERROR_ON(sizeof (union lock_slot) != _POBJ_CL_ALIGNMENT);
+	COMPILE_ERROR_ON(sizeof (union reader_slot) != _POBJ_CL_ALIGNMENT);
+
+	struct lock_table *lt = Zalloc(sizeof (*lt));
+	if (lt == NULL) {
+		ERR("!Zalloc");
+		return NULL;
+	}
+
+	lt->owners_size = LOCK_OWNERS_INIT;
+	lt->owners = Zalloc(lt->owners_size * sizeof (*lt->owners));
+	if (lt->owners == NULL) {
+		ERR("!Zalloc");
+		goto err_owners;
+	}
+
+	if (reader_bias) {
+		size_t size = VISIBLE_READERS * sizeof (union reader_slot);
+		lt->readers_raw = Zalloc(size + _POBJ_CL_ALIGNMENT);
+		if (lt->readers_raw == NULL) {
+			ERR("!Zalloc");
+			goto err_readers;
+		}
+
+		lt->readers = lock_table_align(lt->readers_raw);
+	}
+
+	return lt;
+
+err_readers:
+	Free(lt->owners);
+err_owners:
+	Free(lt);
+	return NULL;
+}
+
+/*
+ * sync_lock_table_delete -- free a DRAM lock table
+ *
+ * Locks initialized with default attributes do not hold any resources, so
+ * the slots are not destroyed one by one.
+ */
+void
+sync_lock_table_delete(struct lock_table *lt)
+{
+	LOG(3, "lt %p", lt);
+
+	for (int i = 0; i < LOCK_TABLE_MAX_CHUNKS; ++i)
+		Free(lt->chunks_raw[i]);
+
+	Free(lt->owners);
+	Free(lt->readers_raw);
+	Free(lt);
+}
+
+/*
+ * lock_table_locate -- (internal) find the chunk and position of a slot
+ */
+static inline void
+lock_table_locate(uint64_t slot, unsigned *chunk, uint64_t *pos)
+{
+	uint64_t n = (slot >> LOCK_TABLE_CHUNK0_BITS) + 1;
+	*chunk = 63 - (unsigned)__builtin_clzll(n);
+	*pos = slot - (((1ULL << *chunk) - 1) << LOCK_TABLE_CHUNK0_BITS);
+}
+
+/*
+ * lock_table_get -- (internal) return the lock stored in a slot
+ */
+static inline void *
+lock_table_get(struct lock_table *lt, uint64_t slot)
+{
+	unsigned chunk;
+	uint64_t pos;
+	lock_table_locate(slot, &chunk, &pos);
+
+	return &lt->chunks[chunk][pos];
+}
+
+/*
+ * lock_owners_find -- (internal) return the hash table entry of the lock,
+ *	or the empty entry where it belongs
+ */
+static struct lock_owner *
+lock_owners_find(struct lock_owner *owners, uint64_t size, const void *lock)
+{
+	uint64_t h = ((uintptr_t)lock / sizeof (uint64_t)) *
+		0x9E3779B97F4A7C15ULL;
+
+	for (uint64_t i = h >> 32; ; ++i) {
+		struct lock_owner *o = &owners[i & (size - 1)];
+		if (o->lock == lock || o->lock == NULL)
+			return o;
+	}
+}
+
+/*
+ * lock_owners_grow -- (internal) double the size of the slot owners hash
+ *	table
+ */
+static int
+lock_owners_grow(struct lock_table *lt)
+{
+	uint64_t size = lt->owners_size * 2;
+	struct lock_owner *owners = Zalloc(size * sizeof (*owners));
+	if (owners == NULL) {
+		ERR("!Zalloc");
+		return -1;
+	}
+
+	for (uint64_t i = 0; i < lt->owners_size; ++i) {
+		struct lock_owner *o = &lt->owners[i];
+		if (o->lock != NULL)
+			*lock_owners_find(owners, size, o->lock) = *o;
+	}
+
+	Free(lt->owners);
+	lt->owners = owners;
+	lt->owners_size = size;
+
+	return 0;
+}
+
+/*
+ * lock_table_slot -- (internal) return the slot of the lock, reusing the
+ *	one it had if it was initialized before in this run
+ */
+static int
+lock_table_slot(struct lock_table *lt, const void *lock, uint64_t *slot)
+{
+	int ret = 0;
+
+	util_mutex_lock(&Lock_owners_lock);
+
+	struct lock_owner *o = lock_owners_find(lt->owners, lt->owners_size,
+		lock);
+	if (o->lock != NULL) {
+		*slot = o->slot;
+		goto out;
+	}
+
+	/* keep the hash table at most half full */
+	if (2 * (lt->nslots + 1) > lt->owners_size) {
+		if (lock_owners_grow(lt)) {
+			ret = -1;
+			goto out;
+		}
+		o = lock_owners_find(lt->owners, lt->owners_size, lock);
+	}
+
+	*slot = lt->nslots++;
+	o->lock = lock;
+	o->slot = *slot;
+
+out:
+	util_mutex_unlock(&Lock_owners_lock);
+	return ret;
+}
+
+/*
+ * lock_table_alloc -- (internal) hand out the slot of the lock, allocating
+ *	its chunk if necessary
+ */
+static union lock_slot *
+lock_table_alloc(struct lock_table *lt, const void *lock, uint64_t *slot)
+{
+	if (lock_table_slot(lt, lock, slot))
+		return NULL;
+
+	unsigned chunk;
+	uint64_t pos;
+	lock_table_locate(*slot, &chunk, &pos);
+	if (chunk >= LOCK_TABLE_MAX_CHUNKS) {
+		ERR("lock table full");
+		return NULL;
+	}
+
+	while (lt->chunks[chunk] == NULL) {
+		size_t size = (LOCK_TABLE_CHUNK0 << chunk) *
+			sizeof (union lock_slot);
+		void *raw = Malloc(size + _POBJ_CL_ALIGNMENT);
+		if (raw == NULL) {
+			ERR("!Malloc");
+			return NULL;
+		}
+
+		if (!__sync_bool_compare_and_swap(&lt->chunks_raw[chunk],
+				NULL, raw)) {
+			/* another thread got there first, wait for it */
+			Free(raw);
+			while (lt->chunks[chunk] == NULL)
+				__sync_synchronize();
+			break;
+		}
+
+		__sync_synchronize();
+		lt->chunks[chunk] = lock_table_align(raw);
+	}
+
+	return &lt->chunks[chunk][pos];
+}
+
 /*
  * _get_lock -- (internal) atomically initialize and return a lock
+ *
+ * When the pool uses a DRAM lock table, the pthread part of the pmem-resident
+ * lock only holds the index of the slot that contains the real lock.
  */
 static void *
-_get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
+_get_lock(PMEMobjpool *pop, volatile uint64_t *runid, void *lock,
 	int (*init_lock)(void *lock, void *arg), size_t size)
 {
+	uint64_t pop_runid = pop->run_id;
+
 	LOG(15, "pop_runid %ju runid %ju lock %p init_lock %p", pop_runid,
 		*runid, lock, init_lock);
 
@@ -95,7 +424,19 @@ _get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
 				pop_runid - 1))
 			continue;
 
-		if (init_lock(lock, NULL)) {
+		void *real_lock = lock;
+		if (pop->lock_table != NULL) {
+			uint64_t slot;
+			real_lock = lock_table_alloc(pop->lock_table, lock,
+				&slot);
+			if (real_lock == NULL) {
+				__sync_fetch_and_and(runid, 0);
+				return NULL;
+			}
+			*(volatile uint64_t *)lock = slot;
+		}
+
+		if (init_lock(real_lock, NULL)) {
 			ERR("error initializing lock");
 			__sync_fetch_and_and(runid, 0);
 			return NULL;
@@ -106,8 +447,13 @@ _get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
 			ERR("error setting lock runid");
 			return NULL;
 		}
+
+		return real_lock;
 	}
 
+	if (pop->lock_table != NULL)
+		return lock_table_get(pop->lock_table, *(uint64_t *)lock);
+
 	return lock;
 }
 
@@ -115,13 +461,222 @@ _get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
  * get_lock -- (internal) atomically initialize and return a lock
  */
 static inline void *
-get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
+get_lock(PMEMobjpool *pop, volatile uint64_t *runid, void *lock,
 	int (*init_lock)(void *lock, void *arg), size_t size)
 {
-	if (likely(*runid == pop_runid))
-		return lock;
+	if (likely(*runid == pop->run_id)) {
+		if (pop->lock_table == NULL)
+			return lock;
+
+		return lock_table_get(pop->lock_table, *(uint64_t *)lock);
+	}
+
+	return _get_lock(pop, runid, lock, init_lock, size);
+}
+
+/*
+ * rwlock_init_biased -- (internal) initialize a reader-biased rwlock
+ */
+static int
+rwlock_init_biased(union lock_slot *l, void *arg)
+{
+	l->biased.rbias = 1;
+	l->biased.inhibit = 0;
+
+	return pthread_rwlock_init(&l->biased.rwlock, arg);
+}
+
+/*
+ * reader_slot -- (internal) return the visible reader slot of the current
+ *	thread for the given lock
+ */
+static inline union reader_slot *
+reader_slot(struct lock_table *lt, union lock_slot *l)
+{
+	uint64_t h = ((uintptr_t)&Fast_nreads >> 6) * 31 +
+		((uintptr_t)l >> 6);
+	h *= 0x9e3779b97f4a7c15ULL;
+
+	return &lt->readers[h >> (64 - VISIBLE_READERS_BITS)];
+}
+
+/*
+ * rwlock_fast_rdlock -- (internal) try to read lock a reader-biased rwlock
+ *	by announcing the reader in its visible reader slot
+ */
+static int
+rwlock_fast_rdlock(struct lock_table *lt, union lock_slot *l)
+{
+	if (!l->biased.rbias || Fast_nreads == FAST_READS_MAX)
+		return 0;
+
+	union reader_slot *s = reader_slot(lt, l);
+	if (s->lock != NULL || !__sync_bool_compare_and_swap(&s->lock, NULL, l))
+		return 0;
+
+	/* the bias could have been revoked before the reader was visible */
+	if (!l->biased.rbias) {
+		__sync_lock_release(&s->lock);
+		return 0;
+	}
+
+	Fast_reads[Fast_nreads].lock = l;
+	Fast_reads[Fast_nreads].slot = s;
+	Fast_nreads++;
+
+	return 1;
+}
+
+/*
+ * rwlock_fast_unlock -- (internal) unlock a reader-biased rwlock if it was
+ *	read locked through the visible reader slot by the current thread
+ */
+static int
+rwlock_fast_unlock(void *rwlock)
+{
+	union lock_slot *l = rwlock;
+
+	for (unsigned i = Fast_nreads; i-- > 0; ) {
+		if (Fast_reads[i].lock != l)
+			continue;
+
+		__sync_lock_release(&Fast_reads[i].slot->lock);
+		Fast_reads[i] = Fast_reads[--Fast_nreads];
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * rwlock_bias_restore -- (internal) count down the slow read locks of an
+ *	rwlock and restore the reader bias when the count drops to zero
+ *
+ * Must be called with the rwlock read locked, so that no writer runs.
+ */
+static void
+rwlock_bias_restore(union lock_slot *l)
+{
+	if (l->biased.rbias)
+		return;
+
+	uint32_t inhibit;
+	do {
+		inhibit = l->biased.inhibit;
+		if (inhibit == 0)
+			break;
+	} while (!__sync_bool_compare_and_swap(&l->biased.inhibit,
+			inhibit, inhibit - 1));
+
+	if (inhibit <= 1)
+		l->biased.rbias = 1;
+}
+
+/*
+ * rwlock_timed_out -- (internal) check whether the timeout has passed
+ */
+static int
+rwlock_timed_out(const struct timespec *abs_timeout)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	return now.tv_sec > abs_timeout->tv_sec ||
+		(now.tv_sec == abs_timeout->tv_sec &&
+		now.tv_nsec >= abs_timeout->tv_nsec);
+}
+
+/*
+ * rwlock_revoke_bias -- (internal) revoke the reader bias of a write locked
+ *	rwlock and wait for the visible readers to leave
+ *
+ * If try is set, or the timeout passes, the readers are not waited for and
+ * the bias is restored, so that the next writer sweeps the slots again.
+ */
+static int
+rwlock_revoke_bias(struct lock_table *lt, union lock_slot *l, int try,
+	const struct timespec *abs_timeout)
+{
+	if (!l->biased.rbias)
+		return 0;
+
+	l->biased.inhibit = READER_BIAS_INHIBIT;
+	l->biased.rbias = 0;
+	__sync_synchronize();
+
+	int ret = 0;
+	for (unsigned i = 0; i < VISIBLE_READERS; ++i) {
+		while (lt->readers[i].lock == l) {
+			if (try)
+				ret = EBUSY;
+			else if (abs_timeout && rwlock_timed_out(abs_timeout))
+				ret = ETIMEDOUT;
+
+			if (ret != 0) {
+				l->biased.rbias = 1;
+				return ret;
+			}
+
+			sched_yield();
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * rwlock_rdlock_biased -- (internal) read lock a reader-biased rwlock
+ */
+static int
+rwlock_rdlock_biased(struct lock_table *lt, void *rwlock, int try,
+	const struct timespec *abs_timeout)
+{
+	union lock_slot *l = rwlock;
+
+	if (rwlock_fast_rdlock(lt, l))
+		return 0;
+
+	int ret;
+	if (try)
+		ret = pthread_rwlock_tryrdlock(&l->biased.rwlock);
+	else if (abs_timeout)
+		ret = pthread_rwlock_timedrdlock(&l->biased.rwlock,
+			abs_timeout);
+	else
+		ret = pthread_rwlock_rdlock(&l->biased.rwlock);
 
-	return _get_lock(pop_runid, runid, lock, init_lock, size);
+	if (ret == 0)
+		rwlock_bias_restore(l);
+
+	return ret;
+}
+
+/*
+ * rwlock_wrlock_biased -- (internal) write lock a reader-biased rwlock
+ */
+static int
+rwlock_wrlock_biased(struct lock_table *lt, void *rwlock, int try,
+	const struct timespec *abs_timeout)
+{
+	union lock_slot *l = rwlock;
+
+	int ret;
+	if (try)
+		ret = pthread_rwlock_trywrlock(&l->biased.rwlock);
+	else if (abs_timeout)
+		ret = pthread_rwlock_timedwrlock(&l->biased.rwlock,
+			abs_timeout);
+	else
+		ret = pthread_rwlock_wrlock(&l->biased.rwlock);
+
+	if (ret != 0)
+		return ret;
+
+	if ((ret = rwlock_revoke_bias(lt, l, try, abs_timeout)) != 0)
+		pthread_rwlock_unlock(&l->biased.rwlock);
+
+	return ret;
 }
 
 /*
@@ -268,6 +823,9 @@ pmemobj_rwlock_rdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_rdlock_biased(pop->lock_table, rwlock, 0, NULL);
+
 	return pthread_rwlock_rdlock(rwlock);
 }
 
@@ -286,6 +844,9 @@ pmemobj_rwlock_wrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_wrlock_biased(pop->lock_table, rwlock, 0, NULL);
+
 	return pthread_rwlock_wrlock(rwlock);
 }
 
@@ -306,6 +867,10 @@ pmemobj_rwlock_timedrdlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_rdlock_biased(pop->lock_table, rwlock, 0,
+			abs_timeout);
+
 	return pthread_rwlock_timedrdlock(rwlock, abs_timeout);
 }
 
@@ -326,6 +891,10 @@ pmemobj_rwlock_timedwrlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_wrlock_biased(pop->lock_table, rwlock, 0,
+			abs_timeout);
+
 	return pthread_rwlock_timedwrlock(rwlock, abs_timeout);
 }
 
@@ -344,6 +913,9 @@ pmemobj_rwlock_tryrdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_rdlock_biased(pop->lock_table, rwlock, 1, NULL);
+
 	return pthread_rwlock_tryrdlock(rwlock);
 }
 
@@ -362,6 +934,9 @@ pmemobj_rwlock_trywrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop))
+		return rwlock_wrlock_biased(pop->lock_table, rwlock, 1, NULL);
+
 	return pthread_rwlock_trywrlock(rwlock);
 }
 
@@ -378,6 +953,9 @@ pmemobj_rwlock_unlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
+	if (READER_BIASED(pop) && rwlock_fast_unlock(rwlock))
+		return 0;
+
 	return pthread_rwlock_unlock(rwlock);
 }
 
@@ -67,3 +67,6 @@ pmemobj_mutex_unlock_nofail(PMEMobjpool *pop, PMEMmutex *mutexp)
 }
 
 int pmemobj_mutex_assert_locked(PMEMobjpool *pop, PMEMmutex *mutexp);
+
+struct lock_table *sync_lock_table_new(int reader_bias);
+void sync_lock_table_delete(struct lock_table *lt);
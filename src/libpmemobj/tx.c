@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <sys/queue.h>
 #include <stdlib.h>
 
@@ -51,15 +52,39 @@
 #include "ctree.h"
 #include "valgrind_internal.h"
 
+/*
+ * Number of nesting levels whose frames are kept in the thread-local
+ * transaction state, deeper levels use a heap-allocated frame array.
+ */
+#define	TX_INLINE_FRAMES 8
+
+/* initial capacity of the per-thread array of the registered callbacks */
+#define	TX_INIT_CALLBACKS 8
+
 struct tx_data {
-	SLIST_ENTRY(tx_data) tx_entry;
 	jmp_buf env;
+	int has_env; /* env is valid, abort returns to it */
+	int read_only; /* no modifications are allowed */
+};
+
+struct tx_callback {
+	pmemobj_tx_callback func;
+	void *arg;
 };
 
 static __thread struct {
 	enum pobj_tx_stage stage;
 	int last_errnum;
 	struct lane_section *section;
+	uint64_t id; /* serial number of the last outermost transaction */
+	int read_only; /* the outermost transaction holds no lane */
+	unsigned depth; /* number of open (nested) transactions */
+	unsigned ext_frames; /* capacity of the ext array */
+	struct tx_data *ext; /* frames beyond TX_INLINE_FRAMES */
+	struct tx_data frames[TX_INLINE_FRAMES];
+	unsigned ncallbacks; /* registered in the current transaction */
+	unsigned callbacks_size; /* capacity of the callbacks array */
+	struct tx_callback *callbacks;
 } tx;
 
 struct tx_lock_data {
@@ -75,10 +100,16 @@ struct lane_tx_runtime {
 	PMEMobjpool *pop;
 	struct ctree *ranges;
 	unsigned cache_slot;
-	SLIST_HEAD(txd, tx_data) tx_entries;
 	SLIST_HEAD(txl, tx_lock_data) tx_locks;
 };
 
+/*
+ * Read-only transactions don't hold a lane, the section of the outermost
+ * one has only the runtime part, which is kept per thread.
+ */
+static __thread struct lane_tx_runtime tx_ro_runtime;
+static __thread struct lane_section tx_ro_section;
+
 struct tx_alloc_args {
 	type_num_t type_num;
 };
@@ -139,11 +170,168 @@ pmemobj_tx_abort_null(int errnum)
 		FATAL("%s called in invalid stage %d", __func__, tx.stage);\
 } while (0)
 
+/*
+ * The deep nesting frames and the callbacks array are kept for the lifetime
+ * of the thread, the key frees them when it exits.
+ */
+static pthread_key_t tx_ext_key;
+
+/*
+ * tx_ext_free -- (internal) frees the deep nesting frames and the callbacks
+ *	array of an exiting thread, runs in that thread
+ */
+static void
+tx_ext_free(void *arg)
+{
+	Free(tx.ext);
+	tx.ext = NULL;
+	tx.ext_frames = 0;
+
+	Free(tx.callbacks);
+	tx.callbacks = NULL;
+	tx.callbacks_size = 0;
+}
+
+/*
+ * tx_ext_register -- (internal) makes sure the thread frees its per-thread
+ *	arrays on exit, called before the first of them is allocated
+ */
+static int
+tx_ext_register(void)
+{
+	if (tx.ext != NULL || tx.callbacks != NULL)
+		return 0;
+
+	if ((errno = pthread_setspecific(tx_ext_key, &tx)) != 0) {
+		ERR("!pthread_setspecific");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_init -- initializes the per-thread transaction state management
+ *
+ * Called by constructor.
+ */
+void
+tx_init(void)
+{
+	LOG(3, NULL);
+
+	int ret = pthread_key_create(&tx_ext_key, tx_ext_free);
+	if (ret) {
+		errno = ret;
+		FATAL("!pthread_key_create");
+	}
+}
+
+/*
+ * tx_fini -- frees the deep nesting frames of the calling thread
+ *
+ * Called by destructor.
+ */
+void
+tx_fini(void)
+{
+	LOG(3, NULL);
+
+	/* the key destructor is not called for the main thread */
+	tx_ext_free(NULL);
+
+	(void) pthread_key_delete(tx_ext_key);
+}
+
+/*
+ * tx_frame -- (internal) returns the frame of the innermost transaction
+ */
+static inline struct tx_data *
+tx_frame(void)
+{
+	ASSERT(tx.depth > 0);
+
+	unsigned level = tx.depth - 1;
+	if (level < TX_INLINE_FRAMES)
+		return &tx.frames[level];
+
+	return &tx.ext[level - TX_INLINE_FRAMES];
+}
+
+/*
+ * tx_frame_push -- (internal) opens a frame for a new (nested) transaction
+ */
+static struct tx_data *
+tx_frame_push(void)
+{
+	unsigned level = tx.depth;
+	if (level >= TX_INLINE_FRAMES) {
+		unsigned idx = level - TX_INLINE_FRAMES;
+		if (idx >= tx.ext_frames) {
+			unsigned n = tx.ext_frames ? tx.ext_frames * 2 :
+				TX_INLINE_FRAMES;
+			if (tx_ext_register())
+				return NULL;
+
+			struct tx_data *ext = Realloc(tx.ext,
+				n * sizeof (*ext));
+			if (ext == NULL)
+				return NULL;
+
+			tx.ext = ext;
+			tx.ext_frames = n;
+		}
+	}
+
+	tx.depth++;
+
+	return tx_frame();
+}
+
+/*
+ * tx_frame_pop -- (internal) closes the frame of the innermost transaction
+ */
+static void
+tx_frame_pop(void)
+{
+	ASSERT(tx.depth > 0);
+
+	tx.depth--;
+}
+
+/*
+ * tx_run_callbacks -- (internal) calls the functions registered within
+ *	the outermost transaction, which has just ended in the current stage
+ */
+static void
+tx_run_callbacks(PMEMobjpool *pop)
+{
+	for (unsigned i = 0; i < tx.ncallbacks; ++i)
+		tx.callbacks[i].func(pop, tx.stage, tx.callbacks[i].arg);
+
+	tx.ncallbacks = 0;
+}
+
+/*
+ * tx_check_read_only -- (internal) returns 1 and reports an error if the
+ *	current transaction is read-only
+ */
+static inline int
+tx_check_read_only(const char *func)
+{
+	if (!tx_frame()->read_only)
+		return 0;
+
+	ERR("%s called in a read-only transaction", func);
+	return 1;
+}
+
 /*
  * constructor_tx_alloc -- (internal) constructor for normal alloc
  */
 static int
-constructor_tx_alloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+constructor_tx_alloc(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -177,7 +365,7 @@ constructor_tx_alloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
  */
 static int
 constructor_tx_zalloc(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -203,7 +391,11 @@ constructor_tx_zalloc(PMEMobjpool *pop, void *ptr,
 	/* do not report changes to the new object */
 	VALGRIND_ADD_TO_TX(ptr, usable_size);
 
-	memset(ptr, 0, usable_size);
+	/* a zeroed block does not have to be cleared again */
+	if (zeroed)
+		VALGRIND_DO_MAKE_MEM_DEFINED(pop, ptr, usable_size);
+	else
+		memset(ptr, 0, usable_size);
 
 	return 0;
 }
@@ -213,7 +405,7 @@ constructor_tx_zalloc(PMEMobjpool *pop, void *ptr,
  */
 static int
 constructor_tx_add_range(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -256,7 +448,8 @@ constructor_tx_add_range(PMEMobjpool *pop, void *ptr,
  * constructor_tx_copy -- (internal) copy constructor
  */
 static int
-constructor_tx_copy(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+constructor_tx_copy(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -292,7 +485,7 @@ constructor_tx_copy(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
  */
 static int
 constructor_tx_copy_zero(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -321,7 +514,10 @@ constructor_tx_copy_zero(PMEMobjpool *pop, void *ptr,
 	if (usable_size > args->copy_size) {
 		void *zero_ptr = (void *)((uintptr_t)ptr + args->copy_size);
 		size_t zero_size = usable_size - args->copy_size;
-		memset(zero_ptr, 0, zero_size);
+		if (zeroed)
+			VALGRIND_DO_MAKE_MEM_DEFINED(pop, zero_ptr, zero_size);
+		else
+			memset(zero_ptr, 0, zero_size);
 	}
 
 	return 0;
@@ -346,11 +542,9 @@ tx_clear_undo_log(PMEMobjpool *pop, struct list_head *head,
 {
 	LOG(3, NULL);
 
-	PMEMoid obj;
-	while (!OBJ_LIST_EMPTY(head)) {
-		obj = head->pe_first;
-
 #ifdef USE_VG_PMEMCHECK
+	PMEMoid obj = head->pe_first;
+	while (obj.off != 0) {
 		/*
 		 * Clean the valgrind state of the underlying memory for
 		 * allocated objects in the undo log, so that not-persisted
@@ -373,15 +567,18 @@ tx_clear_undo_log(PMEMobjpool *pop, struct list_head *head,
 			VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, obj.off),
 					size);
 		}
-#endif
 
-		if (flags & TX_CLR_FLAG_FREE) {
-			/* remove and free all elements from undo log */
-			list_remove_free_oob(pop, head, &obj);
-		} else {
-			list_remove(pop, -1 * (ssize_t)OBJ_OOB_SIZE, head, obj);
-		}
+		obj = OOB_HEADER_FROM_OID(pop, obj)->oob.pe_next;
+		if (obj.off == head->pe_first.off)
+			break;
 	}
+#endif
+
+	/* elements are removed, and freed, from the undo log in batches */
+	if (flags & TX_CLR_FLAG_FREE)
+		list_remove_free_oob_all(pop, head);
+	else
+		list_remove_oob_all(pop, head);
 }
 
 /*
@@ -654,14 +851,7 @@ tx_post_commit_alloc(PMEMobjpool *pop, struct lane_tx_layout *layout)
 {
 	LOG(3, NULL);
 
-	PMEMoid obj;
-
-	while (!OBJ_LIST_EMPTY(&layout->undo_alloc)) {
-		obj = layout->undo_alloc.pe_first;
-
-		list_remove(pop, -1 * (ssize_t)OBJ_OOB_SIZE,
-			&layout->undo_alloc, obj);
-	}
+	list_remove_oob_all(pop, &layout->undo_alloc);
 }
 
 /*
@@ -805,8 +995,13 @@ add_to_tx_and_lock(struct lane_tx_runtime *lane, enum pobj_tx_lock type,
 			break;
 		case TX_LOCK_RWLOCK:
 			txl->lock.rwlock = lock;
-			retval = pmemobj_rwlock_wrlock(lane->pop,
-				txl->lock.rwlock);
+			/* nothing is written under a read-only transaction */
+			if (tx.read_only)
+				retval = pmemobj_rwlock_rdlock(lane->pop,
+					txl->lock.rwlock);
+			else
+				retval = pmemobj_rwlock_wrlock(lane->pop,
+					txl->lock.rwlock);
 			break;
 		default:
 			ERR("Unrecognized lock type");
@@ -991,13 +1186,11 @@ tx_realloc_common(PMEMoid oid, size_t size, uint64_t type_num,
 }
 
 /*
- * pmemobj_tx_begin -- initializes new transaction
+ * tx_begin -- (internal) initializes new transaction
  */
-int
-pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
+static int
+tx_begin(PMEMobjpool *pop, jmp_buf env, int read_only, va_list argp)
 {
-	LOG(3, NULL);
-
 	int err = 0;
 
 	struct lane_tx_runtime *lane = NULL;
@@ -1006,16 +1199,33 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		if (lane->pop != pop)
 			return pmemobj_tx_abort_err(EINVAL);
 
+		/* transactions nested in a read-only one are read-only too */
+		if (tx_frame()->read_only)
+			read_only = 1;
+
 		VALGRIND_START_TX;
 	} else if (tx.stage == TX_STAGE_NONE) {
 		VALGRIND_START_TX;
 
-		lane_hold(pop, &tx.section, LANE_SECTION_TRANSACTION);
+		tx.id++;
+		tx.read_only = read_only;
+
+		if (read_only) {
+			/* no lane, undo log nor ranges cache is needed */
+			tx.section = &tx_ro_section;
+			tx.section->runtime = &tx_ro_runtime;
+
+			lane = tx.section->runtime;
+			lane->ranges = NULL;
+		} else {
+			lane_hold(pop, &tx.section, LANE_SECTION_TRANSACTION);
+
+			/* the ranges cache is kept by the lane */
+			lane = tx.section->runtime;
+			ASSERT(ctree_is_empty_unlocked(lane->ranges));
+		}
 
-		lane = tx.section->runtime;
-		SLIST_INIT(&lane->tx_entries);
 		SLIST_INIT(&lane->tx_locks);
-		lane->ranges = ctree_new();
 		lane->cache_slot = 0;
 
 		lane->pop = pop;
@@ -1023,35 +1233,29 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		FATAL("Invalid stage %d to begin new transaction", tx.stage);
 	}
 
-	struct tx_data *txd = Malloc(sizeof (*txd));
+	struct tx_data *txd = tx_frame_push();
 	if (txd == NULL) {
 		err = errno;
 		goto err_abort;
 	}
 
 	tx.last_errnum = 0;
-	if (env != NULL)
+	txd->has_env = env != NULL;
+	if (txd->has_env)
 		memcpy(txd->env, env, sizeof (jmp_buf));
-	else
-		memset(txd->env, 0, sizeof (jmp_buf));
 
-	SLIST_INSERT_HEAD(&lane->tx_entries, txd, tx_entry);
+	txd->read_only = read_only;
 
 	tx.stage = TX_STAGE_WORK;
 
 	/* handle locks */
-	va_list argp;
-	va_start(argp, env);
 	enum pobj_tx_lock lock_type;
 
 	while ((lock_type = va_arg(argp, enum pobj_tx_lock)) != TX_LOCK_NONE) {
 		err = add_to_tx_and_lock(lane, lock_type, va_arg(argp, void *));
-		if (err) {
-			va_end(argp);
+		if (err)
 			goto err_abort;
-		}
 	}
-	va_end(argp);
 
 	ASSERT(err == 0);
 	return 0;
@@ -1064,6 +1268,38 @@ err_abort:
 	return err;
 }
 
+/*
+ * pmemobj_tx_begin -- initializes new transaction
+ */
+int
+pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
+{
+	LOG(3, NULL);
+
+	va_list argp;
+	va_start(argp, env);
+	int ret = tx_begin(pop, env, 0, argp);
+	va_end(argp);
+
+	return ret;
+}
+
+/*
+ * pmemobj_tx_begin_ro -- initializes new read-only transaction
+ */
+int
+pmemobj_tx_begin_ro(PMEMobjpool *pop, jmp_buf env, ...)
+{
+	LOG(3, NULL);
+
+	va_list argp;
+	va_start(argp, env);
+	int ret = tx_begin(pop, env, 1, argp);
+	va_end(argp);
+
+	return ret;
+}
+
 /*
  * pmemobj_tx_lock -- get lane from pool and add lock to transaction.
  */
@@ -1078,6 +1314,43 @@ pmemobj_tx_lock(enum pobj_tx_lock type, void *lockp)
 	return add_to_tx_and_lock(lane, type, lockp);
 }
 
+/*
+ * pmemobj_tx_on_end -- registers a function called when the outermost
+ *	transaction ends
+ */
+int
+pmemobj_tx_on_end(pmemobj_tx_callback func, void *arg)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	if (tx.ncallbacks == tx.callbacks_size) {
+		unsigned n = tx.callbacks_size ? tx.callbacks_size * 2 :
+			TX_INIT_CALLBACKS;
+
+		if (tx_ext_register())
+			return errno;
+
+		struct tx_callback *callbacks = Realloc(tx.callbacks,
+			n * sizeof (*callbacks));
+		if (callbacks == NULL) {
+			ERR("!Realloc");
+			return ENOMEM;
+		}
+
+		tx.callbacks = callbacks;
+		tx.callbacks_size = n;
+	}
+
+	tx.callbacks[tx.ncallbacks].func = func;
+	tx.callbacks[tx.ncallbacks].arg = arg;
+	tx.ncallbacks++;
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_stage -- returns current transaction stage
  */
@@ -1089,6 +1362,17 @@ pmemobj_tx_stage()
 	return tx.stage;
 }
 
+/*
+ * pmemobj_tx_id -- returns identifier of the current transaction
+ */
+uint64_t
+pmemobj_tx_id(void)
+{
+	LOG(3, NULL);
+
+	return tx.stage == TX_STAGE_WORK ? tx.id : 0;
+}
+
 /*
  * pmemobj_tx_abort -- aborts current transaction
  */
@@ -1107,9 +1391,9 @@ pmemobj_tx_abort(int errnum)
 
 	tx.stage = TX_STAGE_ONABORT;
 	struct lane_tx_runtime *lane = tx.section->runtime;
-	struct tx_data *txd = SLIST_FIRST(&lane->tx_entries);
+	struct tx_data *txd = tx_frame();
 
-	if (SLIST_NEXT(txd, tx_entry) == NULL) {
+	if (tx.depth == 1 && !tx.read_only) {
 		/* this is the outermost transaction */
 
 		struct lane_tx_layout *layout =
@@ -1120,7 +1404,11 @@ pmemobj_tx_abort(int errnum)
 	}
 
 	tx.last_errnum = errnum;
-	if (!util_is_zeroed(txd->env, sizeof (jmp_buf)))
+
+	if (tx.depth == 1)
+		tx_run_callbacks(lane->pop);
+
+	if (txd->has_env)
 		longjmp(txd->env, errnum);
 	else
 		errno = errnum;
@@ -1152,9 +1440,8 @@ pmemobj_tx_commit()
 
 	struct lane_tx_runtime *lane =
 		(struct lane_tx_runtime *)tx.section->runtime;
-	struct tx_data *txd = SLIST_FIRST(&lane->tx_entries);
 
-	if (SLIST_NEXT(txd, tx_entry) == NULL) {
+	if (tx.depth == 1 && !tx.read_only) {
 		/* this is the outermost transaction */
 
 		struct lane_tx_layout *layout =
@@ -1177,6 +1464,9 @@ pmemobj_tx_commit()
 	}
 
 	tx.stage = TX_STAGE_ONCOMMIT;
+
+	if (tx.depth == 1)
+		tx_run_callbacks(lane->pop);
 }
 
 /*
@@ -1194,20 +1484,23 @@ pmemobj_tx_end()
 		FATAL("pmemobj_tx_end called without pmemobj_tx_begin");
 
 	struct lane_tx_runtime *lane = tx.section->runtime;
-	struct tx_data *txd = SLIST_FIRST(&lane->tx_entries);
-	SLIST_REMOVE_HEAD(&lane->tx_entries, tx_entry);
-
-	Free(txd);
+	tx_frame_pop();
 
 	VALGRIND_END_TX;
 
-	if (SLIST_EMPTY(&lane->tx_entries)) {
+	if (tx.depth == 0 && tx.read_only) {
+		/* the outermost read-only transaction holds no lane */
+		tx.stage = TX_STAGE_NONE;
+		release_and_free_tx_locks(lane);
+		tx.section = NULL;
+		tx.read_only = 0;
+	} else if (tx.depth == 0) {
 		/* this is the outermost transaction */
 		struct lane_tx_layout *layout =
 			(struct lane_tx_layout *)tx.section->layout;
 
 		/* cleanup cache */
-		ctree_delete(lane->ranges);
+		ctree_clear_unlocked(lane->ranges);
 		lane->cache_slot = 0;
 
 		/* the transaction state and undo log should be clear */
@@ -1285,7 +1578,7 @@ pmemobj_tx_add_large(struct lane_tx_layout *layout,
  */
 static int
 constructor_tx_range_cache(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg)
+	size_t usable_size, int zeroed, void *arg)
 {
 	LOG(3, NULL);
 
@@ -1482,6 +1775,9 @@ pmemobj_tx_add_range_direct(const void *ptr, size_t size)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_err(EPERM);
+
 	struct lane_tx_runtime *lane =
 		(struct lane_tx_runtime *)tx.section->runtime;
 
@@ -1511,6 +1807,9 @@ pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_err(EPERM);
+
 	struct lane_tx_runtime *lane =
 		(struct lane_tx_runtime *)tx.section->runtime;
 
@@ -1548,6 +1847,9 @@ pmemobj_tx_alloc(size_t size, uint64_t type_num)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_null(EPERM);
+
 	if (size == 0) {
 		ERR("allocation with size 0");
 		return pmemobj_tx_abort_null(EINVAL);
@@ -1569,6 +1871,9 @@ pmemobj_tx_zalloc(size_t size, uint64_t type_num)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_null(EPERM);
+
 	if (size == 0) {
 		ERR("allocation with size 0");
 		return pmemobj_tx_abort_null(EINVAL);
@@ -1589,6 +1894,9 @@ pmemobj_tx_realloc(PMEMoid oid, size_t size, uint64_t type_num)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_null(EPERM);
+
 	return tx_realloc_common(oid, size, type_num,
 			constructor_tx_alloc, constructor_tx_copy);
 }
@@ -1605,6 +1913,9 @@ pmemobj_tx_zrealloc(PMEMoid oid, size_t size, uint64_t type_num)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_null(EPERM);
+
 	return tx_realloc_common(oid, size, type_num,
 			constructor_tx_zalloc, constructor_tx_copy_zero);
 }
@@ -1620,6 +1931,9 @@ pmemobj_tx_strdup(const char *s, uint64_t type_num)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_null(EPERM);
+
 	if (NULL == s) {
 		ERR("cannot duplicate NULL string");
 		return pmemobj_tx_abort_null(EINVAL);
@@ -1648,6 +1962,9 @@ pmemobj_tx_free(PMEMoid oid)
 	ASSERT_IN_TX();
 	ASSERT_TX_STAGE_WORK();
 
+	if (tx_check_read_only(__func__))
+		return pmemobj_tx_abort_err(EPERM);
+
 	if (OBJ_OID_IS_NULL(oid))
 		return 0;
 
@@ -1696,9 +2013,17 @@ pmemobj_tx_free(PMEMoid oid)
 static int
 lane_transaction_construct(PMEMobjpool *pop, struct lane_section *section)
 {
-	section->runtime = Zalloc(sizeof (struct lane_tx_runtime));
-	if (section->runtime == NULL)
+	struct lane_tx_runtime *lane = Zalloc(sizeof (*lane));
+	if (lane == NULL)
+		return ENOMEM;
+
+	lane->ranges = ctree_new();
+	if (lane->ranges == NULL) {
+		Free(lane);
 		return ENOMEM;
+	}
+
+	section->runtime = lane;
 
 	return 0;
 }
@@ -1709,7 +2034,10 @@ lane_transaction_construct(PMEMobjpool *pop, struct lane_section *section)
 static void
 lane_transaction_destruct(PMEMobjpool *pop, struct lane_section *section)
 {
-	Free(section->runtime);
+	struct lane_tx_runtime *lane = section->runtime;
+
+	ctree_delete(lane->ranges);
+	Free(lane);
 }
 
 #ifdef USE_VG_MEMCHECK
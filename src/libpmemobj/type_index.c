@@ -0,0 +1,317 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * type_index.c -- volatile per-type object index
+ *
+ * The index maps every type number to a crit-bit tree of offsets of the
+ * (non-internal) objects of that type. It makes typed iteration cost
+ * proportional to the number of objects of the requested type instead of
+ * the number of all objects in the pool.
+ *
+ * The index is not stored in the pool. It is built by walking the heap on
+ * the first typed lookup and from then on it is kept up to date by the
+ * allocator, so pools that never iterate by type pay nothing for it.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "libpmemobj.h"
+#include "util.h"
+#include "redo.h"
+#include "memops.h"
+#include "pmalloc.h"
+#include "lane.h"
+#include "list.h"
+#include "obj.h"
+#include "out.h"
+#include "sys_util.h"
+#include "heap.h"
+#include "heap_layout.h"
+#include "ctree.h"
+#include "type_index.h"
+
+struct type_index {
+	/*
+	 * Held for writing while the index is built and when a new type is
+	 * added, for reading otherwise. The per-type trees have their own
+	 * locks.
+	 */
+	pthread_rwlock_t lock;
+
+	/* type number -> struct ctree * of object offsets */
+	struct ctree *types;
+
+	/* cleared when an update fails, the index is not used afterwards */
+	int valid;
+};
+
+/*
+ * type_index_tree_create -- (internal) returns the tree of objects of the
+ *	given type, creating it if needed
+ *
+ * Must be called with the index lock held for writing.
+ */
+static struct ctree *
+type_index_tree_create(struct type_index *ti, uint64_t type_num)
+{
+	uint64_t key = type_num;
+	struct ctree *tree = (struct ctree *)ctree_find_ge_unlocked(ti->types,
+		&key);
+	if (tree != NULL && key == type_num)
+		return tree;
+
+	tree = ctree_new();
+	if (tree != NULL && ctree_insert_unlocked(ti->types, type_num,
+			(uint64_t)tree) != 0) {
+		ctree_delete(tree);
+		tree = NULL;
+	}
+
+	return tree;
+}
+
+/*
+ * type_index_tree -- (internal) returns the tree of objects of the given type
+ *
+ * Must be called with the index lock held for reading. If the tree does
+ * not exist and 'create' is set, the lock is temporarily upgraded to add it.
+ */
+static struct ctree *
+type_index_tree(struct type_index *ti, uint64_t type_num, int create)
+{
+	uint64_t key = type_num;
+	struct ctree *tree = (struct ctree *)ctree_find_ge_unlocked(ti->types,
+		&key);
+	if (tree != NULL && key == type_num)
+		return tree;
+
+	if (!create)
+		return NULL;
+
+	util_rwlock_unlock(&ti->lock);
+	util_rwlock_wrlock(&ti->lock);
+
+	tree = type_index_tree_create(ti, type_num);
+
+	util_rwlock_unlock(&ti->lock);
+	util_rwlock_rdlock(&ti->lock);
+
+	return tree;
+}
+
+/*
+ * type_index_add -- (internal) adds the object to the index
+ *
+ * Must be called with the index lock held, for writing if 'exclusive' is set
+ * and for reading otherwise.
+ */
+static void
+type_index_add(PMEMobjpool *pop, struct type_index *ti, uint64_t off,
+	int exclusive)
+{
+	struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, off);
+	if (oobh->size & OBJ_INTERNAL_OBJECT_MASK)
+		return;
+
+	struct ctree *tree = exclusive ?
+		type_index_tree_create(ti, oobh->type_num) :
+		type_index_tree(ti, oobh->type_num, 1);
+	if (tree == NULL) {
+		ti->valid = 0;
+		return;
+	}
+
+	int ret = ctree_insert(tree, off, off);
+	if (ret != 0 && ret != EEXIST) {
+		LOG(2, "type index disabled, ctree_insert: %d", ret);
+		ti->valid = 0;
+	}
+}
+
+/*
+ * type_index_build_cb -- (internal) heap walk callback
+ */
+static int
+type_index_build_cb(uint64_t off, void *arg)
+{
+	PMEMobjpool *pop = *(PMEMobjpool **)arg;
+	struct type_index *ti = pop->type_index;
+
+	type_index_add(pop, ti,
+		off + sizeof (struct allocation_header) + OBJ_OOB_SIZE, 1);
+
+	return !ti->valid;
+}
+
+/*
+ * type_index_get -- (internal) returns the index of the pool, building it
+ *	if this is the first lookup
+ */
+static struct type_index *
+type_index_get(PMEMobjpool *pop)
+{
+	struct type_index *ti = pop->type_index;
+	if (ti != NULL)
+		return ti;
+
+	ti = Malloc(sizeof (*ti));
+	if (ti == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	ti->types = ctree_new();
+	if (ti->types == NULL) {
+		Free(ti);
+		return NULL;
+	}
+
+	ti->valid = 1;
+	util_rwlock_init(&ti->lock);
+
+	/*
+	 * Publish the index before walking the heap, so that objects
+	 * allocated or freed concurrently with the walk are accounted for
+	 * by type_index_update once the lock is released.
+	 */
+	util_rwlock_wrlock(&ti->lock);
+	if (!__sync_bool_compare_and_swap(&pop->type_index, NULL, ti)) {
+		util_rwlock_unlock(&ti->lock);
+		type_index_delete(ti);
+		return pop->type_index;
+	}
+
+	struct memory_block m = {0, 0, 0, 0};
+	heap_foreach_object(pop, type_index_build_cb, &pop, m);
+
+	util_rwlock_unlock(&ti->lock);
+
+	return ti;
+}
+
+/*
+ * type_index_delete -- deletes the index and all of its trees
+ */
+void
+type_index_delete(struct type_index *ti)
+{
+	uint64_t key = 0;
+	struct ctree *tree;
+	while ((tree = (struct ctree *)ctree_find_ge_unlocked(ti->types,
+			&key)) != NULL) {
+		ctree_remove_unlocked(ti->types, key, 1);
+		ctree_delete(tree);
+		key = 0;
+	}
+
+	ctree_delete(ti->types);
+	util_rwlock_destroy(&ti->lock);
+	Free(ti);
+}
+
+/*
+ * type_index_find_ge -- looks up the first object of the given type whose
+ *	offset is not less than *off
+ *
+ * On success *off is set to the offset of the found object or to 0 if there
+ * is none. Returns -1 if the index is not available, in which case the caller
+ * has to fall back to walking the heap.
+ */
+int
+type_index_find_ge(PMEMobjpool *pop, uint64_t type_num, uint64_t *off)
+{
+	struct type_index *ti = type_index_get(pop);
+	if (ti == NULL)
+		return -1;
+
+	int ret = 0;
+	util_rwlock_rdlock(&ti->lock);
+
+	if (!ti->valid) {
+		ret = -1;
+		goto out;
+	}
+
+	struct ctree *tree = type_index_tree(ti, type_num, 0);
+	if (tree == NULL) {
+		*off = 0;
+		goto out;
+	}
+
+	ctree_find_ge(tree, off);
+
+out:
+	util_rwlock_unlock(&ti->lock);
+	return ret;
+}
+
+/*
+ * type_index_update -- moves an object in the index, if the pool has one
+ *
+ * 'old_off' is the offset of the object that has been freed or reallocated
+ * (0 if none or if it was internal) and 'old_type' its type number, read
+ * before the operation. 'new_off' is the offset of the allocated object
+ * (0 if none), its type is read from the object header.
+ */
+void
+type_index_update(PMEMobjpool *pop, uint64_t old_off, uint64_t old_type,
+	uint64_t new_off)
+{
+	/*
+	 * Orders the heap changes of the operation before the check, pairs
+	 * with the publication of the index in type_index_get.
+	 */
+	__sync_synchronize();
+
+	struct type_index *ti = pop->type_index;
+	if (ti == NULL)
+		return;
+
+	util_rwlock_rdlock(&ti->lock);
+
+	if (!ti->valid)
+		goto out;
+
+	if (old_off != 0) {
+		struct ctree *tree = type_index_tree(ti, old_type, 0);
+		if (tree != NULL)
+			ctree_remove(tree, old_off, 1);
+	}
+
+	if (new_off != 0)
+		type_index_add(pop, ti, new_off, 0);
+
+out:
+	util_rwlock_unlock(&ti->lock);
+}
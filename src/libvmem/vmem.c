@@ -48,6 +48,7 @@
 #include "util.h"
 #include "out.h"
 #include "sys_util.h"
+#include "numa.h"
 #include "vmem.h"
 
 /*
@@ -101,6 +102,7 @@ vmem_init(void)
 		out_set_vsnprintf_func(je_vmem_navsnprintf);
 		LOG(3, NULL);
 		util_init();
+		util_numa_init();
 		Header_size = roundup(sizeof (VMEM), Pagesize);
 
 		/* Set up jemalloc messages to a custom print function */
@@ -142,9 +144,18 @@ vmem_fini(void)
  */
 VMEM *
 vmem_create(const char *dir, size_t size)
+{
+	return vmem_create_ext(dir, size, NULL);
+}
+
+/*
+ * vmem_create_ext -- create a memory pool in a temp file with given tunables
+ */
+VMEM *
+vmem_create_ext(const char *dir, size_t size, const struct vmem_opts *opts)
 {
 	vmem_init();
-	LOG(3, "dir \"%s\" size %zu", dir, size);
+	LOG(3, "dir \"%s\" size %zu opts %p", dir, size, opts);
 
 	if (size < VMEM_MIN_POOL) {
 		ERR("size %zu smaller than %zu", size, VMEM_MIN_POOL);
@@ -152,6 +163,13 @@ vmem_create(const char *dir, size_t size)
 		return NULL;
 	}
 
+	if (opts != NULL &&
+			(opts->flags & ~(unsigned)VMEM_OPT_VALID_FLAGS) != 0) {
+		ERR("invalid flags 0x%x", opts->flags);
+		errno = EINVAL;
+		return NULL;
+	}
+
 	/* silently enforce multiple of page size */
 	size = roundup(size, Pagesize);
 
@@ -166,10 +184,28 @@ vmem_create(const char *dir, size_t size)
 	vmp->addr = addr;
 	vmp->size = size;
 	vmp->caller_mapped = 0;
+	vmp->pools = NULL;
+	vmp->npools = 0;
+	vmp->interleave = 0;
+
+	pool_opts_t popts;
+	memset(&popts, 0, sizeof (popts));
+	if (opts != NULL) {
+		LOG(4, "narenas %u flags 0x%x tcache_max %zu lg_dirty_mult %d",
+			opts->narenas, opts->flags, opts->tcache_max,
+			opts->lg_dirty_mult);
+		popts.narenas = opts->narenas;
+		if (opts->flags & VMEM_OPT_NO_TCACHE)
+			popts.flags |= POOL_OPT_NO_TCACHE;
+		if (opts->flags & VMEM_OPT_NO_PURGE)
+			popts.flags |= POOL_OPT_NO_PURGE;
+		popts.tcache_max = opts->tcache_max;
+		popts.lg_dirty_mult = opts->lg_dirty_mult;
+	}
 
 	/* Prepare pool for jemalloc */
-	if (je_vmem_pool_create((void *)((uintptr_t)addr + Header_size),
-			size - Header_size, 1) == NULL) {
+	if (je_vmem_pool_create_ext((void *)((uintptr_t)addr + Header_size),
+			size - Header_size, 1, &popts) == NULL) {
 		ERR("pool creation failed");
 		util_unmap(vmp->addr, vmp->size);
 		return NULL;
@@ -215,6 +251,9 @@ vmem_create_in_region(void *addr, size_t size)
 	vmp->addr = addr;
 	vmp->size = size;
 	vmp->caller_mapped = 1;
+	vmp->pools = NULL;
+	vmp->npools = 0;
+	vmp->interleave = 0;
 
 	/* Prepare pool for jemalloc */
 	if (je_vmem_pool_create((void *)((uintptr_t)addr + Header_size),
@@ -235,6 +274,147 @@ vmem_create_in_region(void *addr, size_t size)
 	return vmp;
 }
 
+/* next pool of an interleaved pool set used by this thread */
+static __thread unsigned Interleave_next;
+
+/*
+ * vmem_pool -- (internal) get the allocator pool of a single memory pool
+ */
+static inline pool_t *
+vmem_pool(VMEM *vmp)
+{
+	return (pool_t *)((uintptr_t)vmp + Header_size);
+}
+
+/*
+ * vmem_alloc_first -- (internal) get the index of the pool of a pool set
+ * new allocations are tried from first
+ *
+ * This is the pool of the node the calling thread runs on, or the next pool
+ * in turn when the set is interleaved.
+ */
+static inline unsigned
+vmem_alloc_first(VMEM *vmp)
+{
+	if (vmp->pools == NULL)
+		return 0;
+
+	if (vmp->interleave)
+		return Interleave_next++ % vmp->npools;
+
+	return util_numa_node() % vmp->npools;
+}
+
+/*
+ * vmem_alloc_pool -- (internal) get the i-th pool a new allocation is tried
+ * from, or NULL if there is none left
+ *
+ * When the first pool of a pool set is exhausted, the following ones are
+ * tried in order.
+ */
+static inline pool_t *
+vmem_alloc_pool(VMEM *vmp, unsigned first, unsigned i)
+{
+	if (vmp->pools == NULL)
+		return i == 0 ? vmem_pool(vmp) : NULL;
+
+	if (i == vmp->npools)
+		return NULL;
+
+	return vmem_pool(vmp->pools[(first + i) % vmp->npools]);
+}
+
+/*
+ * vmem_ptr_pool -- (internal) get the pool an allocation belongs to
+ */
+static inline pool_t *
+vmem_ptr_pool(VMEM *vmp, void *ptr)
+{
+	if (vmp->pools == NULL)
+		return vmem_pool(vmp);
+
+	for (unsigned i = 0; i < vmp->npools; i++) {
+		struct vmem *pvmp = vmp->pools[i];
+		if ((uintptr_t)ptr - (uintptr_t)pvmp->addr < pvmp->size)
+			return vmem_pool(pvmp);
+	}
+
+	/* NULL or a foreign pointer, let the first pool deal with it */
+	return vmem_pool(vmp->pools[0]);
+}
+
+/*
+ * vmem_numa_free -- (internal) delete the pools and free a pool set
+ */
+static void
+vmem_numa_free(VMEM *vmp)
+{
+	for (unsigned i = 0; i < vmp->npools; i++)
+		vmem_delete(vmp->pools[i]);
+
+	Free(vmp->pools);
+	Free(vmp);
+}
+
+/*
+ * vmem_create_numa -- create a set of memory pools, one per directory
+ *
+ * Directory n is meant to be local to NUMA node n.  Allocations are served
+ * from pool (node % ndirs) of the node the caller runs on, or from all of
+ * the pools in turn with VMEM_OPT_INTERLEAVE.  Once that pool is exhausted,
+ * the following ones are used in order.
+ */
+VMEM *
+vmem_create_numa(const char *const dirs[], unsigned ndirs, size_t size,
+		const struct vmem_opts *opts)
+{
+	vmem_init();
+	LOG(3, "dirs %p ndirs %u size %zu opts %p", dirs, ndirs, size, opts);
+
+	if (ndirs == 0) {
+		ERR("no directories given");
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct vmem *vmp = Malloc(sizeof (*vmp));
+	if (vmp == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	memset(vmp, 0, sizeof (*vmp));
+	memcpy(vmp->hdr.signature, VMEM_HDR_SIG, POOL_HDR_SIG_LEN);
+	vmp->caller_mapped = 1;
+	vmp->interleave = opts != NULL &&
+			(opts->flags & VMEM_OPT_INTERLEAVE) != 0;
+
+	vmp->pools = Malloc(ndirs * sizeof (VMEM *));
+	if (vmp->pools == NULL) {
+		ERR("!Malloc");
+		Free(vmp);
+		return NULL;
+	}
+
+	for (unsigned i = 0; i < ndirs; i++) {
+		vmp->pools[i] = vmem_create_ext(dirs[i], size, opts);
+		if (vmp->pools[i] == NULL) {
+			int oerrno = errno;
+			vmem_numa_free(vmp);
+			errno = oerrno;
+			return NULL;
+		}
+		vmp->npools++;
+	}
+
+	if (ndirs < util_numa_nnodes())
+		LOG(3, "%u directories for %u NUMA nodes", ndirs,
+			util_numa_nnodes());
+
+	LOG(3, "vmp %p", vmp);
+	return vmp;
+}
+
 /*
  * vmem_delete -- delete a memory pool
  */
@@ -243,7 +423,12 @@ vmem_delete(VMEM *vmp)
 {
 	LOG(3, "vmp %p", vmp);
 
-	int ret = je_vmem_pool_delete((pool_t *)((uintptr_t)vmp + Header_size));
+	if (vmp->pools != NULL) {
+		vmem_numa_free(vmp);
+		return;
+	}
+
+	int ret = je_vmem_pool_delete(vmem_pool(vmp));
 	if (ret != 0) {
 		ERR("invalid pool handle: %p", vmp);
 		errno = EINVAL;
@@ -265,7 +450,16 @@ vmem_check(VMEM *vmp)
 	vmem_init();
 	LOG(3, "vmp %p", vmp);
 
-	return je_vmem_pool_check((pool_t *)((uintptr_t)vmp + Header_size));
+	if (vmp->pools == NULL)
+		return je_vmem_pool_check(vmem_pool(vmp));
+
+	for (unsigned i = 0; i < vmp->npools; i++) {
+		int ret = vmem_check(vmp->pools[i]);
+		if (ret != 1)
+			return ret;
+	}
+
+	return 1;
 }
 
 /*
@@ -276,8 +470,13 @@ vmem_stats_print(VMEM *vmp, const char *opts)
 {
 	LOG(3, "vmp %p opts \"%s\"", vmp, opts ? opts : "");
 
-	je_vmem_pool_malloc_stats_print(
-			(pool_t *)((uintptr_t)vmp + Header_size),
+	if (vmp->pools != NULL) {
+		for (unsigned i = 0; i < vmp->npools; i++)
+			vmem_stats_print(vmp->pools[i], opts);
+		return;
+	}
+
+	je_vmem_pool_malloc_stats_print(vmem_pool(vmp),
 			print_jemalloc_stats, NULL, opts);
 }
 
@@ -289,8 +488,14 @@ vmem_malloc(VMEM *vmp, size_t size)
 {
 	LOG(3, "vmp %p size %zu", vmp, size);
 
-	return je_vmem_pool_malloc(
-			(pool_t *)((uintptr_t)vmp + Header_size), size);
+	unsigned first = vmem_alloc_first(vmp);
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmem_alloc_pool(vmp, first, i)) != NULL; i++)
+		ptr = je_vmem_pool_malloc(pool, size);
+
+	return ptr;
 }
 
 /*
@@ -301,7 +506,7 @@ vmem_free(VMEM *vmp, void *ptr)
 {
 	LOG(3, "vmp %p ptr %p", vmp, ptr);
 
-	je_vmem_pool_free((pool_t *)((uintptr_t)vmp + Header_size), ptr);
+	je_vmem_pool_free(vmem_ptr_pool(vmp, ptr), ptr);
 }
 
 /*
@@ -312,20 +517,46 @@ vmem_calloc(VMEM *vmp, size_t nmemb, size_t size)
 {
 	LOG(3, "vmp %p nmemb %zu size %zu", vmp, nmemb, size);
 
-	return je_vmem_pool_calloc((pool_t *)((uintptr_t)vmp + Header_size),
-			nmemb, size);
+	unsigned first = vmem_alloc_first(vmp);
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmem_alloc_pool(vmp, first, i)) != NULL; i++)
+		ptr = je_vmem_pool_calloc(pool, nmemb, size);
+
+	return ptr;
 }
 
 /*
  * vmem_realloc -- resize a memory allocation
+ *
+ * The allocation stays in the pool it was made from, even if the caller
+ * has moved to another node in the meantime, unless that pool can't hold
+ * its new size.
  */
 void *
 vmem_realloc(VMEM *vmp, void *ptr, size_t size)
 {
 	LOG(3, "vmp %p ptr %p size %zu", vmp, ptr, size);
 
-	return je_vmem_pool_ralloc((pool_t *)((uintptr_t)vmp + Header_size),
-			ptr, size);
+	if (ptr == NULL)
+		return vmem_malloc(vmp, size);
+
+	pool_t *pool = vmem_ptr_pool(vmp, ptr);
+	void *ret = je_vmem_pool_ralloc(pool, ptr, size);
+	if (ret != NULL || size == 0 || vmp->pools == NULL)
+		return ret;
+
+	/* the pool of the allocation is exhausted, move it to another one */
+	size_t usable = je_vmem_pool_malloc_usable_size(pool, ptr);
+	ret = vmem_malloc(vmp, size);
+	if (ret == NULL)
+		return NULL;
+
+	memcpy(ret, ptr, MIN(usable, size));
+	je_vmem_pool_free(pool, ptr);
+
+	return ret;
 }
 
 /*
@@ -336,9 +567,14 @@ vmem_aligned_alloc(VMEM *vmp, size_t alignment, size_t size)
 {
 	LOG(3, "vmp %p alignment %zu size %zu", vmp, alignment, size);
 
-	return je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)vmp + Header_size),
-			alignment, size);
+	unsigned first = vmem_alloc_first(vmp);
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmem_alloc_pool(vmp, first, i)) != NULL; i++)
+		ptr = je_vmem_pool_aligned_alloc(pool, alignment, size);
+
+	return ptr;
 }
 
 /*
@@ -350,8 +586,7 @@ vmem_strdup(VMEM *vmp, const char *s)
 	LOG(3, "vmp %p s %p", vmp, s);
 
 	size_t size = strlen(s) + 1;
-	void *retaddr = je_vmem_pool_malloc(
-			(pool_t *)((uintptr_t)vmp + Header_size), size);
+	void *retaddr = vmem_malloc(vmp, size);
 	if (retaddr == NULL)
 		return NULL;
 
@@ -366,6 +601,5 @@ vmem_malloc_usable_size(VMEM *vmp, void *ptr)
 {
 	LOG(3, "vmp %p ptr %p", vmp, ptr);
 
-	return je_vmem_pool_malloc_usable_size(
-			(pool_t *)((uintptr_t)vmp + Header_size), ptr);
+	return je_vmem_pool_malloc_usable_size(vmem_ptr_pool(vmp, ptr), ptr);
 }
@@ -45,12 +45,21 @@
 #define	VMEM_FORMAT_INCOMPAT 0x0000
 #define	VMEM_FORMAT_RO_COMPAT 0x0000
 
+/* flags of struct vmem_opts known to this version of the library */
+#define	VMEM_OPT_VALID_FLAGS\
+	(VMEM_OPT_NO_TCACHE | VMEM_OPT_NO_PURGE | VMEM_OPT_INTERLEAVE)
+
 struct vmem {
 	struct pool_hdr hdr;	/* memory pool header */
 
 	void *addr;	/* mapped region */
 	size_t size;	/* size of mapped region */
 	int caller_mapped;
+
+	/* pools of a NUMA pool set, NULL for a single pool */
+	struct vmem **pools;
+	unsigned npools;
+	int interleave;	/* spread allocations over all pools */
 };
 
 void vmem_init(void);
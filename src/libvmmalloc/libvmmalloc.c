@@ -54,6 +54,12 @@
  *
  * 4) If the process forks, there is no separate log file open for a new
  *    process, even if the configured log file name is terminated with "-".
+ *
+ * 5) VMMALLOC_POOL_DIR may list several directories separated by ':', one
+ *    per NUMA node.  A pool is created in each of them and allocations are
+ *    served from the pool of the node the calling thread runs on (or from
+ *    all of them in turn if VMMALLOC_NUMA_INTERLEAVE is set).  Memory is
+ *    always returned to the pool it was allocated from.
  */
 
 #define	_GNU_SOURCE
@@ -78,22 +84,111 @@
 #include "util.h"
 #include "vmem.h"
 #include "vmmalloc.h"
+#include "numa.h"
 #include "out.h"
 #include "valgrind_internal.h"
 
 #define	HUGE (2 * 1024 * 1024)
 
+#define	MAXDIRS NUMA_NODES_MAX
+
+/*
+ * vmmalloc_pool -- a pool with its backing file
+ */
+struct vmmalloc_pool {
+	VMEM *vmp;
+	char *dir;
+	int fd;
+	int fd_clone;
+	int private;
+};
+
 /*
  * private to this file...
  */
 static size_t Header_size;
-static VMEM *Vmp;
-static char *Dir;
-static int Fd;
-static int Fd_clone;
-static int Private;
+static VMEM *Vmp;	/* the first pool, set once all pools are created */
+static struct vmmalloc_pool Pools[MAXDIRS];
+static unsigned Npools;
+static int Interleave;
+static __thread unsigned Interleave_next;
+static char Dirs[PATH_MAX * 4];
 static int Forkopt = 1; /* default behavior - remap as private */
 
+/*
+ * vmmalloc_pool -- (internal) get the allocator pool of a vmem pool
+ */
+static inline pool_t *
+vmmalloc_pool(VMEM *vmp)
+{
+	return (pool_t *)((uintptr_t)vmp + Header_size);
+}
+
+/*
+ * vmmalloc_alloc_first -- (internal) get the index of the pool new
+ * allocations are tried from first
+ */
+static inline unsigned
+vmmalloc_alloc_first(void)
+{
+	if (Npools == 1)
+		return 0;
+
+	if (Interleave)
+		return Interleave_next++ % Npools;
+
+	return util_numa_node() % Npools;
+}
+
+/*
+ * vmmalloc_alloc_pool -- (internal) get the i-th pool a new allocation is
+ * tried from, or NULL if there is none left
+ *
+ * When the first pool is exhausted, the following ones are tried in order.
+ */
+static inline pool_t *
+vmmalloc_alloc_pool(unsigned first, unsigned i)
+{
+	if (i == Npools)
+		return NULL;
+
+	return vmmalloc_pool(Pools[(first + i) % Npools].vmp);
+}
+
+/*
+ * vmmalloc_ptr_pool -- (internal) get the pool an allocation belongs to
+ *
+ * The blocks allocated before the pools were created come from the system
+ * heap and are handed to the first pool, just like with a single pool.
+ */
+static inline pool_t *
+vmmalloc_ptr_pool(void *ptr)
+{
+	for (unsigned i = 1; i < Npools; i++) {
+		VMEM *vmp = Pools[i].vmp;
+		if ((uintptr_t)ptr - (uintptr_t)vmp->addr < vmp->size)
+			return vmmalloc_pool(vmp);
+	}
+
+	return vmmalloc_pool(Vmp);
+}
+
+/*
+ * vmmalloc_aligned_alloc -- (internal) allocate an aligned block from
+ * the pools
+ */
+static void *
+vmmalloc_aligned_alloc(size_t alignment, size_t size)
+{
+	unsigned first = vmmalloc_alloc_first();
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmmalloc_alloc_pool(first, i)) != NULL; i++)
+		ptr = je_vmem_pool_aligned_alloc(pool, alignment, size);
+
+	return ptr;
+}
 
 /*
  * malloc -- allocate a block of size bytes
@@ -108,8 +203,15 @@ malloc(size_t size)
 		return je_vmem_malloc(size);
 	}
 	LOG(4, "size %zu", size);
-	return je_vmem_pool_malloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size), size);
+
+	unsigned first = vmmalloc_alloc_first();
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmmalloc_alloc_pool(first, i)) != NULL; i++)
+		ptr = je_vmem_pool_malloc(pool, size);
+
+	return ptr;
 }
 
 /*
@@ -125,12 +227,21 @@ calloc(size_t nmemb, size_t size)
 		return je_vmem_calloc(nmemb, size);
 	}
 	LOG(4, "nmemb %zu, size %zu", nmemb, size);
-	return je_vmem_pool_calloc((pool_t *)((uintptr_t)Vmp + Header_size),
-			nmemb, size);
+
+	unsigned first = vmmalloc_alloc_first();
+	void *ptr = NULL;
+	pool_t *pool;
+	for (unsigned i = 0; ptr == NULL &&
+			(pool = vmmalloc_alloc_pool(first, i)) != NULL; i++)
+		ptr = je_vmem_pool_calloc(pool, nmemb, size);
+
+	return ptr;
 }
 
 /*
  * realloc -- resize a block previously allocated by malloc
+ *
+ * The block stays in its pool, unless that pool can't hold its new size.
  */
 __ATTR_ALLOC_SIZE__(2)
 void *
@@ -141,8 +252,25 @@ realloc(void *ptr, size_t size)
 		return je_vmem_realloc(ptr, size);
 	}
 	LOG(4, "ptr %p, size %zu", ptr, size);
-	return je_vmem_pool_ralloc((pool_t *)((uintptr_t)Vmp + Header_size),
-			ptr, size);
+
+	if (ptr == NULL)
+		return malloc(size);
+
+	pool_t *pool = vmmalloc_ptr_pool(ptr);
+	void *ret = je_vmem_pool_ralloc(pool, ptr, size);
+	if (ret != NULL || size == 0 || Npools == 1)
+		return ret;
+
+	/* the pool of the block is exhausted, move it to another one */
+	size_t usable = je_vmem_pool_malloc_usable_size(pool, ptr);
+	ret = malloc(size);
+	if (ret == NULL)
+		return NULL;
+
+	memcpy(ret, ptr, MIN(usable, size));
+	je_vmem_pool_free(pool, ptr);
+
+	return ret;
 }
 
 /*
@@ -156,7 +284,7 @@ free(void *ptr)
 		return;
 	}
 	LOG(4, "ptr %p", ptr);
-	je_vmem_pool_free((pool_t *)((uintptr_t)Vmp + Header_size), ptr);
+	je_vmem_pool_free(vmmalloc_ptr_pool(ptr), ptr);
 }
 
 /*
@@ -172,7 +300,7 @@ cfree(void *ptr)
 		return;
 	}
 	LOG(4, "ptr %p", ptr);
-	je_vmem_pool_free((pool_t *)((uintptr_t)Vmp + Header_size), ptr);
+	je_vmem_pool_free(vmmalloc_ptr_pool(ptr), ptr);
 }
 
 #ifdef	VMMALLOC_OVERRIDE_MEMALIGN
@@ -191,9 +319,7 @@ memalign(size_t boundary, size_t size)
 		return je_vmem_memalign(boundary, size);
 	}
 	LOG(4, "boundary %zu  size %zu", boundary, size);
-	return je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size),
-			boundary, size);
+	return vmmalloc_aligned_alloc(boundary, size);
 }
 #endif
 
@@ -217,9 +343,7 @@ aligned_alloc(size_t alignment, size_t size)
 		return je_vmem_memalign(alignment, size);
 	}
 	LOG(4, "alignment %zu  size %zu", alignment, size);
-	return je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size),
-			alignment, size);
+	return vmmalloc_aligned_alloc(alignment, size);
 }
 #endif
 
@@ -242,9 +366,7 @@ posix_memalign(void **memptr, size_t alignment, size_t size)
 		return ret;
 	}
 	LOG(4, "alignment %zu  size %zu", alignment, size);
-	*memptr = je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size),
-			alignment, size);
+	*memptr = vmmalloc_aligned_alloc(alignment, size);
 	if (*memptr == NULL)
 		ret = errno;
 	errno = oerrno;
@@ -266,9 +388,7 @@ valloc(size_t size)
 		return je_vmem_valloc(size);
 	}
 	LOG(4, "size %zu", size);
-	return je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size),
-			Pagesize, size);
+	return vmmalloc_aligned_alloc(Pagesize, size);
 }
 
 __ATTR_MALLOC__
@@ -282,9 +402,7 @@ pvalloc(size_t size)
 		return je_vmem_valloc(roundup(size, Pagesize));
 	}
 	LOG(4, "size %zu", size);
-	return je_vmem_pool_aligned_alloc(
-			(pool_t *)((uintptr_t)Vmp + Header_size),
-			Pagesize, roundup(size, Pagesize));
+	return vmmalloc_aligned_alloc(Pagesize, roundup(size, Pagesize));
 }
 #endif
 
@@ -298,8 +416,7 @@ malloc_usable_size(void *ptr)
 		return je_vmem_malloc_usable_size(ptr);
 	}
 	LOG(4, "ptr %p", ptr);
-	return je_vmem_pool_malloc_usable_size(
-			(pool_t *)((uintptr_t)Vmp + Header_size), ptr);
+	return je_vmem_pool_malloc_usable_size(vmmalloc_ptr_pool(ptr), ptr);
 }
 
 #if (defined(__GLIBC__) && !defined(__UCLIBC__))
@@ -348,9 +465,9 @@ print_jemalloc_stats(void *ignore, const char *s)
  * libvmmalloc_create -- (internal) create a memory pool in a temp file
  */
 static VMEM *
-libvmmalloc_create(const char *dir, size_t size)
+libvmmalloc_create(struct vmmalloc_pool *p, size_t size)
 {
-	LOG(3, "dir \"%s\" size %zu", dir, size);
+	LOG(3, "dir \"%s\" size %zu", p->dir, size);
 
 	if (size < VMMALLOC_MIN_POOL) {
 		LOG(1, "size %zu smaller than %zu", size, VMMALLOC_MIN_POOL);
@@ -361,19 +478,19 @@ libvmmalloc_create(const char *dir, size_t size)
 	/* silently enforce multiple of page size */
 	size = roundup(size, Pagesize);
 
-	Fd = util_tmpfile(dir, "/vmem.XXXXXX");
-	if (Fd == -1)
+	p->fd = util_tmpfile(p->dir, "/vmem.XXXXXX");
+	if (p->fd == -1)
 		return NULL;
 
-	if ((errno = posix_fallocate(Fd, 0, (off_t)size)) != 0) {
+	if ((errno = posix_fallocate(p->fd, 0, (off_t)size)) != 0) {
 		ERR("!posix_fallocate");
-		(void) close(Fd);
+		(void) close(p->fd);
 		return NULL;
 	}
 
 	void *addr;
-	if ((addr = util_map(Fd, size, 0, 4 << 20)) == NULL) {
-		(void) close(Fd);
+	if ((addr = util_map(p->fd, size, 0, 4 << 20)) == NULL) {
+		(void) close(p->fd);
 		return NULL;
 	}
 
@@ -384,6 +501,9 @@ libvmmalloc_create(const char *dir, size_t size)
 	vmp->addr = addr;
 	vmp->size = size;
 	vmp->caller_mapped = 0;
+	vmp->pools = NULL;
+	vmp->npools = 0;
+	vmp->interleave = 0;
 
 	/* Prepare pool for jemalloc */
 	if (je_vmem_pool_create((void *)((uintptr_t)addr + Header_size),
@@ -409,32 +529,34 @@ libvmmalloc_create(const char *dir, size_t size)
  * libvmmalloc_clone - (internal) clone the entire pool
  */
 static void *
-libvmmalloc_clone(void)
+libvmmalloc_clone(struct vmmalloc_pool *p)
 {
-	LOG(3, NULL);
+	LOG(3, "vmp %p", p->vmp);
 
-	Fd_clone = util_tmpfile(Dir, "/vmem.XXXXXX");
-	if (Fd_clone == -1)
+	VMEM *vmp = p->vmp;
+
+	p->fd_clone = util_tmpfile(p->dir, "/vmem.XXXXXX");
+	if (p->fd_clone == -1)
 		return NULL;
 
-	if ((errno = posix_fallocate(Fd_clone, 0, (off_t)Vmp->size)) != 0) {
+	if ((errno = posix_fallocate(p->fd_clone, 0, (off_t)vmp->size)) != 0) {
 		ERR("!posix_fallocate");
-		(void) close(Fd_clone);
+		(void) close(p->fd_clone);
 		return NULL;
 	}
 
-	void *addr = mmap(NULL, Vmp->size, PROT_READ|PROT_WRITE,
-			MAP_SHARED, Fd_clone, 0);
+	void *addr = mmap(NULL, vmp->size, PROT_READ|PROT_WRITE,
+			MAP_SHARED, p->fd_clone, 0);
 	if (addr == MAP_FAILED) {
 		LOG(1, "!mmap");
-		(void) close(Fd_clone);
+		(void) close(p->fd_clone);
 		return NULL;
 	}
 
 	LOG(3, "copy the entire pool file: dst %p src %p size %zu",
-			addr, Vmp->addr, Vmp->size);
+			addr, vmp->addr, vmp->size);
 
-	util_range_rw(Vmp->addr, sizeof (struct pool_hdr));
+	util_range_rw(vmp->addr, sizeof (struct pool_hdr));
 
 	/*
 	 * Part of vmem pool was probably freed at some point, so Valgrind
@@ -442,36 +564,31 @@ libvmmalloc_clone(void)
 	 * pool, so as a workaround temporarily disable error reporting.
 	 */
 	VALGRIND_DO_DISABLE_ERROR_REPORTING;
-	memcpy(addr, Vmp->addr, Vmp->size);
+	memcpy(addr, vmp->addr, vmp->size);
 	VALGRIND_DO_ENABLE_ERROR_REPORTING;
 
-	util_range_none(Vmp->addr, sizeof (struct pool_hdr));
+	util_range_none(vmp->addr, sizeof (struct pool_hdr));
 
 	return addr;
 }
 
 /*
- * libvmmalloc_prefork -- (internal) prepare for fork()
+ * libvmmalloc_prefork_pool -- (internal) prepare a pool for fork()
  *
  * Clones the entire pool or remaps it with MAP_PRIVATE flag.
  */
 static void
-libvmmalloc_prefork(void)
+libvmmalloc_prefork_pool(struct vmmalloc_pool *p)
 {
-	LOG(3, NULL);
-
-	/*
-	 * There's no need to grab any locks here, as jemalloc pre-fork handler
-	 * is executed first, and it does all the synchronization.
-	 */
+	LOG(3, "vmp %p", p->vmp);
 
-	ASSERTne(Vmp, NULL);
-	ASSERTne(Dir, NULL);
+	ASSERTne(p->vmp, NULL);
+	ASSERTne(p->dir, NULL);
 
-	void *addr = Vmp->addr;
-	size_t size = Vmp->size;
+	void *addr = p->vmp->addr;
+	size_t size = p->vmp->size;
 
-	if (Private) {
+	if (p->private) {
 		LOG(3, "already mapped as private - do nothing");
 		return;
 	}
@@ -484,7 +601,7 @@ libvmmalloc_prefork(void)
 	case 2:
 		LOG(3, "clone the entire pool file");
 
-		if (libvmmalloc_clone() != NULL)
+		if (libvmmalloc_clone(p) != NULL)
 			break;
 
 		if (Forkopt == 2) {
@@ -497,22 +614,22 @@ libvmmalloc_prefork(void)
 	case 1:
 		LOG(3, "remap the pool file as private");
 
-		Vmp = mmap(addr, size, PROT_READ|PROT_WRITE,
-				MAP_PRIVATE|MAP_FIXED, Fd, 0);
+		p->vmp = mmap(addr, size, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_FIXED, p->fd, 0);
 
-		if (Vmp == MAP_FAILED) {
+		if (p->vmp == MAP_FAILED) {
 			out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
 					"remapping failed\n");
 			abort();
 		}
 
-		if (Vmp != addr) {
+		if (p->vmp != addr) {
 			out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
 					"wrong address\n");
 			abort();
 		}
 
-		Private = 1;
+		p->private = 1;
 		break;
 
 	case 0:
@@ -524,6 +641,25 @@ libvmmalloc_prefork(void)
 	}
 }
 
+/*
+ * libvmmalloc_prefork -- (internal) prepare for fork()
+ */
+static void
+libvmmalloc_prefork(void)
+{
+	LOG(3, NULL);
+
+	/*
+	 * There's no need to grab any locks here, as jemalloc pre-fork handler
+	 * is executed first, and it does all the synchronization.
+	 */
+
+	ASSERTne(Vmp, NULL);
+
+	for (unsigned i = 0; i < Npools; i++)
+		libvmmalloc_prefork_pool(&Pools[i]);
+}
+
 /*
  * libvmmalloc_postfork_parent -- (internal) parent post-fork handler
  */
@@ -537,11 +673,49 @@ libvmmalloc_postfork_parent(void)
 		return;
 	}
 
-	if (Private) {
+	for (unsigned i = 0; i < Npools; i++) {
+		struct vmmalloc_pool *p = &Pools[i];
+
+		if (p->private) {
+			LOG(3, "pool mapped as private - do nothing");
+		} else {
+			LOG(3, "close the cloned pool file");
+			(void) close(p->fd_clone);
+		}
+	}
+}
+
+/*
+ * libvmmalloc_postfork_child_pool -- (internal) map the clone of a pool
+ */
+static void
+libvmmalloc_postfork_child_pool(struct vmmalloc_pool *p)
+{
+	if (p->private) {
 		LOG(3, "pool mapped as private - do nothing");
-	} else {
-		LOG(3, "close the cloned pool file");
-		(void) close(Fd_clone);
+		return;
+	}
+
+	LOG(3, "close the original pool file");
+	(void) close(p->fd);
+	p->fd = p->fd_clone;
+
+	void *addr = p->vmp->addr;
+	size_t size = p->vmp->size;
+
+	LOG(3, "mapping cloned pool file at %p", addr);
+	p->vmp = mmap(addr, size, PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_FIXED, p->fd, 0);
+	if (p->vmp == MAP_FAILED) {
+		out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
+				"mapping failed\n");
+		abort();
+	}
+
+	if (p->vmp != addr) {
+		out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
+				"wrong address\n");
+		abort();
 	}
 }
 
@@ -558,33 +732,48 @@ libvmmalloc_postfork_child(void)
 		return;
 	}
 
-	if (Private) {
-		LOG(3, "pool mapped as private - do nothing");
-	} else {
-		LOG(3, "close the original pool file");
-		(void) close(Fd);
-		Fd = Fd_clone;
+	for (unsigned i = 0; i < Npools; i++)
+		libvmmalloc_postfork_child_pool(&Pools[i]);
 
-		void *addr = Vmp->addr;
-		size_t size = Vmp->size;
+	/* XXX - open a new log file, with the new PID in the name */
+}
 
-		LOG(3, "mapping cloned pool file at %p", addr);
-		Vmp = mmap(addr, size, PROT_READ|PROT_WRITE,
-				MAP_SHARED|MAP_FIXED, Fd, 0);
-		if (Vmp == MAP_FAILED) {
-			out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
-					"mapping failed\n");
-			abort();
-		}
+/*
+ * libvmmalloc_parse_dirs -- (internal) split the list of pool directories
+ *
+ * The list is copied to a static buffer, as nothing may be allocated yet.
+ */
+static void
+libvmmalloc_parse_dirs(const char *list)
+{
+	if (strlen(list) >= sizeof (Dirs)) {
+		out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
+				"%s value too long", VMMALLOC_POOL_DIR_VAR);
+		abort();
+	}
+
+	strcpy(Dirs, list);
 
-		if (Vmp != addr) {
+	char *dir = Dirs;
+	for (;;) {
+		if (Npools == MAXDIRS) {
 			out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
-					"wrong address\n");
+					"more than %u directories in %s",
+					MAXDIRS, VMMALLOC_POOL_DIR_VAR);
 			abort();
 		}
+
+		Pools[Npools++].dir = dir;
+
+		char *sep = strchr(dir, ':');
+		if (sep == NULL)
+			break;
+
+		*sep = '\0';
+		dir = sep + 1;
 	}
 
-	/* XXX - open a new log file, with the new PID in the name */
+	LOG(4, "%u pool directories", Npools);
 }
 
 /*
@@ -621,19 +810,22 @@ libvmmalloc_init(void)
 	out_set_vsnprintf_func(je_vmem_navsnprintf);
 	LOG(3, NULL);
 	util_init();
+	util_numa_init();
 
 	/* set up jemalloc messages to a custom print function */
 	je_vmem_malloc_message = print_jemalloc_messages;
 
 	Header_size = roundup(sizeof (VMEM), Pagesize);
 
-	if ((Dir = getenv(VMMALLOC_POOL_DIR_VAR)) == NULL) {
+	if ((env_str = getenv(VMMALLOC_POOL_DIR_VAR)) == NULL) {
 		out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
 				"environment variable %s not specified",
 				VMMALLOC_POOL_DIR_VAR);
 		abort();
 	}
 
+	libvmmalloc_parse_dirs(env_str);
+
 	if ((env_str = getenv(VMMALLOC_POOL_SIZE_VAR)) == NULL) {
 		out_log(NULL, 0, NULL, 0, "Error (libvmmalloc): "
 				"environment variable %s not specified",
@@ -670,17 +862,27 @@ libvmmalloc_init(void)
 		LOG(4, "Fork action %d", Forkopt);
 	}
 
+	if ((env_str = getenv(VMMALLOC_NUMA_INTERLEAVE_VAR)) != NULL) {
+		Interleave = strcmp(env_str, "1") == 0;
+		LOG(4, "Interleave %d", Interleave);
+	}
+
 	/*
 	 * XXX - vmem_create() could be used here, but then we need to
 	 * link vmem.o, including all the vmem API.
 	 */
-	Vmp = libvmmalloc_create(Dir, size);
-	if (Vmp == NULL) {
-		out_log(NULL, 0, NULL, 0, "!Error (libvmmalloc): "
-				"vmem pool creation failed");
-		abort();
+	for (unsigned i = 0; i < Npools; i++) {
+		Pools[i].vmp = libvmmalloc_create(&Pools[i], size);
+		if (Pools[i].vmp == NULL) {
+			out_log(NULL, 0, NULL, 0, "!Error (libvmmalloc): "
+					"vmem pool creation failed");
+			abort();
+		}
 	}
 
+	/* from now on malloc(3) is served from the pools */
+	Vmp = Pools[0].vmp;
+
 	LOG(2, "initialization completed");
 }
 
@@ -704,9 +906,14 @@ libvmmalloc_fini(void)
 	je_vmem_malloc_stats_print(
 		print_jemalloc_stats, NULL, "gba");
 
-	LOG_NONL(0, "\n=========    vmem pool   ========\n");
-	je_vmem_pool_malloc_stats_print(
-		(pool_t *)((uintptr_t)Vmp + Header_size),
-		print_jemalloc_stats, NULL, "gba");
+	for (unsigned i = 0; i < Npools; i++) {
+		if (Npools == 1)
+			LOG_NONL(0, "\n=========    vmem pool   ========\n");
+		else
+			LOG_NONL(0, "\n=========   vmem pool %u  ========\n",
+					i);
+		je_vmem_pool_malloc_stats_print(vmmalloc_pool(Pools[i].vmp),
+			print_jemalloc_stats, NULL, "gba");
+	}
 	out_fini();
 }
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * blk_csum.c -- unit test for pools with per-block checksums
+ *
+ * usage: blk_csum bsize file operation:lba...
+ *
+ * operations are 'r' or 'w' or 'x' (corrupt the data of a block)
+ *
+ */
+
+#include "unittest.h"
+
+/* internal blocks are aligned at least to this boundary in the pool file */
+#define	BLOCK_ALIGN 256
+
+static size_t Bsize;
+
+/*
+ * construct -- build a buffer for writing
+ */
+static void
+construct(unsigned char *buf)
+{
+	static int ord = 1;
+
+	memset(buf, ord, Bsize);
+
+	ord++;
+
+	if (ord > 255)
+		ord = 1;
+}
+
+/*
+ * ident -- identify what a buffer holds
+ */
+static char *
+ident(unsigned char *buf)
+{
+	static char descr[100];
+	unsigned val = *buf;
+
+	for (size_t i = 1; i < Bsize; i++)
+		if (buf[i] != val) {
+			sprintf(descr, "{%u} TORN at byte %zu", val, i);
+			return descr;
+		}
+
+	sprintf(descr, "{%u}", val);
+	return descr;
+}
+
+/*
+ * corrupt -- flip a byte in the data block filled with the given value
+ *
+ * The pool must not be open while the file is modified.
+ */
+static void
+corrupt(const char *path, unsigned char val)
+{
+	int fd = OPEN(path, O_RDWR);
+	struct stat stbuf;
+	FSTAT(fd, &stbuf);
+
+	size_t size = (size_t)stbuf.st_size;
+	unsigned char *addr = MMAP(NULL, size, PROT_READ|PROT_WRITE,
+			MAP_SHARED, fd, 0);
+
+	unsigned char *pattern = MALLOC(Bsize);
+	memset(pattern, val, Bsize);
+
+	int found = 0;
+	for (size_t off = 0; off + Bsize <= size; off += BLOCK_ALIGN) {
+		if (memcmp(addr + off, pattern, Bsize) == 0) {
+			addr[off + Bsize / 2] ^= 0xff;
+			found = 1;
+			break;
+		}
+	}
+
+	if (!found)
+		UT_FATAL("block {%u} not found in %s", val, path);
+
+	FREE(pattern);
+	MUNMAP(addr, size);
+	CLOSE(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "blk_csum");
+
+	if (argc < 4)
+		UT_FATAL("usage: %s bsize file op:lba...", argv[0]);
+
+	Bsize = strtoul(argv[1], NULL, 0);
+
+	const char *path = argv[2];
+
+	PMEMblkpool *handle = pmemblk_create_csum(path, Bsize, 0,
+			S_IWUSR | S_IRUSR);
+	if (handle == NULL)
+		UT_FATAL("!%s: pmemblk_create_csum", path);
+
+	UT_OUT("%s block size %zu usable blocks %zu",
+			argv[1], Bsize, pmemblk_nblock(handle));
+
+	unsigned char *buf = MALLOC(Bsize);
+
+	for (int arg = 3; arg < argc; arg++) {
+		if (strchr("rwx", argv[arg][0]) == NULL || argv[arg][1] != ':')
+			UT_FATAL("op must be r: or w: or x:");
+		off_t lba = strtol(&argv[arg][2], NULL, 0);
+
+		switch (argv[arg][0]) {
+		case 'r':
+			if (pmemblk_read(handle, buf, lba) < 0)
+				UT_OUT("!read      lba %jd", lba);
+			else
+				UT_OUT("read      lba %jd: %s", lba,
+						ident(buf));
+			break;
+
+		case 'w':
+			construct(buf);
+			if (pmemblk_write(handle, buf, lba) < 0)
+				UT_OUT("!write     lba %jd", lba);
+			else
+				UT_OUT("write     lba %jd: %s", lba,
+						ident(buf));
+			break;
+
+		case 'x':
+			if (pmemblk_read(handle, buf, lba) < 0)
+				UT_FATAL("!read lba %jd", lba);
+
+			pmemblk_close(handle);
+			corrupt(path, buf[0]);
+
+			handle = pmemblk_open(path, Bsize);
+			if (handle == NULL)
+				UT_FATAL("!%s: pmemblk_open", path);
+
+			UT_OUT("corrupt   lba %jd", lba);
+			break;
+		}
+	}
+
+	FREE(buf);
+	pmemblk_close(handle);
+
+	int result = pmemblk_check(path, Bsize);
+	if (result < 0)
+		UT_OUT("!%s: pmemblk_check", path);
+	else if (result == 0)
+		UT_OUT("%s: pmemblk_check: not consistent", path);
+
+	DONE(NULL);
+}
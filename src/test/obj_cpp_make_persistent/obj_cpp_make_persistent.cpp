@@ -41,6 +41,9 @@
 #include <libpmemobj/pool.hpp>
 #include <libpmemobj/make_persistent.hpp>
 
+#include <memory>
+#include <utility>
+
 #define LAYOUT "cpp"
 
 using namespace nvml::obj;
@@ -80,8 +83,29 @@ public:
 	p<char> arr[TEST_ARR_SIZE];
 };
 
+/*
+ * Records the value category of the constructor argument.
+ */
+class bar {
+public:
+	bar(int &val) : category(1), val(val) {
+	}
+
+	bar(int &&val) : category(2), val(val) {
+	}
+
+	bar(std::unique_ptr<int> &&val) : category(3), val(*val) {
+		val.reset();
+	}
+
+	p<int> category;
+	p<int> val;
+};
+
 struct root {
 	persistent_ptr<foo> pfoo;
+	persistent_ptr<bar> pbar;
+	persistent_ptr<int> pint;
 };
 
 /*
@@ -138,6 +162,57 @@ test_make_args(pool<struct root> &pop)
 	UT_ASSERT(r->pfoo == nullptr);
 }
 
+/*
+ * test_make_forward -- (internal) test make_persistent argument forwarding
+ */
+void
+test_make_forward(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		int lval = 5;
+		r->pbar = make_persistent<bar>(lval);
+		UT_ASSERTeq(r->pbar->category, 1);
+		UT_ASSERTeq(r->pbar->val, 5);
+		delete_persistent<bar>(r->pbar);
+
+		r->pbar = make_persistent<bar>(6);
+		UT_ASSERTeq(r->pbar->category, 2);
+		UT_ASSERTeq(r->pbar->val, 6);
+		delete_persistent<bar>(r->pbar);
+
+		std::unique_ptr<int> uval(new int(7));
+		r->pbar = make_persistent<bar>(std::move(uval));
+		UT_ASSERTeq(r->pbar->category, 3);
+		UT_ASSERTeq(r->pbar->val, 7);
+		UT_ASSERT(uval == nullptr);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->pbar->category, 3);
+	UT_ASSERTeq(r->pbar->val, 7);
+
+	/* writes to a fresh object are not logged, but the object is freed */
+	TX_BEGIN(pop.get_handle()) {
+		r->pint = make_persistent<int>();
+		UT_ASSERTeq(*r->pint, 0);
+		*r->pint = 8;
+		r->pbar->val = 8;
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERT(r->pint == nullptr);
+	UT_ASSERTeq(r->pbar->val, 7);
+
+	TX_BEGIN(pop.get_handle()) {
+		delete_persistent<bar>(r->pbar);
+	} TX_END
+
+	UT_ASSERT(r->pbar == nullptr);
+}
+
 /*
  * test_additional_delete -- (internal) test double delete and delete rollback
  */
@@ -197,6 +272,7 @@ main(int argc, char *argv[])
 
 	test_make_no_args(pop);
 	test_make_args(pop);
+	test_make_forward(pop);
 	test_additional_delete(pop);
 
 	pop.close();
@@ -41,6 +41,8 @@
 #include <libpmemobj/pool.hpp>
 #include <libpmemobj/make_persistent_array.hpp>
 
+#include <stdexcept>
+
 #define LAYOUT "cpp"
 
 using namespace nvml::obj;
@@ -152,6 +154,77 @@ test_make_two_d(pool_base &pop)
 	} TX_END
 }
 
+/*
+ * test_make_trivial -- (internal) test make_persistent of a trivial array
+ */
+void
+test_make_trivial(pool_base &pop)
+{
+	TX_BEGIN(pop.get_handle()) {
+		auto pint = make_persistent<int[]>(100);
+		for (int i = 0; i < 100; ++i) {
+			UT_ASSERTeq(pint[i], 0);
+			pint[i] = i + 1;
+		}
+		delete_persistent<int[]>(pint, 100);
+
+		/* reuses the memory of the previous array */
+		pint = make_persistent<int[]>(100);
+		for (int i = 0; i < 100; ++i)
+			UT_ASSERTeq(pint[i], 0);
+		delete_persistent<int[]>(pint, 100);
+
+		auto pintN = make_persistent<int[10][10]>();
+		for (int i = 0; i < 10; ++i)
+			for (int j = 0; j < 10; ++j)
+				UT_ASSERTeq(pintN[i][j], 0);
+		delete_persistent<int[10][10]>(pintN);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int constructed;
+
+/*
+ * Throws from the constructor of the third element.
+ */
+struct thrower {
+	thrower() {
+		if (constructed == 2)
+			throw std::runtime_error("thrower");
+		constructed++;
+	}
+
+	~thrower() {
+		constructed--;
+	}
+
+	p<int> val;
+};
+
+/*
+ * test_constructor_exception -- (internal) test array construction failure
+ */
+void
+test_constructor_exception(pool_base &pop)
+{
+	bool thrown = false;
+
+	TX_BEGIN(pop.get_handle()) {
+		try {
+			make_persistent<thrower[]>(5);
+		} catch (std::runtime_error &) {
+			thrown = true;
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(thrown);
+	UT_ASSERTeq(constructed, 0);
+}
+
 /*
  * test_abort_revert -- (internal) test destruction behavior and revert
  */
@@ -208,6 +281,8 @@ main(int argc, char *argv[])
 
 	test_make_one_d(pop);
 	test_make_two_d(pop);
+	test_make_trivial(pop);
+	test_constructor_exception(pop);
 	test_abort_revert(pop);
 
 	pop.close();
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_self_relative_ptr.cpp -- cpp self_relative_ptr test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj/make_persistent.hpp>
+#include <libpmemobj/p.hpp>
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/pool.hpp>
+#include <libpmemobj/self_relative_ptr.hpp>
+#include <libpmemobj/transaction.hpp>
+
+#define LAYOUT "cpp"
+
+using namespace nvml::obj;
+
+namespace {
+
+const int NODES = 10;
+
+struct node {
+	p<int> val;
+	self_relative_ptr<node> next;
+};
+
+struct root {
+	self_relative_ptr<node> head;
+	persistent_ptr<node> first;
+};
+
+/*
+ * test_basic -- (internal) test conversions and comparisons
+ */
+void
+test_basic(pool<struct root> &pop)
+{
+	static_assert(sizeof(self_relative_ptr<node>) == sizeof(uint64_t),
+		"self_relative_ptr is not compact");
+
+	persistent_ptr<root> r = pop.get_root();
+
+	UT_ASSERT(r->head == nullptr);
+	UT_ASSERT(r->head.get() == nullptr);
+	UT_ASSERT(OID_IS_NULL(r->head.raw()));
+
+	transaction::exec_tx(pop, [&] {
+		r->first = make_persistent<node>();
+		r->first->val = 1;
+		r->head = r->first;
+	});
+
+	UT_ASSERT(r->head != nullptr);
+	UT_ASSERT(r->head.get() == r->first.get());
+	UT_ASSERT(OID_EQUALS(r->head.raw(), r->first.raw()));
+	UT_ASSERT(persistent_ptr<node>(r->head) == r->first);
+	UT_ASSERTeq(r->head->val, 1);
+	UT_ASSERTeq((*r->head).val, 1);
+
+	/* a copy recomputes the distance for its own location */
+	self_relative_ptr<node> copy = r->head;
+	UT_ASSERT(copy == r->head);
+	UT_ASSERTeq(copy->val, 1);
+
+	/* a pointer may point to the object it is embedded in */
+	transaction::exec_tx(pop, [&] {
+		r->first->next = self_relative_ptr<node>(r->first.get());
+	});
+	UT_ASSERT(r->first->next.get() == r->first.get());
+	UT_ASSERT(r->first->next->next->next == r->head);
+
+	transaction::exec_tx(pop, [&] {
+		r->first->next = nullptr;
+		delete_persistent<node>(r->first);
+		r->head = nullptr;
+	});
+
+	UT_ASSERT(r->head == nullptr);
+	UT_ASSERT(r->first == nullptr);
+}
+
+/*
+ * test_list -- (internal) build a list, abort a modification of it
+ */
+void
+test_list(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	transaction::exec_tx(pop, [&] {
+		for (int i = 0; i < NODES; ++i) {
+			persistent_ptr<node> n = make_persistent<node>();
+			n->val = i;
+			n->next = r->head;
+			r->head = n;
+		}
+	});
+
+	try {
+		transaction::exec_tx(pop, [&] {
+			r->head = r->head->next;
+			r->head->next = nullptr;
+			transaction::abort(EINVAL);
+		});
+	} catch (nvml::manual_tx_abort &) {
+	}
+
+	int i = NODES;
+	for (node *n = r->head.get(); n != nullptr; n = n->next.get())
+		UT_ASSERTeq(n->val, --i);
+	UT_ASSERTeq(i, 0);
+}
+
+/*
+ * test_reopen -- (internal) check the list is intact at a new address
+ */
+void
+test_reopen(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	int i = NODES;
+	for (node *n = r->head.get(); n != nullptr; n = n->next.get()) {
+		UT_ASSERTeq(pmemobj_pool_by_ptr(n), pop.get_handle());
+		UT_ASSERTeq(n->val, --i);
+	}
+	UT_ASSERTeq(i, 0);
+}
+
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_self_relative_ptr");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pool<struct root> pop;
+
+	try {
+		pop = pool<struct root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_basic(pop);
+	test_list(pop);
+
+	pop.close();
+
+	try {
+		pop = pool<struct root>::open(path, LAYOUT);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	test_reopen(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_snapshot.cpp -- cpp transaction snapshot test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/p.hpp>
+#include <libpmemobj/pool.hpp>
+#include <libpmemobj/transaction.hpp>
+
+#define LAYOUT "cpp"
+
+using namespace nvml::obj;
+
+namespace {
+
+const int NFIELDS = 20;
+
+struct foo {
+	p<int> fields[NFIELDS];
+	p<char> small[NFIELDS];
+};
+
+struct root {
+	foo f;
+	foo arr[4];
+};
+
+/*
+ * set_foo -- (internal) assign val to every field of f
+ */
+void
+set_foo(foo &f, int val)
+{
+	for (int i = 0; i < NFIELDS; ++i) {
+		f.fields[i] = val;
+		f.small[i] = (char)val;
+	}
+}
+
+/*
+ * check_foo -- (internal) check every field of f is equal to val
+ */
+void
+check_foo(foo &f, int val)
+{
+	for (int i = 0; i < NFIELDS; ++i) {
+		UT_ASSERTeq(f.fields[i], val);
+		UT_ASSERTeq(f.small[i], (char)val);
+	}
+}
+
+/*
+ * test_tx_id -- (internal) test transaction identifiers
+ */
+void
+test_tx_id(pool<struct root> &pop)
+{
+	uint64_t id1 = 0;
+	uint64_t id2 = 0;
+
+	UT_ASSERTeq(pmemobj_tx_id(), 0);
+
+	TX_BEGIN(pop.get_handle()) {
+		id1 = pmemobj_tx_id();
+		UT_ASSERTne(id1, 0);
+
+		TX_BEGIN(pop.get_handle()) {
+			UT_ASSERTeq(pmemobj_tx_id(), id1);
+		} TX_END
+
+		UT_ASSERTeq(pmemobj_tx_id(), id1);
+	} TX_ONCOMMIT {
+		UT_ASSERTeq(pmemobj_tx_id(), 0);
+	} TX_END
+
+	TX_BEGIN(pop.get_handle()) {
+		id2 = pmemobj_tx_id();
+	} TX_END
+
+	UT_ASSERTne(id2, 0);
+	UT_ASSERTne(id1, id2);
+}
+
+/*
+ * test_field_writes -- (internal) test rollback of field writes, also
+ * across consecutive transactions
+ */
+void
+test_field_writes(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		set_foo(r->f, 1);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_foo(r->f, 1);
+
+	/* the fields are already known to the filter, but not to this tx */
+	TX_BEGIN(pop.get_handle()) {
+		set_foo(r->f, 2);
+		set_foo(r->f, 3);
+		check_foo(r->f, 3);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	check_foo(r->f, 1);
+
+	/* writes in the reverse order */
+	TX_BEGIN(pop.get_handle()) {
+		for (int i = NFIELDS - 1; i >= 0; --i)
+			r->f.fields[i] = 4;
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	check_foo(r->f, 1);
+}
+
+/*
+ * test_snapshot -- (internal) test transaction::snapshot
+ */
+void
+test_snapshot(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	try {
+		transaction::snapshot(&r->f);
+		UT_ASSERT(0);
+	} catch (nvml::transaction_error &) {
+	}
+
+	TX_BEGIN(pop.get_handle()) {
+		transaction::snapshot(&r->f);
+		set_foo(r->f, 5);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	check_foo(r->f, 1);
+
+	TX_BEGIN(pop.get_handle()) {
+		transaction::snapshot(r->arr, 4);
+
+		TX_BEGIN(pop.get_handle()) {
+			for (int i = 0; i < 4; ++i)
+				set_foo(r->arr[i], 6);
+		} TX_END
+
+		for (int i = 0; i < 4; ++i)
+			check_foo(r->arr[i], 6);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	for (int i = 0; i < 4; ++i)
+		check_foo(r->arr[i], 0);
+
+	TX_BEGIN(pop.get_handle()) {
+		transaction::snapshot(&r->f);
+		set_foo(r->f, 7);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_foo(r->f, 7);
+}
+
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_snapshot");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pool<struct root> pop;
+
+	try {
+		pop = pool<struct root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_tx_id(pop);
+	test_field_writes(pop);
+	test_snapshot(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
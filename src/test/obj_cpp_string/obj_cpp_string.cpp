@@ -0,0 +1,182 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_string.cpp -- cpp persistent string test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/pool.hpp>
+#include <libpmemobj/make_persistent.hpp>
+#include <libpmemobj/string.hpp>
+
+#define LAYOUT "cpp"
+
+using namespace nvml::obj;
+
+namespace {
+
+struct root {
+	string str;
+	persistent_ptr<string> pstr;
+};
+
+/*
+ * test_assign -- (internal) test assigning and appending
+ */
+void
+test_assign(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	UT_ASSERT(r->str.empty());
+	UT_ASSERT(r->str == "");
+
+	TX_BEGIN(pop.get_handle()) {
+		r->str = "abc";
+		r->str.append("def");
+		r->str += 'g';
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->str == "abcdefg");
+	UT_ASSERTeq(r->str.size(), 7);
+	UT_ASSERTeq(r->str.find('d'), 3);
+	UT_ASSERTeq(r->str.find('x'), string::npos);
+
+	TX_BEGIN(pop.get_handle()) {
+		for (int i = 0; i < 100; ++i)
+			r->str += "0123456789";
+		r->str[0] = 'A';
+		UT_ASSERTeq(r->str.size(), 1007);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERT(r->str == "abcdefg");
+	UT_ASSERT(r->str.str() == std::string("abcdefg"));
+
+	/* the old contents overwritten by a reassignment are rolled back */
+	TX_BEGIN(pop.get_handle()) {
+		r->str = "XYZ";
+		UT_ASSERT(r->str == "XYZ");
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERT(r->str == "abcdefg");
+	UT_ASSERTeq(r->str.size(), 7);
+
+	TX_BEGIN(pop.get_handle()) {
+		r->str.clear();
+		r->str += "uvw";
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERT(r->str == "abcdefg");
+
+	TX_BEGIN(pop.get_handle()) {
+		r->str.clear();
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->str.empty());
+	UT_ASSERTeq(strlen(r->str.c_str()), 0);
+}
+
+/*
+ * test_compare -- (internal) test comparing strings allocated with
+ * make_persistent
+ */
+void
+test_compare(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->str = std::string("persistent");
+		r->pstr = make_persistent<string>("persistent");
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->str == *r->pstr);
+
+	TX_BEGIN(pop.get_handle()) {
+		r->pstr->assign("memory");
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->str != *r->pstr);
+	UT_ASSERT(*r->pstr < r->str);
+	UT_ASSERT(*r->pstr == "memory");
+
+	TX_BEGIN(pop.get_handle()) {
+		delete_persistent<string>(r->pstr);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->pstr == nullptr);
+}
+
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_string");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pool<struct root> pop;
+
+	try {
+		pop = pool<struct root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_assign(pop);
+	test_compare(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
@@ -562,6 +562,75 @@ test_tx_no_throw_abort_scope(pool<root> &pop)
 	UT_ASSERT(rootp->parr == nullptr);
 }
 
+/*
+ * test_tx_read_only_scope -- test read-only transaction
+ */
+void
+test_tx_read_only_scope(pool<root> &pop)
+{
+	auto rootp = pop.get_root();
+
+	UT_ASSERT(rootp->pfoo == nullptr);
+
+	try {
+		transaction::manual to(pop);
+		rootp->pfoo = make_persistent<foo>();
+		rootp->pfoo->bar = 42;
+		transaction::commit();
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	try {
+		transaction::read_only to(pop, rootp->mtx, rootp->pfoo->smtx);
+		UT_ASSERTeq(rootp->pfoo->bar, 42);
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERTeq(transaction::get_last_tx_error(), 0);
+
+	bool exception_thrown = false;
+	try {
+		transaction::read_only to(pop, rootp->mtx);
+		rootp->pfoo->bar = 1;
+		UT_ASSERT(0);
+	} catch (nvml::transaction_error &) {
+		exception_thrown = true;
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(exception_thrown);
+	UT_ASSERTeq(transaction::get_last_tx_error(), EPERM);
+	UT_ASSERTeq(rootp->pfoo->bar, 42);
+
+	exception_thrown = false;
+	try {
+		transaction::read_only to(pop);
+		delete_persistent<foo>(rootp->pfoo);
+		UT_ASSERT(0);
+	} catch (nvml::transaction_error &) {
+		exception_thrown = true;
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(exception_thrown);
+	UT_ASSERT(rootp->pfoo != nullptr);
+
+	try {
+		transaction::manual to(pop);
+		delete_persistent<foo>(rootp->pfoo);
+		rootp->pfoo = nullptr;
+		transaction::commit();
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(rootp->pfoo == nullptr);
+}
+
 }
 
 int
@@ -595,6 +664,8 @@ main(int argc, char *argv[])
 	test_tx_throw_no_abort_scope<transaction::automatic>(pop);
 	test_tx_no_throw_abort_scope<transaction::automatic>(pop);
 
+	test_tx_read_only_scope(pop);
+
 	pop.close();
 
 	DONE(NULL);
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_unordered_map.cpp -- cpp persistent concurrent hash map test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/pool.hpp>
+#include <libpmemobj/make_persistent.hpp>
+#include <libpmemobj/unordered_map.hpp>
+
+#include <chrono>
+#include <thread>
+
+#define LAYOUT "cpp"
+
+using namespace nvml::obj;
+
+namespace {
+
+typedef unordered_map<uint64_t, uint64_t> map_type;
+
+struct root {
+	map_type map;
+	persistent_ptr<map_type> pmap;
+};
+
+/* number of keys per thread */
+const uint64_t num_ops = 1000;
+
+/* the number of threads */
+const int num_threads = 8;
+
+/*
+ * test_basic -- (internal) test single-threaded operations
+ */
+void
+test_basic(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+	map_type &map = r->map;
+	uint64_t val;
+
+	UT_ASSERT(map.empty());
+	UT_ASSERT(!map.find(1, val));
+	UT_ASSERTeq(map.erase(1), 0);
+
+	UT_ASSERT(map.insert(1, 10));
+	UT_ASSERT(!map.insert(1, 11));
+	UT_ASSERT(map.find(1, val));
+	UT_ASSERTeq(val, 10);
+
+	UT_ASSERT(!map.insert_or_assign(1, 12));
+	UT_ASSERT(map.find(1, val));
+	UT_ASSERTeq(val, 12);
+	UT_ASSERTeq(map.bucket_count(), 1);
+
+	for (uint64_t i = 2; i <= num_ops; ++i)
+		UT_ASSERT(map.insert(i, i * 10));
+
+	UT_ASSERTeq(map.size(), num_ops);
+	UT_ASSERT(map.load_factor() <= 1.0f);
+
+	uint64_t sum = 0;
+	map.for_each([&](const uint64_t &k, const uint64_t &v) {
+		UT_ASSERTeq(v, k == 1 ? 12 : k * 10);
+		sum += k;
+	});
+	UT_ASSERTeq(sum, num_ops * (num_ops + 1) / 2);
+
+	/* changes within an outer transaction are rolled back */
+	TX_BEGIN(pop.get_handle()) {
+		UT_ASSERTeq(map.erase(2), 1);
+		UT_ASSERT(map.insert(num_ops + 1, 0));
+		UT_ASSERTeq(map.count(2), 0);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(map.size(), num_ops);
+	UT_ASSERTeq(map.count(2), 1);
+	UT_ASSERTeq(map.count(num_ops + 1), 0);
+
+	for (uint64_t i = 1; i <= num_ops; i += 2)
+		UT_ASSERTeq(map.erase(i), 1);
+
+	UT_ASSERTeq(map.size(), num_ops / 2);
+
+	map.clear();
+	UT_ASSERT(map.empty());
+	UT_ASSERTeq(map.bucket_count(), 0);
+}
+
+/*
+ * worker -- (internal) insert, look up and remove a disjoint set of keys
+ */
+void
+worker(persistent_ptr<map_type> map, uint64_t id)
+{
+	uint64_t val;
+
+	for (uint64_t i = 0; i < num_ops; ++i)
+		UT_ASSERT(map->insert(i * num_threads + id, id));
+
+	for (uint64_t i = 0; i < num_ops; ++i) {
+		UT_ASSERT(map->find(i * num_threads + id, val));
+		UT_ASSERTeq(val, id);
+	}
+
+	for (uint64_t i = 0; i < num_ops; i += 2)
+		UT_ASSERTeq(map->erase(i * num_threads + id), 1);
+}
+
+/*
+ * test_mt -- (internal) test concurrent operations
+ */
+void
+test_mt(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->pmap = make_persistent<map_type>();
+		r->pmap->rehash(128);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->pmap->bucket_count(), 128);
+
+	std::thread threads[num_threads];
+	for (int i = 0; i < num_threads; ++i)
+		threads[i] = std::thread(worker, r->pmap, i);
+
+	for (int i = 0; i < num_threads; ++i)
+		threads[i].join();
+
+	UT_ASSERTeq(r->pmap->size(), num_threads * num_ops / 2);
+
+	uint64_t val;
+	for (uint64_t k = 0; k < num_threads * num_ops; ++k) {
+		bool removed = (k / num_threads) % 2 == 0;
+		UT_ASSERTeq(r->pmap->find(k, val), !removed);
+	}
+
+	TX_BEGIN(pop.get_handle()) {
+		delete_persistent<map_type>(r->pmap);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * grow_worker -- (internal) insert a disjoint set of keys outside of
+ * a transaction
+ */
+void
+grow_worker(persistent_ptr<map_type> map, uint64_t id)
+{
+	for (uint64_t i = 0; i < num_ops; ++i)
+		UT_ASSERT(map->insert(i * num_threads + id, id));
+}
+
+/*
+ * test_grow_tx -- (internal) test growing the map while a transaction
+ * holds some of the stripes
+ */
+void
+test_grow_tx(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->pmap = make_persistent<map_type>();
+		r->pmap->rehash(map_type::stripes);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	const uint64_t first_tx_key = num_threads * num_ops;
+	const uint64_t ntx_keys = 2 * map_type::stripes;
+	std::thread threads[num_threads];
+
+	TX_BEGIN(pop.get_handle()) {
+		/* the stripe of this key stays locked until the commit */
+		UT_ASSERT(r->pmap->insert(first_tx_key, 0));
+
+		for (int i = 0; i < num_threads; ++i)
+			threads[i] = std::thread(grow_worker, r->pmap, i);
+
+		/*
+		 * Let the workers grow the map, they eventually block on
+		 * the stripe held by this transaction.
+		 */
+		for (int i = 0; i < 10000; ++i) {
+			if (r->pmap->bucket_count() > 2 * map_type::stripes)
+				break;
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(1));
+		}
+
+		/* lock more stripes, some of them held by the workers */
+		for (uint64_t k = 1; k < ntx_keys; ++k)
+			UT_ASSERT(r->pmap->insert(first_tx_key + k, k));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (int i = 0; i < num_threads; ++i)
+		threads[i].join();
+
+	UT_ASSERTeq(r->pmap->size(), first_tx_key + ntx_keys);
+	UT_ASSERT(r->pmap->load_factor() <= 1.0f);
+
+	for (uint64_t k = 0; k < first_tx_key + ntx_keys; ++k)
+		UT_ASSERTeq(r->pmap->count(k), 1);
+
+	TX_BEGIN(pop.get_handle()) {
+		delete_persistent<map_type>(r->pmap);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_unordered_map");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pool<struct root> pop;
+
+	try {
+		pop = pool<struct root>::create(path, LAYOUT,
+			PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_basic(pop);
+	test_mt(pop);
+	test_grow_tx(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
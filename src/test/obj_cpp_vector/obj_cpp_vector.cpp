@@ -0,0 +1,266 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_vector.cpp -- cpp persistent vector test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj/persistent_ptr.hpp>
+#include <libpmemobj/p.hpp>
+#include <libpmemobj/pool.hpp>
+#include <libpmemobj/make_persistent.hpp>
+#include <libpmemobj/vector.hpp>
+
+#define LAYOUT "cpp"
+
+using namespace nvml::obj;
+
+namespace {
+
+const int TEST_ELEMS = 1000;
+
+struct foo {
+	foo(int v) : bar(v), baz(v * 2)
+	{
+	}
+
+	p<int> bar;
+	p<int> baz;
+};
+
+struct root {
+	vector<int> ints;
+	persistent_ptr<vector<foo>> pfoos;
+};
+
+/*
+ * test_push_back -- (internal) test appending to a zeroed vector
+ */
+void
+test_push_back(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	UT_ASSERT(r->ints.empty());
+	UT_ASSERTeq(r->ints.capacity(), 0);
+
+	TX_BEGIN(pop.get_handle()) {
+		for (int i = 0; i < TEST_ELEMS; ++i)
+			r->ints.push_back(i);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->ints.size(), TEST_ELEMS);
+	UT_ASSERT(r->ints.capacity() >= TEST_ELEMS);
+	UT_ASSERT(r->ints.capacity() < 2 * TEST_ELEMS);
+
+	int i = 0;
+	for (auto it = r->ints.begin(); it != r->ints.end(); ++it)
+		UT_ASSERTeq(*it, i++);
+
+	/* the growth and the appends are rolled back */
+	size_t cap = r->ints.capacity();
+	TX_BEGIN(pop.get_handle()) {
+		for (int i = 0; i < TEST_ELEMS; ++i)
+			r->ints.push_back(-i);
+		UT_ASSERTeq(r->ints.size(), 2 * TEST_ELEMS);
+		UT_ASSERT(r->ints.capacity() > cap);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(r->ints.size(), TEST_ELEMS);
+	UT_ASSERTeq(r->ints.capacity(), cap);
+	for (int i = 0; i < TEST_ELEMS; ++i)
+		UT_ASSERTeq(r->ints[i], i);
+}
+
+/*
+ * test_reuse_abort -- (internal) test the slots of the elements removed in
+ * a transaction and reused by it are restored on abort
+ */
+void
+test_reuse_abort(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints.pop_back();
+		r->ints.push_back(99);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints.clear();
+		for (int i = 0; i < 10; ++i)
+			r->ints.push_back(-i);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints.resize(10);
+		r->ints.resize(20, 7);
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(r->ints.size(), TEST_ELEMS);
+	for (int i = 0; i < TEST_ELEMS; ++i)
+		UT_ASSERTeq(r->ints[i], i);
+}
+
+/*
+ * test_modify -- (internal) test element and range modifications
+ */
+void
+test_modify(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints[0] = 100;
+		r->ints.at(1) = 101;
+
+		int *range = r->ints.range(10, 10);
+		for (int i = 0; i < 10; ++i)
+			range[i] = 0;
+
+		r->ints.pop_back();
+		pmemobj_tx_abort(EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(r->ints.size(), TEST_ELEMS);
+	for (int i = 0; i < TEST_ELEMS; ++i)
+		UT_ASSERTeq(r->ints[i], i);
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints.front() = 100;
+		r->ints.back() = 101;
+		r->ints.resize(10);
+		r->ints.resize(20, 7);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->ints.size(), 20);
+	UT_ASSERTeq(r->ints[0], 100);
+	UT_ASSERTeq(r->ints[9], 9);
+	UT_ASSERTeq(r->ints[10], 7);
+	UT_ASSERTeq(r->ints[19], 7);
+
+	try {
+		r->ints.at(20);
+		UT_ASSERT(0);
+	} catch (std::out_of_range &) {
+	}
+
+	try {
+		r->ints.push_back(1);
+		UT_ASSERT(0);
+	} catch (nvml::transaction_scope_error &) {
+	}
+
+	TX_BEGIN(pop.get_handle()) {
+		r->ints.clear();
+		r->ints.shrink_to_fit();
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->ints.empty());
+	UT_ASSERTeq(r->ints.capacity(), 0);
+}
+
+/*
+ * test_objects -- (internal) test a vector of objects allocated with
+ * make_persistent
+ */
+void
+test_objects(pool<struct root> &pop)
+{
+	persistent_ptr<root> r = pop.get_root();
+
+	TX_BEGIN(pop.get_handle()) {
+		r->pfoos = make_persistent<vector<foo>>();
+		r->pfoos->reserve(TEST_ELEMS);
+		for (int i = 0; i < TEST_ELEMS; ++i)
+			r->pfoos->emplace_back(i);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->pfoos->capacity(), TEST_ELEMS);
+	for (int i = 0; i < TEST_ELEMS; ++i) {
+		UT_ASSERTeq((*r->pfoos)[i].bar, i);
+		UT_ASSERTeq((*r->pfoos)[i].baz, 2 * i);
+	}
+
+	TX_BEGIN(pop.get_handle()) {
+		delete_persistent<vector<foo>>(r->pfoos);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(r->pfoos == nullptr);
+}
+
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_vector");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pool<struct root> pop;
+
+	try {
+		pop = pool<struct root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_push_back(pop);
+	test_reuse_abort(pop);
+	test_modify(pop);
+	test_objects(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
@@ -158,6 +158,51 @@ test_ctree_remove()
 	ctree_delete(t);
 }
 
+static void
+test_ctree_find_ge()
+{
+	struct ctree *t = ctree_new();
+	UT_ASSERT(t != NULL);
+
+	/* search empty tree */
+	uint64_t k = TEST_VAL_A;
+	UT_ASSERT(ctree_find_ge(t, &k) == 0);
+	UT_ASSERTeq(k, 0);
+
+	static const uint64_t keys[] = {
+		3, 4, 7, 64, 65, 128, 1000, 1ULL << 40, UINT64_MAX - 1
+	};
+	const int nkeys = sizeof (keys) / sizeof (keys[0]);
+
+	/* insert in a scrambled order */
+	for (int i = 0; i < nkeys; ++i) {
+		uint64_t key = keys[(i * 4) % nkeys];
+		UT_ASSERT(ctree_insert(t, key, key) == 0);
+	}
+
+	/* every query has to return the smallest key not less than it */
+	uint64_t queries[] = {
+		0, 1, 3, 5, 8, 63, 66, 129, 999, 1001, 1ULL << 39,
+		(1ULL << 40) + 1, UINT64_MAX - 1, UINT64_MAX
+	};
+	for (unsigned q = 0; q < sizeof (queries) / sizeof (queries[0]);
+			++q) {
+		uint64_t expected = 0;
+		for (int i = 0; i < nkeys; ++i) {
+			if (keys[i] >= queries[q]) {
+				expected = keys[i];
+				break;
+			}
+		}
+
+		k = queries[q];
+		UT_ASSERTeq(ctree_find_ge(t, &k), expected);
+		UT_ASSERTeq(k, expected);
+	}
+
+	ctree_delete(t);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -167,6 +212,7 @@ main(int argc, char *argv[])
 	test_ctree_insert();
 	test_ctree_find();
 	test_ctree_remove();
+	test_ctree_find_ge();
 
 	DONE(NULL);
 }
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cursor.c -- unit test for pmemobj_cursor_* and pmemobj_foreach_parallel
+ */
+
+#include "libpmemobj.h"
+#include "unittest.h"
+
+#define	LAYOUT_NAME "obj_cursor"
+
+/* large enough for the heap to be divided into many parts */
+#define	POOL_SIZE (256 * 1024 * 1024)
+
+#define	TYPE_SMALL 1
+#define	TYPE_MEDIUM 2
+#define	TYPE_HUGE 3
+#define	TYPE_FREED 4
+
+#define	NSMALL 3000
+#define	NMEDIUM 500
+#define	NHUGE 40
+
+#define	NTHREADS 4
+
+struct object {
+	uint64_t visits;
+};
+
+/*
+ * alloc_objects -- (internal) allocates objects of the given type and size,
+ * interleaved with objects that are freed right away
+ */
+static void
+alloc_objects(PMEMobjpool *pop, int n, uint64_t type_num, size_t size)
+{
+	for (int i = 0; i < n; ++i) {
+		PMEMoid oid;
+		int ret = pmemobj_zalloc(pop, &oid, size, type_num);
+		UT_ASSERTeq(ret, 0);
+
+		if (i % 3 == 0) {
+			ret = pmemobj_zalloc(pop, &oid, size, TYPE_FREED);
+			UT_ASSERTeq(ret, 0);
+			pmemobj_free(&oid);
+		}
+	}
+}
+
+/*
+ * test_cursor -- verifies that the cursor visits the same objects, in the
+ * same order, as pmemobj_first and pmemobj_next
+ */
+static void
+test_cursor(PMEMobjpool *pop)
+{
+	PMEMobjcursor *cur = pmemobj_cursor_open(pop, POBJ_ANY_TYPE_NUM);
+	UT_ASSERTne(cur, NULL);
+
+	size_t n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		PMEMoid next = pmemobj_cursor_next(cur);
+		UT_ASSERT(OID_EQUALS(oid, next));
+		n++;
+	}
+	UT_ASSERT(OID_IS_NULL(pmemobj_cursor_next(cur)));
+	UT_ASSERT(OID_IS_NULL(pmemobj_cursor_next(cur)));
+	UT_ASSERTeq(n, NSMALL + NMEDIUM + NHUGE);
+
+	pmemobj_cursor_close(cur);
+
+	uint64_t types[] = {TYPE_SMALL, TYPE_MEDIUM, TYPE_HUGE, TYPE_FREED};
+	for (unsigned i = 0; i < sizeof (types) / sizeof (types[0]); ++i) {
+		cur = pmemobj_cursor_open(pop, types[i]);
+		UT_ASSERTne(cur, NULL);
+
+		PMEMoid typed = pmemobj_first_type_num(pop, types[i]);
+		while (!OID_IS_NULL(typed)) {
+			PMEMoid next = pmemobj_cursor_next(cur);
+			UT_ASSERT(OID_EQUALS(typed, next));
+			typed = pmemobj_next_type_num(typed);
+		}
+		UT_ASSERT(OID_IS_NULL(pmemobj_cursor_next(cur)));
+
+		pmemobj_cursor_close(cur);
+	}
+}
+
+/*
+ * visit -- (internal) counts the visits of the object
+ */
+static int
+visit(PMEMoid oid, void *arg)
+{
+	struct object *obj = pmemobj_direct(oid);
+	__sync_fetch_and_add(&obj->visits, 1);
+	__sync_fetch_and_add((uint64_t *)arg, 1);
+
+	return 0;
+}
+
+/*
+ * stop -- (internal) stops the iteration at the first object
+ */
+static int
+stop(PMEMoid oid, void *arg)
+{
+	__sync_fetch_and_add((uint64_t *)arg, 1);
+
+	return 7;
+}
+
+/*
+ * check_visits -- (internal) verifies that every object of the type has been
+ * visited the expected number of times
+ */
+static void
+check_visits(PMEMobjpool *pop, uint64_t type_num, uint64_t expected)
+{
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		struct object *obj = pmemobj_direct(oid);
+		if (type_num == POBJ_ANY_TYPE_NUM ||
+				pmemobj_type_num(oid) == type_num)
+			UT_ASSERTeq(obj->visits, expected);
+		else
+			UT_ASSERTeq(obj->visits, 0);
+
+		obj->visits = 0;
+	}
+}
+
+/*
+ * test_foreach_parallel -- verifies that every object is visited exactly once
+ */
+static void
+test_foreach_parallel(PMEMobjpool *pop)
+{
+	for (unsigned nthreads = 1; nthreads <= NTHREADS; nthreads *= 2) {
+		uint64_t count = 0;
+		int ret = pmemobj_foreach_parallel(pop, POBJ_ANY_TYPE_NUM,
+			visit, &count, nthreads);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(count, NSMALL + NMEDIUM + NHUGE);
+		check_visits(pop, POBJ_ANY_TYPE_NUM, 1);
+
+		count = 0;
+		ret = pmemobj_foreach_parallel(pop, TYPE_HUGE, visit, &count,
+			nthreads);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(count, NHUGE);
+		check_visits(pop, TYPE_HUGE, 1);
+
+		count = 0;
+		ret = pmemobj_foreach_parallel(pop, POBJ_ANY_TYPE_NUM, stop,
+			&count, nthreads);
+		UT_ASSERTeq(ret, 7);
+		UT_ASSERT(count >= 1 && count <= nthreads);
+	}
+
+	int ret = pmemobj_foreach_parallel(pop, POBJ_ANY_TYPE_NUM, visit, NULL,
+		0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_cursor_free -- frees the objects returned by the cursor
+ */
+static void
+test_cursor_free(PMEMobjpool *pop)
+{
+	PMEMobjcursor *cur = pmemobj_cursor_open(pop, TYPE_SMALL);
+	UT_ASSERTne(cur, NULL);
+
+	size_t n = 0;
+	PMEMoid oid;
+	while (!OID_IS_NULL(oid = pmemobj_cursor_next(cur))) {
+		pmemobj_free(&oid);
+		n++;
+	}
+	UT_ASSERTeq(n, NSMALL);
+
+	pmemobj_cursor_close(cur);
+
+	UT_ASSERT(OID_IS_NULL(pmemobj_first_type_num(pop, TYPE_SMALL)));
+	UT_ASSERT(!OID_IS_NULL(pmemobj_first_type_num(pop, TYPE_MEDIUM)));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cursor");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* empty pool */
+	PMEMobjcursor *cur = pmemobj_cursor_open(pop, POBJ_ANY_TYPE_NUM);
+	UT_ASSERTne(cur, NULL);
+	UT_ASSERT(OID_IS_NULL(pmemobj_cursor_next(cur)));
+	pmemobj_cursor_close(cur);
+
+	alloc_objects(pop, NSMALL, TYPE_SMALL, 64);
+	alloc_objects(pop, NMEDIUM, TYPE_MEDIUM, 4096);
+	alloc_objects(pop, NHUGE, TYPE_HUGE, 4 * 1024 * 1024);
+
+	test_cursor(pop);
+	test_foreach_parallel(pop);
+	test_cursor_free(pop);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -289,6 +289,114 @@ test_internal_object_mask(PMEMobjpool *pop)
 	}
 }
 
+/*
+ * check_type -- (internal) verifies that the typed iteration returns the same
+ * objects, in the same order, as filtering all the objects by type
+ */
+static size_t
+check_type(PMEMobjpool *pop, uint64_t type_num)
+{
+	size_t n = 0;
+	PMEMoid typed = pmemobj_first_type_num(pop, type_num);
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) != type_num)
+			continue;
+
+		UT_ASSERT(OID_EQUALS(oid, typed));
+		typed = pmemobj_next_type_num(typed);
+		n++;
+	}
+
+	UT_ASSERT(OID_IS_NULL(typed));
+
+	return n;
+}
+
+#define	TEST_TYPES 3
+#define	TEST_OBJECTS 64
+
+/*
+ * test_type_index -- verifies the typed iteration while the set of objects
+ * changes in all the ways the allocator supports
+ */
+static void
+test_type_index(PMEMobjpool *pop)
+{
+	PMEMoid oids[TEST_OBJECTS];
+
+	size_t existing = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid)
+		existing++;
+
+	/* allocate objects of interleaved types before the first lookup */
+	for (int i = 0; i < TEST_OBJECTS / 2; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i], sizeof (struct type),
+			(uint64_t)(i % TEST_TYPES), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	for (uint64_t t = 0; t < TEST_TYPES; ++t)
+		check_type(pop, t);
+
+	/* and after it, so that the index is updated rather than built */
+	for (int i = TEST_OBJECTS / 2; i < TEST_OBJECTS; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i], sizeof (struct type),
+			(uint64_t)(i % TEST_TYPES), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	size_t total = 0;
+	for (uint64_t t = 0; t < TEST_TYPES; ++t)
+		total += check_type(pop, t);
+	UT_ASSERTeq(total, existing + TEST_OBJECTS);
+
+	/* free every other object using the safe typed iteration */
+	TOID(struct type) item, nitem;
+	int n = 0;
+	POBJ_FOREACH_SAFE_TYPE(pop, item, nitem) {
+		if (n++ % 2 == 0)
+			POBJ_FREE(&item);
+	}
+
+	/* reallocation that moves the object and changes its type */
+	TOID(struct type_sec) sec = POBJ_FIRST(pop, struct type_sec);
+	UT_ASSERT(!TOID_IS_NULL(sec));
+	int ret = pmemobj_realloc(pop, &sec.oid, 4096, TEST_TYPES);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_type_num(sec.oid), TEST_TYPES);
+	UT_ASSERTeq(check_type(pop, TEST_TYPES), 1);
+
+	/* transactional allocations are indexed only if committed */
+	PMEMoid committed = OID_NULL;
+	TX_BEGIN(pop) {
+		committed = pmemobj_tx_alloc(sizeof (struct type),
+			TEST_TYPES + 1);
+	} TX_END
+	UT_ASSERT(OID_EQUALS(pmemobj_first_type_num(pop, TEST_TYPES + 1),
+		committed));
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_alloc(sizeof (struct type), TEST_TYPES + 1);
+		pmemobj_tx_free(committed);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+	UT_ASSERTeq(check_type(pop, TEST_TYPES + 1), 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_free(committed);
+	} TX_END
+	UT_ASSERTeq(check_type(pop, TEST_TYPES + 1), 0);
+
+	/* types that were never allocated */
+	UT_ASSERT(OID_IS_NULL(pmemobj_first_type_num(pop, UINT64_MAX)));
+
+	for (uint64_t t = 0; t <= TEST_TYPES; ++t)
+		check_type(pop, t);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -330,6 +438,20 @@ main(int argc, char *argv[])
 
 	test_internal_object_mask(pop);
 
+	/* the index is volatile, it has to be rebuilt after reopening */
+	pmemobj_close(pop);
+	if ((pop = pmemobj_open(path, LAYOUT_NAME)) == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	test_type_index(pop);
+
+	pmemobj_close(pop);
+	if ((pop = pmemobj_open(path, LAYOUT_NAME)) == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	for (uint64_t t = 0; t <= TEST_TYPES; ++t)
+		check_type(pop, t);
+
 	pmemobj_close(pop);
 
 	DONE(NULL);
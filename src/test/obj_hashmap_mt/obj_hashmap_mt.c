@@ -0,0 +1,299 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_hashmap_mt.c -- concurrent inserts and lookups of the hashmap_mt
+ * example, within and outside of transactions
+ */
+
+#include <stdio.h>
+
+#include "unittest.h"
+#include "hashmap_mt.h"
+
+#define	LAYOUT_NAME "obj_hashmap_mt"
+
+#define	WRITERS 4
+#define	READERS 4
+#define	KEYS_PER_WRITER 1024 /* multiple of TX_INSERTS */
+#define	TX_INSERTS 16 /* keys per transaction of the odd writers */
+#define	DEFERRED_KEYS 1000
+#define	TX_GROW_KEYS 20000 /* keys inserted one per transaction */
+
+/* initial number of buckets of the hashmap */
+#define	INIT_BUCKETS 64
+
+/* bound of the average number of pairs in a bucket of a grown hashmap */
+#define	MAX_LOAD 4
+
+struct root {
+	TOID(struct hashmap_mt) map;
+	TOID(struct hashmap_mt) deferred;
+	TOID(struct hashmap_mt) tx_grow[2];
+};
+
+static PMEMobjpool *pop;
+static TOID(struct hashmap_mt) map;
+
+/* number of committed keys of each writer */
+static uint64_t published[WRITERS];
+static int writers_done;
+
+/*
+ * key_of -- returns i-th key of the writer
+ */
+static uint64_t
+key_of(unsigned w, uint64_t i)
+{
+	return ((uint64_t)w << 32) | (i + 1);
+}
+
+/*
+ * value_of -- returns value of the key, which is never dereferenced
+ */
+static PMEMoid
+value_of(uint64_t key)
+{
+	PMEMoid value = OID_NULL;
+	value.off = key;
+
+	return value;
+}
+
+/*
+ * check_key -- checks if the key is in the hashmap with its value
+ */
+static void
+check_key(TOID(struct hashmap_mt) hm, uint64_t key)
+{
+	UT_ASSERT(hm_mt_lookup(pop, hm, key));
+	UT_ASSERTeq(hm_mt_get(pop, hm, key).off, key);
+}
+
+/*
+ * nbuckets -- returns number of buckets of the hashmap
+ */
+static uint64_t
+nbuckets(TOID(struct hashmap_mt) hm)
+{
+	FILE *f = tmpfile();
+	UT_ASSERTne(f, NULL);
+	UT_ASSERTeq(hm_mt_cmd(pop, hm, HASHMAP_CMD_DEBUG,
+			(uint64_t)(uintptr_t)f), 0);
+	rewind(f);
+
+	uint64_t seed;
+	uint64_t count;
+	uint64_t n;
+	UT_ASSERTeq(fscanf(f, "seed: %lu\ncount: %lu, buckets: %lu",
+			&seed, &count, &n), 3);
+	fclose(f);
+
+	return n;
+}
+
+/*
+ * writer -- inserts the keys of the writer, the odd writers insert them
+ * in batches within transactions
+ */
+static void *
+writer(void *arg)
+{
+	unsigned w = (unsigned)(uintptr_t)arg;
+	uint64_t n = w % 2 ? TX_INSERTS : 1;
+
+	for (uint64_t i = 0; i < KEYS_PER_WRITER; i += n) {
+		if (n == 1) {
+			UT_ASSERTeq(hm_mt_insert(pop, map, key_of(w, i),
+					value_of(key_of(w, i))), 0);
+		} else {
+			uint64_t keys[TX_INSERTS];
+			PMEMoid values[TX_INSERTS];
+			for (uint64_t j = 0; j < n; j++) {
+				keys[j] = key_of(w, i + j);
+				values[j] = value_of(keys[j]);
+			}
+
+			/* a single batch locks its stripes in order */
+			TX_BEGIN(pop) {
+				UT_ASSERTeq(hm_mt_insert_batch(pop, map,
+						keys, values, n), 0);
+			} TX_ONABORT {
+				UT_ASSERT(0);
+			} TX_END
+		}
+
+		__atomic_store_n(&published[w], i + n, __ATOMIC_RELEASE);
+
+		/* outside of a transaction, after the deferred splits */
+		check_key(map, key_of(w, i + n - 1));
+	}
+
+	return NULL;
+}
+
+/*
+ * reader -- looks up the committed keys and the keys which are never
+ * inserted until all writers are done
+ */
+static void *
+reader(void *arg)
+{
+	unsigned seed = (unsigned)(uintptr_t)arg;
+
+	while (!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE)) {
+		unsigned w = (unsigned)rand_r(&seed) % WRITERS;
+		uint64_t n = __atomic_load_n(&published[w], __ATOMIC_ACQUIRE);
+		if (n == 0)
+			continue;
+
+		uint64_t i = (uint64_t)rand_r(&seed) % n;
+		check_key(map, key_of(w, i));
+		UT_ASSERT(!hm_mt_lookup(pop, map, key_of(WRITERS, i)));
+		UT_ASSERT(OID_IS_NULL(hm_mt_get(pop, map,
+				key_of(WRITERS, i))));
+	}
+
+	return NULL;
+}
+
+/*
+ * test_concurrent -- inserts keys and looks them up from many threads
+ */
+static void
+test_concurrent(void)
+{
+	pthread_t writers[WRITERS];
+	pthread_t readers[READERS];
+
+	for (unsigned i = 0; i < READERS; ++i)
+		PTHREAD_CREATE(&readers[i], NULL, reader,
+				(void *)(uintptr_t)i);
+	for (unsigned i = 0; i < WRITERS; ++i)
+		PTHREAD_CREATE(&writers[i], NULL, writer,
+				(void *)(uintptr_t)i);
+
+	for (unsigned i = 0; i < WRITERS; ++i)
+		PTHREAD_JOIN(writers[i], NULL);
+	__atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+	for (unsigned i = 0; i < READERS; ++i)
+		PTHREAD_JOIN(readers[i], NULL);
+
+	UT_ASSERTeq(hm_mt_count(pop, map), WRITERS * KEYS_PER_WRITER);
+	for (unsigned w = 0; w < WRITERS; ++w)
+		for (uint64_t i = 0; i < KEYS_PER_WRITER; ++i)
+			check_key(map, key_of(w, i));
+
+	UT_ASSERT(nbuckets(map) > INIT_BUCKETS);
+}
+
+/*
+ * test_deferred -- checks the splits which a transaction couldn't do itself
+ * are done by the next call outside of one
+ */
+static void
+test_deferred(TOID(struct hashmap_mt) hm)
+{
+	TX_BEGIN(pop) {
+		for (uint64_t i = 0; i < DEFERRED_KEYS; ++i)
+			UT_ASSERTeq(hm_mt_insert(pop, hm, key_of(0, i),
+					value_of(key_of(0, i))), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	uint64_t n = nbuckets(hm);
+	UT_ASSERT(n > INIT_BUCKETS);
+
+	check_key(hm, key_of(0, 0));
+	UT_ASSERT(nbuckets(hm) > n);
+
+	for (uint64_t i = 0; i < DEFERRED_KEYS; ++i)
+		check_key(hm, key_of(0, i));
+}
+
+/*
+ * test_tx_grow -- checks the inserts done one per transaction into two
+ * hashmaps split the buckets of both
+ */
+static void
+test_tx_grow(TOID(struct hashmap_mt) *hms)
+{
+	for (uint64_t i = 0; i < TX_GROW_KEYS; ++i) {
+		TOID(struct hashmap_mt) hm = hms[i % 2];
+		TX_BEGIN(pop) {
+			UT_ASSERTeq(hm_mt_insert(pop, hm, key_of(0, i),
+					value_of(key_of(0, i))), 0);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+	}
+
+	for (unsigned m = 0; m < 2; ++m) {
+		UT_ASSERT(nbuckets(hms[m]) * MAX_LOAD >=
+				TX_GROW_KEYS / 2);
+		UT_ASSERTeq(hm_mt_count(pop, hms[m]), TX_GROW_KEYS / 2);
+	}
+
+	for (uint64_t i = 0; i < TX_GROW_KEYS; ++i)
+		check_key(hms[i % 2], key_of(0, i));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_hashmap_mt");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME,
+	    PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof (*r)));
+	UT_ASSERTne(r, NULL);
+
+	UT_ASSERTeq(hm_mt_new(pop, &r->map, NULL), 0);
+	UT_ASSERTeq(hm_mt_new(pop, &r->deferred, NULL), 0);
+	UT_ASSERTeq(hm_mt_new(pop, &r->tx_grow[0], NULL), 0);
+	UT_ASSERTeq(hm_mt_new(pop, &r->tx_grow[1], NULL), 0);
+	map = r->map;
+
+	test_concurrent();
+	test_deferred(r->deferred);
+	test_tx_grow(r->tx_grow);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
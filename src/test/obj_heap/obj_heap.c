@@ -74,7 +74,7 @@ test_heap()
 	pop->persist = obj_heap_persist;
 
 	UT_ASSERT(heap_check(pop) != 0);
-	UT_ASSERT(heap_init(pop) == 0);
+	UT_ASSERT(heap_init(pop, 0) == 0);
 	UT_ASSERT(heap_boot(pop) == 0);
 	UT_ASSERT(pop->heap != NULL);
 
@@ -136,12 +136,66 @@ test_heap()
 	Free(mpop);
 }
 
+static void
+test_heap_zeroed()
+{
+	struct mock_pop *mpop = Malloc(MOCK_POOL_SIZE);
+	PMEMobjpool *pop = &mpop->p;
+	memset(pop, 0, MOCK_POOL_SIZE);
+	pop->size = MOCK_POOL_SIZE;
+	pop->heap_size = MOCK_POOL_SIZE - sizeof (PMEMobjpool);
+	pop->heap_offset = (uint64_t)((uint64_t)&mpop->heap - (uint64_t)mpop);
+	pop->persist = obj_heap_persist;
+
+	/* the whole heap is zeroed, zones are initialized up front */
+	UT_ASSERT(heap_init(pop, 1) == 0);
+	UT_ASSERT(heap_check(pop) == 0);
+	UT_ASSERT(heap_boot(pop) == 0);
+
+	struct heap_layout *layout =
+		(struct heap_layout *)((uintptr_t)pop + pop->heap_offset);
+	struct zone *z = ZID_TO_ZONE(layout, 0);
+	UT_ASSERTeq(z->header.magic, ZONE_HEADER_MAGIC);
+	UT_ASSERTeq(z->chunk_headers[0].type, CHUNK_TYPE_FREE);
+	UT_ASSERT(z->chunk_headers[0].flags & CHUNK_FLAG_ZEROED);
+
+	Lane_idx = 0;
+
+	struct bucket *b_def = heap_get_best_bucket(pop, CHUNKSIZE);
+	struct memory_block m = {0, 0, 1, 0};
+	UT_ASSERT(heap_get_bestfit_block(pop, b_def, &m) == 0);
+
+	/* the remainder of the split chunk is still zeroed */
+	struct chunk_header *rem = &z->chunk_headers[m.chunk_id + 1];
+	UT_ASSERTeq(rem->type, CHUNK_TYPE_FREE);
+	UT_ASSERT(rem->flags & CHUNK_FLAG_ZEROED);
+
+	/* the flag is consumed by the first user of the block */
+	UT_ASSERTeq(heap_block_clear_zeroed(pop, m), 1);
+	UT_ASSERTeq(heap_block_clear_zeroed(pop, m), 0);
+	UT_ASSERTeq(z->chunk_headers[m.chunk_id].flags & CHUNK_FLAG_ZEROED, 0);
+
+	/* and it never survives an allocation */
+	struct operation_context *ctx = operation_init(pop, NULL);
+	heap_prep_block_header_operation(pop, m, HEAP_OP_ALLOC, ctx);
+	operation_process(ctx);
+	operation_delete(ctx);
+	UT_ASSERTeq(z->chunk_headers[m.chunk_id].type, CHUNK_TYPE_USED);
+	UT_ASSERTeq(z->chunk_headers[m.chunk_id].flags, 0);
+
+	UT_ASSERT(heap_check(pop) == 0);
+	heap_cleanup(pop);
+
+	Free(mpop);
+}
+
 int
 main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_heap");
 
 	test_heap();
+	test_heap_zeroed();
 
 	DONE(NULL);
 }
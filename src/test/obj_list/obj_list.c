@@ -386,6 +386,35 @@ FUNC_MOCK(pfree, int, PMEMobjpool *pop, uint64_t *ptr)
 	}
 FUNC_MOCK_END
 
+/*
+ * pfree_batch -- pfree_batch mock
+ *
+ * Applies the entries of the callback using redo log and prints freeing
+ * struct oob_item ids. Doesn't free the memory.
+ */
+FUNC_MOCK(pfree_batch, size_t, PMEMobjpool *pop, struct redo_log *redo,
+	uint64_t *offs, size_t noffs, pfree_batch_cb cb, void *arg)
+	FUNC_MOCK_RUN_DEFAULT {
+		struct operation_entry entries[PFREE_BATCH_MAX_ENTRIES];
+		size_t nentries = cb(pop, offs, noffs, entries, arg);
+
+		for (size_t i = 0; i < nentries; ++i)
+			redo_log_store(pop, redo, i,
+				OBJ_PTR_TO_OFF(pop, entries[i].ptr),
+				entries[i].value);
+		redo_log_set_last(pop, redo, nentries - 1);
+		redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+		for (size_t i = 0; i < noffs; ++i) {
+			struct oob_item *item = (struct oob_item *)
+				((uintptr_t)Pop + offs[i] - OOB_OFF);
+			UT_OUT("pfree(id = %d)", item->item.id);
+		}
+
+		return noffs;
+	}
+FUNC_MOCK_END
+
 /*
  * pmalloc_construct -- pmalloc_construct mock
  *
@@ -394,7 +423,7 @@ FUNC_MOCK_END
  */
 FUNC_MOCK(pmalloc_construct, int, PMEMobjpool *pop, uint64_t *off,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg)
+	size_t usable_size, int zeroed, void *arg), void *arg)
 	FUNC_MOCK_RUN_DEFAULT {
 		size = 2 * (size - OOB_OFF) + OOB_OFF;
 		uint64_t *alloc_size = (uint64_t *)((uintptr_t)Pop +
@@ -409,7 +438,7 @@ FUNC_MOCK(pmalloc_construct, int, PMEMobjpool *pop, uint64_t *off,
 		Pop->persist(Pop, Heap_offset, sizeof (*Heap_offset));
 
 		void *ptr = (void *)((uintptr_t)Pop + *off);
-		constructor(pop, ptr, size, arg);
+		constructor(pop, ptr, size, 0, arg);
 
 		return 0;
 	}
@@ -446,12 +475,12 @@ FUNC_MOCK_END
  */
 FUNC_MOCK(prealloc_construct, int, PMEMobjpool *pop, uint64_t *off,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg)
+	size_t usable_size, int zeroed, void *arg), void *arg)
 	FUNC_MOCK_RUN_DEFAULT {
 		int ret = prealloc(pop, off, size);
 		if (!ret) {
 			void *ptr = (void *)((uintptr_t)Pop + *off + OOB_OFF);
-			constructor(pop, ptr, size, arg);
+			constructor(pop, ptr, size, 0, arg);
 		}
 		return ret;
 	}
@@ -785,7 +814,8 @@ do_print_reverse(PMEMobjpool *pop, const char *arg)
  * new value
  */
 static int
-item_constructor(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+item_constructor(PMEMobjpool *pop, void *ptr, size_t usable_size,
+	int zeroed, void *arg)
 {
 	int id = *(int *)arg;
 	struct item *item = (struct item *)ptr;
@@ -186,7 +186,7 @@ test_mock_pool_allocs()
 	mock_pop->drain = obj_drain;
 	mock_pop->memcpy_persist = obj_memcpy;
 
-	heap_init(mock_pop);
+	heap_init(mock_pop, 0);
 	heap_boot(mock_pop);
 
 	lane_boot(mock_pop);
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_queue.c -- unit test for persistent atomic FIFO queue
+ */
+
+#include <errno.h>
+
+#include "unittest.h"
+#include "libpmemobj.h"
+
+#define	LAYOUT_NAME "obj_queue"
+
+#define	NELEMENTS 10
+#define	NTHREADS 4
+#define	NOPS 1000
+
+POBJ_LAYOUT_BEGIN(obj_queue);
+POBJ_LAYOUT_ROOT(obj_queue, struct root);
+POBJ_LAYOUT_TOID(obj_queue, struct item);
+POBJ_LAYOUT_END(obj_queue);
+
+struct item {
+	POBJ_QUEUE_ENTRY(struct item) next;
+	uint64_t value;
+};
+
+POBJ_QUEUE_HEAD(item_queue, struct item);
+
+struct root {
+	struct item_queue queue;
+	TOID(struct item) slots[NTHREADS];
+	uint64_t sums[NTHREADS];
+};
+
+static PMEMobjpool *pop;
+static TOID(struct root) root;
+
+/*
+ * item_construct -- constructor of queue elements
+ */
+static int
+item_construct(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	struct item *item = ptr;
+	item->value = *(uint64_t *)arg;
+	pmemobj_persist(pop, &item->value, sizeof (item->value));
+
+	return 0;
+}
+
+/*
+ * push_new -- appends a new element with the given value
+ */
+static TOID(struct item)
+push_new(uint64_t value)
+{
+	TOID(struct item) item;
+	TOID_ASSIGN(item, POBJ_QUEUE_PUSH_NEW(pop, &D_RW(root)->queue, next,
+		sizeof (struct item), item_construct, &value));
+	UT_ASSERT(!TOID_IS_NULL(item));
+
+	return item;
+}
+
+/*
+ * do_basic -- checks FIFO order and the state of the head after push and pop
+ */
+static void
+do_basic(void)
+{
+	struct item_queue *queue = &D_RW(root)->queue;
+	TOID(struct item) item;
+
+	UT_ASSERT(POBJ_QUEUE_EMPTY(queue));
+	UT_ASSERTeq(POBJ_QUEUE_POP(pop, queue, next, NULL), ENOENT);
+
+	for (uint64_t i = 0; i < NELEMENTS; ++i) {
+		item = push_new(i);
+		UT_ASSERT(TOID_EQUALS(POBJ_QUEUE_LAST(queue), item));
+		UT_ASSERT(TOID_IS_NULL(POBJ_QUEUE_NEXT(item, next)));
+	}
+
+	uint64_t n = 0;
+	POBJ_QUEUE_FOREACH(item, queue, next) {
+		UT_ASSERTeq(D_RO(item)->value, n);
+		n++;
+	}
+	UT_ASSERTeq(n, NELEMENTS);
+
+	/* pop to a persistent slot */
+	TOID(struct item) *slot = &D_RW(root)->slots[0];
+	UT_ASSERTeq(POBJ_QUEUE_POP(pop, queue, next, &slot->oid), 0);
+	UT_ASSERTeq(D_RO(*slot)->value, 0);
+
+	/* push it back as the last element */
+	UT_ASSERTeq(POBJ_QUEUE_PUSH(pop, queue, *slot, next), 0);
+	UT_ASSERT(TOID_EQUALS(POBJ_QUEUE_LAST(queue), *slot));
+	TOID_ASSIGN(*slot, OID_NULL);
+
+	/* pop to a volatile variable */
+	for (uint64_t i = 1; i < NELEMENTS; ++i) {
+		UT_ASSERTeq(POBJ_QUEUE_POP(pop, queue, next, &item.oid), 0);
+		UT_ASSERTeq(D_RO(item)->value, i);
+		pmemobj_free(&item.oid);
+	}
+
+	UT_ASSERT(TOID_EQUALS(POBJ_QUEUE_FIRST(queue),
+		POBJ_QUEUE_LAST(queue)));
+	UT_ASSERTeq(D_RO(POBJ_QUEUE_FIRST(queue))->value, 0);
+
+	/* pop and free the last one */
+	UT_ASSERTeq(POBJ_QUEUE_POP_FREE(pop, queue, next), 0);
+	UT_ASSERT(POBJ_QUEUE_EMPTY(queue));
+	UT_ASSERT(TOID_IS_NULL(POBJ_QUEUE_LAST(queue)));
+	UT_ASSERTeq(POBJ_QUEUE_POP(pop, queue, next, &item.oid), ENOENT);
+
+	TOID(struct item) any;
+	POBJ_FOREACH_TYPE(pop, any)
+		UT_ASSERT(0);
+}
+
+/*
+ * producer -- pushes NOPS elements with consecutive values
+ */
+static void *
+producer(void *arg)
+{
+	uint64_t base = (uint64_t)(uintptr_t)arg * NOPS;
+
+	for (uint64_t i = 0; i < NOPS; ++i)
+		push_new(base + i);
+
+	return NULL;
+}
+
+/*
+ * consumer -- pops NOPS elements and sums up their values
+ */
+static void *
+consumer(void *arg)
+{
+	unsigned idx = (unsigned)(uintptr_t)arg;
+	struct item_queue *queue = &D_RW(root)->queue;
+	TOID(struct item) *slot = &D_RW(root)->slots[idx];
+	uint64_t *sum = &D_RW(root)->sums[idx];
+
+	for (unsigned i = 0; i < NOPS; ) {
+		if (POBJ_QUEUE_POP(pop, queue, next, &slot->oid) != 0)
+			continue;
+
+		*sum += D_RO(*slot)->value;
+		pmemobj_persist(pop, sum, sizeof (*sum));
+
+		pmemobj_free(&slot->oid);
+		i++;
+	}
+
+	return NULL;
+}
+
+/*
+ * do_mt -- runs concurrent producers and consumers
+ */
+static void
+do_mt(void)
+{
+	pthread_t producers[NTHREADS];
+	pthread_t consumers[NTHREADS];
+
+	for (uintptr_t i = 0; i < NTHREADS; ++i) {
+		PTHREAD_CREATE(&consumers[i], NULL, consumer, (void *)i);
+		PTHREAD_CREATE(&producers[i], NULL, producer, (void *)i);
+	}
+
+	for (int i = 0; i < NTHREADS; ++i) {
+		PTHREAD_JOIN(producers[i], NULL);
+		PTHREAD_JOIN(consumers[i], NULL);
+	}
+
+	uint64_t sum = 0;
+	for (int i = 0; i < NTHREADS; ++i) {
+		sum += D_RO(root)->sums[i];
+		UT_ASSERT(TOID_IS_NULL(D_RO(root)->slots[i]));
+	}
+
+	uint64_t n = NTHREADS * NOPS;
+	UT_ASSERTeq(sum, n * (n - 1) / 2);
+	UT_ASSERT(POBJ_QUEUE_EMPTY(&D_RO(root)->queue));
+	UT_ASSERT(TOID_IS_NULL(POBJ_QUEUE_LAST(&D_RO(root)->queue)));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_queue");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	root = POBJ_ROOT(pop, struct root);
+
+	do_basic();
+	do_mt();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -44,6 +44,8 @@
 #include "pmalloc.h"
 #include "list.h"
 #include "obj.h"
+#include "out.h"
+#include "sync.h"
 
 #define	MAX_THREAD_NUM 200
 
@@ -53,7 +55,11 @@
 #define	NANO_PER_ONE 1000000000LL
 #define	TIMEOUT (NANO_PER_ONE / 1000LL)
 
-#define	FATAL_USAGE() UT_FATAL("usage: obj_sync [mrc] <num_threads> <runs>\n")
+#define	FATAL_USAGE()\
+	UT_FATAL("usage: obj_sync [mrct] <num_threads> <runs> [db]\n")
+
+/* pattern of the lock bytes which are not used with the DRAM lock table */
+#define	UNUSED_PATTERN 0xab
 
 /* posix thread worker typedef */
 typedef void *(*worker)(void *);
@@ -61,6 +67,12 @@ typedef void *(*worker)(void *);
 /* the mock pmemobj pool */
 static PMEMobjpool Mock_pop;
 
+/* rwlocks are reader-biased */
+static int Reader_bias;
+
+/* set by the reader right before it releases the rwlock */
+static volatile int Reader_released;
+
 /* the tested object containing persistent synchronization primitives */
 static struct mock_obj {
 	PMEMmutex mutex;
@@ -285,12 +297,150 @@ timed_check_worker(void *arg)
 	return NULL;
 }
 
+/*
+ * bias_reader_worker -- (internal) hold the rwlock for reading for a while
+ */
+static void *
+bias_reader_worker(void *arg)
+{
+	volatile int *locked = arg;
+
+	UT_ASSERTeq(pmemobj_rwlock_rdlock(&Mock_pop, &Test_obj->rwlock), 0);
+	*locked = 1;
+	usleep(100000);
+	Reader_released = 1;
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, &Test_obj->rwlock), 0);
+
+	return NULL;
+}
+
+/*
+ * test_reader_bias -- (internal) check that writers wait for the readers of
+ * a reader-biased rwlock which do not hold the pthread rwlock
+ */
+static void
+test_reader_bias(void)
+{
+	PMEMrwlock *rwlock = &Test_obj->rwlock;
+
+	/* the writer has to wait for the reader, which owns no pthread lock */
+	volatile int locked = 0;
+	pthread_t reader;
+	PTHREAD_CREATE(&reader, NULL, bias_reader_worker, (void *)&locked);
+	while (!locked)
+		sched_yield();
+	UT_ASSERTeq(pmemobj_rwlock_wrlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(Reader_released, 1);
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+	PTHREAD_JOIN(reader, NULL);
+
+	/* the bias is inhibited after a writer, so it must be restored first */
+	for (int i = 0; i < 2000; ++i) {
+		UT_ASSERTeq(pmemobj_rwlock_rdlock(&Mock_pop, rwlock), 0);
+		UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+	}
+
+	UT_ASSERTeq(pmemobj_rwlock_rdlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(pmemobj_rwlock_trywrlock(&Mock_pop, rwlock), EBUSY);
+
+	struct timespec abs_time;
+	clock_gettime(CLOCK_REALTIME, &abs_time);
+	abs_time.tv_nsec += TIMEOUT;
+	if (abs_time.tv_nsec >= NANO_PER_ONE) {
+		abs_time.tv_sec++;
+		abs_time.tv_nsec -= NANO_PER_ONE;
+	}
+	UT_ASSERTeq(pmemobj_rwlock_timedwrlock(&Mock_pop, rwlock, &abs_time),
+		ETIMEDOUT);
+
+	/* recursive read lock, the visible reader slot is already taken */
+	UT_ASSERTeq(pmemobj_rwlock_tryrdlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(pmemobj_rwlock_trywrlock(&Mock_pop, rwlock), EBUSY);
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+
+	UT_ASSERTeq(pmemobj_rwlock_trywrlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(pmemobj_rwlock_tryrdlock(&Mock_pop, rwlock), EBUSY);
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+}
+
+/*
+ * check_unused -- (internal) verify that the pthread part of a lock, except
+ * for the slot index, has not been touched
+ */
+static void
+check_unused(void *lock)
+{
+	char *bytes = lock;
+	for (size_t i = 2 * sizeof (uint64_t); i < _POBJ_CL_ALIGNMENT; ++i)
+		UT_ASSERTeq(bytes[i], (char)UNUSED_PATTERN);
+}
+
+/*
+ * lock_slot -- (internal) return the lock table slot stored in a lock
+ */
+static uint64_t
+lock_slot(void *lock)
+{
+	return ((uint64_t *)lock)[1];
+}
+
+/*
+ * test_slot_reuse -- (internal) check a lock initialized again within
+ * the run, after being zeroed or reallocated, gets its previous slot
+ */
+static void
+test_slot_reuse(void)
+{
+	PMEMmutex *mutex = &Test_obj->mutex;
+	PMEMrwlock *rwlock = &Test_obj->rwlock;
+
+	/* past the failing runs of the mocks */
+	FUNC_MOCK_RCOUNTER_SET(pthread_mutex_init, 2);
+	FUNC_MOCK_RCOUNTER_SET(pthread_rwlock_init, 2);
+
+	UT_ASSERTeq(pmemobj_mutex_lock(&Mock_pop, mutex), 0);
+	UT_ASSERTeq(pmemobj_mutex_unlock(&Mock_pop, mutex), 0);
+	UT_ASSERTeq(pmemobj_rwlock_rdlock(&Mock_pop, rwlock), 0);
+	UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+
+	uint64_t mutex_slot = lock_slot(mutex);
+	uint64_t rwlock_slot = lock_slot(rwlock);
+	UT_ASSERTne(mutex_slot, rwlock_slot);
+
+	for (int i = 0; i < 1000; ++i) {
+		pmemobj_mutex_zero(&Mock_pop, mutex);
+		UT_ASSERTeq(pmemobj_mutex_lock(&Mock_pop, mutex), 0);
+		UT_ASSERTeq(pmemobj_mutex_unlock(&Mock_pop, mutex), 0);
+		UT_ASSERTeq(lock_slot(mutex), mutex_slot);
+
+		/* a zeroed allocation does not keep the slot index */
+		memset(rwlock, 0, 2 * sizeof (uint64_t));
+		UT_ASSERTeq(pmemobj_rwlock_wrlock(&Mock_pop, rwlock), 0);
+		UT_ASSERTeq(pmemobj_rwlock_unlock(&Mock_pop, rwlock), 0);
+		UT_ASSERTeq(lock_slot(rwlock), rwlock_slot);
+	}
+}
+
 /*
  * cleanup -- (internal) clean up after each run
  */
 static void
 cleanup(char test_type)
 {
+	if (Mock_pop.lock_table != NULL) {
+		check_unused(&Test_obj->mutex);
+		check_unused(&Test_obj->mutex_locked);
+		check_unused(&Test_obj->cond);
+		check_unused(&Test_obj->rwlock);
+
+		/* the pmem-resident locks stay untouched, drop their state */
+		sync_lock_table_delete(Mock_pop.lock_table);
+		Mock_pop.lock_table = sync_lock_table_new(Reader_bias);
+		UT_ASSERTne(Mock_pop.lock_table, NULL);
+		return;
+	}
+
 	switch (test_type) {
 		case 'm':
 			pthread_mutex_destroy(&Test_obj->mutex.pmemmutex.mutex);
@@ -361,6 +511,15 @@ main(int argc, char *argv[])
 
 	unsigned long runs = strtoul(argv[3], NULL, 10);
 
+	int dram_locks = 0;
+	if (argc > 4) {
+		if (argv[4][0] == 'b')
+			Reader_bias = 1;
+		else if (argv[4][0] != 'd')
+			FATAL_USAGE();
+		dram_locks = 1;
+	}
+
 	pthread_t *write_threads = MALLOC(num_threads * sizeof (pthread_t));
 	pthread_t *check_threads = MALLOC(num_threads * sizeof (pthread_t));
 
@@ -368,6 +527,11 @@ main(int argc, char *argv[])
 	mock_open_pool(&Mock_pop);
 	Mock_pop.persist = obj_sync_persist;
 	Test_obj = MALLOC(sizeof (struct mock_obj));
+	if (dram_locks) {
+		Mock_pop.lock_table = sync_lock_table_new(Reader_bias);
+		UT_ASSERTne(Mock_pop.lock_table, NULL);
+		memset(Test_obj, UNUSED_PATTERN, sizeof (*Test_obj));
+	}
 	/* zero-initialize the test object */
 	pmemobj_mutex_zero(&Mock_pop, &Test_obj->mutex);
 	pmemobj_mutex_zero(&Mock_pop, &Test_obj->mutex_locked);
@@ -376,6 +540,9 @@ main(int argc, char *argv[])
 	Test_obj->check_data = 0;
 	memset(&Test_obj->data, 0, DATA_SIZE);
 
+	if (Reader_bias && test_type == 'r')
+		test_reader_bias();
+
 	for (int run = 0; run < runs; run++) {
 		if (test_type == 't') {
 			pmemobj_mutex_lock(&Mock_pop,
@@ -402,6 +569,11 @@ main(int argc, char *argv[])
 		cleanup(test_type);
 	}
 
+	if (Mock_pop.lock_table != NULL) {
+		test_slot_reuse();
+		sync_lock_table_delete(Mock_pop.lock_table);
+	}
+
 	FREE(check_threads);
 	FREE(write_threads);
 	FREE(Test_obj);
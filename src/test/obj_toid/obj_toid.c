@@ -31,7 +31,7 @@
  */
 
 /*
- * obj_toid.c -- unit test for TOID_VALID, DIRECT_RO, DIRECT_RW macros
+ * obj_toid.c -- unit test for TOID_VALID, DIRECT_RO, DIRECT_RW and RPTR macros
  */
 #include <sys/param.h>
 #include "unittest.h"
@@ -39,6 +39,7 @@
 #define	LAYOUT_NAME "toid"
 #define	TEST_NUM 5
 TOID_DECLARE(struct obj, 0);
+RPTR_DECLARE(struct obj);
 
 struct obj {
 	int id;
@@ -87,6 +88,52 @@ do_direct_simple(PMEMobjpool *pop)
 	POBJ_FREE(&obj);
 }
 
+/*
+ * do_rptr -- checks conversions and dereferencing of pool-relative pointers
+ */
+static void
+do_rptr(PMEMobjpool *pop)
+{
+	UT_COMPILE_ERROR_ON(sizeof (RPTR(struct obj)) != sizeof (uint64_t));
+
+	TOID(struct obj) obj;
+	POBJ_NEW(pop, &obj, struct obj, NULL, NULL);
+	D_RW(obj)->id = TEST_NUM;
+
+	RPTR(struct obj) r = {0};
+	UT_ASSERT(RPTR_IS_NULL(r));
+	UT_ASSERTeq(RPTR_RO(pop, r), NULL);
+	UT_ASSERT(OID_IS_NULL(RPTR_OID(pop, r)));
+
+	RPTR_ASSIGN(r, obj);
+	UT_ASSERT(!RPTR_IS_NULL(r));
+	UT_ASSERTeq(RPTR_RO(pop, r), D_RO(obj));
+	UT_ASSERTeq(RPTR_RO(pop, r)->id, TEST_NUM);
+	UT_ASSERT(OID_EQUALS(RPTR_OID(pop, r), obj.oid));
+
+	/* the offset does not depend on the location of the pointer */
+	RPTR(struct obj) copy;
+	memcpy(&copy, &r, sizeof (r));
+	UT_ASSERT(RPTR_EQUALS(copy, r));
+	RPTR_RW(pop, copy)->id = TEST_NUM + 1;
+	UT_ASSERTeq(D_RO(obj)->id, TEST_NUM + 1);
+
+	RPTR_ASSIGN_OID(copy, OID_NULL);
+	UT_ASSERT(RPTR_IS_NULL(copy));
+	RPTR_ASSIGN_DIRECT(pop, copy, D_RW(obj));
+	UT_ASSERT(RPTR_EQUALS(copy, r));
+	RPTR_ASSIGN_DIRECT(pop, copy, NULL);
+	UT_ASSERT(RPTR_IS_NULL(copy));
+	RPTR_ASSIGN_OID(copy, obj.oid);
+	UT_ASSERT(RPTR_EQUALS(copy, r));
+
+	UT_ASSERT(OID_EQUALS(pmemobj_oid(D_RO(obj)), obj.oid));
+	UT_ASSERT(OID_IS_NULL(pmemobj_oid(&copy)));
+	UT_ASSERT(OID_IS_NULL(pmemobj_oid(NULL)));
+
+	POBJ_FREE(&obj);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -103,6 +150,7 @@ main(int argc, char *argv[])
 	do_toid_valid(pop);
 	do_toid_no_valid(pop);
 	do_direct_simple(pop);
+	do_rptr(pop);
 
 	pmemobj_close(pop);
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tree_map_mt.c -- lockless lookups and range scans of a tree map
+ * example concurrent with writers, half of whose transactions are aborted
+ */
+
+#include "unittest.h"
+#include "map.h"
+#include "map_art.h"
+#include "map_ctree.h"
+#include "map_rbtree.h"
+
+#define	LAYOUT_NAME "obj_tree_map_mt"
+
+#define	WRITERS 4
+#define	READERS 4
+#define	TXS_PER_WRITER 400 /* every other one is aborted */
+#define	WINDOW 64 /* number of the latest keys of a writer kept in the map */
+#define	ABORTED (1ULL << 39) /* set in the keys inserted by aborted txs */
+#define	RANGE_EVERY 16 /* a reader does a range scan every that many gets */
+
+#define	VALUE_TYPE 1
+
+struct root {
+	TOID(struct map) map;
+};
+
+static PMEMobjpool *pop;
+static struct map_ctx *mapc;
+static TOID(struct map) map;
+
+/* number of committed transactions of each writer */
+static uint64_t committed[WRITERS];
+/* number of committed transactions once the one in progress commits */
+static uint64_t started[WRITERS];
+static int writers_done;
+
+/*
+ * key_of -- returns the key inserted by i-th committed transaction of
+ * the writer
+ */
+static uint64_t
+key_of(unsigned w, uint64_t i)
+{
+	return ((uint64_t)(w + 1) << 40) | (i + 1);
+}
+
+/*
+ * writer -- inserts a key with a new value and removes the key inserted
+ * WINDOW transactions before, aborts every other transaction
+ */
+static void *
+writer(void *arg)
+{
+	unsigned w = (unsigned)(uintptr_t)arg;
+	uint64_t n = 0;
+
+	for (unsigned t = 0; t < TXS_PER_WRITER; ++t) {
+		int abort = t % 2;
+		uint64_t key = key_of(w, n) | (abort ? ABORTED : 0);
+
+		if (!abort)
+			__atomic_store_n(&started[w], n + 1, __ATOMIC_SEQ_CST);
+
+		TX_BEGIN(pop) {
+			PMEMoid v = pmemobj_tx_alloc(sizeof (uint64_t),
+				VALUE_TYPE);
+			*(uint64_t *)pmemobj_direct(v) = key;
+			UT_ASSERTeq(map_insert(mapc, map, key, v), 0);
+
+			/* the thread sees its changes without waiting */
+			UT_ASSERTeq(map_get(mapc, map, key).off, v.off);
+
+			if (n >= WINDOW) {
+				PMEMoid old = map_remove(mapc, map,
+					key_of(w, n - WINDOW));
+				UT_ASSERT(!OID_IS_NULL(old));
+				pmemobj_tx_free(old);
+			}
+
+			if (abort)
+				pmemobj_tx_abort(ECANCELED);
+		} TX_ONCOMMIT {
+			UT_ASSERT(!abort);
+		} TX_ONABORT {
+			UT_ASSERT(abort);
+		} TX_END
+
+		if (!abort)
+			__atomic_store_n(&committed[w], ++n, __ATOMIC_SEQ_CST);
+	}
+
+	return NULL;
+}
+
+/* state of a range scan of the keys of a writer */
+struct scan {
+	uint64_t last; /* the last key seen */
+	char seen[TXS_PER_WRITER / 2]; /* indexes of the keys seen */
+};
+
+/*
+ * scan_cb -- checks the keys come in order and are all committed
+ */
+static int
+scan_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	struct scan *s = arg;
+
+	UT_ASSERT(key > s->last);
+	UT_ASSERTeq(key & ABORTED, 0);
+	UT_ASSERT(!OID_IS_NULL(value));
+
+	uint64_t i = (key & (ABORTED - 1)) - 1;
+	UT_ASSERT(i < TXS_PER_WRITER / 2);
+	s->seen[i] = 1;
+	s->last = key;
+
+	return 0;
+}
+
+/*
+ * scan -- checks a range scan sees all the keys of the writer which are in
+ * the map from its beginning to its end
+ */
+static void
+scan(unsigned w)
+{
+	struct scan s;
+	memset(&s, 0, sizeof (s));
+
+	uint64_t hi = __atomic_load_n(&committed[w], __ATOMIC_SEQ_CST);
+	UT_ASSERTeq(map_range(mapc, map, key_of(w, 0),
+			key_of(w + 1, 0) - 1, scan_cb, &s), 0);
+	uint64_t end = __atomic_load_n(&started[w], __ATOMIC_SEQ_CST);
+
+	for (uint64_t i = end > WINDOW ? end - WINDOW : 0; i < hi; ++i)
+		UT_ASSERT(s.seen[i]);
+}
+
+/*
+ * reader -- looks up the keys which are in the map, until the writer
+ * removes them, and the keys of the aborted transactions
+ */
+static void *
+reader(void *arg)
+{
+	unsigned seed = (unsigned)(uintptr_t)arg;
+	unsigned gets = 0;
+
+	while (!__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE)) {
+		unsigned w = (unsigned)rand_r(&seed) % WRITERS;
+		uint64_t n = __atomic_load_n(&committed[w], __ATOMIC_SEQ_CST);
+		if (n == 0)
+			continue;
+
+		uint64_t i = n - 1 - (uint64_t)rand_r(&seed) %
+			(n < WINDOW ? n : WINDOW);
+		uint64_t key = key_of(w, i);
+
+		PMEMoid v = map_get(mapc, map, key);
+		uint64_t val = OID_IS_NULL(v) ? 0 :
+			*(uint64_t *)pmemobj_direct(v);
+
+		/* not removed by a committed transaction in the meantime */
+		if (__atomic_load_n(&started[w], __ATOMIC_SEQ_CST) <=
+				i + WINDOW) {
+			UT_ASSERT(!OID_IS_NULL(v));
+			UT_ASSERTeq(val, key);
+		}
+
+		UT_ASSERT(OID_IS_NULL(map_get(mapc, map, key | ABORTED)));
+		UT_ASSERT(!map_lookup(mapc, map, key_of(w, n) | ABORTED));
+
+		if (++gets % RANGE_EVERY == 0)
+			scan(w);
+	}
+
+	return NULL;
+}
+
+/*
+ * count_cb -- counts the keys of the map
+ */
+static int
+count_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	UT_ASSERTeq(key & ABORTED, 0);
+	(*(uint64_t *)arg)++;
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tree_map_mt");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name ctree|rbtree|art", argv[0]);
+
+	const struct map_ops *ops;
+	if (strcmp(argv[2], "ctree") == 0)
+		ops = MAP_CTREE;
+	else if (strcmp(argv[2], "rbtree") == 0)
+		ops = MAP_RBTREE;
+	else if (strcmp(argv[2], "art") == 0)
+		ops = MAP_ART;
+	else
+		UT_FATAL("invalid map type: %s", argv[2]);
+
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME,
+	    PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof (*r)));
+	UT_ASSERTne(r, NULL);
+
+	mapc = map_ctx_init(ops, pop);
+	UT_ASSERTne(mapc, NULL);
+	UT_ASSERTeq(map_new(mapc, &r->map, NULL), 0);
+	map = r->map;
+
+	pthread_t writers[WRITERS];
+	pthread_t readers[READERS];
+
+	for (unsigned i = 0; i < READERS; ++i)
+		PTHREAD_CREATE(&readers[i], NULL, reader,
+				(void *)(uintptr_t)i);
+	for (unsigned i = 0; i < WRITERS; ++i)
+		PTHREAD_CREATE(&writers[i], NULL, writer,
+				(void *)(uintptr_t)i);
+
+	for (unsigned i = 0; i < WRITERS; ++i)
+		PTHREAD_JOIN(writers[i], NULL);
+	__atomic_store_n(&writers_done, 1, __ATOMIC_RELEASE);
+	for (unsigned i = 0; i < READERS; ++i)
+		PTHREAD_JOIN(readers[i], NULL);
+
+	/* only the last WINDOW keys of each writer are left */
+	uint64_t count = 0;
+	UT_ASSERTeq(map_foreach(mapc, map, count_cb, &count), 0);
+	UT_ASSERTeq(count, WRITERS * WINDOW);
+
+	for (unsigned w = 0; w < WRITERS; ++w) {
+		uint64_t n = committed[w];
+		UT_ASSERTeq(n, TXS_PER_WRITER / 2);
+		UT_ASSERT(!map_lookup(mapc, map, key_of(w, n - WINDOW - 1)));
+		for (uint64_t i = n - WINDOW; i < n; ++i)
+			UT_ASSERT(map_lookup(mapc, map, key_of(w, i)));
+	}
+
+	map_ctx_free(mapc);
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_callbacks.c -- unit test for pmemobj_tx_on_end
+ */
+#include "unittest.h"
+
+#define	LAYOUT_NAME "tx_callbacks"
+
+#define	TEST_VALUE_A 5
+#define	TEST_VALUE_B 10
+#define	TEST_VALUE_C 15
+#define	NCALLBACKS 20 /* more than the initial size of the callback array */
+
+TOID_DECLARE(struct test_obj, 1);
+
+struct test_obj {
+	int a;
+	PMEMmutex lock;
+};
+
+struct cb_arg {
+	TOID(struct test_obj) obj;
+	enum pobj_tx_stage stage; /* stage of the last call */
+	int a; /* value of the object field at the time of the call */
+	int locked; /* whether the transaction lock was held at the call */
+	int calls;
+	int order; /* position of the last call among all the calls */
+};
+
+static int ncalls;
+
+/*
+ * on_end_cb -- records the state at the end of the transaction
+ */
+static void
+on_end_cb(PMEMobjpool *pop, enum pobj_tx_stage stage, void *arg)
+{
+	struct cb_arg *e = arg;
+
+	e->stage = stage;
+	e->a = D_RO(e->obj)->a;
+	e->calls++;
+	e->order = ncalls++;
+
+	int ret = pmemobj_mutex_trylock(pop, &D_RW(e->obj)->lock);
+	if (ret == 0)
+		pmemobj_mutex_unlock(pop, &D_RW(e->obj)->lock);
+	e->locked = ret == EBUSY;
+}
+
+/*
+ * reset -- prepares the callback arguments for the next transaction
+ */
+static void
+reset(struct cb_arg *e, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		e[i].stage = TX_STAGE_NONE;
+		e[i].a = 0;
+		e[i].locked = 0;
+		e[i].calls = 0;
+		e[i].order = -1;
+	}
+	ncalls = 0;
+}
+
+/*
+ * do_commit -- checks a callback is called after the commit, with
+ *	the transaction locks still held
+ */
+static void
+do_commit(PMEMobjpool *pop, struct cb_arg *e)
+{
+	reset(e, 1);
+	D_RW(e->obj)->a = TEST_VALUE_A;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &D_RW(e->obj)->lock, TX_LOCK_NONE) {
+		UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, e), 0);
+		TX_ADD(e->obj);
+		D_RW(e->obj)->a = TEST_VALUE_B;
+	} TX_ONCOMMIT {
+		UT_ASSERTeq(e->calls, 1);
+	} TX_END
+
+	UT_ASSERTeq(e->calls, 1);
+	UT_ASSERTeq(e->stage, TX_STAGE_ONCOMMIT);
+	UT_ASSERTeq(e->a, TEST_VALUE_B);
+	UT_ASSERT(e->locked);
+}
+
+/*
+ * do_abort -- checks a callback registered in a nested transaction is
+ *	called once, when the outermost one is aborted, after the rollback
+ */
+static void
+do_abort(PMEMobjpool *pop, struct cb_arg *e)
+{
+	reset(e, 1);
+	D_RW(e->obj)->a = TEST_VALUE_A;
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_MUTEX, &D_RW(e->obj)->lock, TX_LOCK_NONE) {
+		TX_BEGIN(pop) {
+			UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, e), 0);
+			TX_ADD(e->obj);
+			D_RW(e->obj)->a = TEST_VALUE_C;
+		} TX_END
+		UT_ASSERTeq(e->calls, 0);
+		pmemobj_tx_abort(EINVAL);
+	} TX_ONABORT {
+		UT_ASSERTeq(e->calls, 1);
+	} TX_END
+
+	UT_ASSERTeq(e->calls, 1);
+	UT_ASSERTeq(e->stage, TX_STAGE_ONABORT);
+	UT_ASSERTeq(e->a, TEST_VALUE_A);
+	UT_ASSERT(e->locked);
+}
+
+/*
+ * do_nested_abort -- checks the callbacks are called when a nested
+ *	transaction aborts the outermost one
+ */
+static void
+do_nested_abort(PMEMobjpool *pop, struct cb_arg *e)
+{
+	reset(e, 2);
+	D_RW(e[0].obj)->a = TEST_VALUE_A;
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, &e[0]), 0);
+		TX_ADD(e[0].obj);
+		D_RW(e[0].obj)->a = TEST_VALUE_B;
+		TX_BEGIN(pop) {
+			UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, &e[1]), 0);
+			pmemobj_tx_abort(EINVAL);
+		} TX_END
+	} TX_END
+
+	for (int i = 0; i < 2; ++i) {
+		UT_ASSERTeq(e[i].calls, 1);
+		UT_ASSERTeq(e[i].stage, TX_STAGE_ONABORT);
+		UT_ASSERTeq(e[i].a, TEST_VALUE_A);
+		UT_ASSERTeq(e[i].order, i);
+	}
+}
+
+/*
+ * do_order -- checks many callbacks are called in the order of
+ *	registration and none is left for the next transaction
+ */
+static void
+do_order(PMEMobjpool *pop, struct cb_arg *e)
+{
+	reset(e, NCALLBACKS);
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NCALLBACKS / 2; ++i)
+			UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, &e[i]), 0);
+		TX_BEGIN(pop) {
+			for (int i = NCALLBACKS / 2; i < NCALLBACKS; ++i)
+				UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb,
+					&e[i]), 0);
+		} TX_END
+	} TX_END
+
+	for (int i = 0; i < NCALLBACKS; ++i) {
+		UT_ASSERTeq(e[i].calls, 1);
+		UT_ASSERTeq(e[i].stage, TX_STAGE_ONCOMMIT);
+		UT_ASSERTeq(e[i].order, i);
+	}
+
+	TX_BEGIN(pop) {
+	} TX_END
+
+	UT_ASSERTeq(ncalls, NCALLBACKS);
+}
+
+/*
+ * thread_func -- registers callbacks in a thread which exits afterwards
+ */
+static void *
+thread_func(void *arg)
+{
+	struct cb_arg *e = arg;
+	PMEMobjpool *pop = pmemobj_pool_by_oid(e->obj.oid);
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NCALLBACKS; ++i)
+			UT_ASSERTeq(pmemobj_tx_on_end(on_end_cb, e), 0);
+	} TX_END
+
+	UT_ASSERTeq(e->calls, NCALLBACKS);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_callbacks");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+	    S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	TOID(struct test_obj) obj;
+	POBJ_ZNEW(pop, &obj, struct test_obj);
+
+	struct cb_arg e[NCALLBACKS];
+	for (int i = 0; i < NCALLBACKS; ++i)
+		e[i].obj = obj;
+
+	do_commit(pop, e);
+	do_abort(pop, e);
+	do_nested_abort(pop, e);
+	do_order(pop, e);
+
+	/* the callback array of the exiting thread is freed */
+	reset(e, 1);
+	pthread_t thread;
+	PTHREAD_CREATE(&thread, NULL, thread_func, e);
+	PTHREAD_JOIN(thread, NULL);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -43,6 +43,7 @@
 #define	TEST_VALUE_B 10
 #define	TEST_VALUE_C 15
 #define	OPS_NUM 8
+#define	NESTING_DEPTH 20
 TOID_DECLARE(struct test_obj, 1);
 
 struct test_obj {
@@ -258,6 +259,71 @@ do_tx_process_nested(PMEMobjpool *pop)
 	UT_ASSERT(pmemobj_tx_stage() == TX_STAGE_NONE);
 }
 
+/*
+ * tx_nest -- begins depth nested transactions, the innermost one modifies
+ *	the object and aborts if requested
+ */
+static int
+tx_nest(PMEMobjpool *pop, TOID(struct test_obj) *obj, int depth, int abort)
+{
+	int aborted = 0;
+
+	TX_BEGIN(pop) {
+		if (depth > 1) {
+			aborted = tx_nest(pop, obj, depth - 1, abort);
+			UT_ASSERTeq(aborted, 0);
+		} else {
+			TX_ADD(*obj);
+			D_RW(*obj)->a = TEST_VALUE_C;
+			if (abort)
+				pmemobj_tx_abort(EINVAL);
+		}
+	} TX_ONABORT {
+		UT_ASSERTeq(pmemobj_tx_errno(), EINVAL);
+		aborted = 1;
+	} TX_END
+
+	return aborted;
+}
+
+static void
+do_tx_deep_nested(PMEMobjpool *pop, TOID(struct test_obj) *obj)
+{
+	D_RW(*obj)->a = TEST_VALUE_A;
+
+	/* abort at the innermost level waterfalls to all the outer ones */
+	UT_ASSERTeq(tx_nest(pop, obj, NESTING_DEPTH, 1), 1);
+	UT_ASSERTeq(D_RO(*obj)->a, TEST_VALUE_A);
+	UT_ASSERT(pmemobj_tx_stage() == TX_STAGE_NONE);
+
+	UT_ASSERTeq(tx_nest(pop, obj, NESTING_DEPTH, 0), 0);
+	UT_ASSERTeq(D_RO(*obj)->a, TEST_VALUE_C);
+	UT_ASSERT(pmemobj_tx_stage() == TX_STAGE_NONE);
+
+	/* the deep nesting frames are reused by the next transaction */
+	UT_ASSERTeq(tx_nest(pop, obj, 2 * NESTING_DEPTH, 1), 1);
+	UT_ASSERTeq(D_RO(*obj)->a, TEST_VALUE_C);
+}
+
+struct deep_nested_arg {
+	PMEMobjpool *pop;
+	TOID(struct test_obj) *obj;
+};
+
+/*
+ * tx_deep_nested_thread -- nests transactions in a thread, which frees its
+ *	deep nesting frames on exit
+ */
+static void *
+tx_deep_nested_thread(void *arg)
+{
+	struct deep_nested_arg *a = arg;
+
+	do_tx_deep_nested(a->pop, a->obj);
+
+	return NULL;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -286,6 +352,13 @@ main(int argc, char *argv[])
 	}
 	do_tx_process(pop);
 	do_tx_process_nested(pop);
+	do_tx_deep_nested(pop, &obj);
+
+	struct deep_nested_arg arg = {pop, &obj};
+	pthread_t thread;
+	PTHREAD_CREATE(&thread, NULL, tx_deep_nested_thread, &arg);
+	PTHREAD_JOIN(thread, NULL);
+
 	pmemobj_close(pop);
 
 	DONE(NULL);
@@ -45,6 +45,9 @@
 
 #define	OBJ_SIZE	(200 * 1024)
 
+/* number of objects freed by a single transaction */
+#define	FREE_MANY_NOBJS	100
+
 enum type_number {
 	TYPE_FREE_NO_TX,
 	TYPE_FREE_WRONG_UUID,
@@ -59,6 +62,7 @@ enum type_number {
 	TYPE_FREE_OOM,
 	TYPE_FREE_ALLOC,
 	TYPE_FREE_AFTER_ABORT,
+	TYPE_FREE_MANY,
 };
 
 TOID_DECLARE(struct object, 0);
@@ -348,6 +352,83 @@ do_tx_free_abort_free(PMEMobjpool *pop)
 	} TX_END
 }
 
+/*
+ * count_objs -- count objects of specified type number
+ */
+static int
+count_objs(PMEMobjpool *pop, int type_num)
+{
+	int nobjs = 0;
+	for (PMEMoid oid = POBJ_FIRST_TYPE_NUM(pop, type_num);
+			!OID_IS_NULL(oid); oid = POBJ_NEXT_TYPE_NUM(oid))
+		nobjs++;
+
+	return nobjs;
+}
+
+/*
+ * do_tx_free_many -- allocate and free many objects of various sizes, each
+ * time within a single transaction
+ */
+static void
+do_tx_free_many(PMEMobjpool *pop)
+{
+	PMEMoid oids[FREE_MANY_NOBJS];
+
+	/* objects allocated in an aborted transaction are freed */
+	TX_BEGIN(pop) {
+		for (int i = 0; i < FREE_MANY_NOBJS; ++i)
+			pmemobj_tx_alloc(64 + (size_t)(i % 10) * 1000,
+				TYPE_FREE_MANY);
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(OID_IS_NULL(POBJ_FIRST_TYPE_NUM(pop, TYPE_FREE_MANY)));
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < FREE_MANY_NOBJS; ++i)
+			oids[i] = pmemobj_tx_alloc(
+				64 + (size_t)(i % 10) * 1000, TYPE_FREE_MANY);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objs(pop, TYPE_FREE_MANY), FREE_MANY_NOBJS);
+
+	/* aborted free leaves the objects intact */
+	TX_BEGIN(pop) {
+		for (int i = 0; i < FREE_MANY_NOBJS; ++i)
+			pmemobj_tx_free(oids[i]);
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objs(pop, TYPE_FREE_MANY), FREE_MANY_NOBJS);
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < FREE_MANY_NOBJS; ++i)
+			pmemobj_tx_free(oids[i]);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(OID_IS_NULL(POBJ_FIRST_TYPE_NUM(pop, TYPE_FREE_MANY)));
+
+	/* the freed memory is available again */
+	for (int i = 0; i < FREE_MANY_NOBJS; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i],
+			64 + (size_t)(i % 10) * 1000, TYPE_FREE_MANY,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	for (int i = 0; i < FREE_MANY_NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -382,6 +463,8 @@ main(int argc, char *argv[])
 	VALGRIND_WRITE_STATS;
 	do_tx_free_abort_free(pop);
 	VALGRIND_WRITE_STATS;
+	do_tx_free_many(pop);
+	VALGRIND_WRITE_STATS;
 
 	pmemobj_close(pop);
 
@@ -0,0 +1,270 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_read_only.c -- unit test for read-only transactions
+ */
+
+#include <errno.h>
+
+#include "unittest.h"
+#include "libpmemobj.h"
+
+#define	LAYOUT_NAME "tx_read_only"
+#define	TEST_VALUE 5
+
+struct root {
+	PMEMrwlock rwlock;
+	PMEMmutex mutex;
+	PMEMoid obj;
+	int value;
+};
+
+/*
+ * do_tx_ro_commit -- read-only transaction commits and can be repeated
+ */
+static void
+do_tx_ro_commit(PMEMobjpool *pop, struct root *rootp)
+{
+	uint64_t id = 0;
+	int value = 0;
+
+	TX_BEGIN_RO_LOCK(pop, TX_LOCK_MUTEX, &rootp->mutex) {
+		id = pmemobj_tx_id();
+		UT_ASSERTne(id, 0);
+		value = rootp->value;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(value, TEST_VALUE);
+	UT_ASSERTeq(pmemobj_tx_stage(), TX_STAGE_NONE);
+
+	TX_BEGIN_RO(pop) {
+		UT_ASSERT(pmemobj_tx_id() > id);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	/* the lock has been released */
+	UT_ASSERTeq(pmemobj_mutex_trylock(pop, &rootp->mutex), 0);
+	pmemobj_mutex_unlock(pop, &rootp->mutex);
+}
+
+/*
+ * do_tx_ro_modify -- every modification aborts a read-only transaction
+ */
+static void
+do_tx_ro_modify(PMEMobjpool *pop, struct root *rootp, int op)
+{
+	int aborted = 0;
+
+	TX_BEGIN_RO(pop) {
+		switch (op) {
+		case 0:
+			pmemobj_tx_add_range_direct(&rootp->value,
+				sizeof (rootp->value));
+			break;
+		case 1:
+			pmemobj_tx_add_range(rootp->obj, 0, sizeof (int));
+			break;
+		case 2:
+			pmemobj_tx_alloc(sizeof (int), 0);
+			break;
+		case 3:
+			pmemobj_tx_zalloc(sizeof (int), 0);
+			break;
+		case 4:
+			pmemobj_tx_realloc(rootp->obj, 2 * sizeof (int), 0);
+			break;
+		case 5:
+			pmemobj_tx_strdup("abc", 0);
+			break;
+		case 6:
+			pmemobj_tx_free(rootp->obj);
+			break;
+		}
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		aborted = 1;
+	} TX_END
+
+	UT_ASSERTeq(aborted, 1);
+	UT_ASSERTeq(errno, EPERM);
+	UT_ASSERTeq(rootp->value, TEST_VALUE);
+	UT_ASSERT(!OID_IS_NULL(rootp->obj));
+}
+
+/*
+ * do_tx_ro_nested -- transactions nested in a read-only transaction are
+ * read-only, a read-only transaction nested in a regular one can't write
+ * either
+ */
+static void
+do_tx_ro_nested(PMEMobjpool *pop, struct root *rootp)
+{
+	int aborted = 0;
+
+	TX_BEGIN_RO(pop) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(&rootp->value,
+				sizeof (rootp->value));
+			UT_ASSERT(0);
+		} TX_END
+	} TX_ONABORT {
+		aborted = 1;
+	} TX_END
+
+	UT_ASSERTeq(aborted, 1);
+	UT_ASSERTeq(errno, EPERM);
+
+	aborted = 0;
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(&rootp->value,
+			sizeof (rootp->value));
+		rootp->value = TEST_VALUE + 1;
+
+		TX_BEGIN_RO(pop) {
+			UT_ASSERTeq(rootp->value, TEST_VALUE + 1);
+			pmemobj_tx_free(rootp->obj);
+			UT_ASSERT(0);
+		} TX_END
+	} TX_ONABORT {
+		aborted = 1;
+	} TX_END
+
+	/* the outer transaction has been rolled back */
+	UT_ASSERTeq(aborted, 1);
+	UT_ASSERTeq(rootp->value, TEST_VALUE);
+	UT_ASSERT(!OID_IS_NULL(rootp->obj));
+
+	/* nested read-only transaction which only reads commits */
+	TX_BEGIN(pop) {
+		TX_BEGIN_RO(pop) {
+			UT_ASSERTeq(rootp->value, TEST_VALUE);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		pmemobj_tx_add_range_direct(&rootp->value,
+			sizeof (rootp->value));
+		rootp->value = TEST_VALUE;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+struct reader_args {
+	PMEMobjpool *pop;
+	struct root *rootp;
+};
+
+/*
+ * reader -- takes the rwlock in a read-only transaction
+ */
+static void *
+reader(void *arg)
+{
+	struct reader_args *args = arg;
+
+	TX_BEGIN_RO_LOCK(args->pop, TX_LOCK_RWLOCK, &args->rootp->rwlock) {
+		UT_ASSERTeq(args->rootp->value, TEST_VALUE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	return NULL;
+}
+
+/*
+ * do_tx_ro_rwlock -- read-only transactions share the rwlock
+ */
+static void
+do_tx_ro_rwlock(PMEMobjpool *pop, struct root *rootp)
+{
+	struct reader_args args = {pop, rootp};
+
+	TX_BEGIN_RO_LOCK(pop, TX_LOCK_RWLOCK, &rootp->rwlock) {
+		/* would block forever if the lock was taken for writing */
+		pthread_t t;
+		PTHREAD_CREATE(&t, NULL, reader, &args);
+		PTHREAD_JOIN(t, NULL);
+
+		UT_ASSERTne(pmemobj_rwlock_trywrlock(pop, &rootp->rwlock), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	/* a regular transaction takes the rwlock for writing */
+	TX_BEGIN_LOCK(pop, TX_LOCK_RWLOCK, &rootp->rwlock) {
+		UT_ASSERTne(pmemobj_rwlock_tryrdlock(pop, &rootp->rwlock), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_read_only");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+	    S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	PMEMoid root = pmemobj_root(pop, sizeof (struct root));
+	struct root *rootp = pmemobj_direct(root);
+
+	rootp->value = TEST_VALUE;
+	pmemobj_persist(pop, &rootp->value, sizeof (rootp->value));
+
+	int ret = pmemobj_zalloc(pop, &rootp->obj, sizeof (int), 0);
+	UT_ASSERTeq(ret, 0);
+
+	do_tx_ro_commit(pop, rootp);
+
+	for (int op = 0; op < 7; ++op)
+		do_tx_ro_modify(pop, rootp, op);
+
+	do_tx_ro_nested(pop, rootp);
+	do_tx_ro_rwlock(pop, rootp);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * vmem_create_ext.c -- unit test for vmem_create_ext
+ *
+ * usage: vmem_create_ext directory
+ */
+
+#include "unittest.h"
+
+#define	POOL_SIZE ((size_t)(128 << 20))
+#define	NTHREADS 4
+#define	NOBJS 64
+#define	NOPS 4096
+#define	MAX_SIZE (64 << 10)
+
+static const struct vmem_opts Opts[] = {
+	{0, 0, 0, 0},				/* all defaults */
+	{1, 0, 0, 0},				/* single arena */
+	{NTHREADS, 0, 0, 0},			/* arena per thread */
+	{0, VMEM_OPT_NO_TCACHE, 0, 0},		/* no thread caches */
+	{0, 0, 4096, 0},			/* only small sizes cached */
+	{0, 0, MAX_SIZE, 0},			/* larger sizes cached */
+	{0, VMEM_OPT_NO_PURGE, 0, 0},		/* never purge */
+	{0, 0, 0, 1},				/* purge eagerly */
+};
+
+/*
+ * worker -- allocate, fill, verify and free objects of various sizes
+ */
+static void *
+worker(void *arg)
+{
+	VMEM *vmp = arg;
+	unsigned char *objs[NOBJS] = {NULL};
+	size_t sizes[NOBJS] = {0};
+	unsigned seed = (unsigned)(uintptr_t)&objs;
+
+	for (int i = 0; i < NOPS; i++) {
+		int n = rand_r(&seed) % NOBJS;
+		if (objs[n] != NULL) {
+			for (size_t j = 0; j < sizes[n]; j++)
+				UT_ASSERTeq(objs[n][j], (unsigned char)n);
+			vmem_free(vmp, objs[n]);
+		}
+
+		/* mostly small sizes, every 8th one a large size */
+		sizes[n] = (size_t)rand_r(&seed) % (n % 8 ? 512 : MAX_SIZE) + 1;
+		objs[n] = vmem_malloc(vmp, sizes[n]);
+		UT_ASSERTne(objs[n], NULL);
+		memset(objs[n], n, sizes[n]);
+	}
+
+	for (int n = 0; n < NOBJS; n++)
+		vmem_free(vmp, objs[n]);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "vmem_create_ext");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s directory", argv[0]);
+
+	struct vmem_opts invalid = {0, ~0U, 0, 0};
+	errno = 0;
+	UT_ASSERTeq(vmem_create_ext(argv[1], POOL_SIZE, &invalid), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(vmem_create_ext(argv[1], 0, &Opts[0]), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	for (size_t i = 0; i < sizeof (Opts) / sizeof (Opts[0]); i++) {
+		VMEM *vmp = vmem_create_ext(argv[1], POOL_SIZE, &Opts[i]);
+		if (vmp == NULL)
+			UT_FATAL("!vmem_create_ext %zu", i);
+
+		pthread_t threads[NTHREADS];
+		for (int t = 0; t < NTHREADS; t++)
+			PTHREAD_CREATE(&threads[t], NULL, worker, vmp);
+		for (int t = 0; t < NTHREADS; t++)
+			PTHREAD_JOIN(threads[t], NULL);
+
+		UT_ASSERTeq(vmem_check(vmp), 1);
+		vmem_delete(vmp);
+	}
+
+	DONE(NULL);
+}
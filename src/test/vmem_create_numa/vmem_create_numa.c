@@ -0,0 +1,198 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * vmem_create_numa.c -- unit test for vmem_create_numa
+ *
+ * usage: vmem_create_numa directory
+ */
+
+#include "unittest.h"
+
+#define	POOL_SIZE ((size_t)(64 << 20))
+#define	NDIRS 3
+#define	NTHREADS 4
+#define	NOBJS 64
+#define	NOPS 4096
+#define	MAX_SIZE (64 << 10)
+#define	NHUGE 4
+#define	HUGE_SIZE ((size_t)(4 << 20))
+#define	MAX_HUGE (NDIRS * POOL_SIZE / HUGE_SIZE)
+
+static const struct vmem_opts Opts[] = {
+	{0, 0, 0, 0},				/* pool of the local node */
+	{0, VMEM_OPT_INTERLEAVE, 0, 0},		/* all pools in turn */
+	{1, VMEM_OPT_INTERLEAVE | VMEM_OPT_NO_TCACHE, 0, 0},
+};
+
+/*
+ * worker -- allocate, resize, verify and free objects of various sizes
+ */
+static void *
+worker(void *arg)
+{
+	VMEM *vmp = arg;
+	unsigned char *objs[NOBJS] = {NULL};
+	size_t sizes[NOBJS] = {0};
+	unsigned seed = (unsigned)(uintptr_t)&objs;
+
+	for (int i = 0; i < NOPS; i++) {
+		int n = rand_r(&seed) % NOBJS;
+		size_t size = (size_t)rand_r(&seed) %
+				(n % 8 ? 512 : MAX_SIZE) + 1;
+
+		if (objs[n] != NULL) {
+			for (size_t j = 0; j < sizes[n]; j++)
+				UT_ASSERTeq(objs[n][j], (unsigned char)n);
+			UT_ASSERT(vmem_malloc_usable_size(vmp, objs[n]) >=
+					sizes[n]);
+
+			if (i % 2) {
+				vmem_free(vmp, objs[n]);
+				objs[n] = vmem_malloc(vmp, size);
+			} else {
+				objs[n] = vmem_realloc(vmp, objs[n], size);
+				if (size > sizes[n])
+					size = sizes[n];
+			}
+		} else {
+			objs[n] = vmem_calloc(vmp, 1, size);
+			UT_ASSERTne(objs[n], NULL);
+			for (size_t j = 0; j < size; j++)
+				UT_ASSERTeq(objs[n][j], 0);
+		}
+		UT_ASSERTne(objs[n], NULL);
+
+		sizes[n] = size;
+		memset(objs[n], n, sizes[n]);
+	}
+
+	for (int n = 0; n < NOBJS; n++)
+		vmem_free(vmp, objs[n]);
+
+	return NULL;
+}
+
+/*
+ * test_fallback -- exhaust the pool of the calling thread, the allocations
+ * have to be served from the other pools of the set
+ */
+static void
+test_fallback(const char **dirs)
+{
+	VMEM *vmp = vmem_create_numa(dirs, NDIRS, POOL_SIZE, NULL);
+	if (vmp == NULL)
+		UT_FATAL("!vmem_create_numa");
+
+	char *small = vmem_malloc(vmp, 64);
+	UT_ASSERTne(small, NULL);
+	memset(small, 1, 64);
+
+	void *huge[MAX_HUGE];
+	size_t n = 0;
+	while (n < MAX_HUGE && (huge[n] = vmem_malloc(vmp, HUGE_SIZE)) != NULL)
+		n++;
+	UT_ASSERT(n * HUGE_SIZE > POOL_SIZE);
+
+	/* the pool of the small block is full, growing moves it */
+	vmem_free(vmp, huge[--n]);
+	small = vmem_realloc(vmp, small, HUGE_SIZE);
+	UT_ASSERTne(small, NULL);
+	for (int i = 0; i < 64; i++)
+		UT_ASSERTeq(small[i], 1);
+	vmem_free(vmp, small);
+
+	while (n > 0)
+		vmem_free(vmp, huge[--n]);
+
+	UT_ASSERTeq(vmem_check(vmp), 1);
+	vmem_delete(vmp);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "vmem_create_numa");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s directory", argv[0]);
+
+	const char *dirs[NDIRS];
+	for (int i = 0; i < NDIRS; i++)
+		dirs[i] = argv[1];
+
+	errno = 0;
+	UT_ASSERTeq(vmem_create_numa(dirs, 0, POOL_SIZE, NULL), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	struct vmem_opts invalid = {0, ~0U, 0, 0};
+	errno = 0;
+	UT_ASSERTeq(vmem_create_numa(dirs, NDIRS, POOL_SIZE, &invalid), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(vmem_create_numa(dirs, NDIRS, 0, NULL), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	for (size_t i = 0; i < sizeof (Opts) / sizeof (Opts[0]); i++) {
+		VMEM *vmp = vmem_create_numa(dirs, NDIRS, POOL_SIZE, &Opts[i]);
+		if (vmp == NULL)
+			UT_FATAL("!vmem_create_numa %zu", i);
+
+		pthread_t threads[NTHREADS];
+		for (int t = 0; t < NTHREADS; t++)
+			PTHREAD_CREATE(&threads[t], NULL, worker, vmp);
+		for (int t = 0; t < NTHREADS; t++)
+			PTHREAD_JOIN(threads[t], NULL);
+
+		/* huge allocations have to be freed in their own pool */
+		void *huge[NHUGE];
+		for (int h = 0; h < NHUGE; h++) {
+			huge[h] = vmem_malloc(vmp, HUGE_SIZE);
+			UT_ASSERTne(huge[h], NULL);
+		}
+		for (int h = 0; h < NHUGE; h++)
+			vmem_free(vmp, huge[h]);
+
+		char *s = vmem_strdup(vmp, "vmem_create_numa");
+		UT_ASSERTne(s, NULL);
+		UT_ASSERTeq(strcmp(s, "vmem_create_numa"), 0);
+		vmem_free(vmp, s);
+
+		UT_ASSERTeq(vmem_check(vmp), 1);
+		vmem_delete(vmp);
+	}
+
+	test_fallback(dirs);
+
+	DONE(NULL);
+}
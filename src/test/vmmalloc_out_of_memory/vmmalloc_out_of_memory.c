@@ -33,7 +33,10 @@
 /*
  * vmmalloc_out_of_memory -- unit test for libvmmalloc out_of_memory
  *
- * usage: vmmalloc_out_of_memory
+ * usage: vmmalloc_out_of_memory [npools]
+ *
+ * With npools given, all of the pools have to be used before the
+ * allocations fail.
  */
 
 #include "unittest.h"
@@ -45,6 +48,7 @@ main(int argc, char *argv[])
 
 	/* allocate all memory */
 	void *prev = NULL;
+	size_t count = 0;
 	for (;;) {
 		void **next = malloc(sizeof (void *));
 		if (next == NULL) {
@@ -54,10 +58,21 @@ main(int argc, char *argv[])
 
 		*next = prev;
 		prev = next;
+		count++;
 	}
 
 	UT_ASSERTne(prev, NULL);
 
+	if (argc > 1) {
+		size_t npools = strtoul(argv[1], NULL, 10);
+		char *size = getenv("VMMALLOC_POOL_SIZE");
+		UT_ASSERTne(size, NULL);
+
+		/* more than the other pools could hold */
+		UT_ASSERT(count * sizeof (void *) >
+				(npools - 1) * strtoul(size, NULL, 10));
+	}
+
 	/* free all allocations */
 	while (prev != NULL) {
 		void **act = prev;
@@ -1023,6 +1023,18 @@ pmempool_check_pool_hdr_default(struct pmempool_check *pcp,
 		}
 	}
 
+	/* block checksums are an optional feature of blk pools */
+	if (pcp->params.type == PMEM_POOL_TYPE_BLK &&
+	    hdrp->incompat_features == (def_hdrp->incompat_features |
+				BLK_FORMAT_INCOMPAT_CSUM))
+		def_hdrp->incompat_features = hdrp->incompat_features;
+
+	/* pools created zeroed have their free chunks flagged as such */
+	if (pcp->params.type == PMEM_POOL_TYPE_OBJ &&
+	    hdrp->incompat_features == (def_hdrp->incompat_features |
+				OBJ_FORMAT_INCOMPAT_ZEROED))
+		def_hdrp->incompat_features = hdrp->incompat_features;
+
 	if (hdrp->incompat_features != def_hdrp->incompat_features) {
 		outv(1, "pool_hdr.incompat_features is not valid\n");
 		if (ask_Yn(pcp->ans, "Do you want to set it to default value "
@@ -1504,10 +1516,13 @@ pmempool_check_btt_info_advanced_repair(struct pmempool_check *pcp,
 
 	uint32_t lbasize = pcp->hdr.blk.bsize;
 
+	int csum = (le32toh(pcp->hdr.pool.incompat_features) &
+			BLK_FORMAT_INCOMPAT_CSUM) != 0;
+
 	/* init btt in requested area */
 	struct btt *bttp = btt_init(rawsize,
 				lbasize, pcp->hdr.pool.poolset_uuid,
-				BTT_DEFAULT_NFREE,
+				BTT_DEFAULT_NFREE, csum,
 				(void *)&btt_context,
 				&pmempool_check_btt_ns_callback);
 